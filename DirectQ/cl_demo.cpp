@@ -20,6 +20,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "d3d_model.h"
 #include "d3d_quake.h"
+#include "particles.h"
+
+#include <vector>
+#include <fstream>
 
 // JPG 1.05 - support for recording demos after connecting to the server
 byte	demo_head[3][MAX_MSGLEN];
@@ -28,10 +32,453 @@ int		demo_head_size[2];
 static int td_frames = 0;
 
 static CQuakeFile demofile;
-static long demofile_len, demofile_start;
+static long demofile_len;
+
+// net_message's own buffer while it's pointed at a message in a mapped demo
+static byte *demo_netbuffer = NULL;
 
 void CL_FinishTimeDemo (void);
 void Menu_DemoPopulate (void);
+void CL_KillBeams (void);
+
+cvar_t cl_demoindex ("cl_demoindex", "1", CVAR_ARCHIVE);
+
+
+/*
+==============================================================================
+
+DEMO INDEXING
+
+An index is a small file in cache/demos holding the length of a demo in demo
+time and the keyframes that have been taken while playing it.  It's written
+when recording stops, or built the first time the demo is played by walking the
+message lengths; nothing is parsed so that runs at I/O speed.
+
+Demo time only advances by the difference between consecutive svc_time
+messages so it keeps going across level changes (where server time resets)
+and a seek position means the same thing for the whole demo.
+
+A keyframe is the offset of a message plus the client state that isn't resent
+every frame, so it can only be taken while playing.  One is added to the
+index every DEMO_KEYFRAME_INTERVAL seconds of play and they're saved back to
+it when playback stops, so seeking only needs to replay from the nearest one
+at or before the target, and later playbacks can jump straight to any part
+that was played before.  Entities don't need to be kept as every update is
+sent relative to the baselines.
+==============================================================================
+*/
+
+#define DEMO_INDEX_IDENT		(('X' << 24) + ('D' << 16) + ('Q' << 8) + 'D')
+#define DEMO_INDEX_VERSION		2
+
+// seconds of demo time between keyframes
+#define DEMO_KEYFRAME_INTERVAL	2.0
+
+// an index is matched to it's demo by the length and a hash of this much of the start
+#define DEMO_HASH_BYTES			0x10000
+
+struct demoindexheader_t
+{
+	int ident;
+	int version;
+	int demolength;
+	unsigned __int64 headhash;
+	float duration;
+	int nummessages;
+	int numkeyframes;
+};
+
+struct democlock_t
+{
+	double time;
+	float lastmsgtime;
+};
+
+struct demokeyframe_t
+{
+	int offset;
+	int level;		// counted from the start of the demo so that it means the same thing on every playback
+	democlock_t clock;
+
+	double mtime[2];
+	int stats[MAX_CL_STATS];
+	int items;
+	float itemgettime[32];
+	float faceanimtime;
+	cshift_t cshifts[NUM_CSHIFTS];
+	bool paused;
+	int intermission;
+	int completed_time;
+	int viewentity;
+	scoreboard_t scores[MAX_SCOREBOARD];
+	lightstyle_t lightstyles[MAX_LIGHTSTYLES];
+};
+
+struct demoindex_t
+{
+	int demolength;
+	unsigned __int64 headhash;
+	float duration;
+	int nummessages;
+	std::vector<demokeyframe_t> keyframes;
+};
+
+// playback
+static demoindex_t demo_index;
+static bool demo_indexed = false;
+static int demo_savedkeyframes = 0;
+static char demo_playname[MAX_PATH];
+static democlock_t demo_clock;
+static double demo_seektarget = 0;
+
+// recording
+static char demo_indexname[MAX_PATH];
+static std::vector<byte> demo_indexhead;
+static int demo_writeoffset = 0;
+
+
+static void CL_ResetDemoClock (democlock_t *clock)
+{
+	clock->time = 0;
+	clock->lastmsgtime = -1;
+}
+
+
+static void CL_AdvanceDemoClock (democlock_t *clock, byte *data, int len)
+{
+	// the server starts each frame's datagram with svc_time; anything else (signon, reliable messages) keeps the current time
+	if (len < 5 || data[0] != svc_time) return;
+
+	float msgtime;
+
+	Q_MemCpy (&msgtime, &data[1], sizeof (float));
+
+	// server time goes back to 0 on a level change so that doesn't move the clock
+	if (clock->lastmsgtime >= 0 && msgtime > clock->lastmsgtime)
+		clock->time += msgtime - clock->lastmsgtime;
+
+	clock->lastmsgtime = msgtime;
+}
+
+
+static void CL_IndexDemoMessage (demoindex_t *index, democlock_t *clock, byte *data, int len)
+{
+	CL_AdvanceDemoClock (clock, data, len);
+
+	index->nummessages++;
+	index->duration = (float) clock->time;
+}
+
+
+static void CL_ClearDemoIndex (demoindex_t *index)
+{
+	index->demolength = 0;
+	index->headhash = 0;
+	index->duration = 0;
+	index->nummessages = 0;
+	index->keyframes.clear ();
+}
+
+
+static void CL_DemoIndexPath (char *path, char *demoname)
+{
+	char cachename[MAX_QPATH];
+
+	// flatten the name so that we don't need to create a directory tree
+	Q_strncpy (cachename, demoname, MAX_QPATH - 1);
+
+	for (int i = 0; cachename[i]; i++)
+		if (cachename[i] == '/' || cachename[i] == '\\')
+			cachename[i] = '_';
+
+	Q_snprintf (path, MAX_PATH, "%s/cache/demos/%s.idx", com_gamedir, cachename);
+}
+
+
+static void CL_SaveDemoIndex (char *demoname, demoindex_t *index)
+{
+	char path[MAX_PATH];
+
+	CL_DemoIndexPath (path, demoname);
+	Sys_mkdir ("cache/demos");
+
+	std::ofstream f (path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if (!f.is_open ()) return;
+
+	demoindexheader_t header;
+
+	header.ident = DEMO_INDEX_IDENT;
+	header.version = DEMO_INDEX_VERSION;
+	header.demolength = index->demolength;
+	header.headhash = index->headhash;
+	header.duration = index->duration;
+	header.nummessages = index->nummessages;
+	header.numkeyframes = index->keyframes.size ();
+
+	f.write ((char *) &header, sizeof (header));
+
+	if (header.numkeyframes)
+		f.write ((char *) &index->keyframes[0], header.numkeyframes * sizeof (demokeyframe_t));
+}
+
+
+static bool CL_LoadDemoIndex (char *demoname, demoindex_t *index)
+{
+	char path[MAX_PATH];
+
+	CL_DemoIndexPath (path, demoname);
+
+	std::ifstream f (path, std::ios::in | std::ios::binary);
+
+	if (!f.is_open ()) return false;
+
+	demoindexheader_t header;
+
+	if (!f.read ((char *) &header, sizeof (header))) return false;
+
+	// a stale or damaged index is just rebuilt
+	if (header.ident != DEMO_INDEX_IDENT) return false;
+	if (header.version != DEMO_INDEX_VERSION) return false;
+	if (header.demolength != index->demolength) return false;
+	if (header.headhash != index->headhash) return false;
+	if (header.numkeyframes < 0 || header.numkeyframes > header.nummessages) return false;
+
+	index->keyframes.resize (header.numkeyframes);
+
+	if (header.numkeyframes && !f.read ((char *) &index->keyframes[0], header.numkeyframes * sizeof (demokeyframe_t)))
+	{
+		index->keyframes.clear ();
+		return false;
+	}
+
+	// keyframes are restored straight into the client so anything that's used as an index has to be checked
+	for (int i = 0; i < header.numkeyframes; i++)
+	{
+		demokeyframe_t *kf = &index->keyframes[i];
+		bool valid = (kf->offset > 0 && kf->offset < header.demolength && kf->level > 0);
+
+		if (i && (kf->offset <= kf[-1].offset || kf->level < kf[-1].level)) valid = false;
+		if (kf->viewentity < 0 || kf->viewentity >= MAX_EDICTS) valid = false;
+
+		for (int j = 0; j < MAX_LIGHTSTYLES; j++)
+			if (kf->lightstyles[j].length < 0 || kf->lightstyles[j].length > MAX_STYLESTRING) valid = false;
+
+		if (!valid)
+		{
+			index->keyframes.clear ();
+			return false;
+		}
+
+		for (int j = 0; j < MAX_SCOREBOARD; j++)
+			kf->scores[j].name[MAX_SCOREBOARDNAME - 1] = 0;
+	}
+
+	index->duration = header.duration;
+	index->nummessages = header.nummessages;
+
+	return true;
+}
+
+
+static void CL_BuildDemoIndex (CQuakeFile *f, demoindex_t *index)
+{
+	democlock_t clock;
+
+	CL_ResetDemoClock (&clock);
+	f->SetPointer (0, FILE_BEGIN);
+
+	// skip the cd track
+	for (;;)
+	{
+		int c = f->ReadChar ();
+
+		if (c == '\n' || c == -1) break;
+	}
+
+	for (;;)
+	{
+		int offset = f->GetPointer ();
+		int msglen;
+		byte msgstart[5];
+
+		if (offset >= index->demolength) break;
+		if (f->Read (&msglen, 4) != 4) break;
+		if (msglen < 0 || msglen > MAX_MSGLEN) break;
+
+		// only the svc_time that a message starts with is needed so skip the view angles and everything after it
+		int startlen = msglen < 5 ? msglen : 5;
+
+		f->SetPointer (12, FILE_CURRENT);
+
+		if (f->Read (msgstart, startlen) != startlen) break;
+
+		f->SetPointer (msglen - startlen, FILE_CURRENT);
+
+		CL_IndexDemoMessage (index, &clock, msgstart, startlen);
+	}
+}
+
+
+static void CL_IndexDemo (CQuakeFile *f, char *demoname, demoindex_t *index)
+{
+	int hunkmark = TempHunk->GetLowMark ();
+	int filepos = f->GetPointer ();
+
+	CL_ClearDemoIndex (index);
+
+	// identify the demo
+	index->demolength = f->GetLength ();
+
+	int headlen = index->demolength < DEMO_HASH_BYTES ? index->demolength : DEMO_HASH_BYTES;
+	byte *head = (byte *) TempHunk->FastAlloc (headlen);
+
+	f->SetPointer (0, FILE_BEGIN);
+
+	if (f->Read (head, headlen) == headlen)
+		index->headhash = COM_FastHash (head, headlen);
+
+	TempHunk->FreeToLowMark (hunkmark);
+
+	if (!CL_LoadDemoIndex (demoname, index))
+	{
+		Con_DPrintf ("Indexing %s\n", demoname);
+		CL_BuildDemoIndex (f, index);
+
+		if (cl_demoindex.integer)
+			CL_SaveDemoIndex (demoname, index);
+	}
+
+	// put the file back where it was
+	f->SetPointer (filepos, FILE_BEGIN);
+}
+
+
+static void CL_TakeDemoKeyframe (void)
+{
+	int offset = demofile.GetPointer ();
+
+	if (demo_index.keyframes.size ())
+	{
+		demokeyframe_t *last = &demo_index.keyframes.back ();
+
+		// keyframes behind the last one were already taken on the way here (or loaded from the index)
+		if (offset <= last->offset) return;
+		if (last->level == cls.demolevel && demo_clock.time < last->clock.time + DEMO_KEYFRAME_INTERVAL) return;
+	}
+
+	demo_index.keyframes.push_back (demokeyframe_t ());
+	demokeyframe_t *s = &demo_index.keyframes.back ();
+
+	s->offset = offset;
+	s->level = cls.demolevel;
+	s->clock = demo_clock;
+
+	s->mtime[0] = cl.mtime[0];
+	s->mtime[1] = cl.mtime[1];
+	s->items = cl.items;
+	s->faceanimtime = cl.faceanimtime;
+	s->paused = cl.paused;
+	s->intermission = cl.intermission;
+	s->completed_time = cl.completed_time;
+	s->viewentity = cl.viewentity;
+
+	Q_MemCpy (s->stats, cl.stats, sizeof (s->stats));
+	Q_MemCpy (s->itemgettime, cl.itemgettime, sizeof (s->itemgettime));
+	Q_MemCpy (s->cshifts, cl.cshifts, sizeof (s->cshifts));
+	Q_MemCpy (s->lightstyles, cls.lightstyles, sizeof (s->lightstyles));
+
+	for (int i = 0; i < cl.maxclients && i < MAX_SCOREBOARD; i++)
+		s->scores[i] = cl.scores[i];
+}
+
+
+static demokeyframe_t *CL_FindDemoKeyframe (double target)
+{
+	demokeyframe_t *best = NULL;
+
+	// find the latest keyframe at or before the target
+	for (int i = 0; i < demo_index.keyframes.size (); i++)
+	{
+		if (demo_index.keyframes[i].clock.time > target) break;
+		best = &demo_index.keyframes[i];
+	}
+
+	return best;
+}
+
+
+static void CL_RestoreDemoKeyframe (demokeyframe_t *s)
+{
+	demofile.SetPointer (s->offset, FILE_BEGIN);
+	demo_clock = s->clock;
+
+	cl.mtime[0] = s->mtime[0];
+	cl.mtime[1] = s->mtime[1];
+	cl.time = s->mtime[0];
+	cl.items = s->items;
+	cl.faceanimtime = s->faceanimtime;
+	cl.paused = s->paused;
+	cl.intermission = s->intermission;
+	cl.completed_time = s->completed_time;
+	cl.viewentity = s->viewentity;
+
+	Q_MemCpy (cl.stats, s->stats, sizeof (s->stats));
+	Q_MemCpy (cl.itemgettime, s->itemgettime, sizeof (s->itemgettime));
+	Q_MemCpy (cl.cshifts, s->cshifts, sizeof (s->cshifts));
+	Q_MemCpy (cls.lightstyles, s->lightstyles, sizeof (s->lightstyles));
+
+	for (int i = 0; i < cl.maxclients && i < MAX_SCOREBOARD; i++)
+		cl.scores[i] = s->scores[i];
+
+	vid.RecalcRefdef = true;
+}
+
+
+static void CL_FinishDemoSeek (void)
+{
+	cls.demoseeking = false;
+
+	// pick up from the last message that was read
+	cl.time = cl.mtime[0];
+
+	// anything transient that was spawned on the way is thrown away
+	for (int i = 0; i < MAX_DLIGHTS; i++)
+		cls.dlights[i].die = -1;
+
+	ParticleSystem.KillParticles ();
+	CL_KillBeams ();
+}
+
+
+static bool CL_OpenDemo (char *name);
+
+static void CL_SeekDemo (double target)
+{
+	demokeyframe_t *best = CL_FindDemoKeyframe (target);
+
+	if (best && best->level == cls.demolevel)
+	{
+		// it's on this level so it can be restored if that gets us closer
+		if (target < demo_clock.time || best->clock.time > demo_clock.time)
+			CL_RestoreDemoKeyframe (best);
+	}
+	else if (target < demo_clock.time)
+	{
+		// going back to a previous level means loading it again so just start over; once
+		// the right level is loaded CL_GetMessage will jump to the best keyframe on it
+		char name[MAX_PATH];
+
+		Q_strncpy (name, cls.demoname, MAX_PATH - 1);
+
+		if (!CL_OpenDemo (name)) return;
+	}
+
+	// anything after the keyframe is replayed without drawing; if the target is on a later level
+	// CL_GetMessage will jump to the best keyframe on it once it's loaded
+	demo_seektarget = target;
+	cls.demoseeking = true;
+}
 
 /*
 ==============================================================================
@@ -55,12 +502,30 @@ CL_StopPlayback
 Called when a demo file runs out, or the user starts a game
 ==============
 */
+static void CL_RestoreNetBuffer (void)
+{
+	if (demo_netbuffer)
+	{
+		net_message.data = demo_netbuffer;
+		demo_netbuffer = NULL;
+	}
+}
+
+
 void CL_StopPlayback (void)
 {
 	if (!cls.demoplayback)
 		return;
 
+	CL_RestoreNetBuffer ();
+
+	// keep any keyframes that were taken this time so that the next playback can seek straight to them
+	if (demo_indexed && cl_demoindex.integer && demo_index.keyframes.size () > demo_savedkeyframes)
+		CL_SaveDemoIndex (demo_playname, &demo_index);
+
+	demo_indexed = false;
 	cls.demoplayback = false;
+	cls.demoseeking = false;
 	demofile.Close ();
 	cls.state = ca_disconnected;
 
@@ -80,6 +545,24 @@ CL_WriteDemoMessage
 Dumps the current net message, prefixed by the length and view angles
 ====================
 */
+static bool CL_WriteDemoData (void *data, int len)
+{
+	// keep the start of the demo so that the index can be matched to it
+	if (demo_indexhead.size () < DEMO_HASH_BYTES)
+	{
+		int headlen = DEMO_HASH_BYTES - demo_indexhead.size ();
+
+		if (headlen > len) headlen = len;
+
+		demo_indexhead.insert (demo_indexhead.end (), (byte *) data, (byte *) data + headlen);
+	}
+
+	demo_writeoffset += len;
+
+	return demofile.Write (data, len);
+}
+
+
 bool CL_WriteDemoMessage (void)
 {
 	int	    len;
@@ -88,19 +571,19 @@ bool CL_WriteDemoMessage (void)
 	bool    Success;
 
 	len = net_message.cursize;
-	Success = demofile.Write (&len, 4);
+	Success = CL_WriteDemoData (&len, 4);
 
 	for (i = 0; i < 3 && Success; i++)
 	{
 		f = cl.viewangles[i];
-		Success = demofile.Write (&f, 4);
+		Success = CL_WriteDemoData (&f, 4);
 	}
 
 	if (Success)
-		Success = demofile.Write (net_message.data, net_message.cursize);
+		Success = CL_WriteDemoData (net_message.data, net_message.cursize);
 
 	if (Success)
-		; // flush buffer
+		CL_IndexDemoMessage (&demo_index, &demo_clock, net_message.data, net_message.cursize);
 	else
 	{
 		demofile.Close ();
@@ -122,9 +605,13 @@ int CL_GetMessage (void)
 	int	    r, i;
 	float	    f;
 	bool    Success;
+	byte	*msghead, *msgdata;
 
 	if (cls.demoplayback)
 	{
+		// the last message is done with
+		CL_RestoreNetBuffer ();
+
 		// decide if it is time to grab the next message
 		if (cls.signon == SIGNON_CONNECTED)	// allways grab until fully connected
 		{
@@ -137,35 +624,78 @@ int CL_GetMessage (void)
 
 				// if this is the third frame, grab the real td_starttime
 				// so the bogus time on the first frame doesn't count
-				if (td_frames == 2) cls.td_starttime = CHostTimer::realtime;
+				if (td_frames == 2)
+				{
+					cls.td_starttime = CHostTimer::realtime;
+					d3d_RenderDef.scenetime = 0;
+				}
 
 				td_frames++;
 			}
+			else if (cls.demoseeking)
+			{
+				// keep reading without waiting for cl.time until demo time catches up with the seek
+				if (demo_clock.time >= demo_seektarget)
+				{
+					CL_FinishDemoSeek ();
+					return 0;
+				}
+
+				// skip ahead if a keyframe on this level is closer to the target than we are
+				demokeyframe_t *kf = CL_FindDemoKeyframe (demo_seektarget);
+
+				if (kf && kf->level == cls.demolevel && kf->offset > demofile.GetPointer ())
+					CL_RestoreDemoKeyframe (kf);
+			}
 			else if (cl.time <= cl.mtime[0]) return 0;
+
+			if (!cls.timedemo) CL_TakeDemoKeyframe ();
 		}
 
 		// Detect EOF, especially for demos in pak files
-		if (demofile.SetPointer (0, FILE_CURRENT) - demofile_start >= demofile_len)
+		if (demofile.GetPointer () >= demofile_len)
 			Host_EndGame ("Missing disconnect in demofile\n");
 
 		// get the next message
-		Success = (demofile.Read (&net_message.cursize, 4) != -1);
-
 		Vector3Copy (cl.mviewangles[1], cl.mviewangles[0]);
 
-		for (i = 0; i < 3 && Success; i++)
+		if ((msghead = (byte *) demofile.GetData (16)) != NULL)
 		{
-			Success = (demofile.Read (&f, 4) != -1);
-			cl.mviewangles[0][i] = f;
-		}
+			// the demo is mapped so net_message is just pointed at the message where it is
+			Q_MemCpy (&net_message.cursize, msghead, 4);
+			Q_MemCpy (cl.mviewangles[0], msghead + 4, 12);
 
-		if (Success)
-		{
-			if (net_message.cursize > MAX_MSGLEN)
+			if (net_message.cursize < 0 || net_message.cursize > MAX_MSGLEN)
 				Host_Error ("Demo message %d > MAX_MSGLEN (%d)", net_message.cursize, MAX_MSGLEN);
 
-			Success = (demofile.Read (net_message.data, net_message.cursize) != -1);
+			if ((msgdata = (byte *) demofile.GetData (net_message.cursize)) != NULL)
+			{
+				demo_netbuffer = net_message.data;
+				net_message.data = msgdata;
+				Success = true;
+			}
+			else Success = false;
 		}
+		else
+		{
+			Success = (demofile.Read (&net_message.cursize, 4) != -1);
+
+			for (i = 0; i < 3 && Success; i++)
+			{
+				Success = (demofile.Read (&f, 4) != -1);
+				cl.mviewangles[0][i] = f;
+			}
+
+			if (Success)
+			{
+				if (net_message.cursize > MAX_MSGLEN)
+					Host_Error ("Demo message %d > MAX_MSGLEN (%d)", net_message.cursize, MAX_MSGLEN);
+
+				Success = (demofile.Read (net_message.data, net_message.cursize) != -1);
+			}
+		}
+
+		if (Success) CL_AdvanceDemoClock (&demo_clock, net_message.data, net_message.cursize);
 
 		if (!Success)
 		{
@@ -250,6 +780,18 @@ void CL_Stop_f (void)
 	// finish up
 	demofile.Close ();
 
+	// the index was built as the demo was written so it just needs to be matched to it
+	if (cl_demoindex.integer && demo_indexhead.size ())
+	{
+		demo_index.demolength = demo_writeoffset;
+		demo_index.headhash = COM_FastHash (&demo_indexhead[0], demo_indexhead.size ());
+
+		CL_SaveDemoIndex (demo_indexname, &demo_index);
+	}
+
+	demo_indexhead.clear ();
+	CL_ClearDemoIndex (&demo_index);
+
 	// force a refresh of the demo list
 	Menu_DemoPopulate ();
 
@@ -338,10 +880,19 @@ void CL_Record_f (void)
 
 	cls.forcetrack = track;
 
+	// the index is named the same way as playdemo will look for it
+	Q_strncpy (demo_indexname, Cmd_Argv (1), MAX_QPATH - 1);
+	COM_DefaultExtension (demo_indexname, ".dem");
+
+	demo_indexhead.clear ();
+	demo_writeoffset = 0;
+	CL_ClearDemoIndex (&demo_index);
+	CL_ResetDemoClock (&demo_clock);
+
 	char demotrack[64];
 
 	sprintf (demotrack, "%i\n", cls.forcetrack);
-	demofile.Write (demotrack, strlen (demotrack));
+	CL_WriteDemoData (demotrack, strlen (demotrack));
 
 	cls.demorecording = true;
 
@@ -416,32 +967,19 @@ void CL_Record_f (void)
 
 void Host_ResetTimers (void);
 
-bool CL_DoPlayDemo (void)
+static bool CL_OpenDemo (char *name)
 {
-	char name[MAX_PATH];
 	int	 c;
 	bool neg = false;
 
-	if (cmd_source != src_command) return false;
-
-	if (Cmd_Argc () != 2)
-	{
-		Con_Printf ("playdemo <demoname> : plays a demo\n");
-		return false;
-	}
-
 	// disconnect from server
 	CL_Disconnect ();
 
-	// open the demo file
-	Q_strncpy (name, Cmd_Argv (1), 127);
-	COM_DefaultExtension (name, ".dem");
-
 	Con_Printf ("Playing demo from %s.\n", name);
 
 	demofile.Close ();
 
-	if (!demofile.Open (name))
+	if (!demofile.Open (name, QFILE_MAP))
 	{
 		Con_Printf ("ERROR: couldn't open %s\n", name);
 		cls.demonum = -1;		// stop demo loop
@@ -449,7 +987,6 @@ bool CL_DoPlayDemo (void)
 	}
 
 	demofile_len = demofile.GetLength ();
-	demofile_start = demofile.SetPointer (0, FILE_CURRENT);
 
 	cls.demoplayback = true;
 	cls.state = ca_connected;
@@ -477,11 +1014,46 @@ bool CL_DoPlayDemo (void)
 	// reinit the timers to keep fx consistent
 	Host_ResetTimers ();
 
+	// keyframes are taken as it plays, on top of any that the index already has
+	CL_ResetDemoClock (&demo_clock);
+	CL_ClearDemoIndex (&demo_index);
+	cls.demolevel = 0;
+	demo_indexed = false;
+
+	if (cl_demoindex.integer)
+	{
+		Q_strncpy (demo_playname, name, MAX_PATH - 1);
+		CL_IndexDemo (&demofile, name, &demo_index);
+		demo_indexed = true;
+	}
+
+	demo_savedkeyframes = demo_index.keyframes.size ();
+
 	// success
 	return true;
 }
 
 
+bool CL_DoPlayDemo (void)
+{
+	char name[MAX_PATH];
+
+	if (cmd_source != src_command) return false;
+
+	if (Cmd_Argc () != 2)
+	{
+		Con_Printf ("playdemo <demoname> : plays a demo\n");
+		return false;
+	}
+
+	// open the demo file
+	Q_strncpy (name, Cmd_Argv (1), 127);
+	COM_DefaultExtension (name, ".dem");
+
+	return CL_OpenDemo (name);
+}
+
+
 /*
 ====================
 CL_PlayDemo_f
@@ -519,6 +1091,9 @@ void CL_FinishTimeDemo (void)
 		float fps = (float) frames / time;
 
 		Con_Printf ("%i frames %0.1f seconds %0.1f fps\n", frames, time, fps);
+
+		// the cost of building each frame's scene on the CPU (r_nulldraw 1 takes the GPU out of the fps as well)
+		Con_Printf ("%0.3f ms scene prep per frame\n", (float) ((d3d_RenderDef.scenetime * 1000.0) / frames));
 	}
 	else Con_Printf ("0 frames 0 seconds 0 fps\n");
 }
@@ -552,3 +1127,91 @@ void CL_TimeDemo_f (void)
 }
 
 
+
+
+/*
+====================
+CL_DemoSeek_f
+
+demoseek <time>
+====================
+*/
+void CL_DemoSeek_f (void)
+{
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc () != 2)
+	{
+		Con_Printf ("demoseek <time> : seeks to a time in seconds, or +/- seconds from the current time\n");
+		return;
+	}
+
+	if (!cls.demoplayback)
+	{
+		Con_Printf ("Not playing a demo.\n");
+		return;
+	}
+
+	if (cls.timedemo)
+	{
+		Con_Printf ("Can't seek during a timedemo\n");
+		return;
+	}
+
+	char *arg = Cmd_Argv (1);
+	double target = atof (arg);
+
+	if (arg[0] == '+' || arg[0] == '-') target += demo_clock.time;
+	if (demo_indexed && target > demo_index.duration) target = demo_index.duration;
+	if (target < 0) target = 0;
+
+	CL_SeekDemo (target);
+}
+
+
+/*
+====================
+CL_DemoInfo_f
+
+demoinfo <demoname>
+====================
+*/
+void CL_DemoInfo_f (void)
+{
+	char name[MAX_PATH];
+	CQuakeFile f;
+	demoindex_t index;
+
+	if (Cmd_Argc () != 2)
+	{
+		Con_Printf ("demoinfo <demoname> : shows the length of a demo\n");
+		return;
+	}
+
+	Q_strncpy (name, Cmd_Argv (1), 127);
+	COM_DefaultExtension (name, ".dem");
+
+	if (!f.Open (name, QFILE_MAP))
+	{
+		Con_Printf ("ERROR: couldn't open %s\n", name);
+		return;
+	}
+
+	CL_IndexDemo (&f, name, &index);
+	f.Close ();
+
+	int seconds = (int) index.duration;
+
+	Con_Printf
+	(
+		"%s: %i:%02i, %i messages, %i keyframes, %i bytes\n",
+		name,
+		seconds / 60,
+		seconds % 60,
+		index.nummessages,
+		(int) index.keyframes.size (),
+		index.demolength
+	);
+}
+
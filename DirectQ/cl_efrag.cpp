@@ -73,6 +73,58 @@ void R_SplitEntityOnNode (entity_t *ent, mnode_t *node, r_efragdef_t *ed)
 }
 
 
+// static entities are numbered as they're added and the efrag links are flattened into a leaf -> entity index the
+// first time the world is built after that, so that the per-frame walk is over flat arrays instead of linked lists
+int r_numstaticents = 0;
+bool r_staticsdirty = false;
+
+entity_t **r_staticents = NULL;
+int *r_leaffirststatic = NULL;
+int *r_leafstatics = NULL;
+
+// an entity in several visible leafs is only taken once per build; the stamps mean nothing needs clearing between builds
+int *r_staticstamp = NULL;
+int r_staticgen = 0;
+
+// the statics collected by the last world build, which are re-emitted as-is on frames that don't rebuild it
+int *r_visstatics = NULL;
+int r_numvisstatics = 0;
+
+// the index is in the zone and only reallocated when it needs to grow, so that statics added during play (such as
+// corpses from makestatic) just refill it instead of taking a new copy each time
+int r_maxstaticents = 0;
+int r_maxleafstatics = 0;
+
+
+void R_ClearEfrags (void)
+{
+	// clear out efrags (one short???)
+	for (int i = 0; i < cl.worldmodel->brushhdr->numleafs; i++)
+		cl.worldmodel->brushhdr->leafs[i].efrags = NULL;
+
+	// release the previous map's index
+	MainZone->Free (r_staticents);
+	MainZone->Free (r_leaffirststatic);
+	MainZone->Free (r_leafstatics);
+	MainZone->Free (r_staticstamp);
+	MainZone->Free (r_visstatics);
+
+	r_numstaticents = 0;
+	r_staticsdirty = false;
+
+	r_staticents = NULL;
+	r_leaffirststatic = NULL;
+	r_leafstatics = NULL;
+	r_staticstamp = NULL;
+	r_staticgen = 0;
+	r_visstatics = NULL;
+	r_numvisstatics = 0;
+
+	r_maxstaticents = 0;
+	r_maxleafstatics = 0;
+}
+
+
 void R_AddEfrags (entity_t *ent)
 {
 	// entities with no model won't get drawn
@@ -91,30 +143,129 @@ void R_AddEfrags (entity_t *ent)
 	Vector3Add (ed.maxs, ent->origin, ent->model->maxs);
 
 	R_SplitEntityOnNode (ent, cl.worldmodel->brushhdr->nodes, &ed);
+
+	// and have the index rebuilt to include it; this can happen during play so the world must be rebuilt to pick it up
+	ent->staticnum = r_numstaticents++;
+	r_staticsdirty = true;
+	d3d_RenderDef.rebuildworld = true;
 }
 
 
-cvar_t r_drawflame ("r_drawflame", "1");
+int R_GrowEfragIndex (int maxitems, int numitems)
+{
+	// doubled so that statics added one at a time don't need a realloc for each
+	if (maxitems < 64) maxitems = 64;
+
+	while (maxitems < numitems) maxitems <<= 1;
+
+	return maxitems;
+}
+
 
-void R_StoreEfrags (efrag_t **ppefrag)
+void R_BuildStaticIndex (void)
 {
-	efrag_t *pefrag = NULL;
-	entity_t *ent = NULL;
+	brushhdr_t *hdr = cl.worldmodel->brushhdr;
+	int numrefs = 0;
+
+	// statics mostly come in at signon so this is normally done once per map; it allocates so must be mainthread
+	if (r_numstaticents > r_maxstaticents)
+	{
+		r_maxstaticents = R_GrowEfragIndex (r_maxstaticents, r_numstaticents);
+
+		MainZone->Free (r_staticents);
+		MainZone->Free (r_staticstamp);
+		MainZone->Free (r_visstatics);
+
+		// the stamps start at 0 which is never a valid generation
+		r_staticents = (entity_t **) MainZone->Alloc (r_maxstaticents * sizeof (entity_t *));
+		r_staticstamp = (int *) MainZone->Alloc (r_maxstaticents * sizeof (int));
+		r_visstatics = (int *) MainZone->Alloc (r_maxstaticents * sizeof (int));
+	}
+
+	if (!r_leaffirststatic)
+		r_leaffirststatic = (int *) MainZone->Alloc ((hdr->numleafs + 2) * sizeof (int));
+
+	// visible leafs are 1 to numleafs; the last may resolve to the first node (see D3DSurf_LeafVisibility) so check contents
+	for (int i = 1; i <= hdr->numleafs; i++)
+	{
+		if (hdr->leafs[i].contents >= 0) continue;
+
+		for (efrag_t *ef = hdr->leafs[i].efrags; ef; ef = ef->leafnext)
+			numrefs++;
+	}
+
+	if (numrefs > r_maxleafstatics)
+	{
+		r_maxleafstatics = R_GrowEfragIndex (r_maxleafstatics, numrefs);
+
+		MainZone->Free (r_leafstatics);
+		r_leafstatics = (int *) MainZone->Alloc (r_maxleafstatics * sizeof (int));
+	}
+
+	numrefs = 0;
 
-	while ((pefrag = *ppefrag) != NULL)
+	for (int i = 1; i <= hdr->numleafs; i++)
 	{
-		ent = pefrag->entity;
-		ppefrag = &pefrag->leafnext;
+		r_leaffirststatic[i] = numrefs;
+
+		if (hdr->leafs[i].contents >= 0) continue;
+
+		for (efrag_t *ef = hdr->leafs[i].efrags; ef; ef = ef->leafnext)
+		{
+			r_staticents[ef->entity->staticnum] = ef->entity;
+			r_leafstatics[numrefs++] = ef->entity->staticnum;
+		}
+	}
+
+	r_leaffirststatic[hdr->numleafs + 1] = numrefs;
 
-		// some progs might try to send static ents with no model through here...
-		if (!ent->model) continue;
+	// the generation carries on from where it was as reused stamps may still hold earlier ones
+	r_numvisstatics = 0;
+	r_staticsdirty = false;
+}
+
+
+void R_BeginEfrags (void)
+{
+	// called before each world build
+	if (r_staticsdirty) R_BuildStaticIndex ();
+
+	r_staticgen++;
+	r_numvisstatics = 0;
+}
+
+
+void R_StoreEfrags (mleaf_t *leaf)
+{
+	if (!r_leaffirststatic) return;
+
+	// leaf 0 never has any and neither does a last leaf that resolves to the first node
+	int leafnum = leaf - cl.worldmodel->brushhdr->leafs;
+	int *statics = r_leafstatics + r_leaffirststatic[leafnum];
+	int numstatics = r_leaffirststatic[leafnum + 1] - r_leaffirststatic[leafnum];
+
+	for (int i = 0; i < numstatics; i++)
+	{
+		// prevent adding twice in this build (if an entity is in more than one leaf)
+		if (r_staticstamp[statics[i]] == r_staticgen) continue;
+
+		r_staticstamp[statics[i]] = r_staticgen;
+		r_visstatics[r_numvisstatics++] = statics[i];
+	}
+}
+
+
+cvar_t r_drawflame ("r_drawflame", "1");
+
+void R_AddStaticEdicts (void)
+{
+	for (int i = 0; i < r_numvisstatics; i++)
+	{
+		entity_t *ent = r_staticents[r_visstatics[i]];
 
 		// allow skipping flames
 		if (ent->model->type == mod_alias && (ent->model->aliashdr->drawflags & AM_FLAME) && !r_drawflame.value) continue;
 
-		// prevent adding twice in this render frame (or if an entity is in more than one leaf)
-		if (ent->visframe == d3d_RenderDef.framecount) continue;
-
 		// if the entity wasn't recorded on the previous frame reset it's lerp
 		if (ent->visframe != d3d_RenderDef.framecount - 1)
 			ent->lerpflags |= LERP_RESETALL;
@@ -129,3 +280,119 @@ void R_StoreEfrags (efrag_t **ppefrag)
 }
 
 
+int R_EntPtrSortFunc (entity_t **e1, entity_t **e2)
+{
+	if (*e1 == *e2) return 0;
+	return (*e1 < *e2) ? -1 : 1;
+}
+
+
+void R_EfragBenchmark_f (void)
+{
+	if (cls.state != ca_connected) return;
+	if (!cl.worldmodel) return;
+
+	// make sure the index is current before anything is timed
+	if (r_staticsdirty) R_BuildStaticIndex ();
+
+	if (!r_numstaticents)
+	{
+		Con_Printf ("r_efragbenchmark : no static entities on this map\n");
+		return;
+	}
+
+	// gathers the static entities in the pvs of every leaf in the map in turn, first by walking the efrag links with
+	// the entities themselves marking the ones that have been taken and then from the flat index
+	brushhdr_t *hdr = cl.worldmodel->brushhdr;
+	int hunkmark = TempHunk->GetLowMark ();
+	entity_t **linkedents = (entity_t **) TempHunk->FastAlloc (r_numstaticents * sizeof (entity_t *));
+	entity_t **indexedents = (entity_t **) TempHunk->FastAlloc (r_numstaticents * sizeof (entity_t *));
+	double passtime[2] = {0, 0};
+	int numlinked = 0;
+	int numindexed = 0;
+	int totalents = 0;
+	int numleafs = 0;
+	int mismatches = 0;
+
+	for (int i = 1; i <= hdr->numleafs; i++)
+	{
+		mleaf_t *leaf = &hdr->leafs[i];
+
+		if (leaf->contents >= 0) continue;
+		if (leaf->contents == CONTENTS_SOLID) continue;
+		if (leaf->contents == CONTENTS_SKY) continue;
+
+		byte *vis = Mod_LeafPVS (leaf, cl.worldmodel);
+
+		for (int pass = 0; pass < 2; pass++)
+		{
+			double start = Sys_ProfileTime ();
+
+			if (pass == 0)
+			{
+				// a new frame so that entities taken on the previous leaf don't get skipped
+				d3d_RenderDef.framecount++;
+				numlinked = 0;
+
+				for (int j = 0; j < hdr->numleafs; j++)
+				{
+					if (!(vis[j >> 3] & (1 << (j & 7)))) continue;
+					if (hdr->leafs[j + 1].contents >= 0) continue;
+
+					for (efrag_t *ef = hdr->leafs[j + 1].efrags; ef; ef = ef->leafnext)
+					{
+						if (ef->entity->visframe == d3d_RenderDef.framecount) continue;
+
+						ef->entity->visframe = d3d_RenderDef.framecount;
+						linkedents[numlinked++] = ef->entity;
+					}
+				}
+			}
+			else
+			{
+				R_BeginEfrags ();
+
+				for (int j = 0; j < hdr->numleafs; j++)
+					if (vis[j >> 3] & (1 << (j & 7))) R_StoreEfrags (&hdr->leafs[j + 1]);
+
+				for (int j = 0; j < r_numvisstatics; j++)
+					indexedents[j] = r_staticents[r_visstatics[j]];
+
+				numindexed = r_numvisstatics;
+			}
+
+			passtime[pass] += Sys_ProfileTime () - start;
+		}
+
+		// the orders are different so compare them sorted
+		qsort (linkedents, numlinked, sizeof (entity_t *), (sortfunc_t) R_EntPtrSortFunc);
+		qsort (indexedents, numindexed, sizeof (entity_t *), (sortfunc_t) R_EntPtrSortFunc);
+
+		if (numlinked != numindexed || memcmp (linkedents, indexedents, numlinked * sizeof (entity_t *)))
+			mismatches++;
+
+		totalents += numlinked;
+		numleafs++;
+	}
+
+	TempHunk->FreeToLowMark (hunkmark);
+
+	// have the next frame collect the statics for the real view again
+	d3d_RenderDef.rebuildworld = true;
+
+	if (!numleafs) return;
+
+	Con_Printf ("%i leafs\n", numleafs);
+	Con_Printf ("%i static entities, %i leaf references, %0.1f per pvs\n", r_numstaticents, r_leaffirststatic[hdr->numleafs + 1], (float) totalents / (float) numleafs);
+	Con_Printf ("efrag links : %0.3f ms per leaf change\n", (passtime[0] * 1000.0) / (double) numleafs);
+	Con_Printf ("flat index  : %0.3f ms per leaf change\n", (passtime[1] * 1000.0) / (double) numleafs);
+
+	if (mismatches)
+		Con_Printf ("%i leafs had different entity sets!\n", mismatches);
+	else Con_Printf ("entity sets are identical\n");
+}
+
+
+cmd_t R_EfragBenchmark_Cmd ("r_efragbenchmark", R_EfragBenchmark_f);
+
+
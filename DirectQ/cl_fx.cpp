@@ -617,6 +617,14 @@ void CL_ParseTEnt (void)
 CL_UpdateTEnts
 =================
 */
+void CL_KillBeams (void)
+{
+	// let any active beams expire now
+	for (int i = 0; i < cl_beams.size (); i++)
+		cl_beams[i]->endtime = -1;
+}
+
+
 void CL_UpdateTEnts (void)
 {
 	vec3_t	    dist, org;
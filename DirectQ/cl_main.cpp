@@ -654,6 +654,8 @@ cmd_t CL_Record_f_Cmd ("record", CL_Record_f);
 cmd_t CL_Stop_f_Cmd ("stop", CL_Stop_f);
 cmd_t CL_PlayDemo_f_Cmd ("playdemo", CL_PlayDemo_f);
 cmd_t CL_TimeDemo_f_Cmd ("timedemo", CL_TimeDemo_f);
+cmd_t CL_DemoSeek_f_Cmd ("demoseek", CL_DemoSeek_f);
+cmd_t CL_DemoInfo_f_Cmd ("demoinfo", CL_DemoInfo_f);
 
 
 void CL_Init (void)
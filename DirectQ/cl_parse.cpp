@@ -457,6 +457,9 @@ void CL_ParseServerInfo (void)
 	// needs to call SCR_UpdateScreen.
 	ParticleSystem.ClearParticles ();
 
+	// demo keyframes from the previous level can't be restored on this one
+	cls.demolevel++;
+
 	model_precache = (char **) MainHunk->Alloc (MAX_MODELS * sizeof (char *));
 	sound_precache = (char **) MainHunk->Alloc (MAX_SOUNDS * sizeof (char *));
 
@@ -618,6 +621,7 @@ void CL_ParseServerInfo (void)
 
 	// ensure that the worldmodel loads OK and crash it if not
 	cl.model_precache[1] = Mod_ForName (model_precache[1], true);
+	mod_knownhash.Report ("model registry");
 
 	// now we do sounds
 	S_BeginPrecaching ();
@@ -25,6 +25,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "particles.h"
 #include "cl_fx.h"
 
+#include <xmmintrin.h>
+
 extern cvar_t r_particlesize;
 extern cvar_t r_drawparticles;
 extern cvar_t sv_gravity;
@@ -41,16 +43,16 @@ QPARTICLESYSTEM::QPARTICLESYSTEM (void)
 }
 
 
-void QPARTICLESYSTEM::StandardParticle (particle_t *p, float *org, float *dir, int color)
+void QPARTICLESYSTEM::StandardParticle (partvert_t *p, float *org, float *dir, int color)
 {
-	p->v.die = cl.time + (0.1 * (Q_fastrand () % 5));
-	p->v.color = d3d_QuakePalette.standard11[((color & ~7) + (Q_fastrand () & 7)) & 255];
-	p->v.grav = -1;
+	p->die = cl.time + (0.1 * (Q_fastrand () % 5));
+	p->color = d3d_QuakePalette.standard11[((color & ~7) + (Q_fastrand () & 7)) & 255];
+	p->grav = -1;
 
 	for (int j = 0; j < 3; j++)
 	{
-		p->v.org[j] = org[j] + ((Q_fastrand () & 15) - 8);
-		p->v.vel[j] = dir[j] * 15;
+		p->org[j] = org[j] + ((Q_fastrand () & 15) - 8);
+		p->vel[j] = dir[j] * 15;
 	}
 }
 
@@ -73,7 +75,7 @@ void QPARTICLESYSTEM::SetExplosionOrigin (float *orgout, float *orgin, int num)
 
 void QPARTICLESYSTEM::SetRamp (partvert_t *v, int rampnum, float baseramp, float ramptime)
 {
-	// the point at which a colour ramp dies, padded with one at the start so that !p->v.ramp is valid
+	// the point at which a colour ramp dies, padded with one at the start so that !p->ramp is valid
 	float rampdie[4] = {0, 9, 9, 7};
 
 	v->color = 0;
@@ -129,25 +131,43 @@ void QPARTICLESYSTEM::InitParticles (void)
 	}
 
 	// default velocity change and gravity
-	this->DefaultParticle.v.dvel[0] = this->DefaultParticle.v.dvel[1] = 0;
-	this->DefaultParticle.v.grav = 0;
+	this->DefaultParticle.dvel[0] = this->DefaultParticle.dvel[1] = 0;
+	this->DefaultParticle.grav = 0;
 
 	// colour and ramps
-	this->DefaultParticle.v.color = 0;
-	this->DefaultParticle.v.rampnum = 0;
-	this->DefaultParticle.v.baseramp = 0;
-	this->DefaultParticle.v.ramptime = 0;
-	this->DefaultParticle.v.die = -1;
+	this->DefaultParticle.color = 0;
+	this->DefaultParticle.rampnum = 0;
+	this->DefaultParticle.baseramp = 0;
+	this->DefaultParticle.ramptime = 0;
+	this->DefaultParticle.die = -1;
 }
 
 
 void QPARTICLESYSTEM::ClearParticles (void)
 {
 	// these need to be wiped immediately on going to a new server
-	// ...it's faster to just alloc one at a time as needed than it is to pre-alloc or alloc in batches...
+	// blocks come from MainHunk so they just get thrown away along with everything else
 	this->ActiveEmitters = NULL;
 	this->FreeEmitters = NULL;
-	this->FreeParticles = NULL;
+
+	for (int i = 0; i < PARTICLE_BLOCK_CLASSES; i++)
+		this->FreeBlocks[i] = NULL;
+
+	this->BenchEndTime = 0;
+	this->BenchSimTime = 0;
+	this->BenchFrames = 0;
+	this->DrawTime = 0;
+}
+
+
+void QPARTICLESYSTEM::KillParticles (void)
+{
+	// empty every emitter without throwing away the blocks; they go back to the free lists on the next run
+	for (emitter_t *pe = this->ActiveEmitters; pe; pe = pe->next)
+	{
+		pe->numparticles = 0;
+		pe->numsynced = 0;
+	}
 }
 
 
@@ -163,8 +183,14 @@ emitter_t *QPARTICLESYSTEM::NewEmitter (vec3_t spawnorg)
 	emitter_t *pe = this->FreeEmitters;
 	this->FreeEmitters = pe->next;
 
-	// no particles yet
+	// no particles yet; the first block is taken when the first particle is added
 	pe->particles = NULL;
+	pe->die = NULL;
+	pe->numparticles = 0;
+	pe->maxparticles = 0;
+	pe->numsynced = 0;
+	pe->blockclass = -1;
+	pe->killflag = 0;
 
 	// copy across origin
 	Vector3Copy (pe->spawnorg, spawnorg);
@@ -179,25 +205,84 @@ emitter_t *QPARTICLESYSTEM::NewEmitter (vec3_t spawnorg)
 }
 
 
-particle_t *QPARTICLESYSTEM::NewParticle (emitter_t *pe)
+void QPARTICLESYSTEM::FreeEmitterBlock (emitter_t *pe)
 {
-	if (!this->FreeParticles)
+	if (pe->particles)
 	{
-		this->FreeParticles = (particle_t *) MainHunk->FastAlloc (sizeof (particle_t));
-		this->FreeParticles->next = NULL;
+		// return the block to the free list for it's size class
+		partblock_t *block = (partblock_t *) pe->particles;
+
+		block->next = this->FreeBlocks[pe->blockclass];
+		this->FreeBlocks[pe->blockclass] = block;
 	}
 
-	// just take from the free list
-	particle_t *p = this->FreeParticles;
-	this->FreeParticles = p->next;
+	pe->particles = NULL;
+	pe->die = NULL;
+	pe->numparticles = 0;
+	pe->maxparticles = 0;
+	pe->numsynced = 0;
+	pe->blockclass = -1;
+}
 
-	// set default drawing parms (may be overwritten as desired)
-	Q_MemCpy (p, &this->DefaultParticle, sizeof (particle_t));
-	p->v.scale = 0.75f + (float) (Q_fastrand () % 5001) * 0.0001f;
 
-	// link it in
-	p->next = pe->particles;
-	pe->particles = p;
+bool QPARTICLESYSTEM::GrowEmitter (emitter_t *pe)
+{
+	int newclass = pe->blockclass + 1;
+
+	// this emitter is already as big as it can get
+	if (newclass >= PARTICLE_BLOCK_CLASSES) return false;
+
+	int newmax = PARTICLE_BLOCK_MIN << newclass;
+	byte *block = NULL;
+
+	if (this->FreeBlocks[newclass])
+	{
+		// just take from the free list
+		block = (byte *) this->FreeBlocks[newclass];
+		this->FreeBlocks[newclass] = this->FreeBlocks[newclass]->next;
+	}
+	else block = (byte *) MainHunk->FastAlloc (newmax * (sizeof (partvert_t) + sizeof (float)));
+
+	// the die times go after the vertexes in the same block; newmax is a multiple of 4 so this stays 16-aligned
+	partvert_t *particles = (partvert_t *) block;
+	float *die = (float *) (block + newmax * sizeof (partvert_t));
+
+	// copy over anything that was in the old block then release it
+	int numparticles = pe->numparticles;
+	int numsynced = pe->numsynced;
+
+	if (pe->particles)
+	{
+		Q_MemCpy (particles, pe->particles, numparticles * sizeof (partvert_t));
+		Q_MemCpy (die, pe->die, numsynced * sizeof (float));
+		this->FreeEmitterBlock (pe);
+	}
+
+	pe->particles = particles;
+	pe->die = die;
+	pe->numparticles = numparticles;
+	pe->maxparticles = newmax;
+	pe->numsynced = numsynced;
+	pe->blockclass = newclass;
+
+	return true;
+}
+
+
+partvert_t *QPARTICLESYSTEM::NewParticle (emitter_t *pe)
+{
+	// move up to a bigger block if this one is full
+	if (pe->numparticles >= pe->maxparticles)
+		if (!this->GrowEmitter (pe))
+			return NULL;
+
+	// take the next free slot
+	partvert_t *p = &pe->particles[pe->numparticles];
+	pe->numparticles++;
+
+	// set default drawing parms (may be overwritten as desired)
+	Q_MemCpy (p, &this->DefaultParticle, sizeof (partvert_t));
+	p->scale = 0.75f + (float) (Q_fastrand () % 5001) * 0.0001f;
 
 	// done
 	return p;
@@ -206,12 +291,15 @@ particle_t *QPARTICLESYSTEM::NewParticle (emitter_t *pe)
 
 void QPARTICLESYSTEM::EntityParticles (entity_t *ent)
 {
-	particle_t	*p;
+	partvert_t	*p;
 	float		sp, sy, cp, cy;
 	float		forward[3];
 
 	emitter_t *pe = this->NewEmitter (ent->origin);
 
+	// these particles should be automatically killed after 1 frame
+	pe->killflag = P_KILLFRAME;
+
 	for (int i = 0; i < NUMVERTEXNORMALS; i++)
 	{
 		if (!(p = this->NewParticle (pe))) return;
@@ -223,18 +311,16 @@ void QPARTICLESYSTEM::EntityParticles (entity_t *ent)
 		forward[1] = cp * sy;
 		forward[2] = -sp;
 
-		// these particles should be automatically killed after 1 frame
-		p->killflag = P_KILLFRAME;
-		p->v.grav = -1;
-		p->v.scale = this->EntPartScales[i];
+		p->grav = -1;
+		p->scale = this->EntPartScales[i];
 
-		this->SetRamp (&p->v, 1, 0, 10);
+		this->SetRamp (p, 1, 0, 10);
 
-		p->v.dvel[0] = p->v.dvel[1] = 4;
+		p->dvel[0] = p->dvel[1] = 4;
 
-		p->v.org[0] = ent->origin[0] + r_avertexnormals[i][0] * 64 + forward[0] * 16;
-		p->v.org[1] = ent->origin[1] + r_avertexnormals[i][1] * 64 + forward[1] * 16;
-		p->v.org[2] = ent->origin[2] + r_avertexnormals[i][2] * 64 + forward[2] * 16;
+		p->org[0] = ent->origin[0] + r_avertexnormals[i][0] * 64 + forward[0] * 16;
+		p->org[1] = ent->origin[1] + r_avertexnormals[i][1] * 64 + forward[1] * 16;
+		p->org[2] = ent->origin[2] + r_avertexnormals[i][2] * 64 + forward[2] * 16;
 	}
 }
 
@@ -263,14 +349,18 @@ void QPARTICLESYSTEM::PointFile (void)
 	for (c = 0, r = 0; ; c++)
 	{
 		vec3_t org;
-		particle_t *p;
+		partvert_t *p;
 
 		f >> org[0] >> org[1] >> org[2];
 
 		if (f.fail ()) break;
 
 		// create a new emitter every 2048 particles so as to not overflow the vertex buffer
-		if (!(c & 2047)) pe = this->NewEmitter (vec3_origin);
+		if (!(c & 2047))
+		{
+			pe = this->NewEmitter (vec3_origin);
+			pe->killflag = P_NEVERKILL;
+		}
 
 		if (!(p = this->NewParticle (pe)))
 		{
@@ -280,12 +370,11 @@ void QPARTICLESYSTEM::PointFile (void)
 		}
 
 		// make these easier to see
-		p->v.scale = 3.0f;
-		p->v.die = cl.time + 999999;
-		p->killflag = P_NEVERKILL;
-		p->v.color = d3d_QuakePalette.standard11[((-c) & 15)];
-		Vector3Copy (p->v.vel, vec3_origin);
-		Vector3Copy (p->v.org, org);
+		p->scale = 3.0f;
+		p->die = cl.time + 999999;
+		p->color = d3d_QuakePalette.standard11[((-c) & 15)];
+		Vector3Copy (p->vel, vec3_origin);
+		Vector3Copy (p->org, org);
 	}
 
 	f.close ();
@@ -310,7 +399,7 @@ void QPARTICLESYSTEM::ParseEffect (void)
 
 void QPARTICLESYSTEM::Explosion (vec3_t org)
 {
-	particle_t *p;
+	partvert_t *p;
 	emitter_t *pe = this->NewEmitter (org);
 	int base = Q_fastrand ();
 
@@ -318,21 +407,21 @@ void QPARTICLESYSTEM::Explosion (vec3_t org)
 	{
 		if (!(p = this->NewParticle (pe))) return;
 
-		p->v.grav = -1;
+		p->grav = -1;
 
 		if (i & 1)
 		{
-			this->SetRamp (&p->v, 1, Q_fastrand () & 3, 10);
-			p->v.dvel[0] = p->v.dvel[1] = 4;
+			this->SetRamp (p, 1, Q_fastrand () & 3, 10);
+			p->dvel[0] = p->dvel[1] = 4;
 		}
 		else
 		{
-			this->SetRamp (&p->v, 2, Q_fastrand () & 3, 15);
-			p->v.dvel[0] = p->v.dvel[1] = -1;
+			this->SetRamp (p, 2, Q_fastrand () & 3, 15);
+			p->dvel[0] = p->dvel[1] = -1;
 		}
 
-		this->SetExplosionVelocity (p->v.vel);
-		this->SetExplosionOrigin (p->v.org, org, base + i);
+		this->SetExplosionVelocity (p->vel);
+		this->SetExplosionOrigin (p->org, org, base + i);
 	}
 }
 
@@ -340,7 +429,7 @@ void QPARTICLESYSTEM::Explosion (vec3_t org)
 void QPARTICLESYSTEM::Explosion (vec3_t org, int colorStart, int colorLength)
 {
 	int			i;
-	particle_t	*p;
+	partvert_t	*p;
 	int			colorMod = 0;
 	int			base = Q_fastrand ();
 
@@ -350,15 +439,15 @@ void QPARTICLESYSTEM::Explosion (vec3_t org, int colorStart, int colorLength)
 	{
 		if (!(p = this->NewParticle (pe))) return;
 
-		p->v.die = cl.time + 0.3f;
-		p->v.color = d3d_QuakePalette.standard11[(colorStart + (colorMod % colorLength)) & 255];
+		p->die = cl.time + 0.3f;
+		p->color = d3d_QuakePalette.standard11[(colorStart + (colorMod % colorLength)) & 255];
 		colorMod++;
 
-		p->v.grav = -1;
-		p->v.dvel[0] = p->v.dvel[1] = 4;
+		p->grav = -1;
+		p->dvel[0] = p->dvel[1] = 4;
 
-		this->SetExplosionVelocity (p->v.vel);
-		this->SetExplosionOrigin (p->v.org, org, base + i);
+		this->SetExplosionVelocity (p->vel);
+		this->SetExplosionOrigin (p->org, org, base + i);
 	}
 }
 
@@ -366,7 +455,7 @@ void QPARTICLESYSTEM::Explosion (vec3_t org, int colorStart, int colorLength)
 void QPARTICLESYSTEM::BlobExplosion (vec3_t org)
 {
 	int			i;
-	particle_t	*p;
+	partvert_t	*p;
 	int			base = Q_fastrand ();
 
 	emitter_t *pe = this->NewEmitter (org);
@@ -375,23 +464,23 @@ void QPARTICLESYSTEM::BlobExplosion (vec3_t org)
 	{
 		if (!(p = this->NewParticle (pe))) return;
 
-		p->v.die = cl.time + (1 + (Q_fastrand () & 8) * 0.05);
-		p->v.grav = -1;
+		p->die = cl.time + (1 + (Q_fastrand () & 8) * 0.05);
+		p->grav = -1;
 
 		if (i & 1)
 		{
-			p->v.dvel[0] = p->v.dvel[1] = 4;
-			p->v.color = d3d_QuakePalette.standard11[66 + (Q_fastrand () % 6)];
+			p->dvel[0] = p->dvel[1] = 4;
+			p->color = d3d_QuakePalette.standard11[66 + (Q_fastrand () % 6)];
 		}
 		else
 		{
-			p->v.dvel[0] = -4;
-			p->v.dvel[1] = 0;
-			p->v.color = d3d_QuakePalette.standard11[150 + (Q_fastrand () % 6)];
+			p->dvel[0] = -4;
+			p->dvel[1] = 0;
+			p->color = d3d_QuakePalette.standard11[150 + (Q_fastrand () % 6)];
 		}
 
-		this->SetExplosionVelocity (p->v.vel);
-		this->SetExplosionOrigin (p->v.org, org, base + i);
+		this->SetExplosionVelocity (p->vel);
+		this->SetExplosionOrigin (p->org, org, base + i);
 	}
 }
 
@@ -399,7 +488,7 @@ void QPARTICLESYSTEM::BlobExplosion (vec3_t org)
 void QPARTICLESYSTEM::Blood (vec3_t org, vec3_t dir, int color, int count)
 {
 	int			i;
-	particle_t	*p;
+	partvert_t	*p;
 
 	emitter_t *pe = this->NewEmitter (org);
 
@@ -415,7 +504,7 @@ void QPARTICLESYSTEM::Blood (vec3_t org, vec3_t dir, int color, int count)
 void QPARTICLESYSTEM::RunEffect (vec3_t org, vec3_t dir, int color, int count)
 {
 	int			i;
-	particle_t	*p;
+	partvert_t	*p;
 
 	// hack the effect type out of the parameters
 	if (hipnotic && count <= 4)
@@ -460,7 +549,7 @@ void QPARTICLESYSTEM::RunEffect (vec3_t org, vec3_t dir, int color, int count)
 
 void QPARTICLESYSTEM::WallHitParticles (vec3_t org, vec3_t dir, int color, int count)
 {
-	particle_t *p;
+	partvert_t *p;
 	int i;
 
 	emitter_t *pe = this->NewEmitter (org);
@@ -477,22 +566,22 @@ void QPARTICLESYSTEM::WallHitParticles (vec3_t org, vec3_t dir, int color, int c
 void QPARTICLESYSTEM::RainParticle (emitter_t *pe, vec3_t mins, vec3_t maxs, int color, vec3_t vel, float time, float z, int type)
 {
 	// type 1 is snow, 0 is rain
-	particle_t *p = this->NewParticle (pe);
+	partvert_t *p = this->NewParticle (pe);
 
 	if (!p) return;
 
-	p->v.org[0] = Q_Random (mins[0], maxs[0]);
-	p->v.org[1] = Q_Random (mins[1], maxs[1]);
-	p->v.org[2] = z;
+	p->org[0] = Q_Random (mins[0], maxs[0]);
+	p->org[1] = Q_Random (mins[1], maxs[1]);
+	p->org[2] = z;
 
-	p->v.vel[0] = vel[0];
-	p->v.vel[1] = vel[1];
-	p->v.vel[2] = vel[2];
+	p->vel[0] = vel[0];
+	p->vel[1] = vel[1];
+	p->vel[2] = vel[2];
 
-	p->v.color = d3d_QuakePalette.standard11[color & 255];
-	p->v.grav = -1;
+	p->color = d3d_QuakePalette.standard11[color & 255];
+	p->grav = -1;
 
-	p->v.die = cl.time + time;
+	p->die = cl.time + time;
 }
 
 
@@ -560,7 +649,7 @@ void QPARTICLESYSTEM::Rain (vec3_t mins, vec3_t maxs, vec3_t dir, int count, int
 void QPARTICLESYSTEM::LavaSplash (vec3_t org)
 {
 	int			i, j, k;
-	particle_t	*p;
+	partvert_t	*p;
 	float		vel;
 	vec3_t		dir;
 
@@ -574,21 +663,21 @@ void QPARTICLESYSTEM::LavaSplash (vec3_t org)
 			{
 				if (!(p = this->NewParticle (pe))) return;
 
-				p->v.die = cl.time + (2 + (Q_fastrand () & 31) * 0.02);
-				p->v.color = d3d_QuakePalette.standard11[224 + (Q_fastrand () & 7)];
-				p->v.grav = -1;
+				p->die = cl.time + (2 + (Q_fastrand () & 31) * 0.02);
+				p->color = d3d_QuakePalette.standard11[224 + (Q_fastrand () & 7)];
+				p->grav = -1;
 
 				dir[0] = j * 8 + (Q_fastrand () & 7);
 				dir[1] = i * 8 + (Q_fastrand () & 7);
 				dir[2] = 256;
 
-				p->v.org[0] = org[0] + dir[0];
-				p->v.org[1] = org[1] + dir[1];
-				p->v.org[2] = org[2] + (Q_fastrand () & 63);
+				p->org[0] = org[0] + dir[0];
+				p->org[1] = org[1] + dir[1];
+				p->org[2] = org[2] + (Q_fastrand () & 63);
 
 				Vector3Normalize (dir);
 				vel = 50 + (Q_fastrand () & 63);
-				Vector3Scale (p->v.vel, dir, vel);
+				Vector3Scale (p->vel, dir, vel);
 			}
 		}
 	}
@@ -597,7 +686,7 @@ void QPARTICLESYSTEM::LavaSplash (vec3_t org)
 
 void QPARTICLESYSTEM::TeleportSplash (vec3_t org)
 {
-	particle_t	*p;
+	partvert_t	*p;
 	float		vel;
 
 	emitter_t *pe = this->NewEmitter (org);
@@ -612,16 +701,16 @@ void QPARTICLESYSTEM::TeleportSplash (vec3_t org)
 			{
 				if (!(p = this->NewParticle (pe))) return;
 
-				p->v.die = cl.time + (0.2 + (Q_fastrand () & 7) * 0.02);
-				p->v.color = d3d_QuakePalette.standard11[7 + (Q_fastrand () & 7)];
-				p->v.grav = -1;
+				p->die = cl.time + (0.2 + (Q_fastrand () & 7) * 0.02);
+				p->color = d3d_QuakePalette.standard11[7 + (Q_fastrand () & 7)];
+				p->grav = -1;
 
-				p->v.org[0] = org[0] + i + (Q_fastrand () & 3);
-				p->v.org[1] = org[1] + j + (Q_fastrand () & 3);
-				p->v.org[2] = org[2] + k + (Q_fastrand () & 3);
+				p->org[0] = org[0] + i + (Q_fastrand () & 3);
+				p->org[1] = org[1] + j + (Q_fastrand () & 3);
+				p->org[2] = org[2] + k + (Q_fastrand () & 3);
 
 				vel = 50 + (Q_fastrand () & 63);
-				Vector3Scale (p->v.vel, norm, vel);
+				Vector3Scale (p->vel, norm, vel);
 			}
 		}
 	}
@@ -656,7 +745,7 @@ void QPARTICLESYSTEM::RocketTrail (vec3_t start, vec3_t end, int trailtype)
 	// a particle trail adds too few new particles to the emiiter, even over a 1/36 second interval
 	// (maxes out at approx. 10) so we can't make this a single draw call....
 	emitter_t *pe = this->NewEmitter (start);
-	particle_t *p = NULL;
+	partvert_t *p = NULL;
 
 	for (int i = 0; i < nump; i++)
 	{
@@ -684,71 +773,71 @@ void QPARTICLESYSTEM::RocketTrail (vec3_t start, vec3_t end, int trailtype)
 			porg[2] = start[2] + plerp * (end[2] - start[2]);
 		}
 
-		Vector3Copy (p->v.vel, vec3_origin);
-		p->v.die = cl.time + 2;
+		Vector3Copy (p->vel, vec3_origin);
+		p->die = cl.time + 2;
 
 		switch (trailtype)
 		{
 		case RT_ROCKET:
 		case RT_GRENADE:
 			// rocket/grenade trail
-			p->v.grav = 1;
+			p->grav = 1;
 
 			// grenade trail decays faster
 			if (trailtype == RT_GRENADE)
-				this->SetRamp (&p->v, 3, 2 + (Q_fastrand () & 3), 5);
-			else this->SetRamp (&p->v, 3, Q_fastrand () & 3, 5);
+				this->SetRamp (p, 3, 2 + (Q_fastrand () & 3), 5);
+			else this->SetRamp (p, 3, Q_fastrand () & 3, 5);
 
-			p->v.org[0] = porg[0] + ((Q_fastrand () % 6) - 3);
-			p->v.org[1] = porg[1] + ((Q_fastrand () % 6) - 3);
-			p->v.org[2] = porg[2] + ((Q_fastrand () % 6) - 3);
+			p->org[0] = porg[0] + ((Q_fastrand () % 6) - 3);
+			p->org[1] = porg[1] + ((Q_fastrand () % 6) - 3);
+			p->org[2] = porg[2] + ((Q_fastrand () % 6) - 3);
 
 			break;
 
 		case RT_GIB:
 		case RT_ZOMGIB:
 			// blood/slight blood
-			p->v.grav = -1;
-			p->v.color = d3d_QuakePalette.standard11[67 + (Q_fastrand () & 3)];
+			p->grav = -1;
+			p->color = d3d_QuakePalette.standard11[67 + (Q_fastrand () & 3)];
 
-			p->v.org[0] = porg[0] + ((Q_fastrand () % 6) - 3);
-			p->v.org[1] = porg[1] + ((Q_fastrand () % 6) - 3);
-			p->v.org[2] = porg[2] + ((Q_fastrand () % 6) - 3);
+			p->org[0] = porg[0] + ((Q_fastrand () % 6) - 3);
+			p->org[1] = porg[1] + ((Q_fastrand () % 6) - 3);
+			p->org[2] = porg[2] + ((Q_fastrand () % 6) - 3);
 
 			break;
 
 		case RT_WIZARD:
 		case RT_KNIGHT:
 			// tracer - wizard/hellknight
-			p->v.die = cl.time + 0.5f;
+			p->die = cl.time + 0.5f;
 
 			tracercount++;
 
-			Vector3Copy (p->v.org, porg);
+			Vector3Copy (p->org, porg);
 
 			// split trail left/right
 			if (tracercount & 1)
 			{
-				p->v.vel[0] = 29.3825109f;
-				p->v.vel[1] = -1.78082475f;
+				p->vel[0] = 29.3825109f;
+				p->vel[1] = -1.78082475f;
 			}
 			else
 			{
-				p->v.vel[0] = -29.3825109f;
-				p->v.vel[1] = 1.78082475f;
+				p->vel[0] = -29.3825109f;
+				p->vel[1] = 1.78082475f;
 			}
 
-			p->v.color = d3d_QuakePalette.standard11[((trailtype == RT_WIZARD) ? 52 : 230) + ((tracercount & 4) << 1)];
+			p->color = d3d_QuakePalette.standard11[((trailtype == RT_WIZARD) ? 52 : 230) + ((tracercount & 4) << 1)];
 
 			break;
 
 		case RT_VORE:
-			p->v.color = d3d_QuakePalette.standard11[9 * 16 + 8 + (Q_fastrand () & 3)];
-			p->v.die = cl.time + 0.3f;
+			p->color = d3d_QuakePalette.standard11[9 * 16 + 8 + (Q_fastrand () & 3)];
+			p->die = cl.time + 0.3f;
 
-			p->v.org[0] = porg[0] + ((Q_fastrand () & 15) - 8);
-			p->v.org[1] = porg[1] + ((Q_fastrand () & 15) - 8);
-			p->v.org[2] = porg[2] + ((Q_fastrand () & 15) - 8);
+			p->org[0] = porg[0] + ((Q_fastrand () & 15) - 8);
+			p->org[1] = porg[1] + ((Q_fastrand () & 15) - 8);
+			p->org[2] = porg[2] + ((Q_fastrand () & 15) - 8);
 
 			break;
 		}
@@ -758,9 +847,14 @@ void QPARTICLESYSTEM::RocketTrail (vec3_t start, vec3_t end, int trailtype)
 
 void QPARTICLESYSTEM::BenchMark (int num)
 {
+	// restart the timings; the report is printed when the last benchmark particle dies
+	this->BenchSimTime = 0;
+	this->BenchFrames = 0;
+	this->DrawTime = 0;
+
 	for (int n = 0; n < num; n++)
 	{
-		particle_t *p = NULL;
+		partvert_t *p = NULL;
 		emitter_t *pe = NULL;
 
 		float org[3] =
@@ -778,133 +872,159 @@ void QPARTICLESYSTEM::BenchMark (int num)
 		{
 			if (!(p = this->NewParticle (pe))) return;
 
-			p->v.org[0] = pe->spawnorg[0] + ((Q_fastrand () & 1023) - 512);
-			p->v.org[1] = pe->spawnorg[1] + ((Q_fastrand () & 1023) - 512);
-			p->v.org[2] = pe->spawnorg[2] + ((Q_fastrand () & 1023) - 512);
+			p->org[0] = pe->spawnorg[0] + ((Q_fastrand () & 1023) - 512);
+			p->org[1] = pe->spawnorg[1] + ((Q_fastrand () & 1023) - 512);
+			p->org[2] = pe->spawnorg[2] + ((Q_fastrand () & 1023) - 512);
 
-			p->v.grav = -0.25f;
+			p->grav = -0.25f;
 
 			if (i & 1)
 			{
-				this->SetRamp (&p->v, 1, Q_fastrand () & 1, 2);
-				p->v.dvel[0] = p->v.dvel[1] = 4;
+				this->SetRamp (p, 1, Q_fastrand () & 1, 2);
+				p->dvel[0] = p->dvel[1] = 4;
 			}
 			else
 			{
-				this->SetRamp (&p->v, 3, Q_fastrand () & 1, 1);
-				p->v.dvel[0] = p->v.dvel[1] = -1;
+				this->SetRamp (p, 3, Q_fastrand () & 1, 1);
+				p->dvel[0] = p->dvel[1] = -1;
 			}
 
-			p->v.vel[0] = (Q_fastrand () & 127) - 64;
-			p->v.vel[1] = (Q_fastrand () & 127) - 64;
-			p->v.vel[2] = (Q_fastrand () & 127) - 64;
+			p->vel[0] = (Q_fastrand () & 127) - 64;
+			p->vel[1] = (Q_fastrand () & 127) - 64;
+			p->vel[2] = (Q_fastrand () & 127) - 64;
+
+			if (p->die > this->BenchEndTime) this->BenchEndTime = p->die;
 		}
 	}
 }
 
 
-void QPARTICLESYSTEM::AddToAlphaList (void)
+void QPARTICLESYSTEM::RunEmitter (emitter_t *pe)
 {
-	if (this->ActiveEmitters)
+	int i;
+
+	// pick up the die times of any particles that were spawned since the last run
+	for (i = pe->numsynced; i < pe->numparticles; i++)
+		pe->die[i] = pe->particles[i].die;
+
+	// remove expired particles, testing 4 at a time and swapping the last particle into any that are removed
+	__m128 now = _mm_set1_ps ((float) cl.time);
+
+	for (i = 0; i + 4 <= pe->numparticles;)
 	{
-		// removes expired particles from the active particles list
-		emitter_t *pe;
-		emitter_t *pekill;
+		int mask = _mm_movemask_ps (_mm_cmplt_ps (_mm_loadu_ps (&pe->die[i]), now));
 
-		// remove from the head of the list
-		for (;;)
+		// nothing in this group has expired
+		if (!mask)
 		{
-			if ((pekill = this->ActiveEmitters) != NULL && !pekill->particles)
-			{
-				// return to the free list
-				this->ActiveEmitters = pekill->next;
-				pekill->next = this->FreeEmitters;
-				this->FreeEmitters = pekill;
-				continue;
-			}
+			i += 4;
+			continue;
+		}
 
-			break;
+		// find the first expired particle in the group
+		while (!(mask & 1))
+		{
+			mask >>= 1;
+			i++;
 		}
 
-		for (pe = this->ActiveEmitters; pe; pe = pe->next)
+		// swap-remove it; the new particle at i will be re-tested on the next pass
+		pe->numparticles--;
+		pe->particles[i] = pe->particles[pe->numparticles];
+		pe->die[i] = pe->die[pe->numparticles];
+	}
+
+	for (; i < pe->numparticles;)
+	{
+		if (pe->die[i] < (float) cl.time)
 		{
-			// remove from a mid-point in the list
-			for (;;)
-			{
-				if ((pekill = pe->next) != NULL && !pekill->particles)
-				{
-					pe->next = pekill->next;
-					pekill->next = this->FreeEmitters;
-					this->FreeEmitters = pekill;
-					continue;
-				}
-
-				break;
-			}
+			pe->numparticles--;
+			pe->particles[i] = pe->particles[pe->numparticles];
+			pe->die[i] = pe->die[pe->numparticles];
+			continue;
+		}
 
-			// prepare this emitter for rendering
-			if (!pe->particles) continue;
+		i++;
+	}
 
-			// removes expired particles from the active particles list
-			//particle_t *p;
-			particle_t *pkill;
-			float etime = cl.time - pe->spawntime;
+	pe->numsynced = pe->numparticles;
 
-			// this is the count of particles that will be drawn this frame
-			pe->numparticles = 0;
+	// update time since the emitter was spawned; this is the same for every particle in the emitter
+	float etime = cl.time - pe->spawntime;
+	partvert_t *p = pe->particles;
 
-			// remove from the head of the list
-			for (;;)
-			{
-				if ((pkill = pe->particles) != NULL && (pkill->v.die < cl.time))
-				{
-					pe->particles = pkill->next;
-					pkill->next = this->FreeParticles;
-					this->FreeParticles = pkill;
+	for (i = 0; i < pe->numparticles; i++, p++)
+		p->etime = etime;
 
-					continue;
-				}
+	// killflags will take effect on the next frame
+	if (pe->killflag == P_KILLFRAME)
+	{
+		for (i = 0; i < pe->numparticles; i++)
+			pe->particles[i].die = pe->die[i] = -1;
+	}
+	else if (pe->killflag == P_NEVERKILL)
+	{
+		float neverdie = cl.time + 666;
 
-				break;
-			}
+		for (i = 0; i < pe->numparticles; i++)
+			pe->particles[i].die = pe->die[i] = neverdie;
+	}
+}
 
-			for (particle_t *p = pe->particles; p; p = p->next)
-			{
-				// remove from a mid-point in the list
-				for (;;)
-				{
-					if ((pkill = p->next) != NULL && (pkill->v.die < cl.time))
-					{
-						p->next = pkill->next;
-						pkill->next = this->FreeParticles;
-						this->FreeParticles = pkill;
-
-						continue;
-					}
-
-					break;
-				}
-
-				// update it's time since the emitter was spawned
-				p->v.etime = etime;
-
-				// count the active particles for this type
-				pe->numparticles++;
-
-				// killflags will take effect on the next frame
-				if (p->killflag == P_KILLFRAME) p->v.die = -1;
-				if (p->killflag == P_NEVERKILL) p->v.die = cl.time + 666;
-			}
 
-			if (!pe->particles) continue;
-			if (!pe->numparticles) continue;
+void QPARTICLESYSTEM::RunEmitters (void)
+{
+	double simstart = Sys_ProfileTime ();
+
+	// this only touches the emitters themselves so it's safe to run on any thread while the rest of the scene is built
+	for (emitter_t *pe = this->ActiveEmitters; pe; pe = pe->next)
+		if (pe->numparticles) this->RunEmitter (pe);
 
-			// these are deferred to here so that particles get removed from the lists even if we're not drawing any
-			if (!r_drawparticles.integer) continue;
-			if (!(r_particlesize.value > 0)) continue;
+	if (this->BenchEndTime > 0) this->BenchSimTime += Sys_ProfileTime () - simstart;
+}
+
+
+void QPARTICLESYSTEM::AddToAlphaList (void)
+{
+	for (emitter_t **link = &this->ActiveEmitters; *link;)
+	{
+		emitter_t *pe = *link;
 
-			// add to the draw list (only if there's something to draw)
-			D3DAlpha_AddToList (pe);
+		if (!pe->numparticles)
+		{
+			// everything in this emitter is dead so return it and it's block to the free lists
+			*link = pe->next;
+			this->FreeEmitterBlock (pe);
+			pe->next = this->FreeEmitters;
+			this->FreeEmitters = pe;
+			continue;
+		}
+
+		link = &pe->next;
+
+		// these are deferred to here so that particles get removed from the lists even if we're not drawing any
+		if (!r_drawparticles.integer) continue;
+		if (!(r_particlesize.value > 0)) continue;
+
+		// add to the draw list (only if there's something to draw)
+		D3DAlpha_AddToList (pe);
+	}
+
+	if (this->BenchEndTime > 0)
+	{
+		this->BenchFrames++;
+
+		if (cl.time > this->BenchEndTime)
+		{
+			Con_Printf
+			(
+				"particle benchmark: %i frames, %0.3f ms simulation, %0.3f ms draw per frame\n",
+				this->BenchFrames,
+				(float) ((this->BenchSimTime * 1000.0) / (double) this->BenchFrames),
+				(float) ((this->DrawTime * 1000.0) / (double) this->BenchFrames)
+			);
+
+			this->BenchEndTime = 0;
 		}
 	}
 }
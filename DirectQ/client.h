@@ -165,6 +165,8 @@ struct client_static_t
 	int			forcetrack;			// -1 = use normal cd track
 	int			td_currframe;		// to meter out one message a frame
 	double		td_starttime;		// realtime at second frame of timedemo
+	bool		demoseeking;		// fast-forwarding a demo; messages are read without waiting and no sounds are started
+	int			demolevel;			// serverinfos since the demo started so that demo keyframes know which level they came from
 
 	download_t	download;
 
@@ -384,6 +386,8 @@ void CL_Stop_f (void);
 void CL_Record_f (void);
 void CL_PlayDemo_f (void);
 void CL_TimeDemo_f (void);
+void CL_DemoSeek_f (void);
+void CL_DemoInfo_f (void);
 
 // cl_parse.c
 void CL_ParseServerMessage (void);
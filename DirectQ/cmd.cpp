@@ -25,6 +25,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 struct cmdalias_t
 {
 	struct cmdalias_t	*next;
+	struct cmdalias_t	*hashnext;
 	char	*name;
 	char	*value;
 };
@@ -72,6 +73,54 @@ void AliasList_f (void)
 // possible commands to execute
 static cmd_t *cmd_functions = NULL;
 
+// commands register from global constructors before the memory pools are up so these are fixed-size static
+// tables chained through hashnext; lookups are case-insensitive the same as the old sorted list search was
+#define CMD_HASH_SIZE	512
+
+static cmd_t *cmd_hash[CMD_HASH_SIZE];
+static cmdalias_t *cmd_aliashash[CMD_HASH_SIZE];
+
+static cmd_t *Cmd_FindCommand (char *name)
+{
+	for (cmd_t *cmd = cmd_hash[COM_HashNameNoCase (name) & (CMD_HASH_SIZE - 1)]; cmd; cmd = cmd->hashnext)
+		if (!_stricmp (name, cmd->name))
+			return cmd;
+
+	return NULL;
+}
+
+
+static cmdalias_t *Cmd_FindAlias (char *name)
+{
+	for (cmdalias_t *a = cmd_aliashash[COM_HashNameNoCase (name) & (CMD_HASH_SIZE - 1)]; a; a = a->hashnext)
+		if (!_stricmp (name, a->name))
+			return a;
+
+	return NULL;
+}
+
+
+static void Cmd_UnlinkAlias (cmdalias_t *alias)
+{
+	for (cmdalias_t **a = &cmd_alias; *a; a = &(*a)->next)
+	{
+		if (*a == alias)
+		{
+			*a = alias->next;
+			break;
+		}
+	}
+
+	for (cmdalias_t **a = &cmd_aliashash[COM_HashNameNoCase (alias->name) & (CMD_HASH_SIZE - 1)]; *a; a = &(*a)->hashnext)
+	{
+		if (*a == alias)
+		{
+			*a = alias->hashnext;
+			break;
+		}
+	}
+}
+
 void Cmd_Inc_f (void)
 {
 	cvar_t *var = NULL;
@@ -131,7 +180,7 @@ void Cmd_NullFunction (void) {}
 
 						COMMAND AUTOCOMPLETION
 
-		This is now used for actual command execution too...
+		Execution goes through the hash tables above; this is only for completion and listing.
 
 =============================================================================
 */
@@ -294,24 +343,6 @@ int Cmd_Match (char *partial, int matchcycle, bool conout)
 }
 
 
-cvar_t *Cmd_FindCvar (char *name)
-{
-	complist_t key = {name, NULL, NULL, NULL};
-	complist_t *clist = (complist_t *) bsearch (&key, complist, numcomplist, sizeof (complist_t), CmdCvarCompareFunc);
-
-	if (!clist)
-		return NULL;
-	else if (clist->var)
-	{
-		// skip nehahra cvars if we're not running nehahra
-		if (!nehahra && (clist->var->usage & CVAR_NEHAHRA)) return NULL;
-
-		return clist->var;
-	}
-	else return NULL;
-}
-
-
 //=============================================================================
 
 void CmdCvarList (bool dumpcmd, bool dumpvar)
@@ -411,7 +442,246 @@ void Cmd_Wait_f (void)
 =============================================================================
 */
 
-sizebuf_t	cmd_text;
+/*
+the command buffer is a stack of text segments.  the bottom one takes Cbuf_AddText and is consumed from the front
+by advancing a read offset rather than moving the remaining text down; Cbuf_InsertText pushes a new segment on top
+which is read before anything below it.  adding or inserting is therefore only ever proportional to the length of
+the new text.  a command can still run across the end of a segment and into the next one down, the same as it could
+run from inserted text into the existing text in a single buffer, so partial lines from successive stuffcmds or an
+exec'ed file with no trailing newline join up exactly as before.
+*/
+
+// a runaway recursive alias stops here
+#define CBUF_MAX_TEXT		(16 * 1024 * 1024)
+
+class QCOMMANDBUFFER
+{
+public:
+	QCOMMANDBUFFER (void);
+	~QCOMMANDBUFFER (void);
+
+	void AddText (char *text);
+	void InsertText (char *text);
+	bool ReadLine (char *line, int maxlen);
+
+private:
+	struct segment_t
+	{
+		int start;
+		int readpos;
+		int end;
+	};
+
+	static void *Grow (void *data, int oldsize, int newsize);
+	int PendingSize (void);
+
+	// text added at the end
+	char *Text;
+	int ReadPos;
+	int CurSize;
+	int MaxSize;
+
+	// text inserted at the front; each segment's text is in the arena above the one below it so
+	// popping a segment just drops the top of the arena
+	char *StackText;
+	int StackSize;
+	int StackMax;
+
+	segment_t *Segments;
+	int NumSegments;
+	int MaxSegments;
+};
+
+
+QCOMMANDBUFFER::QCOMMANDBUFFER (void)
+{
+	// nothing is allocated until it's needed as the zone may not be up yet
+	this->Text = NULL;
+	this->ReadPos = this->CurSize = this->MaxSize = 0;
+
+	this->StackText = NULL;
+	this->StackSize = this->StackMax = 0;
+
+	this->Segments = NULL;
+	this->NumSegments = this->MaxSegments = 0;
+}
+
+
+QCOMMANDBUFFER::~QCOMMANDBUFFER (void)
+{
+	if (!MainZone) return;
+
+	MainZone->Free (this->Text);
+	MainZone->Free (this->StackText);
+	MainZone->Free (this->Segments);
+}
+
+
+void *QCOMMANDBUFFER::Grow (void *data, int oldsize, int newsize)
+{
+	void *newdata = MainZone->FastAlloc (newsize);
+
+	if (data)
+	{
+		Q_MemCpy (newdata, data, oldsize);
+		MainZone->Free (data);
+	}
+
+	return newdata;
+}
+
+
+int QCOMMANDBUFFER::PendingSize (void)
+{
+	return (this->CurSize - this->ReadPos) + this->StackSize;
+}
+
+
+void QCOMMANDBUFFER::AddText (char *text)
+{
+	if (!text || !text[0]) return;
+
+	int len = strlen (text);
+
+	if (this->PendingSize () + len >= CBUF_MAX_TEXT)
+	{
+		Con_Printf ("Cbuf_AddText: overflow\n");
+		return;
+	}
+
+	// everything was read so start again at the beginning
+	if (this->ReadPos == this->CurSize) this->ReadPos = this->CurSize = 0;
+
+	if (this->CurSize + len > this->MaxSize)
+	{
+		// move the unread text down first; this only happens when the buffer fills so it amortizes out
+		if (this->ReadPos)
+		{
+			memmove (this->Text, this->Text + this->ReadPos, this->CurSize - this->ReadPos);
+			this->CurSize -= this->ReadPos;
+			this->ReadPos = 0;
+		}
+
+		if (this->CurSize + len > this->MaxSize)
+		{
+			int newsize = (this->MaxSize < 0x10000) ? 0x10000 : this->MaxSize * 2;
+
+			while (newsize < this->CurSize + len) newsize *= 2;
+
+			this->Text = (char *) QCOMMANDBUFFER::Grow (this->Text, this->CurSize, newsize);
+			this->MaxSize = newsize;
+		}
+	}
+
+	Q_MemCpy (this->Text + this->CurSize, text, len);
+	this->CurSize += len;
+}
+
+
+void QCOMMANDBUFFER::InsertText (char *text)
+{
+	if (!text || !text[0]) return;
+
+	int len = strlen (text);
+
+	if (this->PendingSize () + len >= CBUF_MAX_TEXT)
+	{
+		Con_Printf ("Cbuf_InsertText: overflow\n");
+		return;
+	}
+
+	if (this->StackSize + len > this->StackMax)
+	{
+		int newsize = (this->StackMax < 0x10000) ? 0x10000 : this->StackMax * 2;
+
+		while (newsize < this->StackSize + len) newsize *= 2;
+
+		this->StackText = (char *) QCOMMANDBUFFER::Grow (this->StackText, this->StackSize, newsize);
+		this->StackMax = newsize;
+	}
+
+	if (this->NumSegments == this->MaxSegments)
+	{
+		int newsize = (this->MaxSegments < 64) ? 64 : this->MaxSegments * 2;
+
+		this->Segments = (segment_t *) QCOMMANDBUFFER::Grow (this->Segments, this->NumSegments * sizeof (segment_t), newsize * sizeof (segment_t));
+		this->MaxSegments = newsize;
+	}
+
+	segment_t *seg = &this->Segments[this->NumSegments++];
+
+	seg->start = seg->readpos = this->StackSize;
+	seg->end = this->StackSize + len;
+
+	Q_MemCpy (this->StackText + this->StackSize, text, len);
+	this->StackSize += len;
+}
+
+
+bool QCOMMANDBUFFER::ReadLine (char *line, int maxlen)
+{
+	bool gotline = false;
+	int len = 0;
+	int quotes = 0;
+
+	for (;;)
+	{
+		char *text;
+		int *readpos;
+		int end;
+
+		// read from the top of the stack, or the bottom buffer if the stack is empty
+		if (this->NumSegments)
+		{
+			segment_t *seg = &this->Segments[this->NumSegments - 1];
+
+			if (seg->readpos >= seg->end)
+			{
+				// this one's used up so pop it and carry on with the one below
+				this->StackSize = seg->start;
+				this->NumSegments--;
+				continue;
+			}
+
+			text = this->StackText;
+			readpos = &seg->readpos;
+			end = seg->end;
+		}
+		else
+		{
+			// nothing more to read
+			if (this->ReadPos >= this->CurSize) break;
+
+			text = this->Text;
+			readpos = &this->ReadPos;
+			end = this->CurSize;
+		}
+
+		gotline = true;
+
+		// find a \n or ; line break
+		while (*readpos < end)
+		{
+			char c = text[(*readpos)++];
+
+			if (c == '"') quotes++;
+
+			// don't break if inside a quoted string
+			if (!(quotes & 1) && c == ';') goto line_done;
+			if (c == '\n') goto line_done;
+
+			if (len < maxlen - 1) line[len++] = c;
+		}
+	}
+
+line_done:;
+	line[len] = 0;
+	return gotline;
+}
+
+
+QCOMMANDBUFFER cmd_text;
+
 
 /*
 ============
@@ -420,9 +690,7 @@ Cbuf_Init
 */
 void Cbuf_Init (void)
 {
-	// space for commands and script files
-	// take 64 k
-	SZ_Alloc (&cmd_text, 0x10000);
+	// the buffer grows as needed and nothing needs to be done here any more
 }
 
 
@@ -435,18 +703,7 @@ Adds command text at the end of the buffer
 */
 void Cbuf_AddText (char *text)
 {
-	if (text && text[0])
-	{
-		int l = strlen (text);
-
-		if (cmd_text.cursize + l >= cmd_text.maxsize)
-		{
-			Con_Printf ("Cbuf_AddText: overflow\n");
-			return;
-		}
-
-		SZ_Write (&cmd_text, text, strlen (text));
-	}
+	cmd_text.AddText (text);
 }
 
 
@@ -455,32 +712,11 @@ void Cbuf_AddText (char *text)
 Cbuf_InsertText
 
 Adds command text immediately after the current command
-Adds a \n to the text
-FIXME: actually change the command buffer to do less copying
 ============
 */
 void Cbuf_InsertText (char *text)
 {
-	char *temp = NULL;
-
-	// copy off any commands still remaining in the exec buffer
-	int templen = cmd_text.cursize;
-	int hunkmark = TempHunk->GetLowMark ();
-
-	if (templen)
-	{
-		temp = (char *) TempHunk->FastAlloc (templen + 1);
-		Q_MemCpy (temp, cmd_text.data, templen);
-		SZ_Clear (&cmd_text);
-	}
-
-	// add the entire text of the file
-	Cbuf_AddText (text);
-
-	// add the copied off data
-	if (templen) SZ_Write (&cmd_text, temp, templen);
-
-	TempHunk->FreeToLowMark (hunkmark);
+	cmd_text.InsertText (text);
 }
 
 
@@ -491,56 +727,88 @@ Cbuf_Execute
 */
 void Cbuf_Execute (void)
 {
-	int		i;
-	char	*text;
 	char	line[1024];
-	int		quotes;
 
-	while (cmd_text.cursize)
+	while (cmd_text.ReadLine (line, sizeof (line)))
 	{
-		// find a \n or ; line break
-		text = (char *) cmd_text.data;
-
-		quotes = 0;
+		// execute the command line
+		Cmd_ExecuteString (line, src_command);
 
-		for (i = 0; i < cmd_text.cursize; i++)
+		if (cmd_wait)
 		{
-			if (text[i] == '"') quotes++;
-
-			// don't break if inside a quoted string
-			if (!(quotes & 1) &&  text[i] == ';') break;
-			if (text[i] == '\n') break;
+			// skip out while text still remains in buffer, leaving it
+			// for next frame
+			cmd_wait = false;
+			break;
 		}
+	}
+}
 
-		Q_MemCpy (line, text, i);
-		line[i] = 0;
 
-		// delete the text from the command buffer and move remaining commands down
-		// this is necessary because commands (exec, alias) can insert data at the
-		// beginning of the text buffer
-		if (i == cmd_text.cursize)
-			cmd_text.cursize = 0;
-		else
+/*
+============
+Cbuf_Bench_f
+
+pushes a generated config of (default 10000) lines through a private command buffer, with an alias-style insert
+every few lines, and times it.  the lines are only split, not executed, so this measures the buffer itself.
+============
+*/
+void Cbuf_Bench_f (void)
+{
+	int numlines = (Cmd_Argc () > 1) ? atoi (Cmd_Argv (1)) : 10000;
+
+	if (numlines < 1) numlines = 1;
+
+	int hunkmark = TempHunk->GetLowMark ();
+	char *config = (char *) TempHunk->FastAlloc (numlines * 64 + 1);
+	char *cfgtext = config;
+
+	for (int i = 0; i < numlines; i++)
+	{
+		// a mix of single commands, ;-separated commands and quoted ;s
+		switch (i % 3)
 		{
-			i++;
-			cmd_text.cursize -= i;
-			Q_MemCpy (text, text + i, cmd_text.cursize);
+		case 0: cfgtext += sprintf (cfgtext, "bind k%i \"impulse %i; wait; +attack\"\n", i, i & 255); break;
+		case 1: cfgtext += sprintf (cfgtext, "set cbuf%i %i; echo %i\n", i, i, i); break;
+		default: cfgtext += sprintf (cfgtext, "alias a%i\n", i); break;
 		}
+	}
 
-		// execute the command line
-		Cmd_ExecuteString (line, src_command);
+	QCOMMANDBUFFER *bench = new QCOMMANDBUFFER ();
+	char line[1024];
+	int numread = 0;
+	int numinserts = 0;
+	double starttime = Sys_ProfileTime ();
 
-		if (cmd_wait)
+	// this is what exec does
+	bench->InsertText ("\n");
+	bench->InsertText (config);
+	bench->InsertText ("//cbuf_bench\n");
+
+	while (bench->ReadLine (line, sizeof (line)))
+	{
+		numread++;
+
+		// expand the "alias" lines the same way a real alias would be
+		if (line[0] == 'a' && line[1] == 'l')
 		{
-			// skip out while text still remains in buffer, leaving it
-			// for next frame
-			cmd_wait = false;
-			break;
+			bench->InsertText ("echo expanded; echo alias\n");
+			numinserts++;
 		}
 	}
+
+	double endtime = Sys_ProfileTime ();
+
+	delete bench;
+	TempHunk->FreeToLowMark (hunkmark);
+
+	Con_Printf ("%i lines (%i commands, %i inserts) in %0.3f ms\n", numlines, numread, numinserts, (float) ((endtime - starttime) * 1000.0));
 }
 
 
+cmd_t Cbuf_Bench_Cmd ("cbuf_bench", Cbuf_Bench_f);
+
+
 /*
 ==============================================================================
 
@@ -725,52 +993,36 @@ void Cmd_Alias_f (void)
 	s = Cmd_Argv (1);
 
 	// try to find it first so that we can access it quickly for printing/etc
-	complist_t key = {s, NULL, NULL, NULL};
-	complist_t *clist = (complist_t *) bsearch (&key, complist, numcomplist, sizeof (complist_t), CmdCvarCompareFunc);
+	a = Cmd_FindAlias (s);
 
 	if (Cmd_Argc () == 2)
 	{
-		if (clist)
-		{
-			// protect us oh lord from stupid programmer errors
-			assert (clist->name);
-			assert ((clist->alias || clist->cmd || clist->var));
-
-			if (clist->alias)
-				Con_Printf ("\"%s\" : \"%s\"\n", clist->alias->name, clist->alias->value);
-			else if (clist->cmd)
-				Con_Printf ("\"%s\" is a command\n", s);
-			else if (clist->var)
-				Con_Printf ("\"%s\" is a cvar\n", s);
-		}
+		if (a)
+			Con_Printf ("\"%s\" : \"%s\"\n", a->name, a->value);
+		else if (Cmd_FindCommand (s))
+			Con_Printf ("\"%s\" is a command\n", s);
+		else if (cvar_t::FindVar (s))
+			Con_Printf ("\"%s\" is a cvar\n", s);
 		else Con_Printf ("alias \"%s\" is not found\n", s);
 
 		return;
 	}
 
-	if (clist)
+	if (a)
 	{
-		// protect us oh lord from stupid programmer errors
-		assert (clist->name);
-		assert ((clist->alias || clist->cmd || clist->var));
-
-		if (clist->alias)
-		{
-			// if the alias already exists we reuse it, just free the value
-			HeapFree (GetProcessHeap (), 0, clist->alias->value);
-			clist->alias->value = NULL;
-			a = clist->alias;
-		}
-		else if (clist->cmd)
-		{
-			Con_Printf ("\"%s\" is already a command\n", s);
-			return;
-		}
-		else if (clist->var)
-		{
-			Con_Printf ("\"%s\" is already a cvar\n", s);
-			return;
-		}
+		// if the alias already exists we reuse it, just free the value
+		HeapFree (GetProcessHeap (), 0, a->value);
+		a->value = NULL;
+	}
+	else if (Cmd_FindCommand (s))
+	{
+		Con_Printf ("\"%s\" is already a command\n", s);
+		return;
+	}
+	else if (cvar_t::FindVar (s))
+	{
+		Con_Printf ("\"%s\" is already a cvar\n", s);
+		return;
 	}
 	else
 	{
@@ -781,9 +1033,14 @@ void Cmd_Alias_f (void)
 		a->name = (char *) HeapAlloc (GetProcessHeap (), 0, strlen (s) + 1);
 		strcpy (a->name, s);
 
-		// link it into the alias list
+		// link it into the alias list and the hash
+		int bucket = COM_HashNameNoCase (a->name) & (CMD_HASH_SIZE - 1);
+
 		a->next = cmd_alias;
 		cmd_alias = a;
+
+		a->hashnext = cmd_aliashash[bucket];
+		cmd_aliashash[bucket] = a;
 	}
 
 	// ensure that we haven't missed anything or been stomped
@@ -814,7 +1071,7 @@ void Cmd_Alias_f (void)
 
 void Cmd_Unalias_f (void)
 {
-	cmdalias_t	*a, *prev;
+	cmdalias_t	*a;
 
 	switch (Cmd_Argc ())
 	{
@@ -824,31 +1081,16 @@ void Cmd_Unalias_f (void)
 		break;
 
 	case 2:
-		if (!cmd_alias) return;
-
-		for (prev = a = cmd_alias; a; a = a->next)
+		if ((a = Cmd_FindAlias (Cmd_Argv (1))) != NULL)
 		{
-			if (!a) break;
-
-			if (!strcmp (Cmd_Argv (1), a->name))
-			{
-				prev->next = a->next;
-				HeapFree (GetProcessHeap (), 0, a->value);
-				HeapFree (GetProcessHeap (), 0, a->name);
-				HeapFree (GetProcessHeap (), 0, a);
+			Cmd_UnlinkAlias (a);
 
-				// this is a dubious construct but it seems to run safe enough despite that...
-				// oh well.  live fast, die young.
-#pragma warning(suppress: 6001)
-				prev = a;
+			HeapFree (GetProcessHeap (), 0, a->value);
+			HeapFree (GetProcessHeap (), 0, a->name);
+			HeapFree (GetProcessHeap (), 0, a);
 
-				// rebuild the autocomplete list
-				Cmd_BuildCompletionList ();
-
-				return;
-			}
-
-			prev = a;
+			// rebuild the autocomplete list
+			Cmd_BuildCompletionList ();
 		}
 
 		break;
@@ -869,6 +1111,7 @@ void Cmd_ClearAlias_f (void)
 	}
 
 	cmd_alias = NULL;
+	memset (cmd_aliashash, 0, sizeof (cmd_aliashash));
 
 	// rebuild the autocomplete list
 	Cmd_BuildCompletionList ();
@@ -1005,22 +1248,20 @@ void Cmd_Add (cmd_t *newcmd)
 	// fail if the command is a variable name
 	if (cvar_t::VariableString (newcmd->name)[0]) return;
 
-	// fail if the command already exists
-	for (cmd_t *cmd = cmd_functions; cmd; cmd = cmd->next)
-	{
-		if (!strcmp (newcmd->name, cmd->name))
-		{
-			// silent fail
-			return;
-		}
-	}
+	// fail if the command already exists (silently)
+	if (Cmd_FindCommand (newcmd->name)) return;
 
 	if (!newcmd->function)
 		newcmd->function = Cmd_NullFunction;
 
 	// link in
+	int bucket = COM_HashNameNoCase (newcmd->name) & (CMD_HASH_SIZE - 1);
+
 	newcmd->next = cmd_functions;
 	cmd_functions = newcmd;
+
+	newcmd->hashnext = cmd_hash[bucket];
+	cmd_hash[bucket] = newcmd;
 }
 
 
@@ -1031,15 +1272,7 @@ Cmd_Exists
 */
 bool Cmd_Exists (char *cmd_name)
 {
-	cmd_t	*cmd;
-
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
-	{
-		if (!strcmp (cmd_name, cmd->name))
-			return true;
-	}
-
-	return false;
+	return (Cmd_FindCommand (cmd_name) != NULL);
 }
 
 
@@ -1048,11 +1281,14 @@ bool Cmd_Exists (char *cmd_name)
 Cmd_ExecuteString
 
 A complete command line has been parsed, so try to execute it
-FIXME: lookupnoadd the token to speed search?
 ============
 */
 void Cmd_ExecuteString (char *text, cmd_source_t src)
 {
+	cmd_t *cmd;
+	cmdalias_t *alias;
+	cvar_t *var;
+
 	cmd_source = src;
 	Cmd_TokenizeString (text);
 
@@ -1060,63 +1296,35 @@ void Cmd_ExecuteString (char *text, cmd_source_t src)
 	// check for tokens
 	if (!Cmd_Argc ()) return;
 
-	// run a binary search for faster comparison
-	// reuse the autocomplete list for this as it's already a sorted array
-	complist_t key = {cmd_argv[0], NULL, NULL, NULL};
-	complist_t *clist = (complist_t *) bsearch (&key, complist, numcomplist, sizeof (complist_t), CmdCvarCompareFunc);
-
-	if (!clist)
+	// names are unique across cmds, aliases and cvars so the order we check them in doesn't matter
+	if ((cmd = Cmd_FindCommand (cmd_argv[0])) != NULL)
 	{
-		// only complain if we're up fully
 		if (full_initialized)
-			Con_Printf ("Unknown command \"%s\"\n", Cmd_Argv (0));
-
-		return;
-	}
-	else
-	{
-		assert (clist->name);
-		assert ((clist->alias || clist->cmd || clist->var));
-
-		if (clist->cmd)
 		{
-			if (full_initialized)
-			{
-				// execute normally
-				clist->cmd->function ();
-				return;
-			}
-			else
-			{
-				if (!_stricmp (clist->cmd->name, "exec"))
-				{
-					// allow exec commands before everything comes up as they can call
-					// into other configs which also store cvars
-					clist->cmd->function ();
-					return;
-				}
-			}
-		}
-		else if (clist->alias)
-		{
-			Cbuf_InsertText (clist->alias->value);
-			return;
+			// execute normally
+			cmd->function ();
 		}
-		else if (clist->var)
+		else if (!_stricmp (cmd->name, "exec"))
 		{
-			// skip nehahra cvars if we're not running nehahra
-			if (!nehahra && (clist->var->usage & CVAR_NEHAHRA))
-			{
-				Con_Printf ("Unknown command \"%s\"\n", clist->var->name);
-				return;
-			}
-
-			// perform a variable print or set
-			if (Cmd_Argc () == 1)
-				Con_Printf ("\"%s\" is \"%s\" (default \"%s\")\n", clist->var->name, clist->var->string, clist->var->defaultvalue);
-			else clist->var->Set (Cmd_Argv (1));
+			// allow exec commands before everything comes up as they can call
+			// into other configs which also store cvars
+			cmd->function ();
 		}
 	}
+	else if ((alias = Cmd_FindAlias (cmd_argv[0])) != NULL)
+		Cbuf_InsertText (alias->value);
+	else if ((var = cvar_t::FindVar (cmd_argv[0])) != NULL)
+	{
+		// perform a variable print or set (FindVar skips nehahra cvars if we're not running nehahra)
+		if (Cmd_Argc () == 1)
+			Con_Printf ("\"%s\" is \"%s\" (default \"%s\")\n", var->name, var->string, var->defaultvalue);
+		else var->Set (Cmd_Argv (1));
+	}
+	else if (full_initialized)
+	{
+		// only complain if we're up fully
+		Con_Printf ("Unknown command \"%s\"\n", Cmd_Argv (0));
+	}
 }
 
 
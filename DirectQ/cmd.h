@@ -74,6 +74,7 @@ public:
 	char			*name;
 	xcommand_t		function;
 	cmd_t *next;
+	cmd_t *hashnext;
 };
 
 
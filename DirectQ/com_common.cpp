@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 // used for generating md5 hashes
 #include <wincrypt.h>
+#include <emmintrin.h>
 
 int Q_snprintf (char *buffer, size_t size, const char *format, ...)
 {
@@ -111,6 +112,386 @@ void COM_HashData (byte *hash, const void *data, int size)
 }
 
 
+// fast non-cryptographic hashes for content lookups where md5 is overkill.  the bulk loop is modelled on xxh3:
+// 64-byte stripes xor'ed with a key, 32x32->64 multiplied with sse2 and accumulated into 8 64-bit lanes.
+__declspec (align (16)) static const unsigned int com_FastHashKey[16] =
+{
+	0xbe4ba423, 0x396cfeb8, 0x1cad21f7, 0x2c81017c, 0xdb979083, 0xe96dd4de, 0x1f67b3b7, 0xa4f3b96f,
+	0x6b3a1a4b, 0xc2b2ae3d, 0x27d4eb2f, 0x165667b1, 0x85ebca77, 0x9e3779b1, 0xd6e8feb8, 0x6c1b8a35
+};
+
+static unsigned __int64 COM_FastHashMix (unsigned __int64 h)
+{
+	// murmur3 finalizer
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+
+unsigned __int64 COM_FastHash (const void *data, int size)
+{
+	const byte *src = (const byte *) data;
+	unsigned __int64 hash = 0x9e3779b185ebca87ULL ^ ((unsigned __int64) size * 0xc2b2ae3d27d4eb4fULL);
+
+	if (size >= 64)
+	{
+		__declspec (align (16)) unsigned __int64 lanes[8];
+		__m128i acc[4];
+		__m128i key[4];
+
+		for (int i = 0; i < 4; i++)
+		{
+			acc[i] = _mm_set_epi32 (0x85ebca77, 0xc2b2ae3d, 0x9e3779b1, 0x27d4eb2f + i);
+			key[i] = _mm_load_si128 ((__m128i *) &com_FastHashKey[i * 4]);
+		}
+
+		for (; size >= 64; src += 64, size -= 64)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				__m128i dv = _mm_loadu_si128 ((__m128i *) src + i);
+				__m128i dk = _mm_xor_si128 (dv, key[i]);
+
+				// low 32 of each 64-bit lane times its high 32, plus the lane-swapped input so that no data is lost
+				__m128i prod = _mm_mul_epu32 (dk, _mm_shuffle_epi32 (dk, _MM_SHUFFLE (0, 3, 0, 1)));
+				acc[i] = _mm_add_epi64 (acc[i], _mm_add_epi64 (prod, _mm_shuffle_epi32 (dv, _MM_SHUFFLE (1, 0, 3, 2))));
+			}
+		}
+
+		for (int i = 0; i < 4; i++)
+			_mm_store_si128 ((__m128i *) &lanes[i * 2], acc[i]);
+
+		for (int i = 0; i < 8; i++)
+			hash = COM_FastHashMix (hash ^ lanes[i]) + lanes[i];
+	}
+
+	// remainder
+	for (; size >= 8; src += 8, size -= 8)
+		hash = COM_FastHashMix (hash ^ ((unsigned __int64 *) src)[0]);
+
+	for (; size > 0; src++, size--)
+		hash = (hash ^ src[0]) * 0x100000001b3ULL;
+
+	return COM_FastHashMix (hash);
+}
+
+
+/*
+lz77 packer in the style of lz4; each sequence is a token byte holding a 4-bit literal count and a 4-bit match
+length (either of which spills into 255-terminated extra bytes at 15), the literals, then a 16-bit match offset.
+the last sequence is literals only.  it doesn't compress as well as deflate but it's many times faster both
+ways and there's no deflate in the tree anyway.  safe to call from any thread.
+*/
+#define COM_LZ_HASHBITS		14
+#define COM_LZ_MINMATCH		4
+#define COM_LZ_MAXOFFSET	65535
+
+static byte *COM_WriteLZLength (byte *out, int len)
+{
+	for (len -= 15; len >= 255; len -= 255) *out++ = 255;
+
+	*out++ = len;
+	return out;
+}
+
+
+static void COM_WriteLZSequence (byte **out, const byte *literals, int litlen, int matchlen)
+{
+	byte *op = *out;
+	byte *token = op++;
+
+	*token = ((litlen < 15) ? litlen : 15) << 4;
+
+	if (litlen >= 15) op = COM_WriteLZLength (op, litlen);
+
+	memcpy (op, literals, litlen);
+	op += litlen;
+
+	if (matchlen >= 0)
+	{
+		// the offset is written by the caller
+		*token |= (matchlen < 15) ? matchlen : 15;
+	}
+
+	*out = op;
+}
+
+
+int COM_CompressLZ (const byte *in, int insize, byte *out)
+{
+	// positions are stored +1 so that a zeroed table means empty
+	int *table = (int *) calloc (1 << COM_LZ_HASHBITS, sizeof (int));
+	const byte *ip = in;
+	const byte *anchor = in;
+	const byte *end = in + insize;
+	byte *op = out;
+
+	while (ip + COM_LZ_MINMATCH <= end)
+	{
+		unsigned int seq = *(unsigned int *) ip;
+		unsigned int hash = (seq * 2654435761U) >> (32 - COM_LZ_HASHBITS);
+		int ref = table[hash] - 1;
+
+		table[hash] = (ip - in) + 1;
+
+		if (ref < 0 || (ip - in) - ref > COM_LZ_MAXOFFSET || *(unsigned int *) (in + ref) != seq)
+		{
+			ip++;
+			continue;
+		}
+
+		// extend the match as far as it goes
+		const byte *mp = in + ref + COM_LZ_MINMATCH;
+		const byte *sp = ip + COM_LZ_MINMATCH;
+
+		while (sp < end && *sp == *mp) sp++, mp++;
+
+		int offset = (ip - in) - ref;
+		int matchlen = (sp - ip) - COM_LZ_MINMATCH;
+
+		COM_WriteLZSequence (&op, anchor, ip - anchor, matchlen);
+
+		*op++ = offset & 255;
+		*op++ = offset >> 8;
+
+		if (matchlen >= 15) op = COM_WriteLZLength (op, matchlen);
+
+		ip = anchor = sp;
+	}
+
+	// and whatever's left over
+	COM_WriteLZSequence (&op, anchor, end - anchor, -1);
+
+	free (table);
+	return op - out;
+}
+
+
+static bool COM_ReadLZLength (const byte **in, const byte *end, int *len)
+{
+	const byte *ip = *in;
+	int b;
+
+	do
+	{
+		if (ip >= end) return false;
+
+		b = *ip++;
+		*len += b;
+	} while (b == 255);
+
+	*in = ip;
+	return true;
+}
+
+
+bool COM_DecompressLZ (const byte *in, int insize, byte *out, int outsize)
+{
+	const byte *ip = in;
+	const byte *iend = in + insize;
+	byte *op = out;
+	byte *oend = out + outsize;
+
+	for (;;)
+	{
+		if (ip >= iend) return false;
+
+		int token = *ip++;
+		int litlen = token >> 4;
+
+		if (litlen == 15 && !COM_ReadLZLength (&ip, iend, &litlen)) return false;
+		if (litlen > iend - ip || litlen > oend - op) return false;
+
+		memcpy (op, ip, litlen);
+		ip += litlen;
+		op += litlen;
+
+		// only the last sequence runs up to the end of the input
+		if (ip == iend) return (op == oend);
+		if (iend - ip < 2) return false;
+
+		int offset = ip[0] | (ip[1] << 8);
+		int matchlen = token & 15;
+
+		ip += 2;
+
+		if (!offset || offset > op - out) return false;
+		if (matchlen == 15 && !COM_ReadLZLength (&ip, iend, &matchlen)) return false;
+
+		matchlen += COM_LZ_MINMATCH;
+
+		if (matchlen > oend - op) return false;
+
+		// matches can overlap what they're writing so this needs to go a byte at a time
+		for (byte *mp = op - offset; matchlen; matchlen--) *op++ = *mp++;
+	}
+}
+
+
+// fnv-1a on the lowercased name for lookups that need to match _stricmp
+unsigned int COM_HashNameNoCase (const char *name)
+{
+	unsigned int hash = 2166136261;
+
+	for (; *name; name++)
+	{
+		hash ^= (byte) tolower ((byte) *name);
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+
+QNAMEHASH::QNAMEHASH (void)
+{
+	// globals are constructed before the zone exists so the table is allocated on first insert
+	this->Entries = NULL;
+	this->TableSize = 0;
+	this->NumEntries = 0;
+
+	this->NumLookups = 0;
+	this->NumCompares = 0;
+	this->NumLinear = 0;
+}
+
+
+unsigned int QNAMEHASH::HashName (const char *name)
+{
+	// fnv-1a
+	unsigned int hash = 2166136261;
+
+	for (; *name; name++)
+	{
+		hash ^= (byte) *name;
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+
+int QNAMEHASH::Find (const char *name)
+{
+	this->NumLookups++;
+
+	if (this->Entries)
+	{
+		unsigned int hash = HashName (name);
+
+		for (int i = hash & (this->TableSize - 1);; i = (i + 1) & (this->TableSize - 1))
+		{
+			nameentry_t *e = &this->Entries[i];
+
+			if (!e->name) break;
+			if (e->hash != hash) continue;
+
+			this->NumCompares++;
+
+			if (!strcmp (e->name, name))
+			{
+				this->NumLinear += e->index + 1;
+				return e->index;
+			}
+		}
+	}
+
+	// a miss would have scanned the whole array
+	this->NumLinear += this->NumEntries;
+	return -1;
+}
+
+
+void QNAMEHASH::Grow (void)
+{
+	nameentry_t *oldentries = this->Entries;
+	int oldsize = this->TableSize;
+
+	this->TableSize = oldsize ? oldsize * 2 : 256;
+	this->Entries = (nameentry_t *) MainZone->Alloc (this->TableSize * sizeof (nameentry_t));
+
+	// rehash everything into the new table
+	for (int i = 0; i < oldsize; i++)
+	{
+		if (!oldentries[i].name) continue;
+
+		for (int j = oldentries[i].hash & (this->TableSize - 1);; j = (j + 1) & (this->TableSize - 1))
+		{
+			if (this->Entries[j].name) continue;
+
+			this->Entries[j] = oldentries[i];
+			break;
+		}
+	}
+
+	if (oldentries) MainZone->Free (oldentries);
+}
+
+
+void QNAMEHASH::Insert (const char *name, int index)
+{
+	// keep the load factor under half so that probe chains stay short
+	if ((this->NumEntries + 1) * 2 > this->TableSize) this->Grow ();
+
+	unsigned int hash = HashName (name);
+
+	for (int i = hash & (this->TableSize - 1);; i = (i + 1) & (this->TableSize - 1))
+	{
+		nameentry_t *e = &this->Entries[i];
+
+		if (!e->name)
+		{
+			e->name = name;
+			e->hash = hash;
+			e->index = index;
+			this->NumEntries++;
+			return;
+		}
+
+		if (e->hash == hash && !strcmp (e->name, name))
+		{
+			// already registered; just repoint it
+			e->name = name;
+			e->index = index;
+			return;
+		}
+	}
+}
+
+
+void QNAMEHASH::Clear (void)
+{
+	// keep the allocation around for the next map
+	if (this->Entries) memset (this->Entries, 0, this->TableSize * sizeof (nameentry_t));
+	this->NumEntries = 0;
+}
+
+
+void QNAMEHASH::Report (const char *desc)
+{
+	if (this->NumLookups)
+	{
+		Con_DPrintf
+		(
+			"%s: %i lookups, %i string compares (%i saved)\n",
+			desc,
+			this->NumLookups,
+			this->NumCompares,
+			this->NumLinear - this->NumCompares
+		);
+	}
+
+	this->NumLookups = 0;
+	this->NumCompares = 0;
+	this->NumLinear = 0;
+}
+
+
 #define NUM_SAFE_ARGVS  7
 
 static char     *largv[MAX_NUM_ARGVS + NUM_SAFE_ARGVS + 1];
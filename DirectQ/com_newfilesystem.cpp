@@ -111,6 +111,7 @@ void CQuakeFile::ClearFile (void)
 	this->mmdata = NULL;
 
 	this->pakfile = false;
+	this->writetime = 0;
 }
 
 
@@ -150,6 +151,28 @@ DWORD CQuakeFile::SetPointer (LONG position, DWORD from)
 }
 
 
+int CQuakeFile::GetPointer (void)
+{
+	// SetPointer with FILE_CURRENT doesn't give the position for mapped files so this is the reliable way to get it
+	return this->filepointer;
+}
+
+
+void *CQuakeFile::GetData (int length)
+{
+	// zero-copy read; returns a pointer to the next length bytes and advances over them, or NULL if the file isn't mapped
+	if (!this->filedata) return NULL;
+	if (length < 0 || this->filepointer + length > this->filelength) return NULL;
+
+	void *data = this->filedata;
+
+	this->filedata = ((byte *) this->filedata) + length;
+	this->filepointer += length;
+
+	return data;
+}
+
+
 int CQuakeFile::Read (void *destbuf, int length)
 {
 	// read and advance the pointer
@@ -232,6 +255,32 @@ void CQuakeFile::SetInfo (pack_t *pak, packfile_t *packfile)
 }
 
 
+void CQuakeFile::MapFile (void)
+{
+	// PAK entries are always mapped; an empty file can't be
+	if (this->filedata || !this->filelength) return;
+
+	if ((this->mmhandle = CreateFileMapping (this->fhandle, NULL, PAGE_READONLY, 0, 0, NULL)) == NULL)
+	{
+		this->mmhandle = INVALID_HANDLE_VALUE;
+		return;
+	}
+
+	if ((this->mmdata = MapViewOfFile (this->mmhandle, FILE_MAP_READ, 0, 0, 0)) == NULL)
+	{
+		// just keep reading through the handle
+		CloseHandle (this->mmhandle);
+		this->mmhandle = INVALID_HANDLE_VALUE;
+		return;
+	}
+
+	// the mapping is the whole file; reads carry on from wherever the file pointer is
+	this->mapoffset = 0;
+	this->maplength = this->filelength;
+	this->filedata = ((byte *) this->mmdata) + this->filepointer;
+}
+
+
 bool CQuakeFile::LoadFromPK3 (pk3_t *pk3, char *filename)
 {
 	// yech, this is nasty shit...
@@ -277,6 +326,9 @@ bool CQuakeFile::LoadFromPK3 (pk3_t *pk3, char *filename)
 	unzCloseCurrentFile (uf);
 	unzClose (uf);
 
+	// the temp file is always new so take the time from the zip entry instead
+	this->writetime = file_info.dosDate;
+
 	// fixme - get rid of this
 	return true;
 
@@ -348,6 +400,9 @@ bool CQuakeFile::Open (char *filename, int flags)
 				// need to reset the file pointer as it will be at eof owing to the file just having been created
 				SetFilePointer (this->fhandle, 0, NULL, FILE_BEGIN);
 				this->SetInfo ();
+
+				if (flags & QFILE_MAP) this->MapFile ();
+
 				return true;
 			}
 		}
@@ -359,6 +414,9 @@ bool CQuakeFile::Open (char *filename, int flags)
 			if ((this->fhandle = COM_CreateFile (netpath)) != INVALID_HANDLE_VALUE)
 			{
 				this->SetInfo ();
+
+				if (flags & QFILE_MAP) this->MapFile ();
+
 				return true;
 			}
 		}
@@ -491,6 +549,24 @@ void CQuakeFile::GetFileTime (char *time)
 }
 
 
+unsigned __int64 CQuakeFile::GetWriteTime (void)
+{
+	if (!this->writetime)
+	{
+		// for PAK files this is the time of the PAK itself
+		BY_HANDLE_FILE_INFORMATION FileInfo;
+
+		if (GetFileInformationByHandle (this->fhandle, &FileInfo))
+		{
+			this->writetime = ((unsigned __int64) FileInfo.ftLastWriteTime.dwHighDateTime << 32) |
+				FileInfo.ftLastWriteTime.dwLowDateTime;
+		}
+	}
+
+	return this->writetime;
+}
+
+
 void *CQuakeFile::LoadFile (char *path, class CQuakeAllocator *spacebuf)
 {
 	CQuakeFile f;
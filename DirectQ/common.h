@@ -134,10 +134,50 @@ void COM_ExecQuakeRC (void);
 extern bool		standard_quake, rogue, hipnotic, quoth, nehahra;
 
 void COM_HashData (byte *hash, const void *data, int size);
+unsigned __int64 COM_FastHash (const void *data, int size);
+unsigned int COM_HashNameNoCase (const char *name);
+
+// simple lz77 packer for bulk data written to disk; out must be at least COM_CompressBound (insize)
+#define COM_CompressBound(insize) ((insize) + (insize) / 255 + 16)
+int COM_CompressLZ (const byte *in, int insize, byte *out);
+bool COM_DecompressLZ (const byte *in, int insize, byte *out, int outsize);
 #define COM_CheckHash(h1, h2) !(memcmp ((h1), (h2), 16))
 
 void COM_SortStringList (char **stringlist, bool ascending);
 
+// open-addressed name -> index lookup for the sound and model registries.  names are not copied so
+// they must stay valid (and unchanged) until the next Clear; the table grows itself from the zone.
+class QNAMEHASH
+{
+public:
+	QNAMEHASH (void);
+	int Find (const char *name);
+	void Insert (const char *name, int index);
+	void Clear (void);
+	void Report (const char *desc);
+	int Count (void) {return this->NumEntries;}
+
+private:
+	struct nameentry_t
+	{
+		const char *name;
+		unsigned int hash;
+		int index;
+	};
+
+	static unsigned int HashName (const char *name);
+	void Grow (void);
+
+	nameentry_t *Entries;
+	int TableSize;
+	int NumEntries;
+
+	// lookup counters; linear is what the old strcmp scan over the same array would have cost
+	int NumLookups;
+	int NumCompares;
+	int NumLinear;
+};
+
 #define COM_MAXGAMES 256
 
 extern int com_numgames;
@@ -179,6 +219,10 @@ struct pk3_t
 };
 
 
+// CQuakeFile::Open flags
+#define QFILE_MAP	1	// map files from disk and pk3s as well as pak entries so that GetData can be used
+
+
 // new memory-mapped filesystem
 class CQuakeFile
 {
@@ -192,11 +236,14 @@ public:
 	int ReadChar (void);
 	int GetLength (void);
 	DWORD SetPointer (LONG position, DWORD from);
+	int GetPointer (void);
+	void *GetData (int length);
 
 	bool CreateTempFile (char *filename);
 	bool CreateNewFile (char *filename);
 	bool Write (void *data, int length);
 	void GetFileTime (char *time);
+	unsigned __int64 GetWriteTime (void);
 
 	static void *LoadFile (char *path, class CQuakeAllocator *spacebuf = NULL);
 	void *CopyAlloc (class CQuakeAllocator *spacebuf = NULL);
@@ -205,6 +252,7 @@ public:
 
 private:
 	void SetInfo (pack_t *pak = NULL, packfile_t *packfile = NULL);
+	void MapFile (void);
 	void ClearFile (void);
 	bool LoadFromPK3 (pk3_t *pk3, char *filename);
 	packfile_t *FindInPAK (packfile_t *files, int numfiles, char *filename);
@@ -235,6 +283,9 @@ private:
 
 	// actual file data pointer
 	void *filedata;
+
+	// last write time of the file or the PAK/PK3 containing it; 0 until it's first asked for
+	unsigned __int64 writetime;
 };
 
 
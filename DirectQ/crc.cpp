@@ -77,4 +77,33 @@ void CRC_ProcessByte (unsigned short *crcvalue, byte data)
 unsigned short CRC_Value (unsigned short crcvalue)
 {
 	return crcvalue ^ CRC_XOR_VALUE;
-}
\ No newline at end of file
+}
+
+// 32 bit reflected CRC (the zip/png one) for checksumming whole files; the table is built on first use
+static unsigned int crc32table[256];
+static bool crc32init = false;
+
+unsigned int CRC_Block32 (byte *data, int len, unsigned int crc)
+{
+	if (!crc32init)
+	{
+		for (unsigned int i = 0; i < 256; i++)
+		{
+			unsigned int c = i;
+
+			for (int j = 0; j < 8; j++)
+				c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+
+			crc32table[i] = c;
+		}
+
+		crc32init = true;
+	}
+
+	crc = ~crc;
+
+	for (int i = 0; i < len; i++)
+		crc = crc32table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
+}
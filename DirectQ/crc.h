@@ -22,3 +22,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 void CRC_Init (unsigned short *crcvalue);
 void CRC_ProcessByte (unsigned short *crcvalue, byte data);
 unsigned short CRC_Value (unsigned short crcvalue);
+
+// pass the previous result as crc to continue a checksum over multiple blocks
+unsigned int CRC_Block32 (byte *data, int len, unsigned int crc = 0);
@@ -23,9 +23,14 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 cvar_t	*cvar_vars = NULL;
 cvar_alias_t *cvar_alias_vars = NULL;
 
-char *cvar_null_string = "";
+// cvars register from global constructors before any of the memory pools are up so these are fixed-size
+// static tables, chained through hashnext; the buckets are case-insensitive to match _stricmp
+#define CVAR_HASH_SIZE	512
+
+static cvar_t *cvar_hash[CVAR_HASH_SIZE];
+static cvar_alias_t *cvar_alias_hash[CVAR_HASH_SIZE];
 
-cvar_t *Cmd_FindCvar (char *name);
+char *cvar_null_string = "";
 
 bool cvar_t::initialized = false;
 
@@ -65,14 +70,14 @@ cvar_t *cvar_t::GetNextServerRuleVar (char *prevCvarName)
 /*
 ============
 cvar_t::FindVar
-
-used only for cases where the full completion list can't be relied on to be up yet; use Cmd_FindCvar otherwise
 ============
 */
 cvar_t *cvar_t::FindVar (char *var_name)
 {
+	int bucket = COM_HashNameNoCase (var_name) & (CVAR_HASH_SIZE - 1);
+
 	// regular cvars
-	for (cvar_t *var = cvar_vars; var; var = var->next)
+	for (cvar_t *var = cvar_hash[bucket]; var; var = var->hashnext)
 	{
 		// skip nehahra cvars
 		if (!nehahra && (var->usage & CVAR_NEHAHRA)) continue;
@@ -84,7 +89,7 @@ cvar_t *cvar_t::FindVar (char *var_name)
 	}
 
 	// alias cvars
-	for (cvar_alias_t *var = cvar_alias_vars; var; var = var->next)
+	for (cvar_alias_t *var = cvar_alias_hash[bucket]; var; var = var->hashnext)
 	{
 		// skip nehahra cvars
 		if (!nehahra && (var->var->usage & CVAR_NEHAHRA)) continue;
@@ -323,6 +328,11 @@ void cvar_t::Register (void)
 	// link the variable in
 	this->next = cvar_vars;
 	cvar_vars = this;
+
+	int bucket = COM_HashNameNoCase (this->name) & (CVAR_HASH_SIZE - 1);
+
+	this->hashnext = cvar_hash[bucket];
+	cvar_hash[bucket] = this;
 }
 
 
@@ -365,6 +375,8 @@ cvar_t::cvar_t (char *cvarname, char *initialval, int useflags, cvarcallback_t c
 	this->usage = useflags;
 	this->defaultvalue = NULL;
 	this->callback = cb;
+	this->hashnext = NULL;
+	this->handle = 0;
 
 	// self-register the cvar at construction time
 	this->Register ();
@@ -389,6 +401,8 @@ cvar_t::cvar_t (char *cvarname, float initialval, int useflags, cvarcallback_t c
 	this->usage = useflags;
 	this->defaultvalue = NULL;
 	this->callback = cb;
+	this->hashnext = NULL;
+	this->handle = 0;
 
 	// self-register the cvar at construction time
 	this->Register ();
@@ -408,6 +422,8 @@ cvar_t::cvar_t (void)
 	this->usage = CVAR_DUMMY;
 	this->integer = 0;
 	this->next = NULL;
+	this->hashnext = NULL;
+	this->handle = 0;
 	this->callback = NULL;
 }
 
@@ -451,6 +467,11 @@ cvar_alias_t::cvar_alias_t (char *cvarname, cvar_t *cvarvar)
 
 	this->next = cvar_alias_vars;
 	cvar_alias_vars = this;
+
+	int bucket = COM_HashNameNoCase (this->name) & (CVAR_HASH_SIZE - 1);
+
+	this->hashnext = cvar_alias_hash[bucket];
+	cvar_alias_hash[bucket] = this;
 }
 
 
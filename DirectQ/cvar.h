@@ -108,6 +108,12 @@ public:
 	// next in the chain
 	cvar_t *next;
 
+	// next in the same name hash bucket
+	cvar_t *hashnext;
+
+	// handle given out to QC by cvar_handle; 0 if it hasn't been asked for one yet
+	int handle;
+
 	// if this is true startup and restart cvars get restrictions
 	static bool initialized;
 
@@ -128,6 +134,7 @@ public:
 	cvar_t *var;
 
 	cvar_alias_t *next;
+	cvar_alias_t *hashnext;
 };
 
 
@@ -42,6 +42,7 @@ void D3DMain_ComputeEntityTransform (entity_t *ent);
 
 extern cvar_t r_lightscale;
 extern cvar_t r_additivefullbrights;
+extern cvar_t r_simdcull;
 
 
 cvar_t r_aliasdelerpdelta ("r_aliasdelerpdelta", 10.0f, CVAR_ARCHIVE | CVAR_MAP);
@@ -148,6 +149,25 @@ struct aliasinstance_t
 QTEXTURE d3d_PaletteRowTextures[16];
 
 
+// each alias entity keeps the same instance slot from frame to frame so that its instance data only needs to be
+// re-uploaded when it actually changes; the first half of the buffer holds standard instances and the second half
+// holds shadows.  the instance cache mirrors the contents of the buffer.
+#define MAX_INSTANCE_SLOTS	4096
+
+struct instanceslot_t
+{
+	entity_t *Owner;
+	int LastFrame;
+};
+
+instanceslot_t d3d_InstanceSlots[MAX_INSTANCE_SLOTS];
+aliasinstance_t d3d_InstanceCache[MAX_INSTANCE_SLOTS * 2];
+int d3d_NextInstanceSlot = 0;
+
+ID3D11Buffer *d3d_InstanceData = NULL;
+ID3D11ShaderResourceView *d3d_InstanceSRV = NULL;
+
+
 void D3DAlias_FreeBufferSet (aliasbuffer_t *buf)
 {
 	// release the buffer set
@@ -189,6 +209,8 @@ void D3DAlias_Shutdown (void)
 	aliasbuffer_t::NumBuffers = 0;
 
 	SAFE_RELEASE (d3d_MeshConstants);
+	SAFE_RELEASE (d3d_InstanceSRV);
+	SAFE_RELEASE (d3d_InstanceData);
 }
 
 
@@ -239,13 +261,7 @@ void D3DAlias_InitGlobal (void)
 	D3D11_INPUT_ELEMENT_DESC instlo[] =
 	{
 		D3D_MESH_LAYOUT_COMMON,
-		MAKELAYOUTELEMENT ("TRANSFORM",   0, DXGI_FORMAT_R32G32B32A32_FLOAT, 3, 1),
-		MAKELAYOUTELEMENT ("TRANSFORM",   1, DXGI_FORMAT_R32G32B32A32_FLOAT, 3, 1),
-		MAKELAYOUTELEMENT ("TRANSFORM",   2, DXGI_FORMAT_R32G32B32A32_FLOAT, 3, 1),
-		MAKELAYOUTELEMENT ("TRANSFORM",   3, DXGI_FORMAT_R32G32B32A32_FLOAT, 3, 1),
-		MAKELAYOUTELEMENT ("SHADELIGHT",  0, DXGI_FORMAT_R32G32B32A32_FLOAT, 3, 1),
-		MAKELAYOUTELEMENT ("SHADEVECTOR", 0, DXGI_FORMAT_R32G32B32_FLOAT,    3, 1),
-		MAKELAYOUTELEMENT ("BLEND",       0, DXGI_FORMAT_R32_FLOAT,          3, 1)
+		MAKELAYOUTELEMENT ("INSTANCESLOT", 0, DXGI_FORMAT_R32_UINT, 3, 1)
 	};
 
 	QSHADERFACTORY ShaderFactory (IDR_ALIASFX);
@@ -276,6 +292,36 @@ void D3DAlias_InitGlobal (void)
 	ShaderFactory.CreatePixelShader (&d3d_ShadowPixelShaders[1], "MeshPS", Defines);
 
 	BufferFactory.CreateConstantBuffer (sizeof (aliasinstance_t), &d3d_MeshConstants, "d3d_MeshConstants");
+
+	// a fresh buffer starts out zeroed along with its cache and nobody owns any slots
+	memset (d3d_InstanceCache, 0, sizeof (d3d_InstanceCache));
+
+	for (int i = 0; i < MAX_INSTANCE_SLOTS; i++)
+	{
+		d3d_InstanceSlots[i].Owner = NULL;
+		d3d_InstanceSlots[i].LastFrame = 0;
+	}
+
+	d3d_NextInstanceSlot = 0;
+
+	BufferFactory.CreateGenericBuffer (
+		D3D11_USAGE_DEFAULT,
+		D3D11_BIND_SHADER_RESOURCE,
+		0,
+		sizeof (d3d_InstanceCache),
+		d3d_InstanceCache,
+		&d3d_InstanceData,
+		"d3d_InstanceData");
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+
+	srvDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = sizeof (d3d_InstanceCache) / (sizeof (float) * 4);
+
+	if (FAILED (d3d11_Device->CreateShaderResourceView (d3d_InstanceData, &srvDesc, &d3d_InstanceSRV)))
+		Sys_Error ("D3DAlias_InitGlobal : CreateShaderResourceView failed");
 }
 
 
@@ -316,7 +362,7 @@ aliasbuffer_t *D3DAlias_GetMeshBuffer (aliashdr_t *hdr)
 }
 
 
-void D3DAlias_MakeMeshBuffers (aliashdr_t *hdr, aliasload_t *load, aliasbuffer_t *buf)
+void D3DAlias_CreateMeshBuffers (aliashdr_t *hdr, aliasbuffer_t *buf, void *positions, void *texcoords, void *blends, unsigned short *indexes)
 {
 	// release any buffers previously used by this buffer set
 	SAFE_RELEASE (buf->Positions);
@@ -327,6 +373,16 @@ void D3DAlias_MakeMeshBuffers (aliashdr_t *hdr, aliasload_t *load, aliasbuffer_t
 	// this buffer is live now
 	buf->RegistrationSequence = d3d_RenderDef.RegistrationSequence;
 
+	// create buffers
+	BufferFactory.CreateVertexBuffer (sizeof (aliasposition_t), hdr->nummesh * hdr->nummeshframes, &buf->Positions, "d3d_MeshPositions", positions);
+	BufferFactory.CreateVertexBuffer (sizeof (aliastexcoord_t), hdr->nummesh, &buf->Texcoords, "d3d_MeshTexCoords", texcoords);
+	BufferFactory.CreateVertexBuffer (sizeof (aliasblend_t), hdr->nummesh, &buf->Blends, "d3d_MeshBlends", blends);
+	BufferFactory.CreateIndexBuffer (sizeof (unsigned short), hdr->numindexes, &buf->Indexes, "d3d_MeshIndexes", indexes);
+}
+
+
+void D3DAlias_MakeMeshBuffers (aliashdr_t *hdr, aliasload_t *load, aliasbuffer_t *buf, QMODELCACHE *cache)
+{
 	aliasposition_t *positions = (aliasposition_t *) TempHunk->FastAlloc (hdr->nummesh * hdr->nummeshframes * sizeof (aliasposition_t));
 	aliastexcoord_t *texcoords = (aliastexcoord_t *) TempHunk->FastAlloc (hdr->nummesh * sizeof (aliastexcoord_t));
 	aliasblend_t *blends = (aliasblend_t *) TempHunk->FastAlloc (hdr->nummesh * sizeof (aliasblend_t));
@@ -364,22 +420,54 @@ void D3DAlias_MakeMeshBuffers (aliashdr_t *hdr, aliasload_t *load, aliasbuffer_t
 		else blends[m].blendindex = 1;
 	}
 
-	// create buffers
-	BufferFactory.CreateVertexBuffer (sizeof (aliasposition_t), hdr->nummesh * hdr->nummeshframes, &buf->Positions, "d3d_MeshPositions", positions);
-	BufferFactory.CreateVertexBuffer (sizeof (aliastexcoord_t), hdr->nummesh, &buf->Texcoords, "d3d_MeshTexCoords", texcoords);
-	BufferFactory.CreateVertexBuffer (sizeof (aliasblend_t), hdr->nummesh, &buf->Blends, "d3d_MeshBlends", blends);
-	BufferFactory.CreateIndexBuffer (sizeof (unsigned short), hdr->numindexes, &buf->Indexes, "d3d_MeshIndexes", load->indexes);
+	D3DAlias_CreateMeshBuffers (hdr, buf, positions, texcoords, blends, load->indexes);
+
+	// store everything that was derived from the frame vertexes so that the next load can skip it
+	aliascacheinfo_t info = {hdr->nummeshframes, hdr->nummesh, hdr->numindexes, {hdr->midpoint[0], hdr->midpoint[1], hdr->midpoint[2]}};
+
+	cache->Create ();
+	cache->Write (&info, sizeof (aliascacheinfo_t));
+	cache->Write (hdr->bboxes, hdr->nummeshframes * sizeof (aliasbbox_t));
+	cache->Write (positions, hdr->nummesh * hdr->nummeshframes * sizeof (aliasposition_t));
+	cache->Write (texcoords, hdr->nummesh * sizeof (aliastexcoord_t));
+	cache->Write (blends, hdr->nummesh * sizeof (aliasblend_t));
+	cache->Write (load->indexes, hdr->numindexes * sizeof (unsigned short));
+	cache->Close ();
+}
+
+
+bool D3DAlias_ReadMeshCache (QMODELCACHE *cache, aliascache_t *ac)
+{
+	// everything is read up-front so that a damaged entry is caught before the frame vertexes are skipped
+	if (!(ac->info = (aliascacheinfo_t *) cache->Read (sizeof (aliascacheinfo_t)))) return false;
+
+	if (ac->info->nummeshframes < 1) return false;
+	if (ac->info->nummesh < 1 || ac->info->nummesh > 65536) return false;
+	if (ac->info->numindexes < 3) return false;
+
+	if (!(ac->bboxes = (aliasbbox_t *) cache->Read (ac->info->nummeshframes * sizeof (aliasbbox_t)))) return false;
+	if (!(ac->positions = cache->Read (ac->info->nummesh * ac->info->nummeshframes * sizeof (aliasposition_t)))) return false;
+	if (!(ac->texcoords = cache->Read (ac->info->nummesh * sizeof (aliastexcoord_t)))) return false;
+	if (!(ac->blends = cache->Read (ac->info->nummesh * sizeof (aliasblend_t)))) return false;
+	if (!(ac->indexes = (unsigned short *) cache->Read (ac->info->numindexes * sizeof (unsigned short)))) return false;
+
+	return true;
 }
 
 
 void D3DAlias_CompressMesh (aliashdr_t *hdr, aliasload_t *load)
 {
-	// vertex cache optimization
 	// set up the initial params
 	hdr->nummesh = 0;
 	hdr->numindexes = 0;
 
-	for (int i = 0, v = 0; i < hdr->numtris; i++)
+	// mesh vert for each (vertindex, facesfront) pair so that lookups are direct instead of searching the mesh
+	int *meshverts = (int *) TempHunk->FastAlloc (hdr->vertsperframe * 2 * sizeof (int));
+
+	for (int i = 0; i < hdr->vertsperframe * 2; i++)
+		meshverts[i] = -1;
+
+	for (int i = 0; i < hdr->numtris; i++)
 	{
 		for (int j = 0; j < 3; j++)
 		{
@@ -387,77 +475,281 @@ void D3DAlias_CompressMesh (aliashdr_t *hdr, aliasload_t *load)
 			int vertindex = load->triangles[i].vertindex[j];
 			bool facesfront = load->triangles[i].facesfront || !load->stverts[vertindex].onseam;
 
-			// see does this vert already exist
-			for (v = 0; v < hdr->nummesh; v++)
-			{
-				// it could use the same xyz but have different s and t
-				// MDL only allows this if the front-facing is different so that's what we check
-				if (load->mesh[v].vertindex == vertindex && load->mesh[v].facesfront == facesfront)
-				{
-					// exists; emit an index for it
-					load->indexes[hdr->numindexes] = v;
-					break;
-				}
-			}
+			// it could use the same xyz but have different s and t
+			// MDL only allows this if the front-facing is different so that's what we key on
+			int *v = &meshverts[vertindex * 2 + (facesfront ? 1 : 0)];
 
-			if (v == hdr->nummesh)
+			if (v[0] < 0)
 			{
-				// doesn't exist; emit a new vert and index
-				load->indexes[hdr->numindexes] = hdr->nummesh;
-
+				// doesn't exist; emit a new vert
 				load->mesh[hdr->nummesh].vertindex = vertindex;
 				load->mesh[hdr->nummesh].st[0] = load->stverts[vertindex].s + (facesfront ? 0 : (hdr->skinwidth / 2));
 				load->mesh[hdr->nummesh].st[1] = load->stverts[vertindex].t;
 				load->mesh[hdr->nummesh].facesfront = facesfront;
 
-				hdr->nummesh++;
+				v[0] = hdr->nummesh++;
 			}
 
-			hdr->numindexes++;
+			// emit an index for it
+			load->indexes[hdr->numindexes++] = v[0];
 		}
 	}
 }
 
 
-void D3DAlias_OptimizeMesh (aliashdr_t *hdr, aliasload_t *load)
+/*
+==============================================================================
+
+VERTEX CACHE OPTIMIZATION
+
+Tom Forsyth's "Linear-Speed Vertex Cache Optimisation".  Triangles are emitted greedily by score, where a vert scores higher the more recently it was used and the fewer
+triangles it has left to go.  This replaces D3DXOptimizeFaces/D3DXOptimizeVertices and doesn't need D3DX.
+
+==============================================================================
+*/
+
+#define VCACHE_SIZE			32
+#define VCACHE_MAXVALENCE	64
+
+float d3d_VCacheScore[VCACHE_SIZE];
+float d3d_VCacheValenceScore[VCACHE_MAXVALENCE];
+
+
+float D3DAlias_VertexScore (int cachepos, int numactive)
 {
-	// and now optimize it
-	DWORD *remaptable = (DWORD *) TempHunk->FastAlloc (hdr->nummesh * sizeof (DWORD));
-	DWORD *optresult = (DWORD *) TempHunk->FastAlloc ((hdr->nummesh > hdr->numtris ? hdr->nummesh : hdr->numtris) * sizeof (DWORD));
+	// no triangles left to go so it's irrelevant
+	if (!numactive) return -1.0f;
 
-	aliasmesh_t *newmesh = (aliasmesh_t *) TempHunk->FastAlloc (hdr->nummesh * sizeof (aliasmesh_t));
-	unsigned short *newindexes = (unsigned short *) TempHunk->FastAlloc (hdr->numindexes * sizeof (unsigned short));
+	float score = (cachepos < 0) ? 0.0f : d3d_VCacheScore[cachepos];
 
-	D3DXOptimizeFaces (load->indexes, hdr->numtris, hdr->nummesh, FALSE, optresult);
+	// boost verts with few triangles left so that we don't leave lonely triangles behind
+	if (numactive < VCACHE_MAXVALENCE)
+		return score + d3d_VCacheValenceScore[numactive];
+	else return score + 2.0f * powf ((float) numactive, -0.5f);
+}
 
-	for (int i = 0; i < hdr->numtris; i++)
+
+void D3DAlias_OptimizeFaces (unsigned short *indexes, int numtris, int numverts, int *triorder)
+{
+	if (!d3d_VCacheValenceScore[1])
 	{
-		int src = optresult[i] * 3;
-		int dst = i * 3;
+		// the last 3 verts used were from the last triangle so they get a fixed score
+		for (int i = 0; i < VCACHE_SIZE; i++)
+		{
+			if (i < 3)
+				d3d_VCacheScore[i] = 0.75f;
+			else d3d_VCacheScore[i] = powf (1.0f - (float) (i - 3) / (float) (VCACHE_SIZE - 3), 1.5f);
+		}
+
+		for (int i = 1; i < VCACHE_MAXVALENCE; i++)
+			d3d_VCacheValenceScore[i] = 2.0f * powf ((float) i, -0.5f);
+	}
+
+	int hunkmark = TempHunk->GetLowMark ();
+
+	// per-vertex data
+	int *numactive = (int *) TempHunk->Alloc (numverts * sizeof (int));
+	int *firsttri = (int *) TempHunk->FastAlloc ((numverts + 1) * sizeof (int));
+	int *cachepos = (int *) TempHunk->FastAlloc (numverts * sizeof (int));
+	float *vertscore = (float *) TempHunk->FastAlloc (numverts * sizeof (float));
+
+	// per-triangle data
+	int *vertstris = (int *) TempHunk->FastAlloc (numtris * 3 * sizeof (int));
+	float *triscore = (float *) TempHunk->FastAlloc (numtris * sizeof (float));
+	bool *added = (bool *) TempHunk->Alloc (numtris * sizeof (bool));
 
-		newindexes[dst + 0] = load->indexes[src + 0];
-		newindexes[dst + 1] = load->indexes[src + 1];
-		newindexes[dst + 2] = load->indexes[src + 2];
+	// the cache holds an extra 3 while a triangle is being added
+	int cache[VCACHE_SIZE + 3];
+	int newcache[VCACHE_SIZE + 3];
+	int cachesize = 0;
+
+	// build the list of triangles that use each vert
+	for (int i = 0; i < numtris * 3; i++)
+		numactive[indexes[i]]++;
+
+	firsttri[0] = 0;
+
+	for (int i = 0; i < numverts; i++)
+	{
+		firsttri[i + 1] = firsttri[i] + numactive[i];
+		cachepos[i] = firsttri[i];
 	}
 
-	D3DXOptimizeVertices (newindexes, hdr->numtris, hdr->nummesh, FALSE, optresult);
+	// (cachepos is used as the fill position here then reset)
+	for (int i = 0; i < numtris * 3; i++)
+		vertstris[cachepos[indexes[i]]++] = i / 3;
+
+	for (int i = 0; i < numverts; i++)
+	{
+		cachepos[i] = -1;
+		vertscore[i] = D3DAlias_VertexScore (-1, numactive[i]);
+	}
+
+	int besttri = -1;
+	float bestscore = -1.0f;
+
+	for (int i = 0; i < numtris; i++)
+	{
+		triscore[i] = vertscore[indexes[i * 3 + 0]] + vertscore[indexes[i * 3 + 1]] + vertscore[indexes[i * 3 + 2]];
+
+		if (triscore[i] > bestscore)
+		{
+			besttri = i;
+			bestscore = triscore[i];
+		}
+	}
+
+	for (int i = 0, nexttri = 0; i < numtris; i++)
+	{
+		if (besttri < 0)
+		{
+			// nothing in the cache has triangles left so just take the next one that hasn't been added
+			while (added[nexttri]) nexttri++;
+			besttri = nexttri;
+		}
+
+		unsigned short *tri = &indexes[besttri * 3];
+		int newcachesize = 0;
+
+		triorder[i] = besttri;
+		added[besttri] = true;
+
+		for (int j = 0; j < 3; j++)
+		{
+			int v = tri[j];
+			int *vt = &vertstris[firsttri[v]];
+
+			// remove the triangle from the vert's active list
+			for (int k = 0; k < numactive[v]; k++)
+			{
+				if (vt[k] == besttri)
+				{
+					vt[k] = vt[numactive[v] - 1];
+					break;
+				}
+			}
+
+			numactive[v]--;
+
+			// and put the vert at the front of the cache (a degenerate triangle may use it twice)
+			if (!newcachesize || (newcache[0] != v && newcache[newcachesize - 1] != v))
+				newcache[newcachesize++] = v;
+		}
+
+		// the rest of the old cache goes behind it
+		for (int j = 0; j < cachesize; j++)
+		{
+			int v = cache[j];
+
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newcache[newcachesize++] = v;
+		}
+
+		// update the scores of everything that was touched, including verts that just fell out of the cache
+		for (int j = 0; j < newcachesize; j++)
+		{
+			int v = newcache[j];
+			float oldscore = vertscore[v];
+
+			cachepos[v] = (j < VCACHE_SIZE) ? j : -1;
+			vertscore[v] = D3DAlias_VertexScore (cachepos[v], numactive[v]);
+
+			for (int k = 0; k < numactive[v]; k++)
+				triscore[vertstris[firsttri[v] + k]] += vertscore[v] - oldscore;
+		}
+
+		// the next triangle is the best one using a vert in the cache
+		besttri = -1;
+		bestscore = -1.0f;
+
+		for (int j = 0; j < newcachesize && j < VCACHE_SIZE; j++)
+		{
+			int v = newcache[j];
+
+			for (int k = 0; k < numactive[v]; k++)
+			{
+				int t = vertstris[firsttri[v] + k];
+
+				if (triscore[t] > bestscore)
+				{
+					besttri = t;
+					bestscore = triscore[t];
+				}
+			}
+		}
+
+		if ((cachesize = newcachesize) > VCACHE_SIZE) cachesize = VCACHE_SIZE;
+		Q_MemCpy (cache, newcache, cachesize * sizeof (int));
+	}
+
+	TempHunk->FreeToLowMark (hunkmark);
+}
+
+
+float D3DAlias_MeshACMR (unsigned short *indexes, int numtris, int numverts)
+{
+	// average cache miss ratio for a fifo cache of VCACHE_SIZE; verts transformed per triangle, so 0.5 is ideal and 3 is worst
+	int hunkmark = TempHunk->GetLowMark ();
+	int *fifostamp = (int *) TempHunk->FastAlloc (numverts * sizeof (int));
+	int nummisses = 0;
+
+	for (int i = 0; i < numverts; i++)
+		fifostamp[i] = -VCACHE_SIZE;
+
+	// a vert is in the cache if fewer than VCACHE_SIZE misses have happened since it went in
+	for (int i = 0; i < numtris * 3; i++)
+		if (nummisses - fifostamp[indexes[i]] >= VCACHE_SIZE)
+			fifostamp[indexes[i]] = nummisses++;
+
+	TempHunk->FreeToLowMark (hunkmark);
+
+	return numtris ? (float) nummisses / (float) numtris : 0.0f;
+}
+
+
+void D3DAlias_OptimizeMesh (aliashdr_t *hdr, aliasload_t *load)
+{
+	int *triorder = (int *) TempHunk->FastAlloc (hdr->numtris * sizeof (int));
+	int *remaptable = (int *) TempHunk->FastAlloc (hdr->nummesh * sizeof (int));
+
+	aliasmesh_t *newmesh = (aliasmesh_t *) TempHunk->FastAlloc (hdr->nummesh * sizeof (aliasmesh_t));
+	unsigned short *newindexes = (unsigned short *) TempHunk->FastAlloc (hdr->numindexes * sizeof (unsigned short));
+	int numremapped = 0;
+
+	D3DAlias_OptimizeFaces (load->indexes, hdr->numtris, hdr->nummesh, triorder);
 
 	for (int i = 0; i < hdr->nummesh; i++)
+		remaptable[i] = -1;
+
+	// reorder the triangles and number the verts in the order they're first used so that fetches are sequential
+	for (int i = 0; i < hdr->numtris; i++)
 	{
-		Q_MemCpy (&newmesh[i], &load->mesh[optresult[i]], sizeof (aliasmesh_t));
-		remaptable[optresult[i]] = i;
+		for (int j = 0; j < 3; j++)
+		{
+			int v = load->indexes[triorder[i] * 3 + j];
+
+			if (remaptable[v] < 0)
+			{
+				Q_MemCpy (&newmesh[numremapped], &load->mesh[v], sizeof (aliasmesh_t));
+				remaptable[v] = numremapped++;
+			}
+
+			newindexes[i * 3 + j] = remaptable[v];
+		}
 	}
 
-	// do the index remap
-	for (int i = 0; i < hdr->numindexes; i++)
-		load->indexes[i] = remaptable[newindexes[i]];
+	// compression only emits verts that are used so this is just a failsafe
+	for (int i = 0; i < hdr->nummesh; i++)
+		if (remaptable[i] < 0)
+			Q_MemCpy (&newmesh[numremapped++], &load->mesh[i], sizeof (aliasmesh_t));
 
 	// point the original mesh to the optimized version
+	Q_MemCpy (load->indexes, newindexes, hdr->numindexes * sizeof (unsigned short));
 	load->mesh = newmesh;
 }
 
 
-void D3DAlias_MakeAliasMesh (char *name, aliashdr_t *hdr, aliasload_t *load)
+void D3DAlias_MakeAliasMesh (char *name, aliashdr_t *hdr, aliasload_t *load, QMODELCACHE *cache)
 {
 	// see is it currently in use
 	for (int i = 0; i < aliasbuffer_t::NumBuffers; i++)
@@ -484,6 +776,27 @@ void D3DAlias_MakeAliasMesh (char *name, aliashdr_t *hdr, aliasload_t *load)
 		}
 	}
 
+	if (load->cached)
+	{
+		// the mesh was already compressed, optimized and delerped when the cache entry was written
+		hdr->nummesh = load->cached->info->nummesh;
+		hdr->numindexes = load->cached->info->numindexes;
+
+		D3DAlias_CreateMeshBuffers (
+			hdr,
+			D3DAlias_GetMeshBuffer (hdr),
+			load->cached->positions,
+			load->cached->texcoords,
+			load->cached->blends,
+			load->cached->indexes
+		);
+
+		strcpy (d3d_AliasBuffers[hdr->buffer].Name, name);
+		d3d_AliasBuffers[hdr->buffer].NumMesh = hdr->nummesh;
+		d3d_AliasBuffers[hdr->buffer].NumIndexes = hdr->numindexes;
+		return;
+	}
+
 	// all memory in here is going on the temp hunk
 	int hunkmark = TempHunk->GetLowMark ();
 
@@ -498,7 +811,7 @@ void D3DAlias_MakeAliasMesh (char *name, aliashdr_t *hdr, aliasload_t *load)
 	DelerpMuzzleFlashes (hdr, load);
 
 	// create the buffer set from the generated mesh data
-	D3DAlias_MakeMeshBuffers (hdr, load, D3DAlias_GetMeshBuffer (hdr));
+	D3DAlias_MakeMeshBuffers (hdr, load, D3DAlias_GetMeshBuffer (hdr), cache);
 
 	// store out the info needed for drawing so that cache is valid
 	strcpy (d3d_AliasBuffers[hdr->buffer].Name, name);
@@ -542,10 +855,8 @@ void D3DAlias_TransformShadowed (entity_t *ent)
 
 void D3DAlias_UpdateInstance (entity_t *ent, aliasinstance_t *inst)
 {
-	// suitable for both writing to a mapped buffer or to system memory
-	QMATRIX m (&d3d_ModelViewProjMatrix);
-
-	m.Mult (&inst->ModelMatrix, &ent->matrix);
+	// the matrix is kept in world space so that instances don't go dirty every time the view moves
+	inst->ModelMatrix = ent->matrix;
 
 	inst->shadelight[0] = ent->lightinfo.shadelight[0];
 	inst->shadelight[1] = ent->lightinfo.shadelight[1];
@@ -568,6 +879,11 @@ void D3DAlias_UpdateConstants (entity_t *ent)
 	aliasinstance_t ThisInstance;
 
 	D3DAlias_UpdateInstance (ent, &ThisInstance);
+
+	// the cbuffer path takes the full transform
+	QMATRIX m (&d3d_ModelViewProjMatrix);
+	m.Mult (&ThisInstance.ModelMatrix, &ent->matrix);
+
 	d3d11_Context->UpdateSubresource (d3d_MeshConstants, 0, NULL, &ThisInstance, 0, 0);
 	d3d11_State->VSSetConstantBuffer (1, d3d_MeshConstants);
 }
@@ -668,9 +984,11 @@ void D3DAlias_SetVertexState (entity_t *ent, aliashdr_t *hdr, int flags)
 	}
 	else if (flags & AM_INSTANCED)
 	{
-		d3d11_State->IASetVertexBuffer (3, QINSTANCE::VertexBuffer, sizeof (aliasinstance_t), QINSTANCE::MapOffset);
+		// the per-frame stream only carries slot numbers; the instance data itself lives in the persistent buffer
+		d3d11_State->IASetVertexBuffer (3, QINSTANCE::VertexBuffer, sizeof (unsigned int), QINSTANCE::MapOffset);
 		d3d11_State->IASetInputLayout (d3d_InstancedLayout);
 		d3d11_State->VSSetShader (d3d_InstancedVertexShader);
+		d3d11_State->VSSetShaderResourceView (6, d3d_InstanceSRV);
 	}
 	else
 	{
@@ -680,46 +998,84 @@ void D3DAlias_SetVertexState (entity_t *ent, aliashdr_t *hdr, int flags)
 }
 
 
-bool D3DAlias_BreakBatch (entity_t *ent, entity_t *prev)
+bool D3DAlias_SameBucket (entity_t *ent, entity_t *other)
 {
-	// no previous batch
-	if (!prev) return false;
-
-	// if any of these change we must begin a new batch as they will change the per-instance data
-	if (ent->model != prev->model) return true;
-	if (ent->curr.pose != prev->curr.pose) return true;
-	if (ent->prev.pose != prev->prev.pose) return true;
-	if (ent->teximage != prev->teximage) return true;
-	if (ent->lumaimage != prev->lumaimage) return true;
-	if (ent->cmapimage != prev->cmapimage) return true;
-
-	// no change
-	return false;
+	// if any of these change the entities need different vertex streams, textures or shaders so they can't share a draw
+	if (ent->model != other->model) return false;
+	if (ent->curr.pose != other->curr.pose) return false;
+	if (ent->prev.pose != other->prev.pose) return false;
+	if (ent->teximage != other->teximage) return false;
+	if (ent->lumaimage != other->lumaimage) return false;
+	if (ent->cmapimage != other->cmapimage) return false;
+
+	// the player colours select the palette rows
+	if (ent->cmapimage && ent->playerskin != other->playerskin) return false;
+
+	// same state
+	return true;
+}
+
+
+unsigned int D3DAlias_BucketHash (entity_t *ent)
+{
+	unsigned int hash = (unsigned int) (intptr_t) ent->model;
+
+	hash = hash * 31 + ent->curr.pose;
+	hash = hash * 31 + ent->prev.pose;
+	hash = hash * 31 + (unsigned int) ((intptr_t) ent->teximage >> 4);
+	hash = hash * 31 + (unsigned int) ((intptr_t) ent->lumaimage >> 4);
+	hash = hash * 31 + (unsigned int) ((intptr_t) ent->cmapimage >> 4);
+
+	if (ent->cmapimage) hash = hash * 31 + ent->playerskin;
+
+	return hash ^ (hash >> 16);
+}
+
+
+int D3DAlias_GetInstanceSlot (entity_t *ent)
+{
+	instanceslot_t *slot = NULL;
+
+	// keep the slot from last time if nobody else has taken it
+	if ((unsigned) ent->instanceslot < MAX_INSTANCE_SLOTS && d3d_InstanceSlots[ent->instanceslot].Owner == ent)
+	{
+		d3d_InstanceSlots[ent->instanceslot].LastFrame = d3d_RenderDef.framecount;
+		return ent->instanceslot;
+	}
+
+	// take the first slot that wasn't used this frame or last frame
+	for (int i = 0; i < MAX_INSTANCE_SLOTS; i++)
+	{
+		int slotnum = (d3d_NextInstanceSlot + i) & (MAX_INSTANCE_SLOTS - 1);
+
+		slot = &d3d_InstanceSlots[slotnum];
+
+		if (slot->Owner && slot->LastFrame >= d3d_RenderDef.framecount - 1) continue;
+
+		// the cached data from the previous owner is left alone; it just compares as dirty the first time we write it
+		slot->Owner = ent;
+		slot->LastFrame = d3d_RenderDef.framecount;
+
+		d3d_NextInstanceSlot = slotnum + 1;
+		ent->instanceslot = slotnum;
+
+		return slotnum;
+	}
+
+	// everything is in use
+	return -1;
 }
 
 
-struct instancebatch_t
+struct instancebucket_t
 {
 	entity_t *ent;
 	aliashdr_t *hdr;
-	QTEXTURE *TexImage;
-	QTEXTURE *LumaImage;
-	int NumIndexes;
 	int FirstInstance;
 	int NumInstances;
 };
 
 
-void D3DAlias_WriteInstancedBatch (instancebatch_t *Batch, entity_t *ent, aliashdr_t *hdr)
-{
-	Batch->ent = ent;
-	Batch->hdr = hdr;
-	Batch->TexImage = ent->teximage;
-	Batch->LumaImage = ent->lumaimage;
-	Batch->NumIndexes = hdr->numindexes;
-}
-
-
 void D3DAlias_DrawUninstanced (entity_t *ent, aliashdr_t *hdr, int flags)
 {
 	D3DAlias_Transform (ent, hdr, flags);
@@ -740,43 +1096,50 @@ void D3DAlias_DrawAliasBatch (entity_t **ents, int numents, int flags = 0)
 		d3d11_State->OMSetDepthStencilState (d3d_ShadowStencil, 0x00000001);
 	}
 
-	// we map space for up to numents entities but the actual number written may be less
-	D3D11_MAPPED_SUBRESOURCE MappedResource;
-	D3D11_MAP MapType = D3D11_MAP_WRITE_NO_OVERWRITE;
-	int MapSize = CACHE_ALIGN (numents * sizeof (aliasinstance_t));
-
-	if (QINSTANCE::MapOffset + MapSize >= QINSTANCE::BufferMax)
-	{
-		MapType = D3D11_MAP_WRITE_DISCARD;
-		QINSTANCE::MapOffset = 0;
-	}
+	// we map space for up to numents slot numbers but the actual number written may be less
+	unsigned int *InstanceSlots = (unsigned int *) QINSTANCE::Map (numents * sizeof (unsigned int));
 
-	if (FAILED (d3d11_Context->Map (QINSTANCE::VertexBuffer, 0, MapType, 0, &MappedResource)))
+	if (!InstanceSlots)
 	{
 		Con_Printf ("D3DAlias_DrawAliasBatch : Failed to Map instance buffer\n");
 		return;
 	}
 
-	entity_t *lastent = NULL;
-	aliashdr_t *lasthdr = NULL;
-
 	int hunkmark = TempHunk->GetLowMark ();
 
-	// each ent may in theory need a new batch so we must alloc space for them all
-	instancebatch_t *InstanceBatches = (instancebatch_t *) TempHunk->FastAlloc (numents * sizeof (instancebatch_t));
-	aliasinstance_t *AliasInstances = (aliasinstance_t *) (((byte *) MappedResource.pData) + QINSTANCE::MapOffset);
+	// shadows go in the second half of the instance buffer
+	int SlotBase = (flags & AM_DRAWSHADOW) ? MAX_INSTANCE_SLOTS : 0;
+
+	// each ent may in theory need a new bucket so we must alloc space for them all
+	instancebucket_t *Buckets = (instancebucket_t *) TempHunk->FastAlloc (numents * sizeof (instancebucket_t));
+	int *EntBucket = (int *) TempHunk->FastAlloc (numents * sizeof (int));
+	int *EntSlot = (int *) TempHunk->FastAlloc (numents * sizeof (int));
+	byte *SlotDirty = (byte *) TempHunk->FastAlloc (MAX_INSTANCE_SLOTS);
+
+	int NumBuckets = 0;
+	int NumInstances = 0;
+	int DirtyMin = MAX_INSTANCE_SLOTS;
+	int DirtyMax = -1;
+
+	// open-addressed hash of buckets; translucent batches must keep their order so they only merge with the previous bucket
+	int HashSize = 64;
+
+	while (HashSize < numents * 2) HashSize <<= 1;
 
-	int NumInstanceBatches = 0;
-	int NumAliasInstances = 0;
+	int *BucketHash = (int *) TempHunk->FastAlloc (HashSize * sizeof (int));
 
-	// init the first instance
-	InstanceBatches[0].FirstInstance = 0;
-	InstanceBatches[0].NumInstances = 0;
+	for (int i = 0; i < HashSize; i++) BucketHash[i] = -1;
+
+	memset (SlotDirty, 0, MAX_INSTANCE_SLOTS);
 
 	for (int i = 0; i < numents; i++)
 	{
 		entity_t *ent = ents[i];
 
+		// not in any bucket until we find one (or for ever if it's skipped or runs out of slots)
+		EntBucket[i] = -1;
+		EntSlot[i] = 0;
+
 		// check for skipping
 		if (flags & AM_DRAWSHADOW)
 		{
@@ -791,54 +1154,144 @@ void D3DAlias_DrawAliasBatch (entity_t **ents, int numents, int flags = 0)
 			if (!ent->teximage) continue;
 		}
 
-		// check if state changes are needed and go to a new batch if so
-		if (D3DAlias_BreakBatch (ent, lastent))
+		// retrieve the mdl header
+		aliashdr_t *hdr = ent->model->aliashdr;
+
+		// build the transform; this also gets used if the entity can't have a slot
+		D3DAlias_Transform (ent, hdr, flags);
+
+		if ((EntSlot[i] = D3DAlias_GetInstanceSlot (ent)) < 0)
 		{
-			// update the previous instance batch with the previous values
-			D3DAlias_WriteInstancedBatch (&InstanceBatches[NumInstanceBatches++], lastent, lasthdr);
+			// out of slots so it's drawn on its own after the buckets
+			continue;
+		}
+
+		// find the bucket for this entity
+		int BucketNum = -1;
 
-			// init the new batch
-			InstanceBatches[NumInstanceBatches].FirstInstance = NumAliasInstances;
-			InstanceBatches[NumInstanceBatches].NumInstances = 0;
+		if (flags & AM_ORDERED)
+		{
+			if (NumBuckets && D3DAlias_SameBucket (ent, Buckets[NumBuckets - 1].ent))
+				BucketNum = NumBuckets - 1;
 		}
+		else
+		{
+			int h = D3DAlias_BucketHash (ent) & (HashSize - 1);
 
-		// retrieve the mdl header
-		aliashdr_t *hdr = ent->model->aliashdr;
+			for (; BucketHash[h] != -1; h = (h + 1) & (HashSize - 1))
+			{
+				if (D3DAlias_SameBucket (ent, Buckets[BucketHash[h]].ent))
+				{
+					BucketNum = BucketHash[h];
+					break;
+				}
+			}
 
-		// add an instance for this entity
-		D3DAlias_Transform (ent, hdr, flags);
-		D3DAlias_UpdateInstance (ent, &AliasInstances[NumAliasInstances++]);
+			if (BucketNum < 0) BucketHash[h] = NumBuckets;
+		}
 
-		// add to the current instance batch
-		InstanceBatches[NumInstanceBatches].NumInstances++;
+		if (BucketNum < 0)
+		{
+			// start a new bucket with this entity supplying the state
+			BucketNum = NumBuckets++;
+
+			Buckets[BucketNum].ent = ent;
+			Buckets[BucketNum].hdr = hdr;
+			Buckets[BucketNum].NumInstances = 0;
+		}
+
+		Buckets[BucketNum].NumInstances++;
+		EntBucket[i] = BucketNum;
+
+		// only instances which have actually changed since the slot was last written need to go to the GPU
+		aliasinstance_t NewInstance;
+		aliasinstance_t *CachedInstance = &d3d_InstanceCache[SlotBase + EntSlot[i]];
+
+		D3DAlias_UpdateInstance (ent, &NewInstance);
+
+		if (memcmp (&NewInstance, CachedInstance, sizeof (aliasinstance_t)))
+		{
+			Q_MemCpy (CachedInstance, &NewInstance, sizeof (aliasinstance_t));
+			SlotDirty[EntSlot[i]] = 1;
+
+			if (EntSlot[i] < DirtyMin) DirtyMin = EntSlot[i];
+			if (EntSlot[i] > DirtyMax) DirtyMax = EntSlot[i];
+		}
 
 		// accumulate crap
 		d3d_RenderDef.alias_polys += hdr->numtris;
-		lastent = ent;
-		lasthdr = hdr;
 	}
 
-	// terminate the final batch
-	D3DAlias_WriteInstancedBatch (&InstanceBatches[NumInstanceBatches++], lastent, lasthdr);
+	// lay the buckets out contiguously in the slot stream
+	for (int i = 0; i < NumBuckets; i++)
+	{
+		Buckets[i].FirstInstance = NumInstances;
+		NumInstances += Buckets[i].NumInstances;
+		Buckets[i].NumInstances = 0;
+	}
+
+	for (int i = 0; i < numents; i++)
+	{
+		if (EntBucket[i] < 0) continue;
+
+		instancebucket_t *Bucket = &Buckets[EntBucket[i]];
+		InstanceSlots[Bucket->FirstInstance + Bucket->NumInstances++] = SlotBase + EntSlot[i];
+	}
 
 	// and unmap
-	d3d11_Context->Unmap (QINSTANCE::VertexBuffer, 0);
+	QINSTANCE::Unmap ();
+
+	// upload the dirty instances, one update per contiguous run of slots
+	for (int i = DirtyMin; i <= DirtyMax;)
+	{
+		if (!SlotDirty[i])
+		{
+			i++;
+			continue;
+		}
+
+		int j = i + 1;
+
+		while (j <= DirtyMax && SlotDirty[j]) j++;
+
+		D3D11_BOX UpdateBox;
+
+		UpdateBox.left = (SlotBase + i) * sizeof (aliasinstance_t);
+		UpdateBox.right = (SlotBase + j) * sizeof (aliasinstance_t);
+		UpdateBox.top = 0;
+		UpdateBox.bottom = 1;
+		UpdateBox.front = 0;
+		UpdateBox.back = 1;
+
+		d3d11_Context->UpdateSubresource (d3d_InstanceData, 0, &UpdateBox, &d3d_InstanceCache[SlotBase + i], 0, 0);
+		d3d_RenderDef.alias_uploadbytes += (j - i) * sizeof (aliasinstance_t);
+
+		i = j;
+	}
 
 	// now iterate through them and draw them all
-	for (int i = 0; i < NumInstanceBatches; i++)
+	for (int i = 0; i < NumBuckets; i++)
 	{
-		instancebatch_t *Batch = &InstanceBatches[i];
+		instancebucket_t *Bucket = &Buckets[i];
 
-		// it's possible that we accumulated nothing
-		if (!Batch->NumInstances) continue;
+		D3DAlias_SetVertexState (Bucket->ent, Bucket->hdr, flags | AM_INSTANCED);
+		D3DAlias_SetShadersAndTextures (Bucket->ent, Bucket->ent->teximage, Bucket->ent->lumaimage, flags | AM_INSTANCED);
+		D3DMisc_DrawIndexedInstancedCommon (Bucket->hdr->numindexes, Bucket->NumInstances, 0, 0, Bucket->FirstInstance);
 
-		D3DAlias_SetVertexState (Batch->ent, Batch->hdr, flags | AM_INSTANCED);
-		D3DAlias_SetShadersAndTextures (Batch->ent, Batch->TexImage, Batch->LumaImage, flags | AM_INSTANCED);
-		D3DMisc_DrawIndexedInstancedCommon (Batch->NumIndexes, Batch->NumInstances, 0, 0, Batch->FirstInstance);
+		d3d_RenderDef.alias_draws++;
 	}
 
 	// advance the mapping offset by the number of instances actually written
-	QINSTANCE::MapOffset += CACHE_ALIGN (NumAliasInstances * sizeof (aliasinstance_t));
+	QINSTANCE::Advance (NumInstances * sizeof (unsigned int));
+
+	// anything that didn't get a slot is drawn the old way (the transform is already built but this is a rare case)
+	for (int i = 0; i < numents; i++)
+	{
+		if (EntSlot[i] >= 0) continue;
+
+		D3DAlias_DrawUninstanced (ents[i], ents[i]->model->aliashdr, flags);
+		d3d_RenderDef.alias_draws++;
+	}
 
 	// and done
 	TempHunk->FreeToLowMark (hunkmark);
@@ -965,7 +1418,18 @@ void D3DAlias_SetupFrame (entity_t *ent, aliashdr_t *hdr)
 }
 
 
-void D3DAlias_SetupAliasModel (entity_t *ent)
+cullinfo_t *D3DAlias_GetCullBox (entity_t *ent)
+{
+	// the gun or the chase model are never culled away
+	if (ent == cls.entities[cl.viewentity] && chase_active.value)
+		return NULL;	// no bbox culling on certain entities
+	else if (ent->nocullbox)
+		return NULL;	// no bbox culling on certain entities
+	else return &ent->cullinfo;
+}
+
+
+void D3DAlias_SetupAliasModel (entity_t *ent, bool culled)
 {
 	// take pointers for easier access
 	aliashdr_t *hdr = ent->model->aliashdr;
@@ -973,12 +1437,7 @@ void D3DAlias_SetupAliasModel (entity_t *ent)
 	// assume that the model has been culled
 	ent->visframe = -1;
 
-	// the gun or the chase model are never culled away
-	if (ent == cls.entities[cl.viewentity] && chase_active.value)
-		;	// no bbox culling on certain entities
-	else if (ent->nocullbox)
-		;	// no bbox culling on certain entities
-	else if (R_CullBox (&ent->cullinfo))
+	if (culled)
 	{
 		ent->lerpflags |= LERP_RESETALL;
 		return;
@@ -1012,16 +1471,7 @@ void D3DAlias_SetupAliasModel (entity_t *ent)
 
 
 QEDICTLIST d3d_AliasEdicts;
-
-
-int D3DAlias_ModelSortFunc (entity_t **e1, entity_t **e2)
-{
-	// sort so that the same pose is likely to be used more often
-	// (should this use current poses instead of the cached poses???
-	if (e1[0]->model == e2[0]->model)
-		return (e1[0]->sortorder - e2[0]->sortorder);
-	return (int) (e1[0]->model - e2[0]->model);
-}
+QEDICTLIST d3d_AliasPending;
 
 
 void D3DAlias_RenderAliasModels (void)
@@ -1029,10 +1479,7 @@ void D3DAlias_RenderAliasModels (void)
 	// if (NumOccluded) Con_Printf ("occluded %i\n", NumOccluded);
 	if (!d3d_AliasEdicts.NumEdicts) return;
 
-	// sort the alias edicts by model and poses
-	// (to do - chain these in a list instead to save memory, remove limits and run faster...)
-	qsort (d3d_AliasEdicts.Edicts, d3d_AliasEdicts.NumEdicts, sizeof (entity_t *), (sortfunc_t) D3DAlias_ModelSortFunc);
-
+	// entities are bucketed by state when drawn so no sorting is needed
 	// draw in two passes to prevent excessive shader switching
 	D3DAlias_DrawAliasBatch (d3d_AliasEdicts.Edicts, d3d_AliasEdicts.NumEdicts);
 
@@ -1043,13 +1490,66 @@ void D3DAlias_RenderAliasModels (void)
 
 void D3DAlias_AddEdict (entity_t *ent)
 {
-	D3DAlias_SetupAliasModel (ent);
+	// culling and lighting are deferred to D3DAlias_SetupAliasModels so that they can run alongside the rest of the scene
+	d3d_AliasPending.AddEntity (ent);
+}
 
-	if (ent->visframe != d3d_RenderDef.framecount) return;
 
-	if (ent->alphaval > 0 && ent->alphaval < 255)
-		D3DAlpha_AddToList (ent);
-	else d3d_AliasEdicts.AddEntity (ent);
+void D3DAlias_SetupAliasModels (void)
+{
+	cullinfo_t *boxes[4] = {NULL, NULL, NULL, NULL};
+	int culled = 0;
+
+	// this may run on any thread so it mustn't touch the hunk or the alpha list
+	for (int i = 0; i < d3d_AliasPending.NumEdicts; i++)
+	{
+		entity_t *ent = d3d_AliasPending.Edicts[i];
+		cullinfo_t *ci = NULL;
+		bool entculled = false;
+
+		if (r_simdcull.integer)
+		{
+			// cull the next 4 entities together
+			if (!(i & 3))
+			{
+				for (int j = 0; j < 4; j++)
+					boxes[j] = (i + j < d3d_AliasPending.NumEdicts) ? D3DAlias_GetCullBox (d3d_AliasPending.Edicts[i + j]) : NULL;
+
+				culled = R_CullBoxes (boxes);
+			}
+
+			ci = boxes[i & 3];
+			entculled = (culled & (1 << (i & 3))) != 0;
+		}
+		else if ((ci = D3DAlias_GetCullBox (ent)) != NULL)
+			entculled = R_CullBox (ci);
+
+		// anything inside the frustum may still be hidden behind the world
+		if (ci && !entculled) entculled = R_OccludeBox (ci);
+
+		D3DAlias_SetupAliasModel (ent, entculled);
+
+		if (ent->visframe != d3d_RenderDef.framecount) continue;
+
+		// translucent entities are added to the alpha list by D3DAlias_AddAlphaEdicts
+		if (ent->alphaval > 0 && ent->alphaval < 255) continue;
+
+		d3d_AliasEdicts.AddEntity (ent);
+	}
+}
+
+
+void D3DAlias_AddAlphaEdicts (void)
+{
+	for (int i = 0; i < d3d_AliasPending.NumEdicts; i++)
+	{
+		entity_t *ent = d3d_AliasPending.Edicts[i];
+
+		if (ent->visframe != d3d_RenderDef.framecount) continue;
+
+		if (ent->alphaval > 0 && ent->alphaval < 255)
+			D3DAlpha_AddToList (ent);
+	}
 }
 
 
@@ -1125,7 +1625,7 @@ void D3DAlias_DrawViewModel (int passnum)
 	{
 		D3DAlias_SetupFrame (ent, hdr);
 		D3DMain_ComputeEntityTransform (ent);
-		D3DAlias_SetupAliasModel (ent);
+		D3DAlias_SetupAliasModel (ent, false);
 		D3DAlias_DrawUninstanced (ent, hdr, AM_VIEWMODEL);
 	}
 
@@ -38,6 +38,9 @@ struct d3d_alphalist_t
 	int Type;
 	float Dist;
 
+	// built from the distance, type and texture when the list is sorted
+	unsigned int SortKey;
+
 	// added for brush surfaces so that they don't need to allocate a modelsurf (yuck)
 	entity_t *SurfEntity;
 
@@ -136,22 +139,92 @@ void D3DAlpha_AddToList (dlight_t *dl)
 	D3DAlpha_AddToList (D3D_ALPHATYPE_CORONA, dl, D3DAlpha_GetDist (dl->origin));
 }
 
-int D3DAlpha_SortFunc (const void *a, const void *b)
+/*
+the list is radix sorted on a 32 bit key, ascending, so the key needs to put the farthest items first.  the top 22 bits are the
+inverted top bits of the (always positive) float squared distance, which compare the same as the float does and still keep items
+which are a fraction of a unit apart in order; items which quantize to the same distance are then grouped by type and texture
+so that they can go in the same batch.
+*/
+unsigned int D3DAlpha_MakeSortKey (d3d_alphalist_t *item)
 {
-	d3d_alphalist_t *al1 = *(d3d_alphalist_t **) a;
-	d3d_alphalist_t *al2 = *(d3d_alphalist_t **) b;
-
-	// back to front ordering
-	// this is more correct as it will order surfs properly if less than 1 unit separated
-	if (al2->Dist > al1->Dist)
-		return 1;
-	else if (al2->Dist < al1->Dist)
-		return -1;
-	else return 0;
+	union {float f; unsigned int i;} dist;
+	void *texture = NULL;
+
+	switch (item->Type)
+	{
+	case D3D_ALPHATYPE_WATERWARP:
+	case D3D_ALPHATYPE_SURFACE:
+	case D3D_ALPHATYPE_FENCE:
+		texture = item->surf->texinfo->texture;
+		break;
+
+	case D3D_ALPHATYPE_ALIAS:
+	case D3D_ALPHATYPE_BRUSH:
+	case D3D_ALPHATYPE_SPRITE:
+	case D3D_ALPHATYPE_IQM:
+		texture = item->Entity->model;
+		break;
+
+	default:
+		break;
+	}
+
+	dist.f = item->Dist;
+
+	return ((0x3fffff - (dist.i >> 9)) << 10) | ((item->Type & 15) << 6) | ((((intptr_t) texture) >> 4) & 63);
+}
+
+
+struct alphasortitem_t
+{
+	unsigned int Key;
+	d3d_alphalist_t *Item;
+};
+
+
+alphasortitem_t *D3DAlpha_RadixSort (alphasortitem_t *items, alphasortitem_t *temp, int numitems)
+{
+	int counts[4][256];
+
+	memset (counts, 0, sizeof (counts));
+
+	// get the counts for all passes in one go
+	for (int i = 0; i < numitems; i++)
+	{
+		counts[0][items[i].Key & 255]++;
+		counts[1][(items[i].Key >> 8) & 255]++;
+		counts[2][(items[i].Key >> 16) & 255]++;
+		counts[3][items[i].Key >> 24]++;
+	}
+
+	for (int pass = 0, shift = 0; pass < 4; pass++, shift += 8)
+	{
+		// every key has the same value in this byte so the pass wouldn't change anything
+		if (counts[pass][(items[0].Key >> shift) & 255] == numitems) continue;
+
+		// convert counts to offsets
+		for (int i = 0, offset = 0; i < 256; i++)
+		{
+			int count = counts[pass][i];
+
+			counts[pass][i] = offset;
+			offset += count;
+		}
+
+		for (int i = 0; i < numitems; i++)
+			temp[counts[pass][(items[i].Key >> shift) & 255]++] = items[i];
+
+		// the output of this pass is the input to the next
+		alphasortitem_t *swap = items;
+		items = temp;
+		temp = swap;
+	}
+
+	return items;
 }
 
 
-void D3DAlias_SetupAliasModel (entity_t *e);
+void D3DAlias_SetupAliasModel (entity_t *e, bool culled);
 void D3DAlias_DrawAliasBatch (entity_t **ents, int numents, int flags = 0);
 void D3DSprite_Draw (entity_t *ent);
 
@@ -167,6 +240,10 @@ void D3DPart_End (void);
 void D3DSprite_Begin (void);
 void D3DSprite_End (void);
 
+byte *D3DPart_WriteEmitter (emitter_t *pe, byte *dest);
+byte *D3DSprite_WriteInstance (entity_t *ent, byte *dest);
+int D3DSprite_InstanceSize (void);
+
 void D3DLight_BeginCoronas (void);
 void D3DLight_EndCoronas (void);
 void D3DLight_DrawCorona (dlight_t *dl);
@@ -208,16 +285,97 @@ xcommand_t d3d_AlphaBeginFuncs[] =
 };
 
 
+// sort and submit times for r_speeds
+float d3d_AlphaSortTime = 0;
+float d3d_AlphaSubmitTime = 0;
+
+void D3DAlpha_SortList (void)
+{
+	if (!d3d_AlphaList) return;
+
+	double start = Sys_ProfileTime ();
+
+	// sort the alpha list
+	if (d3d_NumAlphaList > 1)
+	{
+		int hunkmark = TempHunk->GetLowMark ();
+		alphasortitem_t *items = (alphasortitem_t *) TempHunk->FastAlloc (d3d_NumAlphaList * sizeof (alphasortitem_t));
+		alphasortitem_t *temp = (alphasortitem_t *) TempHunk->FastAlloc (d3d_NumAlphaList * sizeof (alphasortitem_t));
+
+		for (int i = 0; i < d3d_NumAlphaList; i++)
+		{
+			items[i].Key = D3DAlpha_MakeSortKey (d3d_AlphaList[i]);
+			items[i].Item = d3d_AlphaList[i];
+		}
+
+		items = D3DAlpha_RadixSort (items, temp, d3d_NumAlphaList);
+
+		for (int i = 0; i < d3d_NumAlphaList; i++)
+			d3d_AlphaList[i] = items[i].Item;
+
+		TempHunk->FreeToLowMark (hunkmark);
+	}
+
+	d3d_AlphaSortTime = (float) ((Sys_ProfileTime () - start) * 1000.0);
+}
+
+
+void D3DAlpha_ClearList (void)
+{
+	// discard everything without drawing it
+	d3d_NumAlphaList = 0;
+}
+
+
+void D3DAlpha_PrewriteInstances (void)
+{
+	int WriteSize = 0;
+
+	// particles and sprites are generated into the instance buffer in list order under a single map before anything is
+	// drawn; consecutive items of each type are then contiguous so the draw functions just need to count them off
+	for (int i = 0; i < d3d_NumAlphaList; i++)
+	{
+		if (d3d_AlphaList[i]->Type == D3D_ALPHATYPE_PARTICLE)
+			WriteSize += d3d_AlphaList[i]->Particle->numparticles * sizeof (partvert_t);
+		else if (d3d_AlphaList[i]->Type == D3D_ALPHATYPE_SPRITE)
+			WriteSize += D3DSprite_InstanceSize ();
+	}
+
+	// if it's too big they map their own space as they're drawn
+	if (!WriteSize) return;
+	if (CACHE_ALIGN (WriteSize) >= QINSTANCE::BufferMax) return;
+
+	byte *dest = (byte *) QINSTANCE::Map (WriteSize);
+
+	if (!dest) return;
+
+	for (int i = 0; i < d3d_NumAlphaList; i++)
+	{
+		if (d3d_AlphaList[i]->Type == D3D_ALPHATYPE_PARTICLE)
+			dest = D3DPart_WriteEmitter (d3d_AlphaList[i]->Particle, dest);
+		else if (d3d_AlphaList[i]->Type == D3D_ALPHATYPE_SPRITE)
+			dest = D3DSprite_WriteInstance (d3d_AlphaList[i]->Entity, dest);
+	}
+
+	QINSTANCE::Unmap ();
+
+	// and move the ring past them so that nothing else overwrites them before they're drawn
+	QINSTANCE::PrewriteOffset = QINSTANCE::MapOffset;
+	QINSTANCE::Advance (WriteSize);
+}
+
+
 void D3DAlpha_RenderList (void)
 {
+	d3d_AlphaSubmitTime = 0;
+
 	// nothing to add
 	if (!d3d_AlphaList) return;
 	if (!d3d_NumAlphaList) return;
 
-	// sort the alpha list
-	if (d3d_NumAlphaList > 1)
-		qsort (d3d_AlphaList, d3d_NumAlphaList, sizeof (d3d_alphalist_t *), D3DAlpha_SortFunc);
+	double start = Sys_ProfileTime ();
 
+	// the list was already sorted when the scene was extracted
 	d3d11_State->OMSetBlendState (d3d_AlphaBlendEnable);
 	d3d11_State->OMSetDepthStencilState (d3d_DepthTestNoWrite);
 
@@ -228,6 +386,8 @@ void D3DAlpha_RenderList (void)
 	// don't call a state change func for this item
 	previous->Type = D3D_ALPHATYPE_NULL;
 
+	D3DAlpha_PrewriteInstances ();
+
 	// now add all the items in it to the alpha buffer
 	for (int i = 0; i < d3d_NumAlphaList; i++)
 	{
@@ -245,7 +405,25 @@ void D3DAlpha_RenderList (void)
 		switch (d3d_AlphaList[i]->Type)
 		{
 		case D3D_ALPHATYPE_ALIAS:
-			D3DAlias_DrawAliasBatch (&d3d_AlphaList[i]->Entity, 1);
+			{
+				// consecutive alias models go in a single batch which instances neighbours that use the same state
+				int numents = 1;
+
+				while (i + numents < d3d_NumAlphaList && d3d_AlphaList[i + numents]->Type == D3D_ALPHATYPE_ALIAS)
+					numents++;
+
+				int hunkmark = TempHunk->GetLowMark ();
+				entity_t **ents = (entity_t **) TempHunk->FastAlloc (numents * sizeof (entity_t *));
+
+				for (int e = 0; e < numents; e++)
+					ents[e] = d3d_AlphaList[i + e]->Entity;
+
+				D3DAlias_DrawAliasBatch (ents, numents, AM_ORDERED);
+				TempHunk->FreeToLowMark (hunkmark);
+
+				// skip over the rest of the batch
+				i += numents - 1;
+			}
 			break;
 
 		case D3D_ALPHATYPE_IQM:
@@ -288,9 +466,14 @@ void D3DAlpha_RenderList (void)
 	// (we ensured that previous is always a valid entry)
 	d3d_AlphaEndFuncs[previous->Type] ();
 
+	// anything else that uses particles or sprites must map its own space
+	QINSTANCE::PrewriteOffset = -1;
+
 	d3d11_State->OMSetBlendState (NULL);
 	d3d11_State->OMSetDepthStencilState (d3d_DepthTestAndWrite);
 
+	d3d_AlphaSubmitTime = (float) ((Sys_ProfileTime () - start) * 1000.0);
+
 	// reset alpha list
 	// Con_Printf ("%i items in alpha list\n", d3d_NumAlphaList);
 	d3d_NumAlphaList = 0;
@@ -202,7 +202,7 @@ void D3DDraw_DrawBatch (void)
 {
 	if (d3d_DrawState.DrawQuads)
 	{
-		d3d11_Context->Unmap (QINSTANCE::VertexBuffer, 0);
+		QINSTANCE::Unmap ();
 		d3d_DrawState.DrawQuads = NULL;
 	}
 
@@ -213,7 +213,7 @@ void D3DDraw_DrawBatch (void)
 
 		D3DMisc_DrawInstancedCommon (4, d3d_DrawState.NumQuads);
 
-		QINSTANCE::MapOffset += CACHE_ALIGN (d3d_DrawState.NumQuads * sizeof (drawinst_t));
+		QINSTANCE::Advance (d3d_DrawState.NumQuads * sizeof (drawinst_t));
 		d3d_DrawState.NumQuads = 0;
 		d3d11_State->ResumeCallback ();
 	}
@@ -242,21 +242,14 @@ void D3DDraw_SubmitQuad (float x, float y, float w, float h, unsigned int c = 0x
 		d3d_ScrapDirty = false;
 	}
 
-	D3D11_MAPPED_SUBRESOURCE MappedResource;
-	D3D11_MAP MapType = D3D11_MAP_WRITE_NO_OVERWRITE;
-
+	// draw what we have if this won't fit so that the map can wrap around
 	if (QINSTANCE::MapOffset + CACHE_ALIGN ((d3d_DrawState.NumQuads + 1) * sizeof (drawinst_t)) >= QINSTANCE::BufferMax)
-	{
 		D3DDraw_DrawBatch ();
-		MapType = D3D11_MAP_WRITE_DISCARD;
-		QINSTANCE::MapOffset = 0;
-	}
 
 	if (!d3d_DrawState.DrawQuads)
 	{
-		if (FAILED (d3d11_Context->Map (QINSTANCE::VertexBuffer, 0, MapType, 0, &MappedResource)))
+		if ((d3d_DrawState.DrawQuads = (drawinst_t *) QINSTANCE::Map (sizeof (drawinst_t))) == NULL)
 			return;
-		else d3d_DrawState.DrawQuads = (drawinst_t *) (&((byte *) MappedResource.pData)[QINSTANCE::MapOffset]);
 	}
 
 	drawinst_t *di = &d3d_DrawState.DrawQuads[d3d_DrawState.NumQuads];
@@ -22,6 +22,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "d3d_quake.h"
 #include "iqm.h"
 #include "resource.h"
+#include <vector>
+#include <algorithm>
+#include <emmintrin.h>
 
 QEDICTLIST d3d_IQMEdicts;
 
@@ -231,7 +234,7 @@ void IQM_LoadV2Poses (iqmheader_t *iqm, iqmdata_t *iqmdata, D3DXMATRIX *basefram
 }
 
 
-void IQM_LoadJoints (iqmheader_t *iqm, iqmdata_t *iqmdata)
+void IQM_LoadJoints (iqmheader_t *iqm, iqmdata_t *iqmdata, model_t *mod)
 {
 	int hunkmark = TempHunk->GetLowMark ();
 
@@ -247,11 +250,30 @@ void IQM_LoadJoints (iqmheader_t *iqm, iqmdata_t *iqmdata)
 		iqmdata->frames = NULL;
 	else
 	{
-		iqmdata->frames = (D3DXMATRIX *) MainHunk->Alloc (iqm->num_frames * iqm->num_poses * sizeof (D3DXMATRIX));
+		// an IQM may be replacing an MDL so it's keyed on its own file rather than what Mod_LoadModel loaded
+		QMODELCACHE cache (mod->name, "iqm", CRC_Block32 ((byte *) iqm, iqm->filesize), iqm->filesize);
+		int numframes = iqm->num_frames * iqm->num_poses;
+		D3DXMATRIX *cachedframes = NULL;
 
-		if (iqm->version == IQM_VERSION1)
-			IQM_LoadV1Poses (iqm, iqmdata, baseframe, inversebaseframe);
-		else IQM_LoadV2Poses (iqm, iqmdata, baseframe, inversebaseframe);
+		iqmdata->frames = (D3DXMATRIX *) MainHunk->Alloc (numframes * sizeof (D3DXMATRIX));
+
+		// the pose matrices are the expensive part so they're what goes in the model cache
+		if (cache.Open () && (cachedframes = (D3DXMATRIX *) cache.Read (numframes * sizeof (D3DXMATRIX))) != NULL)
+		{
+			Q_MemCpy (iqmdata->frames, cachedframes, numframes * sizeof (D3DXMATRIX));
+			cache.Hit ();
+		}
+		else
+		{
+			if (iqm->version == IQM_VERSION1)
+				IQM_LoadV1Poses (iqm, iqmdata, baseframe, inversebaseframe);
+			else IQM_LoadV2Poses (iqm, iqmdata, baseframe, inversebaseframe);
+
+			cache.Create ();
+			cache.Write (iqmdata->frames, numframes * sizeof (D3DXMATRIX));
+		}
+
+		cache.Close ();
 	}
 
 	TempHunk->FreeToLowMark (hunkmark);
@@ -388,7 +410,7 @@ void Mod_LoadIQMModel (model_t *mod, void *buffer, char *path)
 	iqmdata->num_triangles = hdr->num_triangles;
 
 	IQM_LoadVertexes (hdr, iqmdata);
-	IQM_LoadJoints (hdr, iqmdata);
+	IQM_LoadJoints (hdr, iqmdata, mod);
 	IQM_LoadBounds (hdr, iqmdata, mod);
 	IQM_LoadTriangles (hdr, iqmdata);
 	IQM_LoadMesh (hdr, iqmdata, path);
@@ -551,42 +573,271 @@ void D3DAlias_SetShadersAndTextures (entity_t *ent, QTEXTURE *teximage, QTEXTURE
 extern ID3D11Buffer *d3d_MeshConstants;
 
 
-// fixme - iqm with no joints?
-void D3DIQM_AnimateFrame (iqmdata_t *hdr, int lastframe, int currframe, float lerp)
+/*
+===============================================================================
+
+POSE EVALUATION
+
+joint transforms are affine so only the top 3 rows of each matrix are needed; these are lerped and concatenated
+4 floats at a time.  poses for all visible IQMs are evaluated together on the worker threads before any are drawn,
+and entities using the same model, frame pair and blend share the one pose.
+
+===============================================================================
+*/
+
+#define MAX_IQM_JOINTS	256
+
+struct iqmposekey_t
 {
-	// temp memory for building the animation (we need to keep this for the entire model as subsequent
-	// joints may reference prior parent joints in the list)
-	int hunkmark = TempHunk->GetLowMark ();
-	D3DXMATRIX *outframe = (D3DXMATRIX *) TempHunk->FastAlloc (hdr->num_joints * sizeof (D3DXMATRIX));
-	iqmjointrow_t *rows = (iqmjointrow_t *) TempHunk->FastAlloc (sizeof (iqmjointrow_t));
+	iqmdata_t *hdr;
+	int lastpose;
+	int currpose;
+	float lerp;
+};
+
+struct iqmpose_t
+{
+	iqmposekey_t key;
+
+	// into the row pool; there are 3 rows of 4 floats for each joint
+	int firstrow;
+};
+
+
+class QIQMPOSECACHE
+{
+public:
+	QIQMPOSECACHE (void);
+
+	int Find (iqmdata_t *hdr, int lastframe, int currframe, float lerp, bool *added = NULL);
+	void EvaluatePending (void);
+	float *GetRows (int pose) {return &this->Rows[this->Poses[pose].firstrow * 4];}
+
+private:
+	void Reset (void);
+	void Evaluate (int pose);
+	void Rehash (int size);
+	static void EvaluateJob (int index, void *data);
+	static unsigned int HashKey (iqmposekey_t *key);
+
+	std::vector<iqmpose_t> Poses;
+	std::vector<float> Rows;
 
-	D3DXVECTOR4 *outvecs1 = rows->data1;
-	D3DXVECTOR4 *outvecs2 = rows->data2;
-	D3DXVECTOR4 *outvecs3 = rows->data3;
+	// pose index + 1 so that 0 is empty
+	std::vector<int> HashTable;
+
+	int NumEvaluated;
+	int FrameCount;
+};
+
+
+QIQMPOSECACHE d3d_IQMPoses;
+
+
+QIQMPOSECACHE::QIQMPOSECACHE (void)
+{
+	this->NumEvaluated = 0;
+	this->FrameCount = -1;
+}
 
-	// this memory should never be referenced if there are no frames or poses
-	D3DXMATRIX *mat1 = (!hdr->num_poses || !hdr->num_frames) ? NULL : &hdr->frames[(lastframe % hdr->num_poses) * hdr->num_joints];
-	D3DXMATRIX *mat2 = (!hdr->num_poses || !hdr->num_frames) ? NULL : &hdr->frames[(currframe % hdr->num_poses) * hdr->num_joints];
 
-	// and build the animation
-	for (int i = 0; i < hdr->num_joints; i++)
+void QIQMPOSECACHE::Reset (void)
+{
+	this->Poses.clear ();
+	this->Rows.clear ();
+	this->NumEvaluated = 0;
+
+	if (this->HashTable.size () < 64)
+		this->HashTable.resize (64);
+
+	std::fill (this->HashTable.begin (), this->HashTable.end (), 0);
+}
+
+
+unsigned int QIQMPOSECACHE::HashKey (iqmposekey_t *key)
+{
+	unsigned int hash = (unsigned int) ((size_t) key->hdr >> 4);
+
+	hash = hash * 31 + key->lastpose;
+	hash = hash * 31 + key->currpose;
+	hash = hash * 31 + *(unsigned int *) &key->lerp;
+
+	return hash ^ (hash >> 15);
+}
+
+
+void QIQMPOSECACHE::Rehash (int size)
+{
+	this->HashTable.resize (size);
+	std::fill (this->HashTable.begin (), this->HashTable.end (), 0);
+
+	for (int i = 0; i < (int) this->Poses.size (); i++)
 	{
+		int slot = QIQMPOSECACHE::HashKey (&this->Poses[i].key) & (size - 1);
+
+		while (this->HashTable[slot]) slot = (slot + 1) & (size - 1);
+
+		this->HashTable[slot] = i + 1;
+	}
+}
+
+
+int QIQMPOSECACHE::Find (iqmdata_t *hdr, int lastframe, int currframe, float lerp, bool *added)
+{
+	// poses are only kept for the frame they were made in
+	if (this->FrameCount != d3d_RenderDef.framecount)
+	{
+		this->Reset ();
+		this->FrameCount = d3d_RenderDef.framecount;
+	}
+
+	iqmposekey_t key = {hdr, 0, 0, 0};
+
+	// with no animation every entity using the model gets the same identity pose
+	if (hdr->num_poses && hdr->num_frames)
+	{
+		key.lastpose = lastframe % hdr->num_poses;
+		key.currpose = currframe % hdr->num_poses;
+
+		// the blend doesn't matter if both frames are the same and this lets more entities share
+		if (key.lastpose != key.currpose) key.lerp = lerp;
+	}
+
+	int mask = this->HashTable.size () - 1;
+	int slot = QIQMPOSECACHE::HashKey (&key) & mask;
+
+	for (; this->HashTable[slot]; slot = (slot + 1) & mask)
+	{
+		iqmpose_t *pose = &this->Poses[this->HashTable[slot] - 1];
+
+		if (pose->key.hdr != key.hdr) continue;
+		if (pose->key.lastpose != key.lastpose) continue;
+		if (pose->key.currpose != key.currpose) continue;
+		if (pose->key.lerp != key.lerp) continue;
+
+		if (added) *added = false;
+		return this->HashTable[slot] - 1;
+	}
+
+	// add a new one; it's evaluated by the next EvaluatePending
+	iqmpose_t newpose = {key, this->Rows.size () / 4};
+	int numjoints = (hdr->num_joints < MAX_IQM_JOINTS) ? hdr->num_joints : MAX_IQM_JOINTS;
+
+	this->Rows.resize (this->Rows.size () + numjoints * 12);
+	this->Poses.push_back (newpose);
+	this->HashTable[slot] = this->Poses.size ();
+
+	// keep the load at 50% or less
+	if (this->Poses.size () * 2 > this->HashTable.size ())
+		this->Rehash (this->HashTable.size () * 2);
+
+	if (added) *added = true;
+	return this->Poses.size () - 1;
+}
+
+
+void QIQMPOSECACHE::Evaluate (int pose)
+{
+	iqmposekey_t *key = &this->Poses[pose].key;
+	iqmdata_t *hdr = key->hdr;
+	float *base = this->GetRows (pose);
+	float *out = base;
+	int numjoints = (hdr->num_joints < MAX_IQM_JOINTS) ? hdr->num_joints : MAX_IQM_JOINTS;
+
+	if (!hdr->num_poses || !hdr->num_frames)
+	{
+		for (int i = 0; i < numjoints; i++, out += 12)
+		{
+			_mm_storeu_ps (&out[0], _mm_set_ps (0, 0, 0, 1));
+			_mm_storeu_ps (&out[4], _mm_set_ps (0, 0, 1, 0));
+			_mm_storeu_ps (&out[8], _mm_set_ps (0, 1, 0, 0));
+		}
+
+		return;
+	}
+
+	float *mat1 = (float *) &hdr->frames[key->lastpose * hdr->num_joints];
+	float *mat2 = (float *) &hdr->frames[key->currpose * hdr->num_joints];
+	__m128 lerp = _mm_set1_ps (key->lerp);
+	__m128 wmask = _mm_castsi128_ps (_mm_set_epi32 (-1, 0, 0, 0));
+
+	for (int i = 0; i < numjoints; i++, mat1 += 16, mat2 += 16, out += 12)
+	{
+		__m128 r[3];
+
+		// mat1 + (mat2 - mat1) * lerp
+		for (int j = 0; j < 3; j++)
+		{
+			__m128 m1 = _mm_loadu_ps (&mat1[j * 4]);
+			r[j] = _mm_add_ps (m1, _mm_mul_ps (_mm_sub_ps (_mm_loadu_ps (&mat2[j * 4]), m1), lerp));
+		}
+
 		// the joints were unioned and parent is in the same memory location so this is valid to do
-		if (!hdr->num_poses || !hdr->num_frames)
-			D3DXMatrixIdentity (&outframe[i]);
-		else if (hdr->jointsv2[i].parent >= 0)
-			outframe[i] = outframe[hdr->jointsv2[i].parent] * (mat1[i] + ((mat2[i] - mat1[i]) * lerp));
-		else outframe[i] = mat1[i] + ((mat2[i] - mat1[i]) * lerp);
-
-		// copy out to 3xvec4 for more space in the constants (otherwise we'd just use a matrix array)
-		outvecs1[i] = D3DXVECTOR4 (outframe[i].m[0]);
-		outvecs2[i] = D3DXVECTOR4 (outframe[i].m[1]);
-		outvecs3[i] = D3DXVECTOR4 (outframe[i].m[2]);
+		int parent = hdr->jointsv2[i].parent;
+
+		if (parent >= 0)
+		{
+			// parent * child; parents always come before their children so the parent is already done
+			float *prow = &base[parent * 12];
+
+			for (int j = 0; j < 3; j++)
+			{
+				__m128 p = _mm_loadu_ps (&prow[j * 4]);
+				__m128 o = _mm_mul_ps (_mm_shuffle_ps (p, p, _MM_SHUFFLE (0, 0, 0, 0)), r[0]);
+
+				o = _mm_add_ps (o, _mm_mul_ps (_mm_shuffle_ps (p, p, _MM_SHUFFLE (1, 1, 1, 1)), r[1]));
+				o = _mm_add_ps (o, _mm_mul_ps (_mm_shuffle_ps (p, p, _MM_SHUFFLE (2, 2, 2, 2)), r[2]));
+
+				// the child's bottom row is 0 0 0 1 so the parent's translation just carries through
+				_mm_storeu_ps (&out[j * 4], _mm_add_ps (o, _mm_and_ps (p, wmask)));
+			}
+		}
+		else
+		{
+			_mm_storeu_ps (&out[0], r[0]);
+			_mm_storeu_ps (&out[4], r[1]);
+			_mm_storeu_ps (&out[8], r[2]);
+		}
 	}
+}
 
-	d3d11_Context->UpdateSubresource (d3d_IQMJointRows, 0, NULL, rows, 0, 0);
 
-	TempHunk->FreeToLowMark (hunkmark);
+void QIQMPOSECACHE::EvaluateJob (int index, void *data)
+{
+	QIQMPOSECACHE *cache = (QIQMPOSECACHE *) data;
+
+	cache->Evaluate (cache->NumEvaluated + index);
+}
+
+
+void QIQMPOSECACHE::EvaluatePending (void)
+{
+	int numpending = this->Poses.size () - this->NumEvaluated;
+
+	if (numpending < 1) return;
+
+	// nothing can be added while this runs so the pools won't move
+	Sys_ParallelFor (numpending, QIQMPOSECACHE::EvaluateJob, this);
+
+	this->NumEvaluated += numpending;
+	d3d_RenderDef.iqm_poses += numpending;
+}
+
+
+void D3DIQM_UploadPose (iqmdata_t *hdr, float *rows)
+{
+	static iqmjointrow_t jointrows;
+	int numjoints = (hdr->num_joints < MAX_IQM_JOINTS) ? hdr->num_joints : MAX_IQM_JOINTS;
+
+	// copy out to 3xvec4 for more space in the constants (otherwise we'd just use a matrix array)
+	for (int i = 0; i < numjoints; i++, rows += 12)
+	{
+		Q_MemCpy (&jointrows.data1[i], &rows[0], sizeof (D3DXVECTOR4));
+		Q_MemCpy (&jointrows.data2[i], &rows[4], sizeof (D3DXVECTOR4));
+		Q_MemCpy (&jointrows.data3[i], &rows[8], sizeof (D3DXVECTOR4));
+	}
+
+	d3d11_Context->UpdateSubresource (d3d_IQMJointRows, 0, NULL, &jointrows, 0, 0);
 }
 
 
@@ -622,7 +873,11 @@ void D3DIQM_DrawIQM (entity_t *ent)
 	D3DAlias_TransformStandard (ent);
 	D3DAlias_UpdateConstants (ent);
 
-	D3DIQM_AnimateFrame (hdr, ent->prev.pose, ent->curr.pose, ent->poselerp.blend);
+	// normally this was already evaluated in the batch; the view model and anything else drawn on it's own is done here
+	int pose = d3d_IQMPoses.Find (hdr, ent->prev.pose, ent->curr.pose, ent->poselerp.blend);
+
+	d3d_IQMPoses.EvaluatePending ();
+	D3DIQM_UploadPose (hdr, d3d_IQMPoses.GetRows (pose));
 	D3DIQM_DrawFullMesh (hdr, ent, hdr->skins, hdr->fullbrights, AM_IQM);
 
 	// no shadows on alpha IQMs
@@ -646,8 +901,12 @@ void D3DIQM_DrawIQM (entity_t *ent)
 }
 
 
-void D3DIQM_DrawIQMs (void)
+void D3DIQM_SetupIQMs (d3d_scene_t *scene)
 {
+	// this is on the scene's hunk mark so that it lives until the scene is submitted
+	scene->IQMEdicts = (entity_t **) TempHunk->FastAlloc (d3d_IQMEdicts.NumEdicts * sizeof (entity_t *));
+	scene->NumIQMEdicts = 0;
+
 	for (int i = 0; i < d3d_IQMEdicts.NumEdicts; i++)
 	{
 		entity_t *ent = d3d_IQMEdicts.Edicts[i];
@@ -658,7 +917,7 @@ void D3DIQM_DrawIQMs (void)
 		// we must always have at least one valid skin
 		if (!ent->model->iqmheader->skins[0]) continue;
 
-		if (R_CullBox (&ent->cullinfo))
+		if (R_CullBox (&ent->cullinfo) || R_OccludeBox (&ent->cullinfo))
 		{
 			ent->lerpflags |= LERP_RESETALL;
 			continue;
@@ -667,13 +926,35 @@ void D3DIQM_DrawIQMs (void)
 		// mark as visible (primarily for bbox drawing)
 		ent->visframe = d3d_RenderDef.framecount;
 
+		// gather the poses for everything visible, including alpha entities which are drawn later in the frame
+		bool added = false;
+
+		d3d_IQMPoses.Find (ent->model->iqmheader, ent->prev.pose, ent->curr.pose, ent->poselerp.blend, &added);
+
+		if (!added) d3d_RenderDef.iqm_posesshared++;
+
 		if (ent->alphaval > 0 && ent->alphaval < 255)
 		{
 			D3DAlpha_AddToList (ent);
 			continue;
 		}
 
-		D3DIQM_DrawIQM (ent);
+		scene->IQMEdicts[scene->NumIQMEdicts++] = ent;
 	}
 }
 
+
+void D3DIQM_EvaluatePoses (void)
+{
+	// evaluate them all in one go before anything is drawn
+	// (this goes wide itself so it's run after the rest of the scene has been set up rather than as one of its jobs)
+	d3d_IQMPoses.EvaluatePending ();
+}
+
+
+void D3DIQM_DrawIQMs (d3d_scene_t *scene)
+{
+	for (int i = 0; i < scene->NumIQMEdicts; i++)
+		D3DIQM_DrawIQM (scene->IQMEdicts[i]);
+}
+
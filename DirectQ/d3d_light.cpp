@@ -30,6 +30,13 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 cvar_t r_lightscale ("r_lightscale", "1", CVAR_ARCHIVE);
 
+// a skyline is a run of horizontal segments marking the top of the allocated space in a page; there can never be more
+// segments than there are columns in a page as each one is at least 1 texel wide
+struct lightskyline_t
+{
+	int x, y, w;
+};
+
 // note - we need to retain the MAX_LIGHTMAPS limit for texturechain building so we put this in a static array instead of a vector
 // (this can probably change now that we have a texture array)
 // the staging texture could just go to a memory block, then we add a modified flag
@@ -125,6 +132,36 @@ public:
 		}
 	}
 
+	bool GetDirtyRect (d3d_dirtyrect_t *rect)
+	{
+		if (!this->Texels || !this->Modified) return false;
+
+		rect->left = this->LightBox.left;
+		rect->top = this->LightBox.top;
+		rect->right = this->LightBox.right;
+		rect->bottom = this->LightBox.bottom;
+
+		return true;
+	}
+
+	void UpdateRect (d3d_dirtyrect_t *rect)
+	{
+		// the box isn't reset until the rect is actually uploaded so that anything discarded by the null backend stays modified
+		D3D11_BOX box;
+
+		box.left = rect->left;
+		box.top = rect->top;
+		box.right = rect->right;
+		box.bottom = rect->bottom;
+		box.front = 0;
+		box.back = 1;
+
+		d3d11_Context->UpdateSubresource (QLIGHTMAP::Texture, rect->lightmap, &box, this->BoxTexels (&box), LIGHTMAP_SIZE << 2, 0);
+
+		this->ResetBox ();
+		d3d_RenderDef.numdlight++;
+	}
+
 	// lightmap texture array
 	static ID3D11Texture2D *Texture;
 	static ID3D11ShaderResourceView *SRV;
@@ -135,7 +172,10 @@ public:
 	// let's get rid of some globals
 	static int LightProperty;
 	static int NumLightmaps;
-	static unsigned short *Allocated;
+
+	// skyline packer state for the page currently being filled
+	static lightskyline_t *Skyline;
+	static int NumSkyline;
 };
 
 
@@ -148,7 +188,8 @@ ID3D11ShaderResourceView *QLIGHTMAP::SRV = NULL;
 
 int QLIGHTMAP::LightProperty = 0;
 int QLIGHTMAP::NumLightmaps = 0;
-unsigned short *QLIGHTMAP::Allocated = NULL;
+lightskyline_t *QLIGHTMAP::Skyline = NULL;
+int QLIGHTMAP::NumSkyline = 0;
 
 
 void D3DLight_ClearLightmaps (void)
@@ -162,7 +203,8 @@ void D3DLight_ClearLightmaps (void)
 	SAFE_RELEASE (QLIGHTMAP::Texture);
 	SAFE_RELEASE (QLIGHTMAP::SRV);
 
-	QLIGHTMAP::Allocated = NULL;
+	QLIGHTMAP::Skyline = NULL;
+	QLIGHTMAP::NumSkyline = 0;
 	QLIGHTMAP::NumLightmaps = 0;
 	QLIGHTMAP::LightProperty++;
 }
@@ -617,6 +659,35 @@ void D3DLight_BeginFrame (void)
 		// and add a corona for this light
 		D3DAlpha_AddToList (dl);
 	}
+}
+
+
+void D3DLight_GatherDirtyRects (d3d_scene_t *scene)
+{
+	// there can never be more than one rect per lightmap
+	scene->DirtyRects = (d3d_dirtyrect_t *) TempHunk->FastAlloc ((QLIGHTMAP::NumLightmaps + 1) * sizeof (d3d_dirtyrect_t));
+	scene->NumDirtyRects = 0;
+
+	for (int i = 0; i < QLIGHTMAP::NumLightmaps; i++)
+	{
+		d3d_dirtyrect_t *rect = &scene->DirtyRects[scene->NumDirtyRects];
+
+		if (QLIGHTMAP::Lightmaps[i].GetDirtyRect (rect))
+		{
+			rect->lightmap = i;
+			scene->NumDirtyRects++;
+		}
+	}
+}
+
+
+void D3DLight_UploadDirtyRects (d3d_scene_t *scene)
+{
+	for (int i = 0; i < scene->NumDirtyRects; i++)
+	{
+		d3d_dirtyrect_t *rect = &scene->DirtyRects[i];
+		QLIGHTMAP::Lightmaps[rect->lightmap].UpdateRect (rect);
+	}
 
 	// the lightmap is always bound to slot 6
 	d3d11_State->PSSetShaderResourceView (6, QLIGHTMAP::SRV);
@@ -1156,11 +1227,13 @@ void D3DLight_WriteLightMap (unsigned *dest, int stride, unsigned *blocklights,
 }
 
 
+// lightmaps are only ever built by one thread at a time (which may not be the main thread) so this can't go on the hunk
+static unsigned int d3d_LightBlock[LIGHTMAP_SIZE * LIGHTMAP_SIZE * 3];
+
 void D3DLight_BuildLightmap (msurface_t *surf, QLIGHTMAP *lm)
 {
 	int size = surf->smax * surf->tmax * 3;
-	int hunkmark = TempHunk->GetLowMark ();
-	unsigned int *lightblock = (unsigned int *) TempHunk->FastAlloc (size * sizeof (unsigned int));
+	unsigned int *lightblock = d3d_LightBlock;
 	bool updated = false;
 
 	// recache properties here because adding dynamic lights may uncache them
@@ -1227,11 +1300,7 @@ void D3DLight_BuildLightmap (msurface_t *surf, QLIGHTMAP *lm)
 	// this is always done so that nothing is left hanging over from a previous frame
 	D3DLight_ClearDynamics (surf);
 
-	if (!updated)
-	{
-		TempHunk->FreeToLowMark (hunkmark);
-		return;
-	}
+	if (!updated) return;
 
 	// get a mapping if we need to
 	unsigned int *dest = lm->BoxTexels (&surf->LightBox);
@@ -1240,7 +1309,6 @@ void D3DLight_BuildLightmap (msurface_t *surf, QLIGHTMAP *lm)
 	{
 		// dirty the surface properties so that the mapping will be tried again next time
 		surf->LightProperties = ~QLIGHTMAP::LightProperty;
-		TempHunk->FreeToLowMark (hunkmark);
 		return;
 	}
 
@@ -1253,45 +1321,121 @@ void D3DLight_BuildLightmap (msurface_t *surf, QLIGHTMAP *lm)
 	else D3DLight_WriteLightMap (dest, LIGHTMAP_SIZE, lightblock, surf->smax, surf->tmax);
 
 	lm->ExpandBox (&surf->LightBox);
-	TempHunk->FreeToLowMark (hunkmark);
 }
 
 
-bool D3DLight_AllocBlock (int w, int h, UINT *x, UINT *y)
+void D3DLight_ResetSkyline (void)
 {
-	int		i, j;
-	int		best, best2;
+	// a new page is a single segment spanning the full width
+	QLIGHTMAP::Skyline[0].x = 0;
+	QLIGHTMAP::Skyline[0].y = 0;
+	QLIGHTMAP::Skyline[0].w = LIGHTMAP_SIZE;
+	QLIGHTMAP::NumSkyline = 1;
+}
+
+
+int D3DLight_SkylineFit (int node, int w, int h)
+{
+	// find the lowest y that a block of w texels will sit at if placed at the left of this segment
+	lightskyline_t *sk = &QLIGHTMAP::Skyline[node];
+	int x = sk->x;
+	int y = 0;
+
+	if (x + w > LIGHTMAP_SIZE) return -1;
+
+	for (int widthleft = w; widthleft > 0; sk++)
+	{
+		if (sk->y > y) y = sk->y;
+		if (y + h > LIGHTMAP_SIZE) return -1;
+
+		widthleft -= sk->w;
+	}
+
+	return y;
+}
 
-	best = LIGHTMAP_SIZE;
 
-	for (i = 0; i < LIGHTMAP_SIZE - w; i++)
+bool D3DLight_AllocBlock (int w, int h, UINT *x, UINT *y)
+{
+	int bestnode = -1;
+	int bestheight = LIGHTMAP_SIZE + 1;
+	int bestwidth = LIGHTMAP_SIZE + 1;
+
+	// bottom-left rule; take the position that leaves the lowest top edge, tie-breaking on the narrowest segment so
+	// that gaps are filled in preference to open space.  this only ever visits each segment once so it's O(segments)
+	// rather than the O(LIGHTMAP_SIZE * w) of the old column scan
+	for (int i = 0; i < QLIGHTMAP::NumSkyline; i++)
 	{
-		best2 = 0;
+		int fity = D3DLight_SkylineFit (i, w, h);
+
+		if (fity < 0) continue;
 
-		for (j = 0; j < w; j++)
+		if (fity + h < bestheight || (fity + h == bestheight && QLIGHTMAP::Skyline[i].w < bestwidth))
 		{
-			if (QLIGHTMAP::Allocated[i + j] >= best) break;
-			if (QLIGHTMAP::Allocated[i + j] > best2) best2 = QLIGHTMAP::Allocated[i + j];
+			bestnode = i;
+			bestheight = fity + h;
+			bestwidth = QLIGHTMAP::Skyline[i].w;
+			*x = QLIGHTMAP::Skyline[i].x;
+			*y = fity;
 		}
+	}
+
+	if (bestnode < 0)
+		return false;
 
-		if (j == w)
+	// insert the new segment for the top of this block
+	lightskyline_t *sk = QLIGHTMAP::Skyline;
+
+	memmove (&sk[bestnode + 1], &sk[bestnode], (QLIGHTMAP::NumSkyline - bestnode) * sizeof (lightskyline_t));
+	QLIGHTMAP::NumSkyline++;
+
+	sk[bestnode].x = *x;
+	sk[bestnode].y = bestheight;
+	sk[bestnode].w = w;
+
+	// shrink or remove the segments that are now shadowed by the new one
+	for (int i = bestnode + 1; i < QLIGHTMAP::NumSkyline; i++)
+	{
+		int shrink = (sk[i - 1].x + sk[i - 1].w) - sk[i].x;
+
+		if (shrink <= 0) break;
+
+		if (shrink < sk[i].w)
 		{
-			// this is a valid spot
-			*x = i;
-			*y = best = best2;
+			sk[i].x += shrink;
+			sk[i].w -= shrink;
+			break;
 		}
+
+		memmove (&sk[i], &sk[i + 1], (QLIGHTMAP::NumSkyline - i - 1) * sizeof (lightskyline_t));
+		QLIGHTMAP::NumSkyline--;
+		i--;
 	}
 
-	if (best + h > LIGHTMAP_SIZE)
-		return false;
+	// merge neighbouring segments at the same height
+	for (int i = 0; i < QLIGHTMAP::NumSkyline - 1; i++)
+	{
+		if (sk[i].y != sk[i + 1].y) continue;
 
-	for (i = 0; i < w; i++)
-		QLIGHTMAP::Allocated[*x + i] = best + h;
+		sk[i].w += sk[i + 1].w;
+		memmove (&sk[i + 1], &sk[i + 2], (QLIGHTMAP::NumSkyline - i - 2) * sizeof (lightskyline_t));
+		QLIGHTMAP::NumSkyline--;
+		i--;
+	}
 
 	return true;
 }
 
 
+int D3DLight_SurfaceSortFunc (msurface_t **s1, msurface_t **s2)
+{
+	// tallest first, then widest, so that the skyline stays as flat as possible
+	if (s1[0]->tmax != s2[0]->tmax)
+		return s2[0]->tmax - s1[0]->tmax;
+	else return s2[0]->smax - s1[0]->smax;
+}
+
+
 void D3DLight_BuildAllLightmaps (void)
 {
 	// release all lightmap textures
@@ -1307,7 +1451,12 @@ void D3DLight_BuildAllLightmaps (void)
 	int hunkmark = TempHunk->GetLowMark ();
 
 	// initialize block allocation
-	QLIGHTMAP::Allocated = (unsigned short *) TempHunk->Alloc (LIGHTMAP_SIZE * sizeof (unsigned short));
+	QLIGHTMAP::Skyline = (lightskyline_t *) TempHunk->Alloc ((LIGHTMAP_SIZE + 1) * sizeof (lightskyline_t));
+	D3DLight_ResetSkyline ();
+
+	// stats
+	double packtime = 0;
+	int usedtexels = 0;
 
 	for (int j = 1; j < MAX_MODELS; j++)
 	{
@@ -1332,7 +1481,11 @@ void D3DLight_BuildAllLightmaps (void)
 		if (!mod->brushhdr->numsurfaces) continue;
 
 		brushhdr_t *hdr = mod->brushhdr;
-		hunkmark = TempHunk->GetLowMark ();
+		int modelmark = TempHunk->GetLowMark ();
+
+		// gather all lightmapped surfaces in this model so that they can be packed in size order
+		msurface_t **packsurfs = (msurface_t **) TempHunk->FastAlloc (hdr->numsurfaces * sizeof (msurface_t *));
+		int numpacksurfs = 0;
 
 		for (int i = 0; i < hdr->numsurfaces; i++)
 		{
@@ -1345,6 +1498,18 @@ void D3DLight_BuildAllLightmaps (void)
 			surf->smax = (surf->extents[0] >> 4) + 1;
 			surf->tmax = (surf->extents[1] >> 4) + 1;
 
+			packsurfs[numpacksurfs] = surf;
+			numpacksurfs++;
+		}
+
+		double packstart = Sys_DoubleTime ();
+
+		qsort (packsurfs, numpacksurfs, sizeof (msurface_t *), (sortfunc_t) D3DLight_SurfaceSortFunc);
+
+		for (int i = 0; i < numpacksurfs; i++)
+		{
+			msurface_t *surf = packsurfs[i];
+
 			if (!D3DLight_AllocBlock (surf->smax, surf->tmax, &surf->LightBox.left, &surf->LightBox.top))
 			{
 				// go to a new block
@@ -1354,7 +1519,7 @@ void D3DLight_BuildAllLightmaps (void)
 					return;
 				}
 
-				memset (QLIGHTMAP::Allocated, 0, LIGHTMAP_SIZE * sizeof (unsigned short));
+				D3DLight_ResetSkyline ();
 
 				if (!D3DLight_AllocBlock (surf->smax, surf->tmax, &surf->LightBox.left, &surf->LightBox.top))
 				{
@@ -1367,15 +1532,23 @@ void D3DLight_BuildAllLightmaps (void)
 			surf->LightBox.right = surf->LightBox.left + surf->smax;
 			surf->LightBox.bottom = surf->LightBox.top + surf->tmax;
 
+			// initially assign these
+			surf->LightmapTextureNum = QLIGHTMAP::NumLightmaps;
+			usedtexels += surf->smax * surf->tmax;
+		}
+
+		packtime += Sys_DoubleTime () - packstart;
+
+		for (int i = 0; i < numpacksurfs; i++)
+		{
+			msurface_t *surf = packsurfs[i];
+
 			// create our staging texture if we need to
-			QLIGHTMAP::Lightmaps[QLIGHTMAP::NumLightmaps].AllocTexels ();
+			QLIGHTMAP::Lightmaps[surf->LightmapTextureNum].AllocTexels ();
 
 			// ensure no dlight update happens and rebuild the lightmap fully
 			D3DLight_ClearDynamics (surf);
 
-			// initially assign these
-			surf->LightmapTextureNum = QLIGHTMAP::NumLightmaps;
-
 			// the surf initially has invalid properties set which forces the lightmap to be built here
 			surf->LightProperties = ~QLIGHTMAP::LightProperty;
 
@@ -1385,12 +1558,22 @@ void D3DLight_BuildAllLightmaps (void)
 			// and build the map
 			D3DLight_BuildLightmap (surf, &QLIGHTMAP::Lightmaps[surf->LightmapTextureNum]);
 		}
+
+		TempHunk->FreeToLowMark (modelmark);
 	}
 
 	// any future attempts to access this should crash
-	QLIGHTMAP::Allocated = NULL;
+	QLIGHTMAP::Skyline = NULL;
+	QLIGHTMAP::NumSkyline = 0;
 	QLIGHTMAP::NumLightmaps++;
 
+	Con_DPrintf (
+		"%i lightmap pages at %0.1f%% occupancy packed in %0.3f ms\n",
+		QLIGHTMAP::NumLightmaps,
+		((float) usedtexels * 100.0f) / (float) (QLIGHTMAP::NumLightmaps * LIGHTMAP_SIZE * LIGHTMAP_SIZE),
+		(float) (packtime * 1000.0)
+	);
+
 	// create the texture
 	D3D11_TEXTURE2D_DESC *desc = QTEXTURE::MakeTextureDesc (LIGHTMAP_SIZE, LIGHTMAP_SIZE, IMAGE_UPDATE);
 
@@ -25,6 +25,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "cl_fx.h"
 #include "particles.h"
 
+#include <xmmintrin.h>
+
 void D3DState_DrawOrderChanged (cvar_t *var);
 void D3DState_WireFrameChanged (cvar_t *var);
 
@@ -34,18 +36,28 @@ cvar_t r_draworder ("r_draworder", "0", 0, D3DState_DrawOrderChanged);
 void D3DLight_AnimateLight (float time);
 void V_CalcBlend (void);
 
+void D3DSurf_MarkWorld (void);
 void D3DSurf_BuildWorld (void);
-void D3DSurf_DrawWorld (void);
+void D3DOcclusion_RenderOccluders (void);
+void D3DSurf_ExtractWorld (d3d_scene_t *scene);
+void D3DSurf_BuildDeferredLightmaps (d3d_scene_t *scene);
+void D3DSurf_DrawWorld (d3d_scene_t *scene);
 
 void D3DWarp_BeginFrame (void);
 void D3DFog_BeginFrame (void);
 
 void D3DAlias_DrawViewModel (int passnum);
+void D3DAlias_SetupAliasModels (void);
+void D3DAlias_AddAlphaEdicts (void);
 void D3DAlias_RenderAliasModels (void);
-void D3DIQM_DrawIQMs (void);
+void D3DIQM_SetupIQMs (d3d_scene_t *scene);
+void D3DIQM_EvaluatePoses (void);
+void D3DIQM_DrawIQMs (d3d_scene_t *scene);
 
 void D3DBBoxes_Show (void);
 void D3DLight_BeginFrame (void);
+void D3DLight_GatherDirtyRects (d3d_scene_t *scene);
+void D3DLight_UploadDirtyRects (d3d_scene_t *scene);
 void D3DHLSL_UpdateMainCBuffer (void);
 
 QMATRIX d3d_WorldMatrix;
@@ -54,6 +66,9 @@ QMATRIX d3d_ModelViewProjMatrix;
 // render definition for this frame
 d3d_renderdef_t d3d_RenderDef;
 
+// draw packets for this frame
+d3d_scene_t d3d_Scene;
+
 // view origin
 QMATRIX r_viewvectors;
 
@@ -63,6 +78,9 @@ refdef_t	r_refdef;
 texture_t	*r_notexture_mip;
 
 cvar_t	r_norefresh ("r_norefresh", "0");
+cvar_t	r_nulldraw ("r_nulldraw", "0");
+cvar_t	r_serialprep ("r_serialprep", "0");
+cvar_t	r_simdcull ("r_simdcull", "1");
 cvar_t	r_drawentities ("r_drawentities", "1");
 cvar_t	r_drawviewmodel ("r_drawviewmodel", "1");
 cvar_t	r_speeds ("r_speeds", "0");
@@ -107,6 +125,7 @@ void D3D_BeginVisedicts (void)
 {
 	// begin all of our entity lists for this frame
 	d3d_AliasEdicts.BeginFrame ();
+	d3d_AliasPending.BeginFrame ();
 	d3d_BrushEdicts.BeginFrame ();
 	d3d_MergeEdicts.BeginFrame ();
 	d3d_IQMEdicts.BeginFrame ();
@@ -454,6 +473,113 @@ bool R_CullBox (cullinfo_t *ci)
 }
 
 
+/*
+=================
+R_CullBoxes
+
+culls 4 boxes at a time against the frustum with SSE; gives the same results and leaves the same cullplane
+behind as calling R_CullBox on each box would.  NULL boxes are skipped.  returns a mask with bit n set if
+box n was culled.
+=================
+*/
+static int R_CullBoxForPlaneBits (cullinfo_t *ci, int planebits)
+{
+	if (!ci) return 0;
+
+	// R_CullBox always tests the plane it last culled against, even if it's not in the clipflags
+	int testbits = ci->clipflags & 31;
+
+	if (ci->cullplane != -1) testbits |= (1 << ci->cullplane);
+
+	if (!(planebits & testbits))
+	{
+		ci->cullplane = -1;
+		return 0;
+	}
+
+	// keep the cached plane if it still culls, otherwise take the first one in the same order as R_CullBox
+	if (ci->cullplane == -1 || !(planebits & (1 << ci->cullplane)))
+	{
+		for (int i = 0; i < 5; i++)
+		{
+			if (planebits & ci->clipflags & (1 << i))
+			{
+				ci->cullplane = i;
+				break;
+			}
+		}
+	}
+
+	return 1;
+}
+
+
+static int R_CullBoxesSSE (__m128 *mins, __m128 *maxs, cullinfo_t **boxes)
+{
+	int planebits[4] = {0, 0, 0, 0};
+	int culled = 0;
+
+	for (int i = 0; i < 5; i++)
+	{
+		mplane_t *p = &vid.frustum[i];
+
+		// nearest point to the plane, picked per-axis the same way as R_CullPlaneForNearestPoint
+		__m128 x = (p->signbits & 1) ? mins[0] : maxs[0];
+		__m128 y = (p->signbits & 2) ? mins[1] : maxs[1];
+		__m128 z = (p->signbits & 4) ? mins[2] : maxs[2];
+
+		// and summed in the same order as CULLPOINT so that results match exactly
+		__m128 dist = _mm_add_ps (
+			_mm_add_ps (_mm_mul_ps (_mm_set1_ps (p->normal[0]), x), _mm_mul_ps (_mm_set1_ps (p->normal[1]), y)),
+			_mm_mul_ps (_mm_set1_ps (p->normal[2]), z)
+		);
+
+		int outside = _mm_movemask_ps (_mm_cmplt_ps (dist, _mm_set1_ps (p->dist)));
+
+		for (int j = 0; j < 4; j++)
+			if (outside & (1 << j)) planebits[j] |= (1 << i);
+	}
+
+	for (int j = 0; j < 4; j++)
+		if (R_CullBoxForPlaneBits (boxes[j], planebits[j])) culled |= (1 << j);
+
+	return culled;
+}
+
+
+int R_CullBoxes (cullinfo_t **boxes)
+{
+	static float nullbox[3] = {0, 0, 0};
+	float *bmins[4], *bmaxs[4];
+	__m128 mins[3], maxs[3];
+
+	for (int j = 0; j < 4; j++)
+	{
+		bmins[j] = boxes[j] ? boxes[j]->mins : nullbox;
+		bmaxs[j] = boxes[j] ? boxes[j]->maxs : nullbox;
+	}
+
+	// swizzle to SoA
+	for (int i = 0; i < 3; i++)
+	{
+		mins[i] = _mm_setr_ps (bmins[0][i], bmins[1][i], bmins[2][i], bmins[3][i]);
+		maxs[i] = _mm_setr_ps (bmaxs[0][i], bmaxs[1][i], bmaxs[2][i], bmaxs[3][i]);
+	}
+
+	return R_CullBoxesSSE (mins, maxs, boxes);
+}
+
+
+int R_CullBoxesSoA (float **bounds, int first, cullinfo_t **boxes)
+{
+	// bounds are mins x/y/z then maxs x/y/z, each array padded so that first + 3 is always valid
+	__m128 mins[3] = {_mm_loadu_ps (&bounds[0][first]), _mm_loadu_ps (&bounds[1][first]), _mm_loadu_ps (&bounds[2][first])};
+	__m128 maxs[3] = {_mm_loadu_ps (&bounds[3][first]), _mm_loadu_ps (&bounds[4][first]), _mm_loadu_ps (&bounds[5][first])};
+
+	return R_CullBoxesSSE (mins, maxs, boxes);
+}
+
+
 //==================================================================================
 
 int SignbitsForPlane (mplane_t *out)
@@ -479,6 +605,12 @@ void D3DMain_BeginFrame (void)
 	// initialize r_speeds and flags
 	d3d_RenderDef.brush_polys = 0;
 	d3d_RenderDef.alias_polys = 0;
+	d3d_RenderDef.iqm_poses = 0;
+	d3d_RenderDef.iqm_posesshared = 0;
+	d3d_RenderDef.alias_draws = 0;
+	d3d_RenderDef.alias_uploadbytes = 0;
+	d3d_RenderDef.inst_maps = 0;
+	d3d_RenderDef.inst_bytes = 0;
 
 	// don't allow cheats in multiplayer
 	if (cl.maxclients > 1) r_fullbright.Set (0.0f);
@@ -534,7 +666,7 @@ D3D_PrepareRender
 float r_oldvieworigin[3];
 float r_oldviewangles[3];
 
-void D3DMain_SetupD3D (void)
+void D3DMain_SetupView (void)
 {
 	vec3_t o, a;
 
@@ -554,14 +686,6 @@ void D3DMain_SetupD3D (void)
 		Vector3Copy (r_oldviewangles, r_refdef.viewangles);
 	}
 
-	// r_wireframe 1 is cheating in multiplayer but forcing it client-side is totally bogus as a cheater could just recompile the engine
-	// note that D3D10+ separate the render target from the viewport so that clears are no longer restricted to just the viewport rect
-	// the render target clear is handled in D3DRTT_BeginEffects as the active target may change (as is the viewport)
-	// an r_draworder change will rebuild the depth test state so that it's inverted
-	if (r_draworder.value)
-		d3d11_Context->ClearDepthStencilView (d3d11_DepthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 0, 1);
-	else d3d11_Context->ClearDepthStencilView (d3d11_DepthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1, 1);
-
 	// the world matrix is the inverse of a standard transform with z going up
 	d3d_WorldMatrix.Identity ();
 	d3d_WorldMatrix.Translate (r_refdef.vieworigin);
@@ -591,6 +715,18 @@ void D3DMain_SetupD3D (void)
 		vid.frustum[i].dist = Vector3Dot (r_refdef.vieworigin, vid.frustum[i].normal); // FIXME: shouldn't this always be zero?
 		vid.frustum[i].signbits = SignbitsForPlane (&vid.frustum[i]);
 	}
+}
+
+
+void D3DMain_SetupD3D (void)
+{
+	// r_wireframe 1 is cheating in multiplayer but forcing it client-side is totally bogus as a cheater could just recompile the engine
+	// note that D3D10+ separate the render target from the viewport so that clears are no longer restricted to just the viewport rect
+	// the render target clear is handled in D3DRTT_BeginEffects as the active target may change (as is the viewport)
+	// an r_draworder change will rebuild the depth test state so that it's inverted
+	if (r_draworder.value)
+		d3d11_Context->ClearDepthStencilView (d3d11_DepthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 0, 1);
+	else d3d11_Context->ClearDepthStencilView (d3d11_DepthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1, 1);
 
 	d3d11_State->RSSetState (d3d_RS3DView);
 	d3d11_State->OMSetDepthStencilState (d3d_DepthTestAndWrite);
@@ -699,6 +835,8 @@ void D3DMain_UpdateContentsColor (void)
 
 
 int r_speedstime = -1;
+float r_scenetime = -1;
+float r_submittime = -1;
 
 /*
 ================
@@ -708,8 +846,6 @@ r_refdef must be set before the first call
 ================
 */
 
-void D3DSurf_DrawBrushModel (entity_t *ent);
-
 void V_AdjustContentCShift (int contents);
 void D3DRTT_BeginEffects (void);
 void D3DRTT_EndEffects (void);
@@ -720,55 +856,150 @@ void D3DMain_CSSetUAV (int slot, ID3D11UnorderedAccessView *uav, UINT initcount)
 }
 
 
-void R_RenderView (void)
+void D3DMain_VisJob (int index, void *data)
 {
-	if (!D3DVid_IsCreated ()) return;
+	// mark the leafs and nodes that are in the pvs
+	D3DSurf_MarkWorld ();
+}
 
-	double dTime1 = 0, dTime2 = 0;
-	int hunkmark = TempHunk->GetLowMark ();
 
-	if (r_norefresh.value)
-	{
-		d3d11_Context->ClearRenderTargetView (d3d11_RenderTargetView, D3DMisc_GetColorFromRGBA ((byte *) &d3d_QuakePalette.standard11[109]));
-		return;
-	}
+void D3DMain_OcclusionJob (int index, void *data)
+{
+	// draw the occluders in the pvs so that the world and entities can be tested against them
+	D3DOcclusion_RenderOccluders ();
+}
 
-	if (r_speeds.value) dTime1 = Sys_DoubleTime ();
 
+void D3DMain_WorldJob (int index, void *data)
+{
+	// build the world to get the final far clipping plane we will use
+	D3DSurf_BuildWorld ();
+
+	// gather the surfaces for the world and all brush models, building any lightmaps for brush models
+	D3DSurf_ExtractWorld ((d3d_scene_t *) data);
+}
+
+
+void D3DMain_ParticleJob (int index, void *data)
+{
+	// run particles always, even if they're not drawn
+	ParticleSystem.RunEmitters ();
+}
+
+
+void D3DMain_AliasJob (int index, void *data)
+{
+	// cull, light and sort every alias model that the world (or the client) added
+	D3DAlias_SetupAliasModels ();
+}
+
+
+void D3DMain_LightmapJob (int index, void *data)
+{
+	// the world's lightmaps are the bulk of them so they get a job of their own
+	D3DSurf_BuildDeferredLightmaps ((d3d_scene_t *) data);
+}
+
+
+void D3DMain_IQMJob (int index, void *data)
+{
+	D3DIQM_SetupIQMs ((d3d_scene_t *) data);
+}
+
+
+void D3DMain_FinishJob (int index, void *data)
+{
+	// everything else for the alpha list
+	D3DAlias_AddAlphaEdicts ();
+	ParticleSystem.AddToAlphaList ();
+
+	// sort all items on the alpha list
+	D3DAlpha_SortList ();
+
+	// and collect everything that needs to go to the lightmap texture
+	D3DLight_GatherDirtyRects ((d3d_scene_t *) data);
+}
+
+
+// jobs that touch the hunk, the alpha list or the console must be mainthread
+#define PREPJOB_VIS			0
+#define PREPJOB_OCCLUSION	1
+#define PREPJOB_WORLD		2
+#define PREPJOB_PARTICLES	3
+#define PREPJOB_ALIAS		4
+#define PREPJOB_LIGHTMAPS	5
+#define PREPJOB_IQM			6
+#define PREPJOB_FINISH		7
+#define NUM_PREPJOBS		8
+
+sysjob_t d3d_PrepJobs[NUM_PREPJOBS] =
+{
+	{"vis", D3DMain_VisJob, true, {0}, 0},
+	{"occlusion", D3DMain_OcclusionJob, false, {PREPJOB_VIS}, 1},
+	{"world", D3DMain_WorldJob, true, {PREPJOB_OCCLUSION}, 1},
+	{"particles", D3DMain_ParticleJob, false, {0}, 0},
+	{"alias", D3DMain_AliasJob, false, {PREPJOB_WORLD}, 1},
+	{"lightmaps", D3DMain_LightmapJob, false, {PREPJOB_WORLD}, 1},
+	{"iqm", D3DMain_IQMJob, true, {PREPJOB_WORLD}, 1},
+	{"finish", D3DMain_FinishJob, true, {PREPJOB_PARTICLES, PREPJOB_ALIAS, PREPJOB_LIGHTMAPS, PREPJOB_IQM}, 4}
+};
+
+
+int D3DMain_GetPrepJobs (sysjob_t **jobs)
+{
+	// for r_speeds
+	jobs[0] = d3d_PrepJobs;
+	return NUM_PREPJOBS;
+}
+
+
+void D3DMain_ExtractScene (d3d_scene_t *scene)
+{
+	// everything in here is CPU-side only; nothing may touch the device until the scene is submitted
 	D3DMain_BeginFrame ();
 	D3DWarp_BeginFrame ();
 	D3DMain_UpdateContentsColor ();
 	V_AdjustContentCShift (d3d_RenderDef.viewleaf->contents);
 	V_UpdateCShifts ();
 
-	// setup for render to texture
-	D3DRTT_BeginEffects ();
-
-	// set up to render
-	D3DMain_SetupD3D ();
+	// set up the view and frustum
+	D3DMain_SetupView ();
 
 	// and anything else
 	D3DLight_BeginFrame ();
 	D3DFog_BeginFrame ();
 
-	// build the world to get the final far clipping plane we will use
-	D3DSurf_BuildWorld ();
+	// the rest of the scene is built as a graph of jobs which are joined before anything is submitted
+	Sys_RunJobGraph (d3d_PrepJobs, NUM_PREPJOBS, scene, !!r_serialprep.value);
+
+	// this goes wide itself so it runs after the graph
+	D3DIQM_EvaluatePoses ();
+}
+
+
+void D3DMain_SubmitScene (d3d_scene_t *scene)
+{
+	// setup for render to texture
+	D3DRTT_BeginEffects ();
+
+	// set up to render
+	D3DMain_SetupD3D ();
 
 	// now update the main constant buffer with our world constants
 	D3DHLSL_UpdateMainCBuffer ();
 
+	// lightmaps must be up to date before anything that uses them is drawn
+	D3DLight_UploadDirtyRects (scene);
+
 	// draw the gun model first so that we get early-z on other scene objects (this is the solid view model pass)
 	D3DAlias_DrawViewModel (0);
 
 	// draw the world model (any brush models that need drawing are also handled here)
-	D3DSurf_DrawWorld ();
+	D3DSurf_DrawWorld (scene);
 
 	// draw our model types
 	D3DAlias_RenderAliasModels ();
-	D3DIQM_DrawIQMs ();
-
-	// add particles to alpha list always
-	ParticleSystem.AddToAlphaList ();
+	D3DIQM_DrawIQMs (scene);
 
 	// draw all items on the alpha list
 	D3DAlpha_RenderList ();
@@ -781,13 +1012,62 @@ void R_RenderView (void)
 
 	// cascade all of our enumerated RTT effects for this frame
 	D3DRTT_EndEffects ();
+}
+
+
+void D3DMain_DiscardScene (d3d_scene_t *scene)
+{
+	// the null backend; the packets are just thrown away so that r_nulldraw with timedemo measures scene extraction alone.
+	// dirty lightmap rects are left pending and will go up with the first scene that's actually submitted
+	D3DAlpha_ClearList ();
+	d3d11_Context->ClearRenderTargetView (d3d11_RenderTargetView, D3DMisc_GetColorFromRGBA ((byte *) &d3d_QuakePalette.standard11[109]));
+}
+
+
+void R_RenderView (void)
+{
+	if (!D3DVid_IsCreated ()) return;
+
+	double dTime1 = 0, dTime2 = 0;
+	int hunkmark = TempHunk->GetLowMark ();
+
+	if (r_norefresh.value)
+	{
+		d3d11_Context->ClearRenderTargetView (d3d11_RenderTargetView, D3DMisc_GetColorFromRGBA ((byte *) &d3d_QuakePalette.standard11[109]));
+		return;
+	}
+
+	if (r_speeds.value) dTime1 = Sys_DoubleTime ();
+
+	double scenestart = Sys_ProfileTime ();
+
+	D3DMain_ExtractScene (&d3d_Scene);
+
+	double sceneend = Sys_ProfileTime ();
+
+	// accumulate for timedemo
+	d3d_RenderDef.scenetime += sceneend - scenestart;
+
+	if (r_nulldraw.value)
+		D3DMain_DiscardScene (&d3d_Scene);
+	else D3DMain_SubmitScene (&d3d_Scene);
+
+	// this is only the CPU side of submission; the GPU may still be working on it
+	double submitend = Sys_ProfileTime ();
 
 	if (r_speeds.value)
 	{
 		dTime2 = Sys_DoubleTime ();
 		r_speedstime = (int) ((dTime2 - dTime1) * 1000.0);
+		r_scenetime = (float) ((sceneend - scenestart) * 1000.0);
+		r_submittime = (float) ((submitend - sceneend) * 1000.0);
+	}
+	else
+	{
+		r_speedstime = -1;
+		r_scenetime = -1;
+		r_submittime = -1;
 	}
-	else r_speedstime = -1;
 
 	TempHunk->FreeToLowMark (hunkmark);
 }
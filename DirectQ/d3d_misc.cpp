@@ -34,6 +34,7 @@ QBUFFERFACTORY BufferFactory;
 ID3D11Buffer *QINSTANCE::VertexBuffer = NULL;
 int QINSTANCE::BufferMax = 0;
 int QINSTANCE::MapOffset = 0;
+int QINSTANCE::PrewriteOffset = -1;
 
 
 void D3DMisc_BeginDynamicVertexes (void)
@@ -58,6 +59,45 @@ void D3DMisc_ShutdownDynamicVertexes (void)
 CD3DInitShutdownHandler d3d_DynamicVertexHandler ("dynamic vertexes", D3DMisc_BeginDynamicVertexes, D3DMisc_ShutdownDynamicVertexes);
 
 
+void *QINSTANCE::Map (int size)
+{
+	D3D11_MAPPED_SUBRESOURCE MappedResource;
+	D3D11_MAP MapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+
+	// the discard renames the buffer so wrapping never has to wait on draws that are still reading the old contents;
+	// anything that was being batched must have been drawn before this happens
+	if (QINSTANCE::MapOffset + CACHE_ALIGN (size) >= QINSTANCE::BufferMax)
+	{
+		MapType = D3D11_MAP_WRITE_DISCARD;
+		QINSTANCE::MapOffset = 0;
+
+		// anything written up front that hasn't been drawn yet goes with the old contents so it must be written again
+		QINSTANCE::PrewriteOffset = -1;
+	}
+
+	if (FAILED (d3d11_Context->Map (QINSTANCE::VertexBuffer, 0, MapType, 0, &MappedResource)))
+		return NULL;
+
+	d3d_RenderDef.inst_maps++;
+
+	return &((byte *) MappedResource.pData)[QINSTANCE::MapOffset];
+}
+
+
+void QINSTANCE::Unmap (void)
+{
+	d3d11_Context->Unmap (QINSTANCE::VertexBuffer, 0);
+}
+
+
+void QINSTANCE::Advance (int size)
+{
+	// move past what was written (and drawn from) so that the next batch goes after it
+	QINSTANCE::MapOffset += CACHE_ALIGN (size);
+	d3d_RenderDef.inst_bytes += size;
+}
+
+
 QEDICTLIST::QEDICTLIST (void)
 {
 	this->Edicts = NULL;
@@ -304,7 +344,7 @@ void D3DBBoxes_DrawBatch (void)
 {
 	if (d3d_BBoxState.BBoxInstances)
 	{
-		d3d11_Context->Unmap (QINSTANCE::VertexBuffer, 0);
+		QINSTANCE::Unmap ();
 		d3d_BBoxState.BBoxInstances = NULL;
 	}
 
@@ -315,7 +355,7 @@ void D3DBBoxes_DrawBatch (void)
 
 		D3DMisc_DrawIndexedInstancedCommon (36, d3d_BBoxState.NumBBoxes);
 
-		QINSTANCE::MapOffset += CACHE_ALIGN (d3d_BBoxState.NumBBoxes * sizeof (bboxinstance_t));
+		QINSTANCE::Advance (d3d_BBoxState.NumBBoxes * sizeof (bboxinstance_t));
 		d3d_BBoxState.NumBBoxes = 0;
 		d3d11_State->ResumeCallback ();
 	}
@@ -324,21 +364,14 @@ void D3DBBoxes_DrawBatch (void)
 
 bool D3DBBoxes_GetBufferSpace (int numboxes)
 {
-	D3D11_MAPPED_SUBRESOURCE MappedResource;
-	D3D11_MAP MapType = D3D11_MAP_WRITE_NO_OVERWRITE;
-
+	// draw what we have if this won't fit so that the map can wrap around
 	if (QINSTANCE::MapOffset + CACHE_ALIGN ((d3d_BBoxState.NumBBoxes + numboxes) * sizeof (bboxinstance_t)) >= QINSTANCE::BufferMax)
-	{
 		D3DBBoxes_DrawBatch ();
-		MapType = D3D11_MAP_WRITE_DISCARD;
-		QINSTANCE::MapOffset = 0;
-	}
 
 	if (!d3d_BBoxState.BBoxInstances)
 	{
-		if (FAILED (d3d11_Context->Map (QINSTANCE::VertexBuffer, 0, MapType, 0, &MappedResource)))
+		if ((d3d_BBoxState.BBoxInstances = (bboxinstance_t *) QINSTANCE::Map (numboxes * sizeof (bboxinstance_t))) == NULL)
 			return false;
-		else d3d_BBoxState.BBoxInstances = (bboxinstance_t *) (&((byte *) MappedResource.pData)[QINSTANCE::MapOffset]);
 	}
 
 	return true;
@@ -897,6 +930,7 @@ void D3DBrush_Init (void);
 void D3DLight_BuildAllLightmaps (void);
 void Host_ResetTimers (void);
 void D3DSurf_BuildWorldCache (void);
+void R_ClearEfrags (void);
 void ClearAllStates (void);
 void V_NewMap (void);
 
@@ -911,9 +945,8 @@ void R_NewMap (void)
 	d3d_RenderDef.framecount = 1;
 	d3d_RenderDef.visframecount = 0;
 
-	// clear out efrags (one short???)
-	for (int i = 0; i < cl.worldmodel->brushhdr->numleafs; i++)
-		cl.worldmodel->brushhdr->leafs[i].efrags = NULL;
+	// clear out efrags
+	R_ClearEfrags ();
 
 	// world entity baseline
 	memset (&d3d_RenderDef.worldentity, 0, sizeof (entity_t));
@@ -117,6 +117,7 @@ byte	*mod_novis;
 
 model_t	**mod_known = NULL;
 int		mod_numknown = 0;
+QNAMEHASH	mod_knownhash;
 
 
 /*
@@ -377,6 +378,7 @@ void Mod_ClearAll (void)
 	// the models array never went down, so if over MAX_MOD_KNOWN unique models get loaded it's crash time.
 	// very unlikely to happen, but it was there all the same...
 	mod_numknown = 0;
+	mod_knownhash.Clear ();
 }
 
 /*
@@ -396,20 +398,18 @@ model_t *Mod_FindName (char *name)
 	}
 
 	// search the currently loaded models
-	for (i = 0; i < mod_numknown; i++)
-		if (!strcmp (mod_known[i]->name, name))
-			break;
-
-	if (i == mod_numknown)
+	if ((i = mod_knownhash.Find (name)) < 0)
 	{
 		if (mod_numknown == MAX_MOD_KNOWN)
 			Host_Error ("mod_numknown == MAX_MOD_KNOWN");
 
 		// allocate a model
+		i = mod_numknown;
 		mod_known[i] = (model_t *) MainHunk->Alloc (sizeof (model_t));
 
 		Q_strncpy (mod_known[i]->name, name, 63);
 		mod_known[i]->needload = true;
+		mod_knownhash.Insert (mod_known[i]->name, i);
 		mod_numknown++;
 	}
 
@@ -426,6 +426,214 @@ Mod_TouchModel
 void Mod_TouchModel (char *name) {Mod_FindName (name);}
 
 
+/*
+===============================================================================
+
+MODEL CACHE
+
+===============================================================================
+*/
+
+cvar_t mod_cache ("mod_cache", "1", CVAR_ARCHIVE);
+
+#define MOD_CACHE_IDENT		(('C' << 24) + ('D' << 16) + ('O' << 8) + 'M')
+#define MOD_CACHE_VERSION	1
+
+struct modcacheheader_t
+{
+	int ident;
+	int version;
+	unsigned int crc;
+	int srclength;
+	unsigned int params;
+	int datasize;
+};
+
+int QMODELCACHE::NumHits = 0;
+modloadinfo_t mod_LoadInfo;
+
+
+QMODELCACHE::QMODELCACHE (char *name, char *ext, unsigned int crc, int srclength, unsigned int params)
+{
+	char cachename[MAX_QPATH];
+
+	// flatten the name so that we don't need to create a directory tree
+	Q_strncpy (cachename, name, MAX_QPATH - 1);
+
+	for (int i = 0; cachename[i]; i++)
+		if (cachename[i] == '/' || cachename[i] == '\\')
+			cachename[i] = '_';
+
+	Q_snprintf (this->Path, MAX_PATH, "%s/cache/models/%s.%s", com_gamedir, cachename, ext);
+
+	this->CRC = crc;
+	this->Params = params;
+	this->SrcLength = srclength;
+
+	this->hFile = INVALID_HANDLE_VALUE;
+	this->hMapping = NULL;
+	this->Base = NULL;
+	this->DataSize = 0;
+	this->ReadPos = 0;
+	this->WriteSize = 0;
+}
+
+
+QMODELCACHE::~QMODELCACHE (void)
+{
+	this->Close ();
+}
+
+
+bool QMODELCACHE::Open (void)
+{
+	if (!mod_cache.integer) return false;
+
+	if ((this->hFile = CreateFile (this->Path, FILE_READ_DATA, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD filesize = GetFileSize (this->hFile, NULL);
+
+	if (filesize > sizeof (modcacheheader_t) && (this->hMapping = CreateFileMapping (this->hFile, NULL, PAGE_READONLY, 0, 0, NULL)) != NULL)
+		this->Base = (byte *) MapViewOfFile (this->hMapping, FILE_MAP_READ, 0, 0, 0);
+
+	modcacheheader_t *header = (modcacheheader_t *) this->Base;
+
+	// a stale or mismatched entry is just ignored and will be overwritten when the model is processed
+	if (header &&
+		header->ident == MOD_CACHE_IDENT &&
+		header->version == MOD_CACHE_VERSION &&
+		header->crc == this->CRC &&
+		header->srclength == this->SrcLength &&
+		header->params == this->Params &&
+		header->datasize + sizeof (modcacheheader_t) == filesize)
+	{
+		this->DataSize = header->datasize;
+		this->ReadPos = sizeof (modcacheheader_t);
+
+		return true;
+	}
+
+	this->Close ();
+	return false;
+}
+
+
+void *QMODELCACHE::Read (int len)
+{
+	if (!this->Base) return NULL;
+
+	// running off the end means the entry doesn't match what the loader expects so nothing more is read from it
+	if (len < 0 || this->ReadPos + len > this->DataSize + (int) sizeof (modcacheheader_t))
+	{
+		this->Close ();
+		return NULL;
+	}
+
+	void *data = this->Base + this->ReadPos;
+
+	// keep lumps 4-byte aligned
+	this->ReadPos += (len + 3) & ~3;
+
+	return data;
+}
+
+
+void QMODELCACHE::Create (void)
+{
+	if (!mod_cache.integer) return;
+
+	// can't write over a mapped entry
+	this->Close ();
+
+	Sys_mkdir ("cache/models");
+
+	this->Out.open (this->Path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if (!this->Out.is_open ()) return;
+
+	// the header is written blank and filled in on close so that an interrupted write never looks valid
+	modcacheheader_t header;
+
+	memset (&header, 0, sizeof (header));
+	this->Out.write ((char *) &header, sizeof (header));
+	this->WriteSize = 0;
+}
+
+
+void QMODELCACHE::Write (void *data, int len)
+{
+	static byte pad[4] = {0, 0, 0, 0};
+
+	if (!this->Out.is_open ()) return;
+
+	this->Out.write ((char *) data, len);
+	this->WriteSize += len;
+
+	// keep lumps 4-byte aligned
+	if (len & 3)
+	{
+		this->Out.write ((char *) pad, 4 - (len & 3));
+		this->WriteSize += 4 - (len & 3);
+	}
+}
+
+
+void QMODELCACHE::Abort (void)
+{
+	if (!this->Out.is_open ()) return;
+
+	// remove whatever was partially written
+	this->Out.close ();
+	DeleteFile (this->Path);
+}
+
+
+void QMODELCACHE::Close (void)
+{
+	if (this->Out.is_open ())
+	{
+		if (this->Out.fail ())
+			this->Abort ();
+		else
+		{
+			modcacheheader_t header;
+
+			header.ident = MOD_CACHE_IDENT;
+			header.version = MOD_CACHE_VERSION;
+			header.crc = this->CRC;
+			header.srclength = this->SrcLength;
+			header.params = this->Params;
+			header.datasize = this->WriteSize;
+
+			this->Out.seekp (0);
+			this->Out.write ((char *) &header, sizeof (header));
+			this->Out.close ();
+		}
+	}
+
+	if (this->Base) UnmapViewOfFile (this->Base);
+	if (this->hMapping) CloseHandle (this->hMapping);
+	if (this->hFile != INVALID_HANDLE_VALUE) CloseHandle (this->hFile);
+
+	this->hFile = INVALID_HANDLE_VALUE;
+	this->hMapping = NULL;
+	this->Base = NULL;
+	this->DataSize = 0;
+	this->ReadPos = 0;
+}
+
+
+void Mod_CacheStats_f (void)
+{
+	Con_Printf ("%i models loaded cold in %0.1f ms\n", mod_LoadInfo.numcold, mod_LoadInfo.coldtime * 1000.0);
+	Con_Printf ("%i models loaded warm in %0.1f ms\n", mod_LoadInfo.numwarm, mod_LoadInfo.warmtime * 1000.0);
+}
+
+
+cmd_t Mod_CacheStats_Cmd ("modcache_stats", Mod_CacheStats_f);
+
+
 /*
 ==================
 Mod_LoadModel
@@ -447,6 +655,8 @@ model_t *Mod_LoadModel (model_t *mod, bool crash)
 	// we're going to be loading and using a lot of temp data with each model, so take a temp hunk pointer for it
 	int hunkmark = TempHunk->GetLowMark ();
 	unsigned *buf =  NULL;
+	double loadstart = Sys_ProfileTime ();
+	int cachehits = QMODELCACHE::NumHits;
 
 	// load the file
 	if (!(buf = (unsigned *) CQuakeFile::LoadFile (mod->name, TempHunk)))
@@ -456,6 +666,10 @@ model_t *Mod_LoadModel (model_t *mod, bool crash)
 		return NULL;
 	}
 
+	// key for the model cache
+	mod_LoadInfo.srclength = CQuakeFile::FileSize;
+	mod_LoadInfo.crc = CRC_Block32 ((byte *) buf, mod_LoadInfo.srclength);
+
 	// call the apropriate loader
 	mod->needload = false;
 
@@ -508,6 +722,22 @@ model_t *Mod_LoadModel (model_t *mod, bool crash)
 	// and throw away the temp data
 	TempHunk->FreeToLowMark (hunkmark);
 
+	// warm if anything at all came from the cache
+	double loadtime = Sys_ProfileTime () - loadstart;
+
+	if (QMODELCACHE::NumHits > cachehits)
+	{
+		Con_DPrintf ("%s loaded warm in %0.2f ms\n", mod->name, (float) (loadtime * 1000.0));
+		mod_LoadInfo.numwarm++;
+		mod_LoadInfo.warmtime += loadtime;
+	}
+	else
+	{
+		Con_DPrintf ("%s loaded cold in %0.2f ms\n", mod->name, (float) (loadtime * 1000.0));
+		mod_LoadInfo.numcold++;
+		mod_LoadInfo.coldtime += loadtime;
+	}
+
 	mod->RegistrationSequence = d3d_RenderDef.RegistrationSequence;
 	return mod;
 }
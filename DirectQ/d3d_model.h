@@ -31,6 +31,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define AM_IQM				32
 #define AM_FLAME			64
 #define AM_INSTANCED		128
+#define AM_ORDERED			256
 
 /*
 
@@ -99,6 +100,10 @@ struct texture_t
 	// for indexed drawing
 	int firstindex;
 	int numindexes;
+
+	// range of surfs in the static index stream (world textures only)
+	int firststatic;
+	int numstatic;
 };
 
 
@@ -139,6 +144,9 @@ struct msurface_t
 	// allocated on hunk during world building
 	void *indexes;
 
+	// position in the static index stream; only valid if the surf's texture has a static range
+	int staticnum;
+
 	mtexinfo_t	*texinfo;
 
 	int			LightmapTextureNum;
@@ -330,6 +338,27 @@ struct aliasbbox_t
 };
 
 
+// what the model cache holds for an MDL; the info is followed by the per-frame bboxes and the vertex/index buffer contents
+struct aliascacheinfo_t
+{
+	int nummeshframes;
+	int nummesh;
+	int numindexes;
+	float midpoint[3];
+};
+
+// an MDL as read back from the model cache; these point into the file mapping so are only valid while it's open
+struct aliascache_t
+{
+	aliascacheinfo_t *info;
+	aliasbbox_t *bboxes;
+	void *positions;
+	void *texcoords;
+	void *blends;
+	unsigned short *indexes;
+};
+
+
 // temp struct for loading stuff
 struct aliasload_t
 {
@@ -341,6 +370,9 @@ struct aliasload_t
 	// generated by the mesh compression/optimization code
 	aliasmesh_t *mesh;
 	unsigned short *indexes;
+
+	// set when the frame vertexes aren't needed because everything derived from them is in the model cache
+	aliascache_t *cached;
 };
 
 
@@ -433,6 +465,9 @@ struct brushhdr_t
 	int			numsurfaces;
 	msurface_t	*surfaces;
 
+	// surface bounds again as mins x/y/z and maxs x/y/z arrays so that they can be culled 4 at a time
+	float		*surfbounds[6];
+
 	int			numclipnodes;
 	mclipnode_t	*clipnodes;
 
@@ -522,6 +557,7 @@ void	Mod_TouchModel (char *name);
 
 extern model_t	**mod_known;
 extern int mod_numknown;
+extern QNAMEHASH mod_knownhash;
 
 mleaf_t *Mod_PointInLeaf (float *p, model_t *model);
 void Mod_SphereFromBounds (float *mins, float *maxs, float *sphere);
@@ -531,4 +567,58 @@ byte *Mod_FatPVS (vec3_t org);
 // handles frame and skin group auto-animations
 int Mod_AnimateGroup (entity_t *ent, float *intervals, int numintervals);
 
+// on-disk cache of post-processed model data in cache/models; an entry is keyed by a checksum of the source file plus
+// a checksum of any load-time settings baked into it, and is read straight out of a file mapping.  lumps are read back
+// in the order they were written and a stale or damaged entry just reports a miss and gets rewritten.  the loader
+// calls Hit once it has checked and used what it read so that only entries that were really used count as warm.
+class QMODELCACHE
+{
+public:
+	QMODELCACHE (char *name, char *ext, unsigned int crc, int srclength, unsigned int params = 0);
+	~QMODELCACHE (void);
+
+	bool Open (void);
+	void *Read (int len);
+	bool Reading (void) {return (this->Base != NULL);}
+	void Hit (void) {if (this->Base) QMODELCACHE::NumHits++;}
+
+	void Create (void);
+	void Write (void *data, int len);
+	void Abort (void);
+	void Close (void);
+
+	static int NumHits;
+
+private:
+	char Path[MAX_PATH];
+	unsigned int CRC;
+	unsigned int Params;
+	int SrcLength;
+
+	// read side
+	HANDLE hFile;
+	HANDLE hMapping;
+	byte *Base;
+	int DataSize;
+	int ReadPos;
+
+	// write side
+	std::ofstream Out;
+	int WriteSize;
+};
+
+// the checksum and length of the file Mod_LoadModel is currently loading, for use as cache keys
+struct modloadinfo_t
+{
+	unsigned int crc;
+	int srclength;
+
+	int numcold;
+	int numwarm;
+	double coldtime;
+	double warmtime;
+};
+
+extern modloadinfo_t mod_LoadInfo;
+
 #endif	// __MODEL__
@@ -0,0 +1,570 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org/>
+*/
+
+#include "quakedef.h"
+#include "d3d_model.h"
+#include "d3d_quake.h"
+
+#include <xmmintrin.h>
+
+// software occlusion culling.  the biggest world faces are picked out at load time and each frame the nearest of those
+// that are in the pvs get rasterized into a small depth buffer on the CPU, which is then reduced to a pyramid where each
+// texel holds the farthest depth of the 4 below it.  node, leaf and entity bounds are tested against the pyramid level
+// where they only cover a few texels.
+//
+// depth is stored as 1/w so that it interpolates linearly across the screen and doesn't depend on the far clipping
+// distance (which isn't known until the world has been built); bigger is nearer and 0 means nothing was drawn there.
+
+void R_ForceRecache (cvar_t *var);
+
+cvar_t r_occlusion ("r_occlusion", 0.0f, CVAR_ARCHIVE, R_ForceRecache);
+cvar_t r_occluders ("r_occluders", 64.0f, CVAR_ARCHIVE);
+
+extern cvar_t r_lockfrustum;
+
+#define OCC_WIDTH		256
+#define OCC_HEIGHT		128
+#define OCC_LEVELS		8			// 256x128 down to 2x1
+#define OCC_NEARW		4.0f		// the same as the real near clipping plane
+#define OCC_MINAREA		4096.0f		// a 64x64 face
+#define OCC_MAXVERTS	64
+#define OCC_TESTSIZE	4			// boxes are tested on the level where they span fewer texels than this
+
+struct occluder_t
+{
+	msurface_t *surf;
+	mnode_t *node;
+	float *verts;
+	int numverts;
+	float area;
+};
+
+struct occludersort_t
+{
+	float score;
+	occluder_t *occ;
+};
+
+// chosen at load time
+static occluder_t *d3d_Occluders = NULL;
+static occludersort_t *d3d_OccluderSort = NULL;
+static int d3d_NumOccluders = 0;
+
+// every level of the pyramid packs into here; level offsets are all multiples of 4 so each row of 4 or more texels is aligned
+static __declspec (align (16)) float d3d_OcclusionBuffer[(OCC_WIDTH * OCC_HEIGHT * 4) / 3 + 16];
+static float *d3d_OcclusionLevels[OCC_LEVELS];
+
+// the matrix the buffer was drawn with; boxes are tested with the same one
+static QMATRIX d3d_OcclusionMVP;
+
+// set when the buffer is valid for the current frame
+static bool d3d_OcclusionActive = false;
+
+// set if the occluders couldn't be picked because the nodes weren't marked for the pvs; reported from the main thread
+static bool d3d_OcclusionNoPVS = false;
+static bool d3d_OcclusionNoPVSWarned = false;
+
+// for r_speeds
+volatile LONG d3d_OccludedBoxes = 0;
+int d3d_OccludersDrawn = 0;
+
+
+void D3DOcclusion_ClearOccluders (void)
+{
+	// these were on the hunk which is about to go away
+	d3d_Occluders = NULL;
+	d3d_OccluderSort = NULL;
+	d3d_NumOccluders = 0;
+	d3d_OcclusionActive = false;
+}
+
+
+float D3DOcclusion_PolygonArea (byte *xyz, int stride, msurface_t *surf)
+{
+	float *v0 = (float *) (xyz + surf->firstvertex * stride);
+	float normal[3] = {0, 0, 0};
+
+	for (int i = 2; i < surf->numvertexes; i++)
+	{
+		float *v1 = (float *) (xyz + (surf->firstvertex + i - 1) * stride);
+		float *v2 = (float *) (xyz + (surf->firstvertex + i) * stride);
+		float e1[3], e2[3], cross[3];
+
+		Vector3Subtract (e1, v1, v0);
+		Vector3Subtract (e2, v2, v0);
+		Vector3Cross (cross, e1, e2);
+		Vector3Add (normal, normal, cross);
+	}
+
+	return Vector3Length (normal) * 0.5f;
+}
+
+
+bool D3DOcclusion_IsOccluder (msurface_t *surf)
+{
+	// these either have holes, are see-through or are drawn at infinity
+	if (surf->flags & (SURF_DRAWSKY | SURF_DRAWTURB | SURF_DRAWFENCE)) return false;
+	if (surf->numvertexes < 3 || surf->numvertexes > OCC_MAXVERTS) return false;
+
+	return true;
+}
+
+
+void D3DOcclusion_BuildOccluders (brushhdr_t *hdr, byte *xyz, int stride)
+{
+	// xyz is the world's vertex data as it's being built, with surf->firstvertex indexing it in steps of stride bytes
+	int numverts = 0;
+	float *verts = NULL;
+
+	d3d_NumOccluders = 0;
+
+	// the first pass counts and the second fills in
+	for (int pass = 0; pass < 2; pass++)
+	{
+		if (pass)
+		{
+			if (!d3d_NumOccluders) break;
+
+			d3d_Occluders = (occluder_t *) MainHunk->Alloc (d3d_NumOccluders * sizeof (occluder_t));
+			d3d_OccluderSort = (occludersort_t *) MainHunk->Alloc (d3d_NumOccluders * sizeof (occludersort_t));
+			verts = (float *) MainHunk->Alloc (numverts * 3 * sizeof (float));
+
+			d3d_NumOccluders = 0;
+		}
+
+		// surfs are taken from the nodes so that each one knows which node it belongs to for the pvs test
+		for (int i = 0; i < hdr->numnodes; i++)
+		{
+			mnode_t *node = &hdr->nodes[i];
+			msurface_t *surf = node->surfaces;
+
+			for (int j = 0; j < node->numsurfaces; j++, surf++)
+			{
+				if (!D3DOcclusion_IsOccluder (surf)) continue;
+
+				float area = D3DOcclusion_PolygonArea (xyz, stride, surf);
+
+				if (area < OCC_MINAREA) continue;
+
+				if (pass)
+				{
+					occluder_t *occ = &d3d_Occluders[d3d_NumOccluders];
+
+					occ->surf = surf;
+					occ->node = node;
+					occ->verts = verts;
+					occ->numverts = surf->numvertexes;
+					occ->area = area;
+
+					for (int v = 0; v < surf->numvertexes; v++, verts += 3)
+						Vector3Copy (verts, (float *) (xyz + (surf->firstvertex + v) * stride));
+				}
+				else numverts += surf->numvertexes;
+
+				d3d_NumOccluders++;
+			}
+		}
+	}
+
+	// set up the pyramid levels
+	float *level = d3d_OcclusionBuffer;
+
+	for (int i = 0; i < OCC_LEVELS; i++)
+	{
+		d3d_OcclusionLevels[i] = level;
+		level += ((OCC_WIDTH >> i) * (OCC_HEIGHT >> i) + 3) & ~3;
+	}
+
+	d3d_OcclusionActive = false;
+}
+
+
+static void D3DOcclusion_Project (float *out, const float *in)
+{
+	// x, y and w in clip space; z isn't needed
+	QMATRIX *m = &d3d_OcclusionMVP;
+
+	out[0] = in[0] * m->_11 + in[1] * m->_21 + in[2] * m->_31 + m->_41;
+	out[1] = in[0] * m->_12 + in[1] * m->_22 + in[2] * m->_32 + m->_42;
+	out[2] = in[0] * m->_14 + in[1] * m->_24 + in[2] * m->_34 + m->_44;
+}
+
+
+static void D3DOcclusion_ToScreen (float *out, const float *clip)
+{
+	// only valid when w is in front of the near plane
+	float rw = 1.0f / clip[2];
+
+	out[0] = (clip[0] * rw * 0.5f + 0.5f) * (float) OCC_WIDTH;
+	out[1] = (0.5f - clip[1] * rw * 0.5f) * (float) OCC_HEIGHT;
+	out[2] = rw;
+}
+
+
+static void D3DOcclusion_Edge (const float *p, const float *q, float *edge)
+{
+	// a * x + b * y + c is positive on the inside of a triangle with positive area
+	edge[0] = p[1] - q[1];
+	edge[1] = q[0] - p[0];
+	edge[2] = p[0] * q[1] - p[1] * q[0];
+}
+
+
+static void D3DOcclusion_RasterTriangle (float *v0, float *v1, float *v2)
+{
+	// each v is screen x, screen y, 1/w
+	float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+
+	// wind consistently so that inside is positive on every edge
+	if (area < 0)
+	{
+		float *tmp = v1;
+		v1 = v2;
+		v2 = tmp;
+		area = -area;
+	}
+
+	// can't fully cover a pixel
+	if (area < 1.0f) return;
+
+	int xmin = (int) floor (min3 (v0[0], v1[0], v2[0]));
+	int xmax = (int) ceil (max3 (v0[0], v1[0], v2[0]));
+	int ymin = (int) floor (min3 (v0[1], v1[1], v2[1]));
+	int ymax = (int) ceil (max3 (v0[1], v1[1], v2[1]));
+
+	if (xmin < 0) xmin = 0;
+	if (ymin < 0) ymin = 0;
+	if (xmax > OCC_WIDTH - 1) xmax = OCC_WIDTH - 1;
+	if (ymax > OCC_HEIGHT - 1) ymax = OCC_HEIGHT - 1;
+
+	if (xmin > xmax || ymin > ymax) return;
+
+	// each edge is weighted by the vertex opposite it
+	float e[3][3];
+
+	D3DOcclusion_Edge (v1, v2, e[0]);
+	D3DOcclusion_Edge (v2, v0, e[1]);
+	D3DOcclusion_Edge (v0, v1, e[2]);
+
+	// 1/w is a plane in screen space
+	float rarea = 1.0f / area;
+	float dzdx = (e[0][0] * v0[2] + e[1][0] * v1[2] + e[2][0] * v2[2]) * rarea;
+	float dzdy = (e[0][1] * v0[2] + e[1][1] * v1[2] + e[2][1] * v2[2]) * rarea;
+	float z0 = (e[0][2] * v0[2] + e[1][2] * v1[2] + e[2][2] * v2[2]) * rarea;
+
+	// a pixel is only written if the triangle covers all of it, and then with the farthest depth in it, so that an occluder
+	// never hides more than it really does.  both come from evaluating at the pixel centre and pulling in by half a pixel.
+	z0 -= 0.5f * (fabs (dzdx) + fabs (dzdy));
+
+	__m128 a0 = _mm_set1_ps (e[0][0]);
+	__m128 a1 = _mm_set1_ps (e[1][0]);
+	__m128 a2 = _mm_set1_ps (e[2][0]);
+	__m128 t0 = _mm_set1_ps (0.5f * (fabs (e[0][0]) + fabs (e[0][1])));
+	__m128 t1 = _mm_set1_ps (0.5f * (fabs (e[1][0]) + fabs (e[1][1])));
+	__m128 t2 = _mm_set1_ps (0.5f * (fabs (e[2][0]) + fabs (e[2][1])));
+	__m128 dzdx4 = _mm_set1_ps (dzdx);
+	__m128 xoffs = _mm_set_ps (3.5f, 2.5f, 1.5f, 0.5f);
+
+	// 4 pixels at a time from an aligned start; the edge tests reject anything outside the triangle
+	int xstart = xmin & ~3;
+
+	for (int y = ymin; y <= ymax; y++)
+	{
+		float py = (float) y + 0.5f;
+		float *row = &d3d_OcclusionLevels[0][y * OCC_WIDTH];
+
+		__m128 e0row = _mm_set1_ps (e[0][1] * py + e[0][2]);
+		__m128 e1row = _mm_set1_ps (e[1][1] * py + e[1][2]);
+		__m128 e2row = _mm_set1_ps (e[2][1] * py + e[2][2]);
+		__m128 zrow = _mm_set1_ps (dzdy * py + z0);
+
+		for (int x = xstart; x <= xmax; x += 4)
+		{
+			__m128 px = _mm_add_ps (_mm_set1_ps ((float) x), xoffs);
+
+			__m128 inside = _mm_and_ps (
+				_mm_and_ps (
+					_mm_cmpge_ps (_mm_add_ps (_mm_mul_ps (a0, px), e0row), t0),
+					_mm_cmpge_ps (_mm_add_ps (_mm_mul_ps (a1, px), e1row), t1)
+				),
+				_mm_cmpge_ps (_mm_add_ps (_mm_mul_ps (a2, px), e2row), t2)
+			);
+
+			if (!_mm_movemask_ps (inside)) continue;
+
+			// keep the nearest in the covered pixels
+			__m128 depth = _mm_load_ps (&row[x]);
+			__m128 z = _mm_max_ps (depth, _mm_add_ps (_mm_mul_ps (dzdx4, px), zrow));
+
+			_mm_store_ps (&row[x], _mm_or_ps (_mm_and_ps (inside, z), _mm_andnot_ps (inside, depth)));
+		}
+	}
+}
+
+
+static void D3DOcclusion_RasterOccluder (occluder_t *occ)
+{
+	// clipping a convex polygon against one plane adds at most one vertex
+	float clip[OCC_MAXVERTS][3];
+	float screen[OCC_MAXVERTS + 1][3];
+	int numscreen = 0;
+
+	for (int i = 0; i < occ->numverts; i++)
+		D3DOcclusion_Project (clip[i], &occ->verts[i * 3]);
+
+	// clip to the near plane so that everything left can be divided by w
+	for (int i = 0; i < occ->numverts; i++)
+	{
+		float *p = clip[i];
+		float *q = clip[(i + 1) % occ->numverts];
+		bool pin = (p[2] >= OCC_NEARW);
+		bool qin = (q[2] >= OCC_NEARW);
+
+		if (pin) D3DOcclusion_ToScreen (screen[numscreen++], p);
+
+		if (pin != qin)
+		{
+			float f = (OCC_NEARW - p[2]) / (q[2] - p[2]);
+			float mid[3] = {p[0] + (q[0] - p[0]) * f, p[1] + (q[1] - p[1]) * f, OCC_NEARW};
+
+			D3DOcclusion_ToScreen (screen[numscreen++], mid);
+		}
+	}
+
+	if (numscreen < 3) return;
+
+	for (int i = 2; i < numscreen; i++)
+		D3DOcclusion_RasterTriangle (screen[0], screen[i - 1], screen[i]);
+
+	d3d_OccludersDrawn++;
+}
+
+
+static void D3DOcclusion_BuildPyramid (void)
+{
+	int w = OCC_WIDTH;
+	int h = OCC_HEIGHT;
+
+	for (int l = 1; l < OCC_LEVELS; l++, w >>= 1, h >>= 1)
+	{
+		float *src = d3d_OcclusionLevels[l - 1];
+		float *dst = d3d_OcclusionLevels[l];
+		int dw = w >> 1;
+		int dh = h >> 1;
+
+		for (int y = 0; y < dh; y++)
+		{
+			float *r0 = &src[(y * 2) * w];
+			float *r1 = r0 + w;
+			float *out = &dst[y * dw];
+			int x = 0;
+
+			// 4 out from 8 in on each of the two rows; min down the columns then across the pairs
+			for (; x + 4 <= dw; x += 4)
+			{
+				__m128 lo = _mm_min_ps (_mm_load_ps (&r0[x * 2]), _mm_load_ps (&r1[x * 2]));
+				__m128 hi = _mm_min_ps (_mm_load_ps (&r0[x * 2 + 4]), _mm_load_ps (&r1[x * 2 + 4]));
+
+				_mm_store_ps (&out[x], _mm_min_ps (_mm_shuffle_ps (lo, hi, _MM_SHUFFLE (2, 0, 2, 0)), _mm_shuffle_ps (lo, hi, _MM_SHUFFLE (3, 1, 3, 1))));
+			}
+
+			// the last few levels are too narrow
+			for (; x < dw; x++)
+				out[x] = min2 (min2 (r0[x * 2], r0[x * 2 + 1]), min2 (r1[x * 2], r1[x * 2 + 1]));
+		}
+	}
+}
+
+
+int D3DOcclusion_SortFunc (occludersort_t *o1, occludersort_t *o2)
+{
+	// biggest on screen first
+	if (o1->score > o2->score) return -1;
+	if (o1->score < o2->score) return 1;
+	return 0;
+}
+
+
+void D3DOcclusion_RenderOccluders (void)
+{
+	// this runs as a job after the pvs is marked and before anything that tests against it
+	d3d_OcclusionActive = false;
+	d3d_OcclusionNoPVS = false;
+	d3d_OccludedBoxes = 0;
+	d3d_OccludersDrawn = 0;
+
+	if (!r_occlusion.integer) return;
+	if (!d3d_NumOccluders) return;
+
+	// the frustum is frozen but the view isn't
+	if (r_lockfrustum.integer) return;
+
+	// every visible leaf marks its way up to the root so if that isn't marked no occluder can pass the pvs test below
+	d3d_OcclusionNoPVS = (cl.worldmodel->brushhdr->nodes->visframe != d3d_RenderDef.visframecount);
+
+	if (d3d_OcclusionNoPVS) return;
+
+	int numcandidates = 0;
+	int maxoccluders = (r_occluders.integer > 1) ? r_occluders.integer : 1;
+
+	for (int i = 0; i < d3d_NumOccluders; i++)
+	{
+		occluder_t *occ = &d3d_Occluders[i];
+		msurface_t *surf = occ->surf;
+
+		// must be in the pvs
+		if (occ->node->visframe != d3d_RenderDef.visframecount) continue;
+
+		// and facing the view
+		float dot = Mod_PlaneDist (surf->plane, r_refdef.vieworigin);
+
+		if (surf->flags & SURF_PLANEBACK)
+		{
+			if (dot > -1.0f) continue;
+		}
+		else if (dot < 1.0f) continue;
+
+		// bigger and nearer hides more
+		float mid[3], dist[3];
+
+		Vector3Lerp (mid, surf->cullinfo.mins, surf->cullinfo.maxs, 0.5f);
+		Vector3Subtract (dist, mid, r_refdef.vieworigin);
+
+		d3d_OccluderSort[numcandidates].score = occ->area / (Vector3Dot (dist, dist) + 1.0f);
+		d3d_OccluderSort[numcandidates].occ = occ;
+		numcandidates++;
+	}
+
+	if (!numcandidates) return;
+
+	if (numcandidates > maxoccluders)
+	{
+		qsort (d3d_OccluderSort, numcandidates, sizeof (occludersort_t), (sortfunc_t) D3DOcclusion_SortFunc);
+		numcandidates = maxoccluders;
+	}
+
+	d3d_OcclusionMVP.Load (&d3d_ModelViewProjMatrix);
+	memset (d3d_OcclusionLevels[0], 0, OCC_WIDTH * OCC_HEIGHT * sizeof (float));
+
+	for (int i = 0; i < numcandidates; i++)
+		D3DOcclusion_RasterOccluder (d3d_OccluderSort[i].occ);
+
+	D3DOcclusion_BuildPyramid ();
+	d3d_OcclusionActive = true;
+}
+
+
+bool D3DOcclusion_IsActive (void)
+{
+	// the job that draws the occluders can't use the console
+	if (d3d_OcclusionNoPVS && !d3d_OcclusionNoPVSWarned)
+	{
+		Con_Printf ("r_occlusion : the pvs nodes weren't marked so no occluders were drawn\n");
+		d3d_OcclusionNoPVSWarned = true;
+	}
+
+	return d3d_OcclusionActive;
+}
+
+
+bool R_OccludeBox (cullinfo_t *ci)
+{
+	// a box is hidden if every texel it covers has an occluder nearer than the nearest point of the box
+	if (!d3d_OcclusionActive) return false;
+
+	float sxmin = 999999, symin = 999999;
+	float sxmax = -999999, symax = -999999;
+	float nearest = 0;
+
+	for (int i = 0; i < 8; i++)
+	{
+		float corner[3] =
+		{
+			(i & 1) ? ci->maxs[0] : ci->mins[0],
+			(i & 2) ? ci->maxs[1] : ci->mins[1],
+			(i & 4) ? ci->maxs[2] : ci->mins[2]
+		};
+
+		float clip[3], screen[3];
+
+		D3DOcclusion_Project (clip, corner);
+
+		// anything reaching the near plane is too close to be hidden
+		if (clip[2] < OCC_NEARW) return false;
+
+		D3DOcclusion_ToScreen (screen, clip);
+
+		// w is linear across the box so its nearest point is always a corner
+		if (screen[0] < sxmin) sxmin = screen[0];
+		if (screen[0] > sxmax) sxmax = screen[0];
+		if (screen[1] < symin) symin = screen[1];
+		if (screen[1] > symax) symax = screen[1];
+		if (screen[2] > nearest) nearest = screen[2];
+	}
+
+	// every pixel the box touches
+	int x0 = (int) floor (sxmin);
+	int x1 = (int) floor (sxmax);
+	int y0 = (int) floor (symin);
+	int y1 = (int) floor (symax);
+
+	if (x0 < 0) x0 = 0;
+	if (y0 < 0) y0 = 0;
+	if (x1 > OCC_WIDTH - 1) x1 = OCC_WIDTH - 1;
+	if (y1 > OCC_HEIGHT - 1) y1 = OCC_HEIGHT - 1;
+
+	// off screen is for the frustum to deal with
+	if (x0 > x1 || y0 > y1) return false;
+
+	// go up the pyramid until the box only covers a few texels
+	int level = 0;
+
+	while (level < OCC_LEVELS - 1 && (x1 - x0 >= OCC_TESTSIZE || y1 - y0 >= OCC_TESTSIZE))
+	{
+		x0 >>= 1;
+		x1 >>= 1;
+		y0 >>= 1;
+		y1 >>= 1;
+		level++;
+	}
+
+	float *depth = d3d_OcclusionLevels[level];
+	int w = OCC_WIDTH >> level;
+
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			// something at least as near as the box may be visible here
+			if (depth[y * w + x] <= nearest) return false;
+		}
+	}
+
+	// this may be called from any thread
+	InterlockedIncrement (&d3d_OccludedBoxes);
+	return true;
+}
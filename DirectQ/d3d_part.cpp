@@ -85,6 +85,10 @@ struct d3d_partstate_t
 {
 	partvert_t *Particles;
 	int NumParticles;
+
+	// where the batch starts in the instance buffer, and whether it was written up front with the rest of the alpha list
+	int FirstOffset;
+	bool Prewritten;
 };
 
 d3d_partstate_t d3d_PartState;
@@ -189,6 +193,7 @@ void D3DPart_CommonState (void)
 	d3d11_State->VSSetConstantBuffer (1, d3d_PartConstants);
 
 	d3d_PartState.NumParticles = 0;
+	d3d_PartState.Prewritten = false;
 }
 
 
@@ -215,19 +220,22 @@ void D3DPart_End (void)
 {
 	if (d3d_PartState.Particles)
 	{
-		d3d11_Context->Unmap (QINSTANCE::VertexBuffer, 0);
+		QINSTANCE::Unmap ();
 		d3d_PartState.Particles = NULL;
 	}
 
 	if (d3d_PartState.NumParticles)
 	{
 		d3d11_State->SuspendCallback ();
-		d3d11_State->IASetVertexBuffer (0, QINSTANCE::VertexBuffer, sizeof (partvert_t), QINSTANCE::MapOffset);
+		d3d11_State->IASetVertexBuffer (0, QINSTANCE::VertexBuffer, sizeof (partvert_t), d3d_PartState.FirstOffset);
 
 		D3DMisc_DrawInstancedCommon (4, d3d_PartState.NumParticles);
 
-		QINSTANCE::MapOffset += CACHE_ALIGN (d3d_PartState.NumParticles * sizeof (partvert_t));
+		// prewritten particles were already allowed for when they were written
+		if (!d3d_PartState.Prewritten) QINSTANCE::Advance (d3d_PartState.NumParticles * sizeof (partvert_t));
+
 		d3d_PartState.NumParticles = 0;
+		d3d_PartState.Prewritten = false;
 		d3d11_State->ResumeCallback ();
 	}
 }
@@ -235,40 +243,57 @@ void D3DPart_End (void)
 
 bool D3DPart_GetBufferSpace (int numparts)
 {
-	D3D11_MAPPED_SUBRESOURCE MappedResource;
-	D3D11_MAP MapType = D3D11_MAP_WRITE_NO_OVERWRITE;
-
+	// draw what we have if this won't fit so that the map can wrap around
 	if (QINSTANCE::MapOffset + CACHE_ALIGN ((d3d_PartState.NumParticles + numparts) * sizeof (partvert_t)) >= QINSTANCE::BufferMax)
-	{
 		D3DPart_End ();
-		MapType = D3D11_MAP_WRITE_DISCARD;
-		QINSTANCE::MapOffset = 0;
-	}
 
 	if (!d3d_PartState.Particles)
 	{
-		if (FAILED (d3d11_Context->Map (QINSTANCE::VertexBuffer, 0, MapType, 0, &MappedResource)))
+		if ((d3d_PartState.Particles = (partvert_t *) QINSTANCE::Map (numparts * sizeof (partvert_t))) == NULL)
 			return false;
-		else d3d_PartState.Particles = (partvert_t *) (&((byte *) MappedResource.pData)[QINSTANCE::MapOffset]);
+
+		d3d_PartState.FirstOffset = QINSTANCE::MapOffset;
 	}
 
 	return true;
 }
 
 
+byte *D3DPart_WriteEmitter (emitter_t *pe, byte *dest)
+{
+	// particles are contiguous in the emitter so they can go over in a single copy
+	Q_MemCpy (dest, pe->particles, pe->numparticles * sizeof (partvert_t));
+
+	return dest + pe->numparticles * sizeof (partvert_t);
+}
+
+
 void D3DPart_DrawEmitter (emitter_t *pe)
 {
-	if (D3DPart_GetBufferSpace (pe->numparticles))
+	double drawstart = Sys_ProfileTime ();
+
+	if (QINSTANCE::PrewriteOffset >= 0)
 	{
-		for (particle_t *p = pe->particles; p; p = p->next)
+		// the particles are already in the buffer following on from the previous emitter's
+		if (!d3d_PartState.NumParticles)
 		{
-			// prevent sneaky compiler shenanigans that could result in reading from mapped buffer memory
-			Q_MemCpy (d3d_PartState.Particles, &p->v, sizeof (partvert_t));
-			d3d_PartState.Particles++;
+			d3d_PartState.FirstOffset = QINSTANCE::PrewriteOffset;
+			d3d_PartState.Prewritten = true;
 		}
 
 		d3d_PartState.NumParticles += pe->numparticles;
+		QINSTANCE::PrewriteOffset += pe->numparticles * sizeof (partvert_t);
+	}
+	else if (D3DPart_GetBufferSpace (pe->numparticles))
+	{
+		// particles are contiguous in the emitter so they can go over in a single copy
+		Q_MemCpy (d3d_PartState.Particles, pe->particles, pe->numparticles * sizeof (partvert_t));
+
+		d3d_PartState.Particles += pe->numparticles;
+		d3d_PartState.NumParticles += pe->numparticles;
 	}
+
+	ParticleSystem.DrawTime += Sys_ProfileTime () - drawstart;
 }
 
 
@@ -90,17 +90,20 @@ public:
 
 
 // textures
+// number of chains in the loaded texture registry; must be a power of 2
+#define TEXTURE_REGISTRY_SIZE	4096
+
 class QTEXTURE
 {
 public:
 	QTEXTURE (void);
-	QTEXTURE (char *_identifier, int _width, int _height, int _flags, byte *_hash);
+	QTEXTURE (char *_identifier, int _width, int _height, int _flags, unsigned __int64 _hash);
 	~QTEXTURE (void);
 
 	void Release (void);
 	void SetObjectNames (void);
 	void SetObjectNames (char *texname, char *srvname);
-	bool MatchWith (char *_identifier, int _width, int _height, int _flags, byte *_hash);
+	bool MatchWith (char *_identifier, int _width, int _height, int _flags, unsigned __int64 _hash);
 	void SetUnused ();
 	void AddFlag (int flag);
 	void DelFlag (int flag);
@@ -139,7 +142,9 @@ public:
 	static unsigned int *ToRGBA (byte *data, int width, int height, unsigned int *palette);
 	bool CreateExternal (byte *data, int type, int flags);
 	bool LoadExternal (char *filename, char **paths, int flags);
-	bool TryLoadExternal (char **_paths);
+	bool LoadExternalFile (class CQuakeFile *f, char *filename, int type, int flags);
+	bool LoadCached (struct texcachekey_t *key);
+	bool TryLoadExternal (char **_paths, byte *_data);
 	bool TryLoadNative (byte *_data);
 	static QTEXTURE *Load (char *_identifier, int _width, int _height, byte *_data, int _flags, char **_paths = NULL);
 	static void Flush (void);
@@ -150,14 +155,23 @@ public:
 	static QTEXTURE BlackTexture;
 
 private:
-	void InitData (char *_identifier, int _width, int _height, int _flags, byte *_hash);
+	void InitData (char *_identifier, int _width, int _height, int _flags, unsigned __int64 _hash);
+	void LinkRegistry (void);
+	void UnlinkRegistry (void);
+	static int RegistryChain (char *_identifier, int _width, int _height, int _flags, unsigned __int64 _hash);
+
 	char identifier[64];
 	int width;
 	int height;
 	int flags;
-	byte hash[16];
+	unsigned __int64 hash;
 	int LastUsage;
 
+	// loaded textures are chained by identifier/size/luma/content so that Load can find a reusable one directly
+	static QTEXTURE *Registry[TEXTURE_REGISTRY_SIZE];
+	QTEXTURE *RegistryNext;
+	int RegistryIndex;
+
 	ID3D11Texture2D *Texture2D;
 	ID3D11ShaderResourceView *SRV;
 };
@@ -521,6 +535,15 @@ struct d3d_renderdef_t
 	int numnode;
 	int numleaf;
 	int numdlight;
+	int iqm_poses;
+	int iqm_posesshared;
+	int alias_draws;
+	int alias_uploadbytes;
+	int inst_maps;
+	int inst_bytes;
+
+	// accumulated scene extraction time (in seconds) for timedemo reporting
+	double scenetime;
 
 	bool rebuildworld;
 
@@ -541,10 +564,15 @@ extern d3d_renderdef_t d3d_RenderDef;
 
 void D3DAlpha_AddToList (entity_t *ent);
 void D3DAlpha_AddToList (struct emitter_t *particle);
+void D3DAlpha_SortList (void);
+void D3DAlpha_ClearList (void);
 void D3DAlpha_RenderList (void);
 void D3DAlpha_AddToList (msurface_t *surf, entity_t *ent, float *midpoint);
 
 bool R_CullBox (cullinfo_t *ci);
+bool R_OccludeBox (cullinfo_t *ci);
+int R_CullBoxes (cullinfo_t **boxes);
+int R_CullBoxesSoA (float **bounds, int first, cullinfo_t **boxes);
 bool R_CullSphere (float *center, float radius, int clipflags);
 int R_PlaneSide (cullinfo_t *ci, mplane_t *p);
 
@@ -572,17 +600,66 @@ public:
 
 
 extern QEDICTLIST d3d_AliasEdicts;
+extern QEDICTLIST d3d_AliasPending;
 extern QEDICTLIST d3d_BrushEdicts;
 extern QEDICTLIST d3d_MergeEdicts;
 extern QEDICTLIST d3d_IQMEdicts;
 
 
-// shared dynamic vertex buffer for all dynamic objects
+// the scene is extracted from the client state into these plain packets without touching the device; the D3D11
+// backend then submits them, and the null backend (r_nulldraw) just throws them away so that frame prep can be timed alone
+
+// when a packet's lightmaps are built
+#define PACKET_LIGHT_EXTRACT	0	// as its surfaces are extracted
+#define PACKET_LIGHT_DEFERRED	1	// by the lightmap job after extraction (the world, which has the most)
+#define PACKET_LIGHT_SUBMIT		2	// immediately before it's drawn (shared models need each entity's own dlights)
+
+struct d3d_surfpacket_t
+{
+	entity_t *ent;
+	msurface_t **surfs;
+	int numsurfs;
+	int lighting;
+};
+
+struct d3d_dirtyrect_t
+{
+	int lightmap;
+	int left, top, right, bottom;
+};
+
+struct d3d_scene_t
+{
+	// brush models first, then the world (with any merged bmodels) as the final packet
+	d3d_surfpacket_t *SurfPackets;
+	int NumSurfPackets;
+
+	// visible non-alpha IQMs (alias models are sorted in-place in d3d_AliasEdicts)
+	entity_t **IQMEdicts;
+	int NumIQMEdicts;
+
+	// modified lightmap regions to upload before anything is drawn
+	d3d_dirtyrect_t *DirtyRects;
+	int NumDirtyRects;
+};
+
+extern d3d_scene_t d3d_Scene;
+
+
+// shared dynamic vertex buffer for all dynamic objects; it's used as a ring with each batch suballocated from MapOffset
+// with no-overwrite, and wrapping around to the start with a discard when a batch doesn't fit in what's left
 struct QINSTANCE
 {
 	static ID3D11Buffer *VertexBuffer;
 	static int BufferMax;
 	static int MapOffset;
+
+	// the alpha list's particles and sprites are written up front; this is where the next one to be drawn is (or -1)
+	static int PrewriteOffset;
+
+	static void *Map (int size);
+	static void Unmap (void);
+	static void Advance (int size);
 };
 
 
@@ -1337,6 +1337,14 @@ void SHOWLMP_drawall (void);
 void D3DDraw_End2D (void);
 
 extern int r_speedstime;
+extern float r_scenetime;
+extern float r_submittime;
+extern float d3d_AlphaSortTime;
+extern float d3d_AlphaSubmitTime;
+extern volatile LONG d3d_OccludedBoxes;
+extern int d3d_OccludersDrawn;
+
+int D3DMain_GetPrepJobs (sysjob_t **jobs);
 
 
 void SCR_UpdateFPS (void)
@@ -1452,6 +1460,45 @@ void SCR_UpdateScreen (void)
 				Draw_String (vid.currsize.width - 100, 40, va ("%5i mdl", d3d_RenderDef.alias_polys));
 				Draw_String (vid.currsize.width - 100, 50, va ("%5i dlight", d3d_RenderDef.numdlight));
 				Draw_String (vid.currsize.width - 100, 60, va ("%5i draw", d3d_RenderDef.numdrawprim));
+
+				// time spent extracting the scene before anything was submitted
+				Draw_String (vid.currsize.width - 100, 70, va ("%5.2f prep", r_scenetime));
+
+				// and the CPU time spent submitting it
+				Draw_String (vid.currsize.width - 100, 80, va ("%5.2f submit", r_submittime));
+
+				// poses evaluated and poses reused by another entity
+				if (d3d_RenderDef.iqm_poses)
+				{
+					Draw_String (vid.currsize.width - 100, 90, va ("%5i pose", d3d_RenderDef.iqm_poses));
+					Draw_String (vid.currsize.width - 100, 100, va ("%5i shared", d3d_RenderDef.iqm_posesshared));
+				}
+
+				// r_speeds 2 breaks the prep time down by job
+				if (r_speeds.value > 1)
+				{
+					sysjob_t *jobs = NULL;
+					int numjobs = D3DMain_GetPrepJobs (&jobs);
+
+					for (int i = 0; i < numjobs; i++)
+						Draw_String (vid.currsize.width - 100, 110 + i * 10, va ("%5.2f %s", (float) (jobs[i].time * 1000.0), jobs[i].name));
+
+					// and the alpha list sort (which is part of the finish job) against its submission
+					Draw_String (vid.currsize.width - 100, 120 + numjobs * 10, va ("%5.2f asort", d3d_AlphaSortTime));
+					Draw_String (vid.currsize.width - 100, 130 + numjobs * 10, va ("%5.2f adraw", d3d_AlphaSubmitTime));
+
+					// alias model draw calls and the instance data that had to be re-uploaded for them
+					Draw_String (vid.currsize.width - 100, 140 + numjobs * 10, va ("%5i mdraw", d3d_RenderDef.alias_draws));
+					Draw_String (vid.currsize.width - 100, 150 + numjobs * 10, va ("%5i kbinst", d3d_RenderDef.alias_uploadbytes >> 10));
+
+					// occluders rasterized and boxes rejected against them
+					Draw_String (vid.currsize.width - 100, 160 + numjobs * 10, va ("%5i occdraw", d3d_OccludersDrawn));
+					Draw_String (vid.currsize.width - 100, 170 + numjobs * 10, va ("%5i occcull", (int) d3d_OccludedBoxes));
+
+					// maps of the shared instance buffer and the bytes written to it
+					Draw_String (vid.currsize.width - 100, 180 + numjobs * 10, va ("%5i imaps", d3d_RenderDef.inst_maps));
+					Draw_String (vid.currsize.width - 100, 190 + numjobs * 10, va ("%5i kbdyn", d3d_RenderDef.inst_bytes >> 10));
+				}
 			}
 
 			if (scr_showcoords.integer)
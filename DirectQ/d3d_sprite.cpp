@@ -38,6 +38,10 @@ struct d3d_spritestate_t
 	spriteinstance_t *SpriteQuads;
 	int NumSprites;
 	int LastFrame;
+
+	// where the batch starts in the instance buffer, and whether it was written up front with the rest of the alpha list
+	int FirstOffset;
+	bool Prewritten;
 };
 
 
@@ -372,6 +376,7 @@ void D3DSprite_Begin (void)
 	d3d_SpriteState.LastFrame = -1;
 	d3d_SpriteState.NumSprites = 0;
 	d3d_SpriteState.SpriteQuads = NULL;
+	d3d_SpriteState.Prewritten = false;
 }
 
 
@@ -379,25 +384,28 @@ void D3DSprite_End (void)
 {
 	if (d3d_SpriteState.SpriteQuads)
 	{
-		d3d11_Context->Unmap (QINSTANCE::VertexBuffer, 0);
+		QINSTANCE::Unmap ();
 		d3d_SpriteState.SpriteQuads = NULL;
 	}
 
 	if (d3d_SpriteState.NumSprites)
 	{
 		d3d11_State->SuspendCallback ();
-		d3d11_State->IASetVertexBuffer (1, QINSTANCE::VertexBuffer, sizeof (spriteinstance_t), QINSTANCE::MapOffset);
+		d3d11_State->IASetVertexBuffer (1, QINSTANCE::VertexBuffer, sizeof (spriteinstance_t), d3d_SpriteState.FirstOffset);
 
 		D3DMisc_DrawInstancedCommon (4, d3d_SpriteState.NumSprites, d3d_SpriteState.LastFrame);
 
-		QINSTANCE::MapOffset += CACHE_ALIGN (d3d_SpriteState.NumSprites * sizeof (spriteinstance_t));
+		// prewritten sprites were already allowed for when they were written
+		if (!d3d_SpriteState.Prewritten) QINSTANCE::Advance (d3d_SpriteState.NumSprites * sizeof (spriteinstance_t));
+
 		d3d_SpriteState.NumSprites = 0;
+		d3d_SpriteState.Prewritten = false;
 		d3d11_State->ResumeCallback ();
 	}
 }
 
 
-void D3DSprite_Draw (entity_t *ent)
+byte *D3DSprite_WriteInstance (entity_t *ent, byte *dest)
 {
 	float		*uvec, *rvec;
 	QMATRIX		av;
@@ -405,8 +413,7 @@ void D3DSprite_Draw (entity_t *ent)
 	vec3_t		temp;
 	float		sr, cr;
 
-	// don't even bother culling, because it's just a single polygon without a surface cache
-	mspriteframe_t *frame = D3DSprite_GetFrame (ent);
+	spriteinstance_t *inst = (spriteinstance_t *) dest;
 	msprite_t *hdr = ent->model->spritehdr;
 
 	Vector3Copy (fixed_origin, ent->origin);
@@ -466,6 +473,26 @@ void D3DSprite_Draw (entity_t *ent)
 		break;
 	}
 
+	// and write in the sprite instance
+	Vector3Copy (inst->entorigin, fixed_origin);
+	Vector3Copy (inst->uvec, uvec);
+	Vector3Copy (inst->rvec, rvec);
+
+	inst->color = r_lightscale.value;
+
+	if (ent->alphaval < 1 || ent->alphaval > 254)
+		inst->alpha = 1.0f;
+	else inst->alpha = (float) ent->alphaval / 255.0f;
+
+	return dest + sizeof (spriteinstance_t);
+}
+
+
+void D3DSprite_Draw (entity_t *ent)
+{
+	// don't even bother culling, because it's just a single polygon without a surface cache
+	mspriteframe_t *frame = D3DSprite_GetFrame (ent);
+
 	if (frame->firstvertex != d3d_SpriteState.LastFrame)
 	{
 		// if the frame changed we need to begin a new instance batch (flushing the old)
@@ -479,35 +506,41 @@ void D3DSprite_Draw (entity_t *ent)
 		d3d_SpriteState.LastFrame = frame->firstvertex;
 	}
 
-	D3D11_MAPPED_SUBRESOURCE MappedResource;
-	D3D11_MAP MapType = D3D11_MAP_WRITE_NO_OVERWRITE;
-
-	if (QINSTANCE::MapOffset + CACHE_ALIGN ((d3d_SpriteState.NumSprites + 1) * sizeof (spriteinstance_t)) >= QINSTANCE::BufferMax)
+	if (QINSTANCE::PrewriteOffset >= 0)
 	{
-		D3DSprite_End ();
-		MapType = D3D11_MAP_WRITE_DISCARD;
-		QINSTANCE::MapOffset = 0;
-	}
+		// the instance is already in the buffer following on from the previous sprite's
+		if (!d3d_SpriteState.NumSprites)
+		{
+			d3d_SpriteState.FirstOffset = QINSTANCE::PrewriteOffset;
+			d3d_SpriteState.Prewritten = true;
+		}
 
-	if (!d3d_SpriteState.SpriteQuads)
-	{
-		if (FAILED (d3d11_Context->Map (QINSTANCE::VertexBuffer, 0, MapType, 0, &MappedResource)))
-			return;
-		else d3d_SpriteState.SpriteQuads = (spriteinstance_t *) (&((byte *) MappedResource.pData)[QINSTANCE::MapOffset]);
+		QINSTANCE::PrewriteOffset += sizeof (spriteinstance_t);
 	}
+	else
+	{
+		// draw what we have if this won't fit so that the map can wrap around
+		if (QINSTANCE::MapOffset + CACHE_ALIGN ((d3d_SpriteState.NumSprites + 1) * sizeof (spriteinstance_t)) >= QINSTANCE::BufferMax)
+			D3DSprite_End ();
 
-	// and write in the sprite instance
-	Vector3Copy (d3d_SpriteState.SpriteQuads[d3d_SpriteState.NumSprites].entorigin, fixed_origin);
-	Vector3Copy (d3d_SpriteState.SpriteQuads[d3d_SpriteState.NumSprites].uvec, uvec);
-	Vector3Copy (d3d_SpriteState.SpriteQuads[d3d_SpriteState.NumSprites].rvec, rvec);
+		if (!d3d_SpriteState.SpriteQuads)
+		{
+			if ((d3d_SpriteState.SpriteQuads = (spriteinstance_t *) QINSTANCE::Map (sizeof (spriteinstance_t))) == NULL)
+				return;
 
-	d3d_SpriteState.SpriteQuads[d3d_SpriteState.NumSprites].color = r_lightscale.value;
+			d3d_SpriteState.FirstOffset = QINSTANCE::MapOffset;
+		}
 
-	if (ent->alphaval < 1 || ent->alphaval > 254)
-		d3d_SpriteState.SpriteQuads[d3d_SpriteState.NumSprites].alpha = 1.0f;
-	else d3d_SpriteState.SpriteQuads[d3d_SpriteState.NumSprites].alpha = (float) ent->alphaval / 255.0f;
+		D3DSprite_WriteInstance (ent, (byte *) &d3d_SpriteState.SpriteQuads[d3d_SpriteState.NumSprites]);
+	}
 
 	d3d_SpriteState.NumSprites++;
 }
 
 
+int D3DSprite_InstanceSize (void)
+{
+	return sizeof (spriteinstance_t);
+}
+
+
@@ -35,6 +35,11 @@ cvar_t r_chainfronttoback ("r_chainfronttoback", 1.0f, CVAR_ARCHIVE);
 cvar_t r_mergebmodels ("r_mergebmodels", 1.0f, CVAR_ARCHIVE);
 cvar_t r_detailtextures ("r_detailtextures", 0.0f, CVAR_ARCHIVE, D3DSurf_ResetDetailTextures);
 
+// the world is built from per-leaf draw lists merged on pvs changes instead of walking the tree; it's not the
+// default as the tree gives front-to-back order within each texture, which is better for early-z
+void R_ForceRecache (cvar_t *var);
+cvar_t r_pvsdrawlists ("r_pvsdrawlists", 0.0f, CVAR_ARCHIVE, R_ForceRecache);
+
 extern cvar_t r_lightscale;
 
 QEDICTLIST d3d_BrushEdicts;
@@ -167,6 +172,17 @@ ID3D11Buffer *d3d_SurfIndexes = NULL;
 ID3D11Buffer *d3d_SurfConstants = NULL;
 ID3D11Buffer *d3d_SurfVertexes = NULL;
 
+// every world surface's indexes built once at load time in texture order so that visible runs of them can be drawn
+// straight from the buffer without being copied each frame; surf n's indexes start at d3d_StaticFirstIndex[n]
+ID3D11Buffer *d3d_SurfStaticIndexes = NULL;
+int *d3d_StaticFirstIndex = NULL;
+int d3d_NumStaticSurfs = 0;
+
+// the visible surfs of the texture being drawn, one bit per surf
+unsigned *d3d_StaticBits = NULL;
+
+cvar_t r_staticindexes ("r_staticindexes", 0.0f, CVAR_ARCHIVE);
+
 ID3D11InputLayout *d3d_SurfLayout = NULL;
 ID3D11VertexShader *d3d_SurfVertexShader[2];
 ID3D11PixelShader *d3d_SurfPixelShader[16];
@@ -175,6 +191,7 @@ ID3D11GeometryShader *d3d_SurfGeometryShader;
 void D3DBrush_Shutdown (void)
 {
 	SAFE_RELEASE (d3d_SurfIndexes);
+	SAFE_RELEASE (d3d_SurfStaticIndexes);
 	SAFE_RELEASE (d3d_SurfVertexes);
 }
 
@@ -188,10 +205,14 @@ void D3DBrush_ClearLoadData (brushhdr_t *hdr)
 }
 
 
+void D3DOcclusion_ClearOccluders (void);
+void D3DOcclusion_BuildOccluders (brushhdr_t *hdr, byte *xyz, int stride);
+
 void D3DBrush_Init (void)
 {
 	// ensure because this gets called at map load as well as at vid_restart
 	D3DBrush_Shutdown ();
+	D3DOcclusion_ClearOccluders ();
 
 	// now build the surfaces for real
 	if (!d3d_BrushState.LoadVertexes) return;
@@ -217,6 +238,8 @@ void D3DBrush_Init (void)
 	int numvertexes = 0;
 	model_t *mod = NULL;
 
+	d3d_NumStaticSurfs = 0;
+
 	for (int j = 1; j < MAX_MODELS; j++)
 	{
 		if (!(mod = cl.model_precache[j])) break;
@@ -261,10 +284,21 @@ void D3DBrush_Init (void)
 			texture_t *tex = NULL;
 
 			if (!(tex = hdr->textures[i])) continue;
+
+			tex->firststatic = d3d_NumStaticSurfs;
+			tex->numstatic = 0;
+
 			if (!(surf = tex->texturechain)) continue;
 
 			for (; surf; surf = surf->texturechain)
 			{
+				// the world's surfs (which inline bmodels share) go to the static stream in the order they're built
+				if (mod == cl.worldmodel)
+				{
+					surf->staticnum = d3d_NumStaticSurfs++;
+					tex->numstatic++;
+				}
+
 				surf->firstvertex = numvertexes;
 				numvertexes += surf->numvertexes;
 				numindexes += surf->numindexes;
@@ -278,6 +312,10 @@ void D3DBrush_Init (void)
 			D3DSurf_ClearTextureChain (tex);
 		}
 
+		// the world's biggest faces are picked out as occluders while their verts are still around
+		if (mod == cl.worldmodel)
+			D3DOcclusion_BuildOccluders (hdr, (byte *) verts, sizeof (brushpolyvert_t));
+
 		D3DBrush_ClearLoadData (hdr);
 		Mod_RecalcNodeBBox (hdr->nodes);
 		Mod_CalcBModelBBox (mod, hdr);
@@ -289,6 +327,38 @@ void D3DBrush_Init (void)
 	BufferFactory.CreateVertexBuffer (sizeof (brushpolyvert_t), numvertexes, &d3d_SurfVertexes, "d3d_SurfVertexes", verts);
 	BufferFactory.CreateIndexBuffer (d3d_BrushState.IndexSize, numindexes, &d3d_SurfIndexes, "d3d_SurfIndexes");
 
+	if (d3d_NumStaticSurfs)
+	{
+		brushhdr_t *hdr = cl.worldmodel->brushhdr;
+		int numstaticindexes = 0;
+
+		d3d_StaticFirstIndex = (int *) MainHunk->Alloc ((d3d_NumStaticSurfs + 1) * sizeof (int));
+		d3d_StaticBits = (unsigned *) MainHunk->Alloc (((d3d_NumStaticSurfs + 31) >> 5) * sizeof (unsigned));
+
+		// static surfs are consecutive in the buffer so a run of them can go in a single draw
+		for (int i = 0; i < hdr->numsurfaces; i++)
+			d3d_StaticFirstIndex[hdr->surfaces[i].staticnum + 1] = hdr->surfaces[i].numindexes;
+
+		for (int i = 0; i < d3d_NumStaticSurfs; i++)
+			d3d_StaticFirstIndex[i + 1] += d3d_StaticFirstIndex[i];
+
+		numstaticindexes = d3d_StaticFirstIndex[d3d_NumStaticSurfs];
+		byte *staticindexes = (byte *) TempHunk->FastAlloc (numstaticindexes * d3d_BrushState.IndexSize);
+
+		for (int i = 0; i < hdr->numsurfaces; i++)
+		{
+			msurface_t *surf = &hdr->surfaces[i];
+
+			Q_MemCpy (
+				staticindexes + d3d_StaticFirstIndex[surf->staticnum] * d3d_BrushState.IndexSize,
+				surf->indexes,
+				surf->numindexes * d3d_BrushState.IndexSize
+			);
+		}
+
+		BufferFactory.CreateIndexBuffer (d3d_BrushState.IndexSize, numstaticindexes, &d3d_SurfStaticIndexes, "d3d_SurfStaticIndexes", staticindexes);
+	}
+
 	d3d_BrushState.MaxIndexes = numindexes;
 	d3d_BrushState.FirstIndex = 0;
 
@@ -407,24 +477,117 @@ void D3DSurf_MarkLeaves (void);
 extern cvar_t r_lockpvs;
 extern cvar_t r_lockfrustum;
 extern cvar_t r_locksurfaces;
+extern cvar_t r_occlusion;
 
 msurface_t **r_cachedworldsurfaces = NULL;
 int r_numcachedworldsurfaces = 0;
 
-mleaf_t **r_cachedworldleafs = NULL;
 int r_numcachedworldleafs = 0;
 
 mnode_t **r_cachedworldnodes = NULL;
 int r_numcachedworldnodes = 0;
 
+// world surfaces in texture order, and each leaf's surfaces as a sorted run of indexes into that, so that the texture-sorted
+// visible set for a pvs can be assembled by merging the runs of its leafs instead of walking the tree (r_pvsdrawlists)
+msurface_t **d3d_RankedSurfs = NULL;
+int *d3d_LeafRuns = NULL;
+int *d3d_LeafFirstRun = NULL;
+
+// the runs are merged by setting a bit for each index then reading them back in order
+unsigned *d3d_RankBits = NULL;
+
+// the visible set for the current pvs
+msurface_t **d3d_PVSSurfs = NULL;
+int d3d_NumPVSSurfs = 0;
+
+mleaf_t **d3d_PVSLeafs = NULL;
+int d3d_NumPVSLeafs = 0;
+
+// the pvs that's currently marked, and the new one which is built for comparison against it
+byte *d3d_CurrPVS = NULL;
+byte *d3d_NewPVS = NULL;
+
+
+int D3DSurf_RankSortFunc (msurface_t **s1, msurface_t **s2)
+{
+	// by texture, then in their original order
+	if ((*s1)->texinfo->texture != (*s2)->texinfo->texture)
+		return ((*s1)->texinfo->texture < (*s2)->texinfo->texture) ? -1 : 1;
+
+	return (int) (*s1 - *s2);
+}
+
+
+int D3DSurf_RunSortFunc (int *r1, int *r2)
+{
+	return *r1 - *r2;
+}
+
+
+void D3DSurf_BuildLeafRuns (brushhdr_t *hdr)
+{
+	int hunkmark = TempHunk->GetLowMark ();
+	int *surfrank = (int *) TempHunk->FastAlloc (hdr->numsurfaces * sizeof (int));
+	int numruns = 0;
+
+	d3d_RankedSurfs = (msurface_t **) MainHunk->Alloc (hdr->numsurfaces * sizeof (msurface_t *));
+
+	for (int i = 0; i < hdr->numsurfaces; i++)
+		d3d_RankedSurfs[i] = &hdr->surfaces[i];
+
+	qsort (d3d_RankedSurfs, hdr->numsurfaces, sizeof (msurface_t *), (sortfunc_t) D3DSurf_RankSortFunc);
+
+	for (int i = 0; i < hdr->numsurfaces; i++)
+		surfrank[d3d_RankedSurfs[i] - hdr->surfaces] = i;
+
+	// visible leafs are 1 to numleafs; the last may resolve to the first node (see D3DSurf_LeafVisibility) so check contents
+	for (int i = 1; i <= hdr->numleafs; i++)
+		if (hdr->leafs[i].contents < 0) numruns += hdr->leafs[i].nummarksurfaces;
+
+	d3d_LeafFirstRun = (int *) MainHunk->Alloc ((hdr->numleafs + 2) * sizeof (int));
+	d3d_LeafRuns = (int *) MainHunk->Alloc ((numruns + 1) * sizeof (int));
+	numruns = 0;
+
+	for (int i = 1; i <= hdr->numleafs; i++)
+	{
+		mleaf_t *leaf = &hdr->leafs[i];
+
+		d3d_LeafFirstRun[i] = numruns;
+
+		if (leaf->contents >= 0) continue;
+
+		for (int j = 0; j < leaf->nummarksurfaces; j++)
+			d3d_LeafRuns[numruns++] = surfrank[leaf->firstmarksurface[j] - hdr->surfaces];
+
+		qsort (&d3d_LeafRuns[d3d_LeafFirstRun[i]], numruns - d3d_LeafFirstRun[i], sizeof (int), (sortfunc_t) D3DSurf_RunSortFunc);
+	}
+
+	d3d_LeafFirstRun[hdr->numleafs + 1] = numruns;
+
+	d3d_RankBits = (unsigned *) MainHunk->Alloc (((hdr->numsurfaces + 31) >> 5) * sizeof (unsigned));
+
+	d3d_PVSSurfs = (msurface_t **) MainHunk->Alloc (hdr->numsurfaces * sizeof (msurface_t *));
+	d3d_NumPVSSurfs = 0;
+
+	d3d_PVSLeafs = (mleaf_t **) MainHunk->Alloc ((hdr->numleafs + 1) * sizeof (mleaf_t *));
+	d3d_NumPVSLeafs = 0;
+
+	d3d_CurrPVS = (byte *) MainHunk->Alloc ((hdr->numleafs + 7) >> 3);
+	d3d_NewPVS = (byte *) MainHunk->Alloc ((hdr->numleafs + 7) >> 3);
+
+	TempHunk->FreeToLowMark (hunkmark);
+}
+
+
 void D3DSurf_BuildWorldCache (void)
 {
 	r_cachedworldsurfaces = (msurface_t **) MainHunk->Alloc (cl.worldmodel->brushhdr->numsurfaces * sizeof (msurface_t *));
 	r_numcachedworldsurfaces = 0;
 
-	r_cachedworldleafs = (mleaf_t **) MainHunk->Alloc ((cl.worldmodel->brushhdr->numleafs + 1) * sizeof (mleaf_t *));
 	r_numcachedworldleafs = 0;
 
+	D3DSurf_BuildLeafRuns (cl.worldmodel->brushhdr);
+
 	// not doing anything with this yet...
 	//r_cachedworldnodes = (mnode_t **) MainHunk->Alloc (cl.worldmodel->brushhdr->numnodes * sizeof (mnode_t *));
 	//r_numcachedworldnodes = 0;
@@ -476,8 +639,75 @@ texture_t *D3DSurf_TextureAnimation (texture_t *base)
 }
 
 
+#define MAX_STATIC_RANGES	32
+
+bool D3DSurf_DrawStaticChain (texture_t *tex)
+{
+	int ranges[MAX_STATIC_RANGES][2];
+	int numranges = 0;
+	int rangestart = -1;
+	int numsurfs = 0;
+	int first = tex->firststatic;
+	int last = tex->firststatic + tex->numstatic;
+
+	// write the visible bitmap for this texture
+	for (msurface_t *surf = tex->texturechain; surf; surf = surf->texturechain, numsurfs++)
+		d3d_StaticBits[surf->staticnum >> 5] |= (1u << (surf->staticnum & 31));
+
+	// and read it back as runs of consecutive surfs
+	for (int i = first; i <= last; i++)
+	{
+		bool visible = (i < last) && (d3d_StaticBits[i >> 5] & (1u << (i & 31)));
+
+		if (visible && rangestart < 0)
+			rangestart = i;
+		else if (!visible && rangestart >= 0)
+		{
+			// too fragmented to be worth it so it goes through the dynamic buffer instead
+			if (numranges == MAX_STATIC_RANGES)
+			{
+				numranges = -1;
+				break;
+			}
+
+			ranges[numranges][0] = rangestart;
+			ranges[numranges][1] = i;
+			numranges++;
+			rangestart = -1;
+		}
+
+		// skip over empty words
+		if (rangestart < 0 && !(i & 31) && i < last && !d3d_StaticBits[i >> 5]) i += 31;
+	}
+
+	// only this texture's bits were set so the words can be cleared whole
+	if (tex->numstatic) memset (&d3d_StaticBits[first >> 5], 0, (((last - 1) >> 5) - (first >> 5) + 1) * sizeof (unsigned));
+
+	if (numranges < 0) return false;
+
+	d3d11_State->IASetIndexBuffer (d3d_SurfStaticIndexes, d3d_BrushState.IndexFormat, 0);
+
+	for (int i = 0; i < numranges; i++)
+	{
+		int firstindex = d3d_StaticFirstIndex[ranges[i][0]];
+		D3DMisc_DrawIndexedCommon (d3d_StaticFirstIndex[ranges[i][1]] - firstindex, firstindex);
+	}
+
+	d3d11_State->IASetIndexBuffer (d3d_SurfIndexes, d3d_BrushState.IndexFormat, 0);
+
+	d3d_RenderDef.brush_polys += numsurfs;
+	D3DSurf_ClearTextureChain (tex);
+
+	return true;
+}
+
+
 void D3DSurf_DrawTextureChain (texture_t *tex)
 {
+	// solid world textures can be drawn from the static indexes (alpha surfs need to keep their sorted order)
+	if (r_staticindexes.integer && d3d_SurfStaticIndexes && tex->numstatic && d3d_BrushState.CurrentAlpha == 255)
+		if (D3DSurf_DrawStaticChain (tex)) return;
+
 	D3D11_MAPPED_SUBRESOURCE MappedResource;
 	D3D11_MAP MapType = D3D11_MAP_WRITE_NO_OVERWRITE;
 
@@ -629,13 +859,16 @@ void D3DSurf_ChainCommon (entity_t *ent, msurface_t *surf, texture_t *tex)
 }
 
 
-void D3DSurf_ChainSurface (msurface_t *surf, entity_t *ent)
+void D3DSurf_ExtractSurface (d3d_surfpacket_t *packet, msurface_t *surf, entity_t *ent)
 {
 	// defer animation until draw time
 	if ((surf->flags & SURF_DRAWTURB) && D3DWarp_CheckAlphaSurface (surf, ent))
 		return;
 
-	D3DSurf_ChainCommon (ent, surf, surf->texinfo->texture);
+	// other packets build their lightmaps later
+	if (packet->lighting == PACKET_LIGHT_EXTRACT) D3DLight_CheckSurfaceForModification (surf);
+
+	packet->surfs[packet->numsurfs++] = surf;
 }
 
 
@@ -689,11 +922,11 @@ void D3DBrush_BatchAlphaSurface (msurface_t *surf, entity_t *ent, int alpha)
 }
 
 
-void D3DSurf_DrawBModelSurfaces (entity_t *ent, brushhdr_t *hdr)
+void D3DSurf_ExtractBModelSurfaces (d3d_surfpacket_t *packet, entity_t *ent, brushhdr_t *hdr)
 {
 	// calculate dynamic lighting for the inline bmodel
 	// this is done after the matrix is calced so that we can have the proper transform for lighting
-	D3DLight_PushDynamics (ent, hdr->nodes + hdr->hulls[0].firstclipnode);
+	if (packet->lighting != PACKET_LIGHT_SUBMIT) D3DLight_PushDynamics (ent, hdr->nodes + hdr->hulls[0].firstclipnode);
 
 	// and now handle it's surfaces
 	msurface_t *surf = hdr->surfaces + hdr->firstmodelsurface;
@@ -710,13 +943,13 @@ void D3DSurf_DrawBModelSurfaces (entity_t *ent, brushhdr_t *hdr)
 				D3DSurf_EmitSurfToAlpha (surf, ent);
 			else if (ent->alphaval > 0 && ent->alphaval < 255)
 				D3DSurf_EmitSurfToAlpha (surf, ent);
-			else D3DSurf_ChainSurface (surf, ent);
+			else D3DSurf_ExtractSurface (packet, surf, ent);
 		}
 	}
 }
 
 
-void D3DSurf_DrawBrushModel (entity_t *ent)
+void D3DSurf_ExtractBrushModel (d3d_scene_t *scene, entity_t *ent)
 {
 	model_t *mod = ent->model;
 
@@ -724,7 +957,7 @@ void D3DSurf_DrawBrushModel (entity_t *ent)
 	if (!mod->brushhdr) return;
 	if (!mod->brushhdr->numsurfaces) return;
 
-	if (R_CullBox (&ent->cullinfo))
+	if (R_CullBox (&ent->cullinfo) || R_OccludeBox (&ent->cullinfo))
 	{
 		// mark as not visible
 		ent->visframe = -1;
@@ -764,26 +997,28 @@ void D3DSurf_DrawBrushModel (entity_t *ent)
 		Vector3Copy (ent->modelorg, r_refdef.vieworigin);
 	}
 
+	d3d_surfpacket_t *packet = &scene->SurfPackets[scene->NumSurfPackets];
+
+	packet->ent = ent;
+	packet->surfs = (msurface_t **) TempHunk->FastAlloc (mod->brushhdr->nummodelsurfaces * sizeof (msurface_t *));
+	packet->numsurfs = 0;
+
+	// if more than one entity uses this model the lightmaps for each must be built and uploaded in turn at draw time
+	packet->lighting = (mod->numents > 1) ? PACKET_LIGHT_SUBMIT : PACKET_LIGHT_EXTRACT;
+
 	// go to a new dynamic frame because this may be a shared model
-	D3DLight_NewDynamicFrame ();
-	D3DSurf_DrawBModelSurfaces (ent, mod->brushhdr);
+	if (packet->lighting != PACKET_LIGHT_SUBMIT) D3DLight_NewDynamicFrame ();
 
-	if (ent->BrushDrawFlags)
-	{
-		extern ID3D11RasterizerState *d3d_RSZFighting;
+	D3DSurf_ExtractBModelSurfaces (packet, ent, mod->brushhdr);
 
-		if (r_usingdepthbias && ent->model->name[0] == '*')
-		{
-			d3d11_State->RSSetState (d3d_RSZFighting);
-			D3DSurf_DrawTextureChains (ent, 255);
-			d3d11_State->RSSetState (d3d_RS3DView);
-		}
-		else D3DSurf_DrawTextureChains (ent, 255);
-	}
+	// only keep it if it's got something to draw
+	if (packet->numsurfs) scene->NumSurfPackets++;
 }
 
 
-void R_StoreEfrags (struct efrag_t **ppefrag);
+void R_BeginEfrags (void);
+void R_StoreEfrags (mleaf_t *leaf);
+void R_AddStaticEdicts (void);
 bool R_CullPlaneForNearestPoint (cullinfo_t *ci, mplane_t *p);
 bool R_CullPlaneForFarthestPoint (cullinfo_t *ci, mplane_t *p);
 
@@ -817,6 +1052,41 @@ bool D3DSurf_CullNode (cullinfo_t *ci, int clipflags)
 }
 
 
+extern cvar_t r_simdcull;
+
+// set up from r_simdcull each time the world is built, but the cull benchmark switches it directly
+static bool d3d_SIMDCull = true;
+
+// benchmarks don't want the world build to emit entities
+static bool d3d_WorldBenchmark = false;
+
+// set each time the world is built if the occlusion buffer is valid for this view
+static bool d3d_OcclusionCull = false;
+
+int D3DSurf_CullNodeSurfaces (mnode_t *node, int first, int sidebit)
+{
+	brushhdr_t *hdr = cl.worldmodel->brushhdr;
+	msurface_t *surf = node->surfaces + first;
+	cullinfo_t *boxes[4] = {NULL, NULL, NULL, NULL};
+	bool anyboxes = false;
+
+	for (int i = 0; i < 4 && first + i < node->numsurfaces; i++, surf++)
+	{
+		// only surfs that D3DSurf_RecursiveWorldNode would otherwise R_CullBox go into the group
+		if (surf->visframe != d3d_RenderDef.framecount) continue;
+		if ((surf->flags & SURF_PLANEBACK) != sidebit) continue;
+		if (!surf->cullinfo.clipflags) continue;
+
+		boxes[i] = &surf->cullinfo;
+		anyboxes = true;
+	}
+
+	if (!anyboxes) return 0;
+
+	return R_CullBoxesSoA (hdr->surfbounds, (node->surfaces - hdr->surfaces) + first, boxes);
+}
+
+
 // this now only builds a cache of surfs and leafs for drawing from; the real draw lists are built separately
 void D3DSurf_RecursiveWorldNode (mnode_t *node, int clipflags)
 {
@@ -829,6 +1099,14 @@ void D3DSurf_RecursiveWorldNode (mnode_t *node, int clipflags)
 	{
 		// node is a leaf so add stuff for drawing
 		mleaf_t *leaf = (mleaf_t *) node;
+
+		// collect any static entities in the leaf so that they can emit entities to the appropriate lists; the leaf box
+		// only bounds its surfaces so they're left to be occlusion tested by their own boxes (which is also why this is
+		// done per leaf and not per node)
+		if (!d3d_WorldBenchmark) R_StoreEfrags (leaf);
+
+		if (d3d_OcclusionCull && R_OccludeBox (&leaf->cullinfo)) return;
+
 		msurface_t **mark = leaf->firstmarksurface;
 		int c = leaf->nummarksurfaces;
 
@@ -842,16 +1120,6 @@ void D3DSurf_RecursiveWorldNode (mnode_t *node, int clipflags)
 			} while (--c);
 		}
 
-		if (leaf->efrags)
-		{
-			// store out any efrags we got so that they can emit entities to the appropriate lists
-			R_StoreEfrags (&leaf->efrags);
-
-			// and cache this leaf for reuse (only needed for efrags)
-			r_cachedworldleafs[r_numcachedworldleafs] = leaf;
-			r_numcachedworldleafs++;
-		}
-
 		d3d_RenderDef.numleaf++;
 		return;
 	}
@@ -869,11 +1137,16 @@ void D3DSurf_RecursiveWorldNode (mnode_t *node, int clipflags)
 		msurface_t *surf = node->surfaces;
 		int sidebit = (node->dot >= 0 ? 0 : SURF_PLANEBACK);
 		int nodesurfs = 0;
+		int culled = 0;
 		float dot;
 
 		// add stuff to the draw lists
-		for (int c = node->numsurfaces; c; c--, surf++)
+		for (int c = 0; c < node->numsurfaces; c++, surf++)
 		{
+			// surfs are culled in groups of 4 from the packed bounds
+			if (d3d_SIMDCull && node->cullinfo.clipflags && !(c & 3))
+				culled = D3DSurf_CullNodeSurfaces (node, c, sidebit);
+
 			// the SURF_PLANEBACK test never actually evaluates to true with GLQuake as the surf
 			// will have the same plane and facing as the node here.  oh well...
 			if (surf->visframe != d3d_RenderDef.framecount) continue;
@@ -881,7 +1154,13 @@ void D3DSurf_RecursiveWorldNode (mnode_t *node, int clipflags)
 
 			// only check for culling if both the node and leaf containing this surf intersect the frustum
 			if (node->cullinfo.clipflags && surf->cullinfo.clipflags)
-				if (R_CullBox (&surf->cullinfo)) continue;
+			{
+				if (d3d_SIMDCull)
+				{
+					if (culled & (1 << (c & 3))) continue;
+				}
+				else if (R_CullBox (&surf->cullinfo)) continue;
+			}
 
 			dot = (surf->plane == node->plane) ? node->dot : Mod_PlaneDist (surf->plane, d3d_RenderDef.worldentity.modelorg);
 
@@ -908,7 +1187,106 @@ void D3DSurf_RecursiveWorldNode (mnode_t *node, int clipflags)
 }
 
 
-void D3DSurf_BuildWorld (void)
+struct pvsgroup_t
+{
+	msurface_t *surfs[4];
+	cullinfo_t *boxes[4];
+	float dots[4];
+	int numsurfs;
+};
+
+
+void D3DSurf_CacheWorldSurface (msurface_t *surf, float dot)
+{
+	if (dot > vid.farclip) vid.farclip = dot;
+	if (-dot > vid.farclip) vid.farclip = -dot;
+
+	// cache this surface for reuse
+	r_cachedworldsurfaces[r_numcachedworldsurfaces] = surf;
+	r_numcachedworldsurfaces++;
+}
+
+
+void D3DSurf_FlushPVSGroup (pvsgroup_t *group)
+{
+	int culled = R_CullBoxes (group->boxes);
+
+	for (int i = 0; i < group->numsurfs; i++)
+	{
+		if (!(culled & (1 << i)))
+			D3DSurf_CacheWorldSurface (group->surfs[i], group->dots[i]);
+
+		group->boxes[i] = NULL;
+	}
+
+	group->numsurfs = 0;
+}
+
+
+// builds the same surface cache as D3DSurf_RecursiveWorldNode but from the visible set that was merged when the pvs last changed,
+// so the tree isn't walked and the surfaces come out in texture order instead of front-to-back
+void D3DSurf_BuildWorldFromPVS (void)
+{
+	pvsgroup_t group = {{NULL, NULL, NULL, NULL}, {NULL, NULL, NULL, NULL}, {0, 0, 0, 0}, 0};
+
+	for (int i = 0; i < d3d_NumPVSLeafs; i++)
+	{
+		mleaf_t *leaf = d3d_PVSLeafs[i];
+
+		// a leaf is culled whenever a node above it would have been so this needs no hierarchy
+		if (D3DSurf_CullNode (&leaf->cullinfo, 31)) continue;
+
+		// collect any static entities in the leaf so that they can emit entities to the appropriate lists; the leaf box
+		// only bounds its surfaces so they're left to be occlusion tested by their own boxes
+		if (!d3d_WorldBenchmark) R_StoreEfrags (leaf);
+
+		if (d3d_OcclusionCull && R_OccludeBox (&leaf->cullinfo)) continue;
+
+		msurface_t **mark = leaf->firstmarksurface;
+
+		for (int c = 0; c < leaf->nummarksurfaces; c++, mark++)
+		{
+			(*mark)->visframe = d3d_RenderDef.framecount;
+			(*mark)->cullinfo.clipflags = leaf->cullinfo.clipflags;
+		}
+
+		d3d_RenderDef.numleaf++;
+	}
+
+	for (int i = 0; i < d3d_NumPVSSurfs; i++)
+	{
+		msurface_t *surf = d3d_PVSSurfs[i];
+
+		if (surf->visframe != d3d_RenderDef.framecount) continue;
+
+		float dot = Mod_PlaneDist (surf->plane, d3d_RenderDef.worldentity.modelorg);
+
+		// the same side test as the node containing this surf would do
+		if ((surf->flags & SURF_PLANEBACK) != (dot >= 0 ? 0 : SURF_PLANEBACK)) continue;
+
+		if (!d3d_SIMDCull)
+		{
+			// only check for culling if the leaf containing this surf intersects the frustum
+			if (surf->cullinfo.clipflags && R_CullBox (&surf->cullinfo)) continue;
+
+			D3DSurf_CacheWorldSurface (surf, dot);
+			continue;
+		}
+
+		// surfs go through in groups of 4 so that they can be culled together while keeping their order
+		if (surf->cullinfo.clipflags) group.boxes[group.numsurfs] = &surf->cullinfo;
+
+		group.surfs[group.numsurfs] = surf;
+		group.dots[group.numsurfs] = dot;
+
+		if (++group.numsurfs == 4) D3DSurf_FlushPVSGroup (&group);
+	}
+
+	if (group.numsurfs) D3DSurf_FlushPVSGroup (&group);
+}
+
+
+void D3DSurf_MarkWorld (void)
 {
 	// ensure
 	cl.worldmodel->brushhdr->bspmodel = false;
@@ -928,7 +1306,14 @@ void D3DSurf_BuildWorld (void)
 	// (although it might not be depending on the scene...)
 	d3d_RenderDef.worldentity.visframe = d3d_RenderDef.framecount;
 	d3d_RenderDef.worldentity.frame = 0;
+}
 
+
+bool D3DOcclusion_IsActive (void);
+
+void D3DSurf_BuildWorld (void)
+{
+	// the leafs were marked by D3DSurf_MarkWorld and anything occluding them has been drawn since
 	d3d_RenderDef.numnode = 0;
 	d3d_RenderDef.numleaf = 0;
 
@@ -936,12 +1321,19 @@ void D3DSurf_BuildWorld (void)
 	{
 		// go to a new cache
 		r_numcachedworldsurfaces = 0;
-		r_numcachedworldleafs = 0;
+		R_BeginEfrags ();
 
 		vid.farclip = 4096.0f;	// never go below this
 
-		D3DSurf_RecursiveWorldNode (cl.worldmodel->brushhdr->nodes, 31);
+		d3d_SIMDCull = (r_simdcull.integer != 0);
+		d3d_OcclusionCull = D3DOcclusion_IsActive ();
+
+		if (r_pvsdrawlists.integer)
+			D3DSurf_BuildWorldFromPVS ();
+		else D3DSurf_RecursiveWorldNode (cl.worldmodel->brushhdr->nodes, 31);
+
 		r_numcachedworldnodes = d3d_RenderDef.numnode;
+		r_numcachedworldleafs = d3d_RenderDef.numleaf;
 
 		// vid.farclip so far represents one side of a right-angled triangle with the longest side being what we actually want
 		vid.farclip = sqrt (vid.farclip * vid.farclip + vid.farclip * vid.farclip);
@@ -949,12 +1341,9 @@ void D3DSurf_BuildWorld (void)
 		// mark not to rebuild
 		d3d_RenderDef.rebuildworld = false;
 	}
-	else
-	{
-		// store efrags from the previous build so that they can emit entities to the appropriate lists
-		for (int i = 0; i < r_numcachedworldleafs; i++)
-			R_StoreEfrags (&r_cachedworldleafs[i]->efrags);
-	}
+
+	// the static entities collected by the last build are reused until it's rebuilt
+	R_AddStaticEdicts ();
 
 	// update r_speeds counters
 	d3d_RenderDef.numnode = r_numcachedworldnodes;
@@ -962,17 +1351,240 @@ void D3DSurf_BuildWorld (void)
 }
 
 
-void D3DSurf_DrawWorld (void)
+void D3DMain_SetupView (void);
+void D3DSurf_MergeLeafRuns (byte *vis);
+void D3DSurf_LeafVisibility (byte *vis);
+
+void D3DSurf_CullBenchmark_f (void)
 {
-	D3DBrush_BeginSurfaces ();
+	if (cls.state != ca_connected) return;
+	if (!cl.worldmodel) return;
+
+	if (r_locksurfaces.integer)
+	{
+		Con_Printf ("r_cullbenchmark : can't run with r_locksurfaces set\n");
+		return;
+	}
+
+	// spins the view through a full circle like timerefresh, traversing the world at each step with the scalar and SIMD
+	// culling in turn so that both the surface lists and the time taken can be compared
+	int numsteps = (Cmd_Argc () == 1) ? 360 : atoi (Cmd_Argv (1));
+
+	if (numsteps < 2) numsteps = 2;
+
+	int hunkmark = TempHunk->GetLowMark ();
+	msurface_t **scalarsurfs = (msurface_t **) TempHunk->FastAlloc (cl.worldmodel->brushhdr->numsurfaces * sizeof (msurface_t *));
+	float startangle = r_refdef.viewangles[1];
+	float startfarclip = vid.farclip;
+	double passtime[2] = {0, 0};
+	int numscalarsurfs = 0;
+	int numtotalsurfs = 0;
+	int mismatches = 0;
+
+	d3d_WorldBenchmark = true;
+	d3d_OcclusionCull = false;
+
+	// the draw lists don't mark nodes so they need to be brought up to date for walking the tree
+	if (r_pvsdrawlists.integer)
+	{
+		d3d_RenderDef.visframecount++;
+		D3DSurf_LeafVisibility (d3d_CurrPVS);
+	}
+
+	for (int i = 0; i < numsteps; i++)
+	{
+		r_refdef.viewangles[1] = startangle + (float) i / (float) numsteps * 360.0f;
+		D3DMain_SetupView ();
+
+		for (int pass = 0; pass < 2; pass++)
+		{
+			// a new frame for each pass so that surfs marked on the previous one don't come through
+			d3d_RenderDef.framecount++;
+			d3d_RenderDef.numnode = 0;
+			d3d_RenderDef.numleaf = 0;
+
+			r_numcachedworldsurfaces = 0;
+			r_numcachedworldleafs = 0;
+			d3d_SIMDCull = (pass == 1);
+
+			double start = Sys_ProfileTime ();
+			D3DSurf_RecursiveWorldNode (cl.worldmodel->brushhdr->nodes, 31);
+			passtime[pass] += Sys_ProfileTime () - start;
+
+			if (pass == 0)
+			{
+				memcpy (scalarsurfs, r_cachedworldsurfaces, r_numcachedworldsurfaces * sizeof (msurface_t *));
+				numscalarsurfs = r_numcachedworldsurfaces;
+			}
+			else if (r_numcachedworldsurfaces != numscalarsurfs || memcmp (scalarsurfs, r_cachedworldsurfaces, numscalarsurfs * sizeof (msurface_t *)))
+				mismatches++;
+			else numtotalsurfs += numscalarsurfs;
+		}
+	}
+
+	d3d_WorldBenchmark = false;
+	TempHunk->FreeToLowMark (hunkmark);
+
+	// put everything back the way it was and have the next frame build the world for real
+	r_refdef.viewangles[1] = startangle;
+	vid.farclip = startfarclip;
+	D3DMain_SetupView ();
+	d3d_RenderDef.rebuildworld = true;
+
+	Con_Printf ("%i views, %i surfaces\n", numsteps, numtotalsurfs);
+	Con_Printf ("scalar : %0.3f ms per view\n", (passtime[0] * 1000.0) / (double) numsteps);
+	Con_Printf ("SIMD   : %0.3f ms per view\n", (passtime[1] * 1000.0) / (double) numsteps);
+
+	if (mismatches)
+		Con_Printf ("%i views had different surface lists!\n", mismatches);
+	else Con_Printf ("surface lists are identical\n");
+}
+
+
+cmd_t D3DSurf_CullBenchmark_Cmd ("r_cullbenchmark", D3DSurf_CullBenchmark_f);
+
+
+int D3DSurf_SurfPtrSortFunc (msurface_t **s1, msurface_t **s2)
+{
+	return (int) (*s1 - *s2);
+}
+
+
+void D3DSurf_LeafBenchmark_f (void)
+{
+	if (cls.state != ca_connected) return;
+	if (!cl.worldmodel) return;
+
+	if (r_locksurfaces.integer || r_lockpvs.integer)
+	{
+		Con_Printf ("r_leafbenchmark : can't run with r_locksurfaces or r_lockpvs set\n");
+		return;
+	}
+
+	// moves the view to the centre of every leaf in the map in turn and times a full leaf change from its pvs to a
+	// built world, first by marking nodes and walking the tree and then by merging the per-leaf draw lists
+	brushhdr_t *hdr = cl.worldmodel->brushhdr;
+	int hunkmark = TempHunk->GetLowMark ();
+	msurface_t **treesurfs = (msurface_t **) TempHunk->FastAlloc (hdr->numsurfaces * sizeof (msurface_t *));
+	mleaf_t *startleaf = d3d_RenderDef.viewleaf;
+	float startorigin[3];
+	float startfarclip = vid.farclip;
+	double passtime[2] = {0, 0};
+	int numtreesurfs = 0;
+	int numleafs = 0;
+	int mismatches = 0;
+
+	Vector3Copy (startorigin, r_refdef.vieworigin);
+	d3d_WorldBenchmark = true;
+	d3d_OcclusionCull = false;
+	d3d_SIMDCull = (r_simdcull.integer != 0);
+
+	for (int i = 1; i <= hdr->numleafs; i++)
+	{
+		mleaf_t *leaf = &hdr->leafs[i];
+
+		if (leaf->contents >= 0) continue;
+		if (leaf->contents == CONTENTS_SOLID) continue;
+		if (leaf->contents == CONTENTS_SKY) continue;
+
+		for (int j = 0; j < 3; j++)
+			r_refdef.vieworigin[j] = leaf->cullinfo.mins[j] + (leaf->cullinfo.maxs[j] - leaf->cullinfo.mins[j]) * 0.5f;
+
+		Vector3Copy (d3d_RenderDef.worldentity.modelorg, r_refdef.vieworigin);
+		d3d_RenderDef.viewleaf = leaf;
+		D3DMain_SetupView ();
+
+		for (int pass = 0; pass < 2; pass++)
+		{
+			double start = Sys_ProfileTime ();
+			byte *vis = Mod_LeafPVS (leaf, cl.worldmodel);
+
+			// a new frame for each pass so that surfs marked on the previous one don't come through
+			d3d_RenderDef.framecount++;
+			d3d_RenderDef.numnode = 0;
+			d3d_RenderDef.numleaf = 0;
+
+			r_numcachedworldsurfaces = 0;
+			r_numcachedworldleafs = 0;
+
+			if (pass == 0)
+			{
+				d3d_RenderDef.visframecount++;
+				D3DSurf_LeafVisibility (vis);
+				D3DSurf_RecursiveWorldNode (hdr->nodes, 31);
+			}
+			else
+			{
+				D3DSurf_MergeLeafRuns (vis);
+				D3DSurf_BuildWorldFromPVS ();
+			}
+
+			passtime[pass] += Sys_ProfileTime () - start;
+
+			// the orders are different so compare them sorted
+			qsort (r_cachedworldsurfaces, r_numcachedworldsurfaces, sizeof (msurface_t *), (sortfunc_t) D3DSurf_SurfPtrSortFunc);
+
+			if (pass == 0)
+			{
+				memcpy (treesurfs, r_cachedworldsurfaces, r_numcachedworldsurfaces * sizeof (msurface_t *));
+				numtreesurfs = r_numcachedworldsurfaces;
+			}
+			else if (r_numcachedworldsurfaces != numtreesurfs || memcmp (treesurfs, r_cachedworldsurfaces, numtreesurfs * sizeof (msurface_t *)))
+				mismatches++;
+		}
+
+		numleafs++;
+	}
+
+	d3d_WorldBenchmark = false;
+	TempHunk->FreeToLowMark (hunkmark);
+
+	// put everything back the way it was and have the next frame redo the pvs and build the world for real
+	Vector3Copy (r_refdef.vieworigin, startorigin);
+	d3d_RenderDef.viewleaf = startleaf;
+	d3d_RenderDef.oldviewleaf = NULL;
+	vid.farclip = startfarclip;
+	D3DMain_SetupView ();
+	d3d_RenderDef.rebuildworld = true;
+
+	if (!numleafs) return;
+
+	Con_Printf ("%i leafs\n", numleafs);
+	Con_Printf ("tree walk  : %0.3f ms per leaf change\n", (passtime[0] * 1000.0) / (double) numleafs);
+	Con_Printf ("draw lists : %0.3f ms per leaf change\n", (passtime[1] * 1000.0) / (double) numleafs);
+
+	if (mismatches)
+		Con_Printf ("%i leafs had different surface sets!\n", mismatches);
+	else Con_Printf ("surface sets are identical\n");
+}
+
+
+cmd_t D3DSurf_LeafBenchmark_Cmd ("r_leafbenchmark", D3DSurf_LeafBenchmark_f);
+
+
+void D3DSurf_ExtractWorld (d3d_scene_t *scene)
+{
+	int numworldsurfs = r_numcachedworldsurfaces;
+
+	// the world packet also takes the surfaces of any merged bmodels
+	for (int i = 0; i < d3d_MergeEdicts.NumEdicts; i++)
+		numworldsurfs += d3d_MergeEdicts.Edicts[i]->model->brushhdr->nummodelsurfaces;
+
+	// brush models are submitted in the order they were extracted and the world always goes last
+	scene->SurfPackets = (d3d_surfpacket_t *) TempHunk->FastAlloc ((d3d_BrushEdicts.NumEdicts + 1) * sizeof (d3d_surfpacket_t));
+	scene->NumSurfPackets = 0;
 
 	// add any brush models we got first as they are more likely to
 	// be occluded by the world than occlude the world
 	for (int i = 0; i < d3d_BrushEdicts.NumEdicts; i++)
-	{
-		entity_t *ent = d3d_BrushEdicts.Edicts[i];
-		D3DSurf_DrawBrushModel (ent);
-	}
+		D3DSurf_ExtractBrushModel (scene, d3d_BrushEdicts.Edicts[i]);
+
+	d3d_surfpacket_t *packet = &scene->SurfPackets[scene->NumSurfPackets++];
+
+	packet->ent = &d3d_RenderDef.worldentity;
+	packet->surfs = (msurface_t **) TempHunk->FastAlloc (numworldsurfs * sizeof (msurface_t *));
+	packet->numsurfs = 0;
+	packet->lighting = PACKET_LIGHT_DEFERRED;
 
 	// go to a new dynamic frame because otherwise we'll inherit it from the prev bmodel
 	D3DLight_NewDynamicFrame ();
@@ -983,7 +1595,7 @@ void D3DSurf_DrawWorld (void)
 		entity_t *ent = d3d_MergeEdicts.Edicts[i];
 		model_t *mod = ent->model;
 
-		if (R_CullBox (&ent->cullinfo))
+		if (R_CullBox (&ent->cullinfo) || R_OccludeBox (&ent->cullinfo))
 		{
 			// mark as not visible
 			ent->visframe = -1;
@@ -1000,7 +1612,7 @@ void D3DSurf_DrawWorld (void)
 		Vector3Copy (ent->modelorg, r_refdef.vieworigin);
 
 		// these don't go a new dynamic frame and pretend that they belong to the world
-		D3DSurf_DrawBModelSurfaces (&d3d_RenderDef.worldentity, mod->brushhdr);
+		D3DSurf_ExtractBModelSurfaces (packet, &d3d_RenderDef.worldentity, mod->brushhdr);
 	}
 
 	// chain up the world now
@@ -1011,12 +1623,76 @@ void D3DSurf_DrawWorld (void)
 	{
 		msurface_t *surf = r_cachedworldsurfaces[i];
 
-		D3DSurf_ChainSurface (surf, &d3d_RenderDef.worldentity);
+		D3DSurf_ExtractSurface (packet, surf, &d3d_RenderDef.worldentity);
 		surf->visframe = d3d_RenderDef.framecount;
 	}
+}
+
+
+void D3DSurf_BuildDeferredLightmaps (d3d_scene_t *scene)
+{
+	// nothing else may change the dynamic frame until this is done as the world's dlights were pushed for the current one
+	for (int i = 0; i < scene->NumSurfPackets; i++)
+	{
+		d3d_surfpacket_t *packet = &scene->SurfPackets[i];
+
+		if (packet->lighting != PACKET_LIGHT_DEFERRED) continue;
+
+		for (int s = 0; s < packet->numsurfs; s++)
+			D3DLight_CheckSurfaceForModification (packet->surfs[s]);
+	}
+}
+
+
+void D3DSurf_SubmitPacket (d3d_surfpacket_t *packet)
+{
+	entity_t *ent = packet->ent;
+
+	if (packet->lighting == PACKET_LIGHT_SUBMIT)
+	{
+		brushhdr_t *hdr = ent->model->brushhdr;
+
+		// go to a new dynamic frame because this is a shared model
+		D3DLight_NewDynamicFrame ();
+		D3DLight_PushDynamics (ent, hdr->nodes + hdr->hulls[0].firstclipnode);
+
+		for (int i = 0; i < packet->numsurfs; i++)
+			D3DSurf_ChainCommon (ent, packet->surfs[i], packet->surfs[i]->texinfo->texture);
+	}
+	else
+	{
+		// lightmaps were already built during extraction
+		for (int i = 0; i < packet->numsurfs; i++)
+		{
+			msurface_t *surf = packet->surfs[i];
+
+			D3DSurf_AddToTextureChain (surf, surf->texinfo->texture);
+			ent->BrushDrawFlags |= surf->flags;
+		}
+	}
+
+	if (ent->BrushDrawFlags)
+	{
+		extern ID3D11RasterizerState *d3d_RSZFighting;
+
+		if (r_usingdepthbias && ent->model->name[0] == '*')
+		{
+			d3d11_State->RSSetState (d3d_RSZFighting);
+			D3DSurf_DrawTextureChains (ent, 255);
+			d3d11_State->RSSetState (d3d_RS3DView);
+		}
+		else D3DSurf_DrawTextureChains (ent, 255);
+	}
+}
+
+
+void D3DSurf_DrawWorld (d3d_scene_t *scene)
+{
+	D3DBrush_BeginSurfaces ();
 
-	// and now draw the world
-	D3DSurf_DrawTextureChains (&d3d_RenderDef.worldentity, 255);
+	// texture chains are shared by every entity using a model so each packet is chained and drawn in turn
+	for (int i = 0; i < scene->NumSurfPackets; i++)
+		D3DSurf_SubmitPacket (&scene->SurfPackets[i]);
 }
 
 
@@ -1084,6 +1760,14 @@ void D3DSurf_LeafVisibility (byte *vis)
 	// mark leafs and surfaces as visible
 	for (int i = 0; i < cl.worldmodel->brushhdr->numleafs; i++, leaf++)
 	{
+		// skip 8 leafs at a time through the empty parts of the pvs
+		if (vis && !(i & 7) && !vis[i >> 3])
+		{
+			i += 7;
+			leaf += 7;
+			continue;
+		}
+
 		if (!vis || (vis[i >> 3] & (1 << (i & 7))))
 		{
 			// note - nodes and leafs need to be in consecutive memory for this to work so
@@ -1105,24 +1789,65 @@ void D3DSurf_LeafVisibility (byte *vis)
 }
 
 
+void D3DSurf_MergeLeafRuns (byte *vis)
+{
+	brushhdr_t *hdr = cl.worldmodel->brushhdr;
+
+	d3d_NumPVSSurfs = 0;
+	d3d_NumPVSLeafs = 0;
+
+	for (int i = 0; i < hdr->numleafs; i++)
+	{
+		// skip 8 leafs at a time through the empty parts of the pvs
+		if (!(i & 7) && !vis[i >> 3])
+		{
+			i += 7;
+			continue;
+		}
+
+		if (!(vis[i >> 3] & (1 << (i & 7)))) continue;
+
+		// pvs bit i is for leaf i + 1; see D3DSurf_LeafVisibility
+		mleaf_t *leaf = &hdr->leafs[i + 1];
+
+		if (leaf->contents >= 0) continue;
+		if (leaf->contents == CONTENTS_SOLID) continue;
+
+		for (int r = d3d_LeafFirstRun[i + 1]; r < d3d_LeafFirstRun[i + 2]; r++)
+			d3d_RankBits[d3d_LeafRuns[r] >> 5] |= (1u << (d3d_LeafRuns[r] & 31));
+
+		d3d_PVSLeafs[d3d_NumPVSLeafs++] = leaf;
+	}
+
+	// read back in texture order; surfs which are in more than one leaf only come out once
+	for (int i = 0, numwords = (hdr->numsurfaces + 31) >> 5; i < numwords; i++)
+	{
+		unsigned bits = d3d_RankBits[i];
+
+		if (!bits) continue;
+
+		for (int b = 0; b < 32; b++)
+			if (bits & (1u << b)) d3d_PVSSurfs[d3d_NumPVSSurfs++] = d3d_RankedSurfs[(i << 5) + b];
+
+		d3d_RankBits[i] = 0;
+	}
+}
+
+
 void D3DSurf_MarkLeaves (void)
 {
 	// viewleaf hasn't changed or we're drawing with a locked PVS
 	if ((d3d_RenderDef.oldviewleaf == d3d_RenderDef.viewleaf) || r_lockpvs.value) return;
 
-	// go to a new visframe
-	d3d_RenderDef.visframecount++;
+	int pvsbytes = (cl.worldmodel->brushhdr->numleafs + 7) >> 3;
 
-	// rebuild the world lists
-	d3d_RenderDef.rebuildworld = true;
-
-	// add in visible leafs - we always add the fat PVS to ensure that client visibility
+	// gather visible leafs - we always add the fat PVS to ensure that client visibility
 	// is the same as that which was used by the server; R_CullBox will take care of unwanted leafs
 	if (r_novis.integer)
-		D3DSurf_LeafVisibility (NULL);
+		memset (d3d_NewPVS, 0xff, pvsbytes);
 	else if (d3d_RenderDef.viewleaf->flags & SURF_DRAWTURB)
-		D3DSurf_LeafVisibility (Mod_FatPVS (r_refdef.vieworigin));
-	else D3DSurf_LeafVisibility (Mod_LeafPVS (d3d_RenderDef.viewleaf, cl.worldmodel));
+		memcpy (d3d_NewPVS, Mod_FatPVS (r_refdef.vieworigin), pvsbytes);
+	else memcpy (d3d_NewPVS, Mod_LeafPVS (d3d_RenderDef.viewleaf, cl.worldmodel), pvsbytes);
 
 	// no old viewleaf so can't make a transition check
 	if (d3d_RenderDef.oldviewleaf)
@@ -1136,8 +1861,32 @@ void D3DSurf_MarkLeaves (void)
 		else if (!r_novis.integer && ((d3d_RenderDef.viewleaf->flags & SURF_DRAWTURB) || (d3d_RenderDef.oldviewleaf->flags & SURF_DRAWTURB)))
 		{
 			// we've had a contents transition so merge the old pvs with the new
-			D3DSurf_LeafVisibility (Mod_LeafPVS (d3d_RenderDef.oldviewleaf, cl.worldmodel));
+			byte *oldvis = Mod_LeafPVS (d3d_RenderDef.oldviewleaf, cl.worldmodel);
+
+			for (int i = 0; i < pvsbytes; i++)
+				d3d_NewPVS[i] |= oldvis[i];
+		}
+	}
+
+	// moving to a leaf that sees the same set as the last one doesn't need anything to be redone
+	// (any forced recache comes through with no oldviewleaf so it will always redo it)
+	if (!d3d_RenderDef.oldviewleaf || memcmp (d3d_NewPVS, d3d_CurrPVS, pvsbytes))
+	{
+		memcpy (d3d_CurrPVS, d3d_NewPVS, pvsbytes);
+
+		// go to a new visframe
+		d3d_RenderDef.visframecount++;
+
+		// rebuild the world lists
+		d3d_RenderDef.rebuildworld = true;
+
+		// the draw lists don't use the node visframes but occluders are picked by them so they're marked for that
+		if (r_pvsdrawlists.integer)
+		{
+			D3DSurf_MergeLeafRuns (d3d_CurrPVS);
+			if (r_occlusion.integer) D3DSurf_LeafVisibility (d3d_CurrPVS);
 		}
+		else D3DSurf_LeafVisibility (d3d_CurrPVS);
 	}
 
 	// we've now completed the PVS change
@@ -33,10 +33,26 @@ For more information, please refer to <http://unlicense.org/>
 
 std::vector<QTEXTURE *> d3d11_Textures;
 
+// Flush moves all free slots to the start of the list
+int d3d11_NumFreeTextures = 0;
+
 QTEXTURE QTEXTURE::WhiteTexture;
 QTEXTURE QTEXTURE::GreyTexture;
 QTEXTURE QTEXTURE::BlackTexture;
 
+QTEXTURE *QTEXTURE::Registry[TEXTURE_REGISTRY_SIZE];
+
+// registry stats for the current map load
+struct texregstats_t
+{
+	int hits;
+	int misses;
+	int hashbytes;
+	double hashtime;
+};
+
+texregstats_t d3d_TexRegStats;
+
 byte *D3DImage_LoadTGA (byte *f, int *width, int *height);
 byte *D3DImage_LoadPCX (byte *f, int *width, int *height);
 
@@ -86,6 +102,7 @@ void D3D11Texture_Shutdown (void)
 		SAFE_DELETE (d3d11_Textures[i]);
 
 	d3d11_Textures.clear ();
+	d3d11_NumFreeTextures = 0;
 }
 
 
@@ -117,13 +134,9 @@ hashhacker_t d3d_HashHacks[] =
 	{{143, 106, 19, 206, 242, 171, 137, 86, 161, 74, 156, 217, 85, 10, 120, 149}, NULL, "sky1_alpha"},
 };
 
+// these are md5s of the original 8-bit data so they're only computed on the paths that can use them
 byte ShotgunShells[] = {202, 6, 69, 163, 17, 112, 190, 234, 102, 56, 225, 242, 212, 175, 27, 187};
 
-// this was generated from a word doc on my own PC
-// while MD5 collisions are possible, they are sufficiently unlikely in the context of
-// a poxy game engine.  this ain't industrial espionage, folks!
-byte no_match_hash[] = {0x40, 0xB4, 0x54, 0x7D, 0x9D, 0xDA, 0x9D, 0x0B, 0xCF, 0x42, 0x70, 0xEE, 0xF1, 0x88, 0xBE, 0x99};
-
 // nehahra sends some textures with 0 width and height (eeewww!  more hacks!)
 // (these are set to entry 0 so that they don't get misidentified as luma)
 // this must be unsigned so that it won't overflow with 32-bit texes
@@ -132,11 +145,11 @@ unsigned nulldata[] = {0, 0, 0, 0};
 
 QTEXTURE::QTEXTURE (void)
 {
-	this->InitData ("", 0, 0, 0, no_match_hash);
+	this->InitData ("", 0, 0, 0, 0);
 }
 
 
-QTEXTURE::QTEXTURE (char *_identifier, int _width, int _height, int _flags, byte *_hash)
+QTEXTURE::QTEXTURE (char *_identifier, int _width, int _height, int _flags, unsigned __int64 _hash)
 {
 	this->InitData (_identifier, _width, _height, _flags, _hash);
 }
@@ -194,7 +207,7 @@ D3DX11_IMAGE_LOAD_INFO *QTEXTURE::ImageLoadInfo (void)
 }
 
 
-void QTEXTURE::InitData (char *_identifier, int _width, int _height, int _flags, byte *_hash)
+void QTEXTURE::InitData (char *_identifier, int _width, int _height, int _flags, unsigned __int64 _hash)
 {
 	if (_identifier)
 		strcpy (this->identifier, _identifier);
@@ -204,14 +217,55 @@ void QTEXTURE::InitData (char *_identifier, int _width, int _height, int _flags,
 	this->height = _height;
 	this->flags = _flags;
 	this->LastUsage = 0;
+	this->hash = _hash;
 
-	Q_MemCpy (this->hash, _hash, 16);
+	this->RegistryNext = NULL;
+	this->RegistryIndex = -1;
 
 	this->Texture2D = NULL;
 	this->SRV = NULL;
 }
 
 
+int QTEXTURE::RegistryChain (char *_identifier, int _width, int _height, int _flags, unsigned __int64 _hash)
+{
+	// everything MatchWith compares goes into the key so that chains only hold real candidates
+	unsigned __int64 key = _hash ^ COM_FastHash (_identifier, strlen (_identifier));
+
+	key ^= ((unsigned __int64) _width << 32) | ((unsigned __int64) _height << 1) | ((_flags & IMAGE_LUMA) ? 1 : 0);
+	key ^= key >> 29;
+	key ^= key >> 17;
+
+	return (int) (key & (TEXTURE_REGISTRY_SIZE - 1));
+}
+
+
+void QTEXTURE::LinkRegistry (void)
+{
+	this->RegistryIndex = QTEXTURE::RegistryChain (this->identifier, this->width, this->height, this->flags, this->hash);
+	this->RegistryNext = QTEXTURE::Registry[this->RegistryIndex];
+	QTEXTURE::Registry[this->RegistryIndex] = this;
+}
+
+
+void QTEXTURE::UnlinkRegistry (void)
+{
+	if (this->RegistryIndex < 0) return;
+
+	for (QTEXTURE **tex = &QTEXTURE::Registry[this->RegistryIndex]; *tex; tex = &(*tex)->RegistryNext)
+	{
+		if (*tex == this)
+		{
+			*tex = this->RegistryNext;
+			break;
+		}
+	}
+
+	this->RegistryNext = NULL;
+	this->RegistryIndex = -1;
+}
+
+
 void QTEXTURE::SetObjectNames (char *texname, char *srvname)
 {
 	if (!this->identifier[0]) return;
@@ -234,7 +288,7 @@ void QTEXTURE::SetObjectNames (void)
 }
 
 
-bool QTEXTURE::MatchWith (char *_identifier, int _width, int _height, int _flags, byte *_hash)
+bool QTEXTURE::MatchWith (char *_identifier, int _width, int _height, int _flags, unsigned __int64 _hash)
 {
 	if (!_identifier) return false;
 
@@ -246,7 +300,7 @@ bool QTEXTURE::MatchWith (char *_identifier, int _width, int _height, int _flags
 	if (this->height != _height) return false;
 
 	// compare the hash and reuse if it matches
-	if (!COM_CheckHash (this->hash, _hash)) return false;
+	if (this->hash != _hash) return false;
 
 	// check for luma match as the incoming luma will get the same hash as it's base
 	// we can't compare flags directly as incoming flags may be changed
@@ -259,7 +313,8 @@ bool QTEXTURE::MatchWith (char *_identifier, int _width, int _height, int _flags
 
 void QTEXTURE::SetUnused (void)
 {
-	Q_MemCpy (this->hash, no_match_hash, 16);
+	// taking it out of the registry ensures that it will never be matched again
+	this->UnlinkRegistry ();
 	this->LastUsage = 666;
 }
 
@@ -643,6 +698,335 @@ D3D11_SUBRESOURCE_DATA *QTEXTURE::BuildMipLevels (byte *data, int width, int hei
 }
 
 
+/*
+==============================================================================
+
+DECODED TEXTURE CACHE
+
+External replacement textures are cached on disk after decoding and mipmapping so that the next load can just map the
+file and hand the levels to CreateTexture2D.  Entries are keyed on the source file's name, size and write time plus the
+load flags, and the least recently used ones are evicted when the cache goes over gl_texcachesize MB.
+
+==============================================================================
+*/
+
+cvar_t gl_texcache ("gl_texcache", "1", CVAR_ARCHIVE);
+cvar_t gl_texcachesize ("gl_texcachesize", "512", CVAR_ARCHIVE);
+
+#define TEX_CACHE_IDENT		(('C' << 24) + ('X' << 16) + ('E' << 8) + 'T')
+#define TEX_CACHE_VERSION	2
+#define TEX_CACHE_MAXLEVELS	16
+
+struct texcachekey_t
+{
+	char *name;
+	int srcsize;
+	unsigned __int64 srctime;
+	int flags;
+};
+
+struct texcacheheader_t
+{
+	int ident;
+	int version;
+	unsigned __int64 srctime;
+	int srcsize;
+	int flags;
+
+	// flags that Upload was called with, which may differ from the load flags
+	int uploadflags;
+
+	// what the texture's own flags were left as after a cold load, so a warm one ends up the same
+	int texflags;
+
+	int format;
+	int width;
+	int height;
+	int numlevels;
+	int datasize;
+};
+
+struct texcachestats_t
+{
+	int hits;
+	int misses;
+	int written;
+	int evicted;
+	double loadtime;
+	double decodetime;
+	double mbread;
+	double mbwritten;
+};
+
+texcachestats_t d3d_TexCacheStats;
+
+// set while an external texture is being decoded so that Upload can write out the final texels
+texcachekey_t *d3d_TexCachePending = NULL;
+
+
+void D3DTexCache_GetPath (char *path, texcachekey_t *key)
+{
+	char cachename[MAX_PATH];
+
+	// flatten the name so that everything goes in one directory
+	Q_strncpy (cachename, key->name, MAX_PATH - 1);
+
+	for (int i = 0; cachename[i]; i++)
+		if (cachename[i] == '/' || cachename[i] == '\\' || cachename[i] == '#')
+			cachename[i] = '_';
+
+	Q_snprintf (path, MAX_PATH, "%s/cache/textures/%s.%08x", com_gamedir, cachename, key->flags);
+}
+
+
+int D3DTexCache_NumLevels (int width, int height, int flags)
+{
+	int numlevels = 1;
+
+	// same as BuildMipLevels
+	if (flags & IMAGE_MIPMAP)
+	{
+		while (width > 1 || height > 1)
+		{
+			if ((width = width >> 1) < 1) width = 1;
+			if ((height = height >> 1) < 1) height = 1;
+
+			numlevels++;
+		}
+	}
+
+	return numlevels;
+}
+
+
+void D3DTexCache_Write (texcachekey_t *key, D3D11_SUBRESOURCE_DATA *srd, int width, int height, int flags, int texflags)
+{
+	char path[MAX_PATH];
+	texcacheheader_t header;
+
+	header.ident = TEX_CACHE_IDENT;
+	header.version = TEX_CACHE_VERSION;
+	header.srctime = key->srctime;
+	header.srcsize = key->srcsize;
+	header.flags = key->flags;
+	header.uploadflags = flags;
+	header.texflags = texflags;
+	header.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	header.width = width;
+	header.height = height;
+	header.numlevels = D3DTexCache_NumLevels (width, height, flags);
+	header.datasize = 0;
+
+	if (header.numlevels > TEX_CACHE_MAXLEVELS) return;
+
+	for (int i = 0; i < header.numlevels; i++)
+	{
+		header.datasize += srd[i].SysMemPitch * height;
+		if ((height = height >> 1) < 1) height = 1;
+	}
+
+	Sys_mkdir ("cache/textures");
+	D3DTexCache_GetPath (path, key);
+
+	std::ofstream f (path, std::ios::out | std::ios::binary);
+
+	if (!f.is_open ()) return;
+
+	f.write ((char *) &header, sizeof (header));
+
+	// levels are tightly packed so the pitch is all we need to write each one
+	for (int i = 0, h = header.height; i < header.numlevels; i++)
+	{
+		f.write ((char *) srd[i].pSysMem, srd[i].SysMemPitch * h);
+		if ((h = h >> 1) < 1) h = 1;
+	}
+
+	f.close ();
+
+	d3d_TexCacheStats.written++;
+	d3d_TexCacheStats.mbwritten += (double) (header.datasize + sizeof (header)) / (1024.0 * 1024.0);
+}
+
+
+bool QTEXTURE::LoadCached (texcachekey_t *key)
+{
+	char path[MAX_PATH];
+	bool succeeded = false;
+	double loadstart = Sys_ProfileTime ();
+
+	D3DTexCache_GetPath (path, key);
+
+	// write attributes is needed to touch the file for lru
+	HANDLE fh = CreateFile (path, FILE_READ_DATA | FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (fh == INVALID_HANDLE_VALUE)
+	{
+		d3d_TexCacheStats.misses++;
+		return false;
+	}
+
+	DWORD filesize = GetFileSize (fh, NULL);
+	HANDLE mh = NULL;
+	texcacheheader_t *header = NULL;
+
+	if (filesize > sizeof (texcacheheader_t) && (mh = CreateFileMapping (fh, NULL, PAGE_READONLY, 0, 0, NULL)) != NULL)
+		header = (texcacheheader_t *) MapViewOfFile (mh, FILE_MAP_READ, 0, 0, 0);
+
+	// a stale or mismatched entry is just ignored and will be overwritten when the texture is decoded
+	if (header &&
+		header->ident == TEX_CACHE_IDENT &&
+		header->version == TEX_CACHE_VERSION &&
+		header->srctime == key->srctime &&
+		header->srcsize == key->srcsize &&
+		header->flags == key->flags &&
+		header->format == DXGI_FORMAT_R8G8B8A8_UNORM &&
+		header->width > 0 && header->height > 0 &&
+		header->numlevels > 0 && header->numlevels <= TEX_CACHE_MAXLEVELS &&
+		header->datasize + sizeof (texcacheheader_t) == filesize)
+	{
+		D3D11_SUBRESOURCE_DATA srd[TEX_CACHE_MAXLEVELS];
+		D3D11_TEXTURE2D_DESC *desc = QTEXTURE::MakeTextureDesc (header->width, header->height, header->uploadflags);
+		byte *texels = (byte *) (header + 1);
+
+		for (int i = 0, w = header->width, h = header->height; i < header->numlevels; i++)
+		{
+			QTEXTURE::SetMipData (&srd[i], texels, w * 4);
+			texels += w * h * 4;
+
+			if ((w = w >> 1) < 1) w = 1;
+			if ((h = h >> 1) < 1) h = 1;
+		}
+
+		// straight from the mapping to the texture
+		desc->MipLevels = header->numlevels;
+		this->CreateTextureAndSRV (desc, srd);
+
+		if (this->Texture2D)
+		{
+			FILETIME ft;
+
+			this->flags = header->texflags;
+
+			// touch it so that lru eviction sees it as used
+			GetSystemTimeAsFileTime (&ft);
+			SetFileTime (fh, NULL, NULL, &ft);
+
+			d3d_TexCacheStats.mbread += (double) filesize / (1024.0 * 1024.0);
+			succeeded = true;
+		}
+	}
+
+	if (header) UnmapViewOfFile (header);
+	if (mh) CloseHandle (mh);
+	CloseHandle (fh);
+
+	if (succeeded)
+	{
+		d3d_TexCacheStats.hits++;
+		d3d_TexCacheStats.loadtime += Sys_ProfileTime () - loadstart;
+	}
+	else d3d_TexCacheStats.misses++;
+
+	return succeeded;
+}
+
+
+struct texcachefile_t
+{
+	char name[MAX_PATH];
+	unsigned __int64 lastused;
+	int size;
+};
+
+
+int D3DTexCache_SortFunc (texcachefile_t *a, texcachefile_t *b)
+{
+	// oldest first
+	if (a->lastused < b->lastused) return -1;
+	if (a->lastused > b->lastused) return 1;
+
+	return 0;
+}
+
+
+double D3DTexCache_Enumerate (std::vector<texcachefile_t> &files)
+{
+	WIN32_FIND_DATA FindFileData;
+	texcachefile_t tcf;
+	char path[MAX_PATH];
+	double totalmb = 0;
+
+	Q_snprintf (path, MAX_PATH, "%s/cache/textures/*", com_gamedir);
+
+	HANDLE hFind = FindFirstFile (path, &FindFileData);
+
+	if (hFind == INVALID_HANDLE_VALUE) return 0;
+
+	do
+	{
+		if (FindFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+
+		Q_snprintf (tcf.name, MAX_PATH, "%s/cache/textures/%s", com_gamedir, FindFileData.cFileName);
+		tcf.lastused = ((unsigned __int64) FindFileData.ftLastWriteTime.dwHighDateTime << 32) | FindFileData.ftLastWriteTime.dwLowDateTime;
+		tcf.size = FindFileData.nFileSizeLow;
+
+		totalmb += (double) tcf.size / (1024.0 * 1024.0);
+		files.push_back (tcf);
+	} while (FindNextFile (hFind, &FindFileData));
+
+	FindClose (hFind);
+
+	return totalmb;
+}
+
+
+void D3DTexCache_Evict (void)
+{
+	std::vector<texcachefile_t> files;
+	double totalmb = D3DTexCache_Enumerate (files);
+
+	if (gl_texcachesize.value > 0 && totalmb > gl_texcachesize.value)
+	{
+		// go down to 90% so that we're not evicting on every map
+		double targetmb = gl_texcachesize.value * 0.9;
+
+		qsort (&files[0], files.size (), sizeof (texcachefile_t), (sortfunc_t) D3DTexCache_SortFunc);
+
+		for (int i = 0; i < files.size () && totalmb > targetmb; i++)
+		{
+			if (!DeleteFile (files[i].name)) continue;
+
+			totalmb -= (double) files[i].size / (1024.0 * 1024.0);
+			d3d_TexCacheStats.evicted++;
+		}
+	}
+}
+
+
+void D3DTexCache_Stats_f (void)
+{
+	std::vector<texcachefile_t> files;
+	double totalmb = D3DTexCache_Enumerate (files);
+
+	Con_Printf ("%i cached textures using %0.1f MB of %i MB\n", (int) files.size (), totalmb, gl_texcachesize.integer);
+	Con_Printf ("%i hits, %i misses, %i written, %i evicted\n", d3d_TexCacheStats.hits, d3d_TexCacheStats.misses, d3d_TexCacheStats.written, d3d_TexCacheStats.evicted);
+	Con_Printf ("%0.1f MB read in %0.3f ms\n", d3d_TexCacheStats.mbread, (float) (d3d_TexCacheStats.loadtime * 1000.0));
+	Con_Printf ("%0.1f MB written\n", d3d_TexCacheStats.mbwritten);
+
+	// estimate what the hits would have cost to decode
+	if (d3d_TexCacheStats.misses && d3d_TexCacheStats.hits)
+	{
+		double decodetime = d3d_TexCacheStats.decodetime / (double) d3d_TexCacheStats.misses;
+		double saved = decodetime * d3d_TexCacheStats.hits - d3d_TexCacheStats.loadtime;
+
+		Con_Printf ("approx %0.3f ms saved\n", (float) (saved * 1000.0));
+	}
+}
+
+
+cmd_t D3DTexCache_Stats_Cmd ("texcache_stats", D3DTexCache_Stats_f);
+
+
 unsigned int *QTEXTURE::ToRGBA (byte *data, int width, int height, unsigned int *palette)
 {
 	if (palette)
@@ -731,6 +1115,13 @@ void QTEXTURE::Upload (byte *data, int width, int height, int flags, unsigned in
 
 	this->CreateTextureAndSRV (desc, srd);
 
+	// store out the final texels for an external texture
+	if (d3d_TexCachePending && this->Texture2D)
+	{
+		D3DTexCache_Write (d3d_TexCachePending, srd, width, height, flags, this->flags);
+		d3d_TexCachePending = NULL;
+	}
+
 	TempHunk->FreeToLowMark (HunkMark);
 }
 
@@ -752,7 +1143,7 @@ bool QTEXTURE::HasLuma (byte *_data, int _width, int _height, int _flags)
 }
 
 
-bool QTEXTURE::TryLoadExternal (char **_paths)
+bool QTEXTURE::TryLoadExternal (char **_paths, byte *_data)
 {
 	// explicitly don't load an external texture
 	if (this->flags & IMAGE_NOEXTERN) return false;
@@ -760,13 +1151,19 @@ bool QTEXTURE::TryLoadExternal (char **_paths)
 	// try to load an external texture using the base identifier
 	if (this->LoadExternal (this->identifier, _paths, this->flags)) return true;
 
+	// the QRP hacks are all for native 8-bit textures
+	if (this->flags & IMAGE_32BIT) return false;
+
 	// it might yet have the QRP convention so try that
 	char *qrpident = (char *) TempHunk->Alloc (256);
+	byte md5[16];
+
+	COM_HashData (md5, _data, this->width * this->height);
 
 	// try the QRP names here
 	for (int i = 0; i < ARRAYLENGTH (d3d_HashHacks); i++)
 	{
-		if (COM_CheckHash (this->hash, d3d_HashHacks[i].hash))
+		if (COM_CheckHash (md5, d3d_HashHacks[i].hash))
 		{
 			// don't mess with the original identifier as that's used for cache checks
 			strcpy (qrpident, this->identifier);
@@ -835,35 +1232,42 @@ QTEXTURE *QTEXTURE::Load (char *_identifier, int _width, int _height, byte *_dat
 	if (nehahra && (_flags & IMAGE_LUMA)) return NULL;
 
 	// take a hash of the image data
-	byte _texhash[16];
-	int slot = -1;
+	int _datasize = _width * _height * ((_flags & IMAGE_32BIT) ? 4 : 1);
+	double hashstart = Sys_ProfileTime ();
+	unsigned __int64 _texhash = COM_FastHash (_data, _datasize);
 
-	COM_HashData (_texhash, _data, _width * _height * ((_flags & IMAGE_32BIT) ? 4 : 1));
+	d3d_TexRegStats.hashtime += Sys_ProfileTime () - hashstart;
+	d3d_TexRegStats.hashbytes += _datasize;
 
-	for (int i = 0; i < d3d11_Textures.size (); i++)
+	// look for a texture we can reuse
+	for (QTEXTURE *reg = QTEXTURE::Registry[QTEXTURE::RegistryChain (_identifier, _width, _height, _flags, _texhash)]; reg; reg = reg->RegistryNext)
 	{
-		if (!d3d11_Textures[i])
+		if (reg->MatchWith (_identifier, _width, _height, _flags, _texhash))
 		{
-			slot = i;
-			continue;
-		}
-
-		if (d3d11_Textures[i]->MatchWith (_identifier, _width, _height, _flags, _texhash))
-		{
-			d3d11_Textures[i]->Reuse ();
+			reg->Reuse ();
+			d3d_TexRegStats.hits++;
 			Con_DPrintf ("reused %s%s\n", _identifier, (_flags & IMAGE_LUMA) ? "_luma" : "");
-			return d3d11_Textures[i];
+			return reg;
 		}
 	}
 
+	d3d_TexRegStats.misses++;
+
 	QTEXTURE *tex = new QTEXTURE (_identifier, _width, _height, _flags, _texhash);
 
 	// fix white line at base of shotgun shells box
-	if (COM_CheckHash (_texhash, ShotgunShells)) Q_MemCpy (_data, _data + 32 * 31, 32);
+	if (_width == 32 && !(_flags & IMAGE_32BIT))
+	{
+		byte md5[16];
+
+		COM_HashData (md5, _data, _datasize);
+
+		if (COM_CheckHash (md5, ShotgunShells)) Q_MemCpy (_data, _data + 32 * 31, 32);
+	}
 
 #if 1
 	// try for external, then fall back on native
-	if (!tex->TryLoadExternal (_paths))
+	if (!tex->TryLoadExternal (_paths, _data))
 	{
 		if (!tex->TryLoadNative (_data))
 		{
@@ -886,13 +1290,11 @@ QTEXTURE *QTEXTURE::Load (char *_identifier, int _width, int _height, byte *_dat
 #endif
 
 	// now add it to the list only after it's been loaded OK
-	if (slot == -1)
-	{
-		d3d11_Textures.push_back (tex);
-		tex = d3d11_Textures[d3d11_Textures.size () - 1];
-	}
-	else d3d11_Textures[slot] = tex;
+	if (d3d11_NumFreeTextures > 0)
+		d3d11_Textures[--d3d11_NumFreeTextures] = tex;
+	else d3d11_Textures.push_back (tex);
 
+	tex->LinkRegistry ();
 	tex->SetObjectNames ();
 
 	return tex;
@@ -958,7 +1360,7 @@ bool QTEXTURE::LoadExternal (char *filename, char **paths, int flags)
 	char namebuf[256];
 	char basename[256];
 	int hunkmark = TempHunk->GetLowMark ();
-	byte *data = NULL;
+	CQuakeFile f;
 	bool succeeded = false;
 
 	// copy off the file name so that we can change it safely
@@ -987,21 +1389,23 @@ bool QTEXTURE::LoadExternal (char *filename, char **paths, int flags)
 				sprintf (namebuf, "%s%s_luma.%s", paths[i], basename, textureextensions[j]);
 			else sprintf (namebuf, "%s%s.%s", paths[i], basename, textureextensions[j]);
 
-			if ((data = (byte *) CQuakeFile::LoadFile (namebuf, TempHunk)) == NULL)
+			if (!f.Open (namebuf))
 			{
 				if (flags & IMAGE_LUMA)
 					sprintf (namebuf, "%s%s_glow.%s", paths[i], basename, textureextensions[j]);
 				else continue;
 
-				if ((data = (byte *) CQuakeFile::LoadFile (namebuf, TempHunk)) == NULL) continue;
+				if (!f.Open (namebuf)) continue;
 			}
 
 			if (j == 0)
 			{
 				// got a link file so use it instead
-				char *linkname = (char *) data;
+				char *linkname = (char *) f.CopyAlloc (TempHunk);
 				int type = TEXTYPE_DDS;
 
+				f.Close ();
+
 				// weenix loonies
 				_strlwr (linkname);
 
@@ -1015,17 +1419,17 @@ bool QTEXTURE::LoadExternal (char *filename, char **paths, int flags)
 				// .link assumes the same path
 				sprintf (namebuf, "%s%s", paths[i], linkname);
 
-				if ((data = (byte *) CQuakeFile::LoadFile (namebuf, TempHunk)) != NULL)
+				if (f.Open (namebuf))
 				{
 					Con_DPrintf ("got a file : %s\n", namebuf);
-					succeeded = this->CreateExternal (data, type, flags);
+					succeeded = this->LoadExternalFile (&f, namebuf, type, flags);
 					goto done;
 				}
 			}
 			else
 			{
 				Con_DPrintf ("got a file : %s\n", namebuf);
-				succeeded = this->CreateExternal (data, j, flags);
+				succeeded = this->LoadExternalFile (&f, namebuf, j, flags);
 				goto done;
 			}
 		}
@@ -1037,6 +1441,36 @@ done:;
 }
 
 
+bool QTEXTURE::LoadExternalFile (CQuakeFile *f, char *filename, int type, int flags)
+{
+	// dds goes up directly so there's nothing to be gained from caching it
+	bool usecache = (gl_texcache.integer && type != TEXTYPE_DDS);
+	texcachekey_t key = {filename, f->GetLength (), f->GetWriteTime (), flags};
+
+	if (usecache && this->LoadCached (&key))
+	{
+		f->Close ();
+		return true;
+	}
+
+	byte *data = (byte *) f->CopyAlloc (TempHunk);
+	double decodestart = Sys_ProfileTime ();
+
+	f->Close ();
+
+	// Upload will write it to the cache when it has the final texels
+	if (usecache) d3d_TexCachePending = &key;
+
+	bool succeeded = this->CreateExternal (data, type, flags);
+
+	d3d_TexCachePending = NULL;
+
+	if (usecache && succeeded) d3d_TexCacheStats.decodetime += Sys_ProfileTime () - decodestart;
+
+	return succeeded;
+}
+
+
 void QTEXTURE::Flush (void)
 {
 	int numflush = 0;
@@ -1044,7 +1478,9 @@ void QTEXTURE::Flush (void)
 	// sanity check - always retain for at least 3 maps (current plus 2 more)
 	if (gl_maxtextureretention.value < 3) gl_maxtextureretention.Set (3);
 
-	for (int i = 0, startpos = 0; i < d3d11_Textures.size (); i++)
+	int startpos = 0;
+
+	for (int i = 0; i < d3d11_Textures.size (); i++)
 	{
 		// already flushed
 		if (d3d11_Textures[i])
@@ -1063,7 +1499,33 @@ void QTEXTURE::Flush (void)
 		startpos++;
 	}
 
+	d3d11_NumFreeTextures = startpos;
+
+	// keep the decoded texture cache inside its limit if this map added to it
+	static int lastwritten = 0;
+
+	if (d3d_TexCacheStats.written != lastwritten)
+	{
+		D3DTexCache_Evict ();
+		lastwritten = d3d_TexCacheStats.written;
+	}
+
 	if (numflush) Con_DPrintf ("Flushed %i textures\n", numflush);
+
+	// this is called after all of the map's textures have been loaded so report on them now
+	if (d3d_TexRegStats.hits + d3d_TexRegStats.misses)
+	{
+		Con_DPrintf
+		(
+			"Textures: %i reused, %i loaded, %0.1f MB hashed in %0.3f ms\n",
+			d3d_TexRegStats.hits,
+			d3d_TexRegStats.misses,
+			(float) d3d_TexRegStats.hashbytes / (1024.0f * 1024.0f),
+			(float) (d3d_TexRegStats.hashtime * 1000.0)
+		);
+	}
+
+	memset (&d3d_TexRegStats, 0, sizeof (texregstats_t));
 }
 
 
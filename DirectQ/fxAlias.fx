@@ -41,6 +41,9 @@ Texture2D tex3 : register(t3);
 Texture2D tex4 : register(t4);
 Texture3D texNoise : register(t5);
 
+// persistent per-entity instance data; 6 float4s per slot laid out as aliasinstance_t
+Buffer<float4> instanceData : register(t6);
+
 
 struct VS_MESH
 {
@@ -58,10 +61,7 @@ struct VS_INSTANCED
 	float4 LastPos : LASTPOS;
 	float3 LastNorm : LASTNORMAL;
 	float2 Tex : TEXCOORD;
-	matrix modelMatrix : TRANSFORM;
-	float4 shadelight : SHADELIGHT;
-	float3 shadevector : SHADEVECTOR;
-	float blend : BLEND;
+	uint Slot : INSTANCESLOT;
 };
 
 struct VS_VIEWMODEL
@@ -153,11 +153,21 @@ PS_MESH InstancedVS (VS_INSTANCED vs_in)
 {
 	PS_MESH vs_out;
 
-	vs_out.Pos = mul (vs_in.modelMatrix, lerp (vs_in.LastPos, vs_in.CurrPos, vs_in.blend));
+	int base = vs_in.Slot * 6;
+	float4 shadevectorblend = instanceData.Load (base + 5);
+	float4 Pos = lerp (vs_in.LastPos, vs_in.CurrPos, shadevectorblend.w);
+
+	// instance matrices are stored in world space so that they stay valid when the view changes
+	float4 WorldPos = instanceData.Load (base + 0) * Pos.x +
+		instanceData.Load (base + 1) * Pos.y +
+		instanceData.Load (base + 2) * Pos.z +
+		instanceData.Load (base + 3) * Pos.w;
+
+	vs_out.Pos = mul (worldMatrix, WorldPos);
 	vs_out.Tex = vs_in.Tex;
-	vs_out.normal = lerp (vs_in.LastNorm, vs_in.CurrNorm, vs_in.blend);
-	vs_out.shadelight = vs_in.shadelight;
-	vs_out.shadevector = vs_in.shadevector;
+	vs_out.normal = lerp (vs_in.LastNorm, vs_in.CurrNorm, shadevectorblend.w);
+	vs_out.shadelight = instanceData.Load (base + 4);
+	vs_out.shadevector = shadevectorblend.xyz;
 
 	return vs_out;
 }
@@ -854,11 +854,16 @@ FIXME: this is a callback from Sys_Quit and Sys_Error.  It would be better
 to run quit through here before the final handoff to the sys code.
 ===============
 */
+void Host_WaitForSaveWriter (void);
+
 void Host_ShutdownGame (void)
 {
 	// keep Con_Printf from trying to update the screen
 	Host_DisableForLoading (true);
 
+	// let any binary save finish writing
+	Host_WaitForSaveWriter ();
+
 	Host_WriteConfiguration ();
 	IPLog_WriteLog ();	// JPG 1.05 - ip loggging
 
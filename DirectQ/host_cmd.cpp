@@ -21,6 +21,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "d3d_model.h"
 #include "d3d_quake.h"
 #include "pr_class.h"
+#include <vector>
+#include <string>
+#include <sstream>
 
 extern cvar_t	pausable;
 
@@ -505,8 +508,108 @@ Host_Savegame_f
 void SCR_Mapshot_f (char *shotname, bool report, bool overwrite);
 void Draw_InvalidateMapshot (void);
 void Menu_DirtySaveLoadMenu (void);
-void ED_WriteGlobals (std::ofstream &f);
+void ED_WriteGlobals (std::ostream &f);
 void ED_Write (std::ofstream &f, edict_t *ed);
+void ED_SnapshotEdicts (std::vector<byte> &data);
+bool ED_LoadBinaryEdicts (byte *data, int size);
+
+// binary saves are much faster to write and load but older versions of directq and other engines can't read them
+cvar_t host_savebinary ("host_savebinary", "0", CVAR_ARCHIVE);
+
+#define SAVE_BINARY_IDENT	(('B' << 24) + ('V' << 16) + ('S' << 8) + 'Q')
+
+// this follows the text header and globals in a binary save, and is followed by the packed edicts
+struct savebinaryheader_t
+{
+	int ident;
+	int rawsize;
+	int packedsize;
+	unsigned __int64 hash;
+};
+
+// a binary save that's being written; the edicts are copied out on the main thread and packed and written on another
+struct savewriter_t
+{
+	std::ofstream f;
+	std::string header;
+	std::vector<byte> edicts;
+	char savename[256];
+	bool failed;
+};
+
+savewriter_t *host_savewriter = NULL;
+HANDLE host_hSaveThread = NULL;
+
+
+DWORD WINAPI Host_SaveWriterThread (LPVOID param)
+{
+	savewriter_t *sw = (savewriter_t *) param;
+	std::vector<byte> packed (COM_CompressBound (sw->edicts.size ()));
+	savebinaryheader_t bh;
+
+	bh.ident = SAVE_BINARY_IDENT;
+	bh.rawsize = sw->edicts.size ();
+	bh.packedsize = COM_CompressLZ (&sw->edicts[0], sw->edicts.size (), &packed[0]);
+	bh.hash = COM_FastHash (&sw->edicts[0], sw->edicts.size ());
+
+	sw->f.write (sw->header.c_str (), sw->header.length ());
+	sw->f.write ((char *) &bh, sizeof (savebinaryheader_t));
+	sw->f.write ((char *) &packed[0], bh.packedsize);
+	sw->f.close ();
+
+	// close sets failbit too if the flush didn't make it
+	sw->failed = sw->f.fail ();
+
+	return 0;
+}
+
+
+void Host_WaitForSaveWriter (void)
+{
+	// called before anything that could touch a save that's still being written
+	if (!host_savewriter) return;
+
+	if (host_hSaveThread)
+	{
+		WaitForSingleObject (host_hSaveThread, INFINITE);
+		CloseHandle (host_hSaveThread);
+		host_hSaveThread = NULL;
+	}
+
+	if (host_savewriter->failed) Con_Printf ("ERROR: couldn't write \"%s\"\n", host_savewriter->savename);
+
+	delete host_savewriter;
+	host_savewriter = NULL;
+}
+
+
+void Host_WriteSaveHeader (std::ostream &f, int version)
+{
+	char comment[SAVEGAME_COMMENT_LENGTH + 1];
+
+	f << std::fixed;
+	f << version << "\n";
+	Host_SavegameComment (comment);
+	f << comment << "\n";
+
+	for (int i = 0; i < NUM_SPAWN_PARMS; i++)
+		f << svs.clients->spawn_parms[i] << "\n";
+
+	f << current_skill << "\n";
+	f << sv.name << "\n";
+	f << sv.time << "\n";
+
+	// write the light styles
+	for (int i = 0; i < MAX_LIGHTSTYLES; i++)
+	{
+		if (sv.lightstyles[i])
+			f << sv.lightstyles[i] << "\n";
+		else f << "m\n";
+	}
+
+	ED_WriteGlobals (f);
+}
+
 
 // note - this is only intended to be called from the menus or from Host_Savegame_f,
 // where all the necessary validation and setup has already been performed!!!
@@ -515,8 +618,10 @@ void Host_DoSavegame (char *savename)
 	// this ensures that savedir is validated and created irrespective of where it is called from
 	if (!COM_ValidateContentFolderCvar (&host_savedir)) return;
 
+	// one at a time, and don't let a save overwrite a file that's still being written
+	Host_WaitForSaveWriter ();
+
 	char name[256];
-	char comment[SAVEGAME_COMMENT_LENGTH + 1];
 
 	for (int i = 0; ; i++)
 	{
@@ -535,46 +640,58 @@ void Host_DoSavegame (char *savename)
 	Q_snprintf (name, 256, "%s/%s%s", com_gamedir, host_savedir.string, savename);
 	COM_DefaultExtension (name, ".sav");
 
-	std::ofstream savefile (name);
-
-	if (!savefile.is_open ())
+	if (host_savebinary.value)
 	{
-		Con_Printf ("ERROR: couldn't open %s.\n", name);
-		return;
-	}
+		savewriter_t *sw = new savewriter_t ();
 
-	// store out the last save game
-	strcpy (host_lastsave, savename);
+		sw->f.open (name, std::ios::out | std::ios::binary);
+
+		if (!sw->f.is_open ())
+		{
+			Con_Printf ("ERROR: couldn't open %s.\n", name);
+			delete sw;
+			return;
+		}
 
-	// saving can cause sound to stall while disk IO is busy so clear the buffer first
-	S_ClearBuffer ();
+		// the header and globals are small enough to just format here
+		std::ostringstream header;
 
-	savefile << std::fixed;
-	savefile << SAVEGAME_VERSION << "\n";
-	Host_SavegameComment (comment);
-	savefile << comment << "\n";
+		Host_WriteSaveHeader (header, SAVEGAME_BINARY_VERSION);
 
-	for (int i = 0; i < NUM_SPAWN_PARMS; i++)
-		savefile << svs.clients->spawn_parms[i] << "\n";
+		sw->header = header.str ();
+		ED_SnapshotEdicts (sw->edicts);
+		Q_strncpy (sw->savename, savename, 255);
+		sw->failed = false;
 
-	savefile << current_skill << "\n";
-	savefile << sv.name << "\n";
-	savefile << sv.time << "\n";
+		// hand it off; if we can't get a thread just write it here
+		host_savewriter = sw;
 
-	// write the light styles
-	for (int i = 0; i < MAX_LIGHTSTYLES; i++)
-	{
-		if (sv.lightstyles[i])
-			savefile << sv.lightstyles[i] << "\n";
-		else savefile << "m\n";
+		if (!(host_hSaveThread = CreateThread (NULL, 0, Host_SaveWriterThread, sw, 0, NULL)))
+			Host_SaveWriterThread (sw);
 	}
+	else
+	{
+		std::ofstream savefile (name);
+
+		if (!savefile.is_open ())
+		{
+			Con_Printf ("ERROR: couldn't open %s.\n", name);
+			return;
+		}
 
-	ED_WriteGlobals (savefile);
+		// saving can cause sound to stall while disk IO is busy so clear the buffer first
+		S_ClearBuffer ();
 
-	for (int i = 0; i < SVProgs->NumEdicts; i++)
-		ED_Write (savefile, GetEdictForNumber (i));
+		Host_WriteSaveHeader (savefile, SAVEGAME_VERSION);
 
-	savefile.close ();
+		for (int i = 0; i < SVProgs->NumEdicts; i++)
+			ED_Write (savefile, GetEdictForNumber (i));
+
+		savefile.close ();
+	}
+
+	// store out the last save game
+	strcpy (host_lastsave, savename);
 
 	Con_Printf ("Saved game to \"%s\"\n", savename);
 
@@ -610,6 +727,63 @@ void Host_Savegame_f (void)
 }
 
 
+/*
+===============
+Host_LoadBinaryEdicts
+
+the text stream has already been through the header; this reopens the file in binary mode for the globals and
+the packed edicts
+===============
+*/
+bool Host_LoadBinaryEdicts (char *name)
+{
+	std::ifstream f (name, std::ios::in | std::ios::binary);
+
+	if (!f.is_open ()) return false;
+
+	int filesize = COM_GetFileSize (f);
+	int hunkmark = TempHunk->GetLowMark ();
+	char *filedata = (char *) TempHunk->FastAlloc (filesize + 1);
+	char *data = filedata;
+	bool loaded = false;
+
+	f.read (filedata, filesize);
+	f.close ();
+	filedata[filesize] = 0;
+
+	// version, comment, spawn parms, skill, map, time, lightstyles
+	for (int lines = 0; lines < NUM_SPAWN_PARMS + MAX_LIGHTSTYLES + 5; data++)
+	{
+		if (data >= filedata + filesize) break;
+		if (*data == '\n') lines++;
+	}
+
+	if ((data = COM_Parse (data)) != NULL && !strcmp (com_token, "{"))
+	{
+		data = ED_ParseGlobals (data);
+
+		// the globals end on a newline and the binary part starts immediately after it
+		if (data && *data == '\n')
+		{
+			savebinaryheader_t *bh = (savebinaryheader_t *) (data + 1);
+			int binsize = (filedata + filesize) - (data + 1);
+
+			if (binsize >= sizeof (savebinaryheader_t) && bh->ident == SAVE_BINARY_IDENT && bh->rawsize > 0 &&
+				bh->packedsize == binsize - sizeof (savebinaryheader_t))
+			{
+				byte *raw = (byte *) TempHunk->FastAlloc (bh->rawsize);
+
+				if (COM_DecompressLZ ((byte *) (bh + 1), bh->packedsize, raw, bh->rawsize) && COM_FastHash (raw, bh->rawsize) == bh->hash)
+					loaded = ED_LoadBinaryEdicts (raw, bh->rawsize);
+			}
+		}
+	}
+
+	TempHunk->FreeToLowMark (hunkmark);
+	return loaded;
+}
+
+
 /*
 ===============
 Host_Loadgame_f
@@ -650,6 +824,9 @@ void Host_Loadgame_f (void)
 
 	cls.demonum = -1;		// stop demo loop in case this fails
 
+	// finish off any save that's still being written in case it's this one
+	Host_WaitForSaveWriter ();
+
 	Q_snprintf (name, 127, "%s/%s%s", com_gamedir, host_savedir.string, loadname);
 	COM_DefaultExtension (name, ".sav");
 	Con_Printf ("Loading game from \"%s\"...\n", loadname);
@@ -684,7 +861,7 @@ void Host_Loadgame_f (void)
 	f >> version;
 	f.ignore (LOADGAME_BUFFER_SIZE, '\n');
 
-	if (version != SAVEGAME_VERSION)
+	if (version != SAVEGAME_VERSION && version != SAVEGAME_BINARY_VERSION)
 	{
 		f.close ();
 		Con_Printf ("Savegame is version %i, not %i\n", version, SAVEGAME_VERSION);
@@ -741,40 +918,54 @@ void Host_Loadgame_f (void)
 		strcpy (sv.lightstyles[i], loadbuffer);
 	}
 
-	// load all the edicts out of the savegame file
-	// (the memset ensures null-termination of the string)
-	memset (loadbuffer, 0, LOADGAME_BUFFER_SIZE);
-	f.read (loadbuffer, LOADGAME_BUFFER_SIZE);
-
-	// -1 is the globals
-	for (SVProgs->NumEdicts = -1; ; SVProgs->NumEdicts++)
+	if (version == SAVEGAME_BINARY_VERSION)
 	{
-		if ((loadbuffer = COM_Parse (loadbuffer)) == NULL) break;
-		if (!com_token[0]) break;
-		if (strcmp (com_token, "{")) Sys_Error ("First token isn't a brace");
+		f.close ();
 
-		if (SVProgs->NumEdicts == -1)
+		if (!Host_LoadBinaryEdicts (name))
 		{
-			// parse the global vars
-			loadbuffer = ED_ParseGlobals (loadbuffer);
+			TempHunk->FreeToLowMark (hunkmark);
+			Host_Error ("Host_Loadgame_f : savegame \"%s\" is damaged", loadname);
 		}
-		else
+	}
+	else
+	{
+		// load all the edicts out of the savegame file
+		// (the memset ensures null-termination of the string)
+		memset (loadbuffer, 0, LOADGAME_BUFFER_SIZE);
+		f.read (loadbuffer, LOADGAME_BUFFER_SIZE);
+
+		// -1 is the globals
+		for (SVProgs->NumEdicts = -1; ; SVProgs->NumEdicts++)
 		{
-			// parse an edict
-			edict_t *ent = GetEdictForNumber (SVProgs->NumEdicts);
+			if ((loadbuffer = COM_Parse (loadbuffer)) == NULL) break;
+			if (!com_token[0]) break;
+			if (strcmp (com_token, "{")) Sys_Error ("First token isn't a brace");
+
+			if (SVProgs->NumEdicts == -1)
+			{
+				// parse the global vars
+				loadbuffer = ED_ParseGlobals (loadbuffer);
+			}
+			else
+			{
+				// parse an edict
+				edict_t *ent = GetEdictForNumber (SVProgs->NumEdicts);
 
-			memset (&ent->v, 0, SVProgs->QC->entityfields * 4);
-			ent->free = false;
-			loadbuffer = ED_ParseEdict (loadbuffer, ent);
+				memset (&ent->v, 0, SVProgs->QC->entityfields * 4);
+				ent->free = false;
+				loadbuffer = ED_ParseEdict (loadbuffer, ent);
 
-			// link it into the bsp tree
-			if (!ent->free) SV_LinkEdict (ent, false);
+				// link it into the bsp tree
+				if (!ent->free) SV_LinkEdict (ent, false);
+			}
 		}
+
+		f.close ();
 	}
 
 	sv.time = time;
 
-	f.close ();
 	TempHunk->FreeToLowMark (hunkmark);
 
 	for (int i = 0; i < NUM_SPAWN_PARMS; i++)
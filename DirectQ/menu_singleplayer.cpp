@@ -360,8 +360,8 @@ void Menu_SaveLoadAddSave (WIN32_FIND_DATA *savefile)
 		f >> version;
 		f.ignore (LOADGAME_BUFFER_SIZE, '\n');
 
-		// check the version
-		if (version != SAVEGAME_VERSION)
+		// check the version (binary saves have the same text header so they can be read here too)
+		if (version != SAVEGAME_VERSION && version != SAVEGAME_BINARY_VERSION)
 		{
 			f.close ();
 			return;
@@ -383,10 +383,15 @@ void Menu_SaveLoadAddSave (WIN32_FIND_DATA *savefile)
 char **saveloadlist = NULL;
 CQuakeZone *SaveZone = NULL;
 
+void Host_WaitForSaveWriter (void);
+
 void Menu_SaveLoadScanSaves (void)
 {
 	if (!savelistchanged) return;
 
+	// make sure we don't read a save that's half written
+	Host_WaitForSaveWriter ();
+
 	// destroy the previous list
 	SAFE_DELETE (SaveInfoList);
 	SAFE_DELETE (SaveScrollbox);
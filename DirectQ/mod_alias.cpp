@@ -76,7 +76,9 @@ float r_avertexnormals[NUMVERTEXNORMALS][3] =
 
 
 bool Mod_FindIQMModel (model_t *mod);
-void D3DAlias_MakeAliasMesh (char *name, aliashdr_t *hdr, aliasload_t *load);
+void D3DAlias_MakeAliasMesh (char *name, aliashdr_t *hdr, aliasload_t *load, QMODELCACHE *cache);
+bool D3DAlias_ReadMeshCache (QMODELCACHE *cache, aliascache_t *ac);
+extern cvar_t r_aliasdelerpdelta;
 
 
 /*
@@ -139,19 +141,42 @@ void Mod_LoadAliasBBoxes (model_t *mod, aliashdr_t *hdr, aliasload_t *load)
 }
 
 
-struct vertexnormals_t
+void Mod_CopyAliasBBoxes (model_t *mod, aliashdr_t *hdr, aliascache_t *ac)
 {
-	int numnormals;
-	float normal[3];
-};
+	// the cache mapping goes away after loading so these need copying out
+	hdr->bboxes = (aliasbbox_t *) MainHunk->Alloc (hdr->nummeshframes * sizeof (aliasbbox_t));
+	Q_MemCpy (hdr->bboxes, ac->bboxes, hdr->nummeshframes * sizeof (aliasbbox_t));
+	Vector3Copy (hdr->midpoint, ac->info->midpoint);
+
+	// the whole model bbox is just the accumulated frame bboxes
+	Mod_ClearBoundingBox (mod->mins, mod->maxs);
+
+	for (int i = 0; i < hdr->nummeshframes; i++)
+		Mod_AccumulateBox (mod->mins, mod->maxs, hdr->bboxes[i].mins, hdr->bboxes[i].maxs);
+
+	// absolute clamp so that we don't go into the wrong clipping hull
+	for (int i = 0; i < 3; i++)
+	{
+		if (mod->mins[i] > -16) mod->mins[i] = -16;
+		if (mod->maxs[i] < 16) mod->maxs[i] = 16;
+	}
+}
 
 
 void Mod_LoadFrameVerts (aliashdr_t *hdr, trivertx_t *verts, aliasload_t *load)
 {
+	// everything derived from the vertexes is coming from the model cache so just count the frame
+	if (load->cached)
+	{
+		load->vertexes[hdr->nummeshframes] = NULL;
+		hdr->nummeshframes++;
+		return;
+	}
+
 	// to do - remap stverts for floating point; do them for baseframe only or for each frame???
 	drawvertx_t *vertexes = (drawvertx_t *) TempHunk->FastAlloc (hdr->vertsperframe * sizeof (drawvertx_t));
 	int fhunkmark = TempHunk->GetLowMark ();
-	vertexnormals_t *vnorms = (vertexnormals_t *) TempHunk->FastAlloc (sizeof (vertexnormals_t) * hdr->vertsperframe);
+	float (*positions)[3] = (float (*)[3]) TempHunk->FastAlloc (hdr->vertsperframe * sizeof (float) * 3);
 
 	// copy out positions and set up for normals calculation
 	for (int i = 0; i < hdr->vertsperframe; i++)
@@ -164,54 +189,42 @@ void Mod_LoadFrameVerts (aliashdr_t *hdr, trivertx_t *verts, aliasload_t *load)
 		vertexes[i].lerpvert = true;
 
 		// no normals initially
-		Vector3Clear (vnorms[i].normal);
-		vnorms[i].numnormals = 0;
+		Vector3Clear (vertexes[i].normal);
+
+		// undo the vertex rotation from modelgen.c here too; done once per vert rather than for each triangle that uses it
+		Vector3Set (positions[i],
+			(float) verts[i].v[1] * hdr->scale[1] + hdr->scale_origin[1],
+			-((float) verts[i].v[0] * hdr->scale[0] + hdr->scale_origin[0]),
+			(float) verts[i].v[2] * hdr->scale[2] + hdr->scale_origin[2]);
 	}
 
 	// recalc the normals based on modelgen.c code
 	for (int i = 0; i < hdr->numtris; i++)
 	{
-		float triverts[3][3];
 		float vtemp1[3], vtemp2[3], normal[3];
 		int *vertindexes = load->triangles[i].vertindex;
 
-		// undo the vertex rotation from modelgen.c here too
-		for (int j = 0; j < 3; j++)
-		{
-			Vector3Set (triverts[j],
-				(float) verts[vertindexes[j]].v[1] * hdr->scale[1] + hdr->scale_origin[1],
-				-((float) verts[vertindexes[j]].v[0] * hdr->scale[0] + hdr->scale_origin[0]),
-				(float) verts[vertindexes[j]].v[2] * hdr->scale[2] + hdr->scale_origin[2]);
-		}
-
 		// calc the per-triangle normal
-		Vector3Subtract (vtemp1, triverts[0], triverts[1]);
-		Vector3Subtract (vtemp2, triverts[2], triverts[1]);
+		Vector3Subtract (vtemp1, positions[vertindexes[0]], positions[vertindexes[1]]);
+		Vector3Subtract (vtemp2, positions[vertindexes[2]], positions[vertindexes[1]]);
 		Vector3Cross (normal, vtemp1, vtemp2);
 		Vector3Normalize (normal);
 
 		// rotate the normal so the model faces down the positive x axis
 		float newnormal[3] = {-normal[1], normal[0], normal[2]};
 
-		// and accumulate it into the calculated normals array
+		// and accumulate it into the vertex normals (the sum only needs normalizing after so there's no need to count them)
 		for (int j = 0; j < 3; j++)
-		{
-			Vector3Add (vnorms[vertindexes[j]].normal, vnorms[vertindexes[j]].normal, newnormal);
-			vnorms[vertindexes[j]].numnormals++;
-		}
+			Vector3Add (vertexes[vertindexes[j]].normal, vertexes[vertindexes[j]].normal, newnormal);
 	}
 
-	// copy out normals
+	// normalize the normals
 	for (int i = 0; i < hdr->vertsperframe; i++)
 	{
-		// numnormals was checked for > 0 in modelgen.c so we shouldn't need to do it again 
-		// here but we do anyway just in case a rogue modder has used a bad modelling tool
-		if (vnorms[i].numnormals > 0)
-		{
-			Vector3Scale (vertexes[i].normal, vnorms[i].normal, (float) vnorms[i].numnormals);
-			Vector3Normalize (vertexes[i].normal);
-		}
-		else Vector3Set (vertexes[i].normal, 0.0f, 0.0f, 1.0f);
+		// a vert that's not used by any triangle has nothing accumulated; modelgen.c should have checked
+		// for this but we do it anyway just in case a rogue modder has used a bad modelling tool
+		if (!(Vector3Normalize (vertexes[i].normal) > 0))
+			Vector3Set (vertexes[i].normal, 0.0f, 0.0f, 1.0f);
 	}
 
 	// and done
@@ -573,30 +586,55 @@ void Mod_LoadAliasModel (model_t *mod, void *buffer)
 	// load triangle lists
 	load.triangles = (dtriangle_t *) &load.stverts[hdr->vertsperframe];
 
+	// the delerp threshold is baked into the mesh so it's part of the cache key
+	QMODELCACHE cache (mod->name, "mdl", mod_LoadInfo.crc, mod_LoadInfo.srclength, CRC_Block32 ((byte *) &r_aliasdelerpdelta.value, sizeof (float)));
+	aliascache_t aliascache;
+
+	// see if the bboxes and mesh are already in the cache
+	if (cache.Open ())
+	{
+		if (D3DAlias_ReadMeshCache (&cache, &aliascache))
+			load.cached = &aliascache;
+		else cache.Close ();
+	}
+
 	// load the frames
-	daliasframetype_t *pframetype = (daliasframetype_t *) &load.triangles[hdr->numtris];
+	daliasframetype_t *firstframetype = (daliasframetype_t *) &load.triangles[hdr->numtris];
 	hdr->frames = (maliasframedesc_t *) MainHunk->Alloc (hdr->numframes * sizeof (maliasframedesc_t));
 
-	hdr->nummeshframes = 0;
+	for (;;)
+	{
+		daliasframetype_t *pframetype = firstframetype;
 
-	// because we don't know how many frames we need in advance we take a copy to the scratch buffer initially
-	// the size of the scratch buffer is compatible with the max number of frames allowed by protocol 666
-	load.vertexes = (drawvertx_t **) scratchbuf;
+		hdr->nummeshframes = 0;
 
-	for (int i = 0; i < hdr->numframes; i++)
-	{
-		aliasframetype_t frametype = (aliasframetype_t) pframetype->type;
+		// because we don't know how many frames we need in advance we take a copy to the scratch buffer initially
+		// the size of the scratch buffer is compatible with the max number of frames allowed by protocol 666
+		load.vertexes = (drawvertx_t **) scratchbuf;
 
-		if (frametype == ALIAS_SINGLE)
-		{
-			daliasframe_t *frame = (daliasframe_t *) (pframetype + 1);
-			pframetype = Mod_LoadAliasFrame (hdr, frame, &hdr->frames[i], &load);
-		}
-		else
+		for (int i = 0; i < hdr->numframes; i++)
 		{
-			daliasgroup_t *group = (daliasgroup_t *) (pframetype + 1);
-			pframetype = Mod_LoadAliasGroup (hdr, group, &hdr->frames[i], &load);
+			aliasframetype_t frametype = (aliasframetype_t) pframetype->type;
+
+			if (frametype == ALIAS_SINGLE)
+			{
+				daliasframe_t *frame = (daliasframe_t *) (pframetype + 1);
+				pframetype = Mod_LoadAliasFrame (hdr, frame, &hdr->frames[i], &load);
+			}
+			else
+			{
+				daliasgroup_t *group = (daliasgroup_t *) (pframetype + 1);
+				pframetype = Mod_LoadAliasGroup (hdr, group, &hdr->frames[i], &load);
+			}
 		}
+
+		if (!load.cached) break;
+		if (load.cached->info->nummeshframes == hdr->nummeshframes) break;
+
+		// the cache entry doesn't match the model so go back and load the frames properly
+		// (this shouldn't ever happen but if it does it just wastes a few group intervals on the hunk)
+		load.cached = NULL;
+		cache.Close ();
 	}
 
 	// copy framepointers from the scratch buffer to the final cached copy
@@ -607,10 +645,16 @@ void Mod_LoadAliasModel (model_t *mod, void *buffer)
 
 	load.vertexes = hdrvertexes;
 
-	Mod_LoadAliasBBoxes (mod, hdr, &load);
+	if (load.cached)
+	{
+		Mod_CopyAliasBBoxes (mod, hdr, load.cached);
+		cache.Hit ();
+	}
+	else Mod_LoadAliasBBoxes (mod, hdr, &load);
 
 	// build the draw lists and vertex/index buffers
-	D3DAlias_MakeAliasMesh (mod->name, hdr, &load);
+	D3DAlias_MakeAliasMesh (mod->name, hdr, &load, &cache);
+	cache.Close ();
 
 	// set the final header
 	mod->aliashdr = hdr;
@@ -678,3 +722,180 @@ void Mod_LoadAliasModel (model_t *mod, void *buffer)
 }
 
 
+
+
+/*
+=================
+Mod_AliasLoadBench_f
+
+times the CPU side of MDL loading (normals, mesh compression and vertex cache optimization) for every
+MDL in a directory; skins aren't loaded and no renderer or model state is touched
+=================
+*/
+void D3DAlias_CompressMesh (aliashdr_t *hdr, aliasload_t *load);
+void D3DAlias_OptimizeMesh (aliashdr_t *hdr, aliasload_t *load);
+float D3DAlias_MeshACMR (unsigned short *indexes, int numtris, int numverts);
+
+void Mod_AliasLoadBench_f (void)
+{
+	char basedir[MAX_PATH];
+	char **filelist = NULL;
+	int hunkmark = TempHunk->GetLowMark ();
+
+	if (Cmd_Argc () > 1)
+	{
+		Q_strncpy (basedir, Cmd_Argv (1), MAX_PATH - 2);
+
+		if (basedir[strlen (basedir) - 1] != '/') strcat (basedir, "/");
+	}
+	else strcpy (basedir, "progs/");
+
+	int numfiles = COM_BuildContentList (&filelist, basedir, ".mdl");
+
+	if (!numfiles)
+	{
+		Con_Printf ("No MDLs found in %s\n", basedir);
+		TempHunk->FreeToLowMark (hunkmark);
+		return;
+	}
+
+	// the list is built in the scratch buffer which the frame loader also uses
+	char **mdllist = (char **) TempHunk->FastAlloc (numfiles * sizeof (char *));
+	Q_MemCpy (mdllist, filelist, numfiles * sizeof (char *));
+
+	double totalframetime = 0, totalcompresstime = 0, totaloptimizetime = 0;
+	int totaltris = 0, nummodels = 0;
+
+	for (int i = 0; i < numfiles; i++)
+	{
+		char path[MAX_PATH];
+		int filemark = TempHunk->GetLowMark ();
+
+		Q_snprintf (path, MAX_PATH, "%s%s", basedir, mdllist[i]);
+
+		mdl_t *pinmodel = (mdl_t *) CQuakeFile::LoadFile (path, TempHunk);
+
+		if (!pinmodel || pinmodel->ident != IDPOLYHEADER || pinmodel->version != ALIAS_VERSION ||
+			pinmodel->numtris < 1 || pinmodel->numverts < 1 || pinmodel->numframes < 1 || pinmodel->numskins < 1)
+		{
+			Con_Printf ("%s is not a valid MDL\n", path);
+			TempHunk->FreeToLowMark (filemark);
+			continue;
+		}
+
+		aliashdr_t hdr;
+		aliasload_t load;
+
+		memset (&hdr, 0, sizeof (hdr));
+		memset (&load, 0, sizeof (load));
+
+		hdr.skinwidth = pinmodel->skinwidth;
+		hdr.skinheight = pinmodel->skinheight;
+		hdr.vertsperframe = pinmodel->numverts;
+		hdr.numtris = pinmodel->numtris;
+		hdr.numframes = pinmodel->numframes;
+
+		Vector3Copy (hdr.scale, pinmodel->scale);
+		Vector3Copy (hdr.scale_origin, pinmodel->scale_origin);
+
+		// step over the skins
+		daliasskintype_t *pskintype = (daliasskintype_t *) &pinmodel[1];
+
+		for (int j = 0; j < pinmodel->numskins; j++)
+		{
+			if (pskintype->type == ALIAS_SKIN_SINGLE)
+				pskintype = (daliasskintype_t *) ((byte *) (pskintype + 1) + (hdr.skinwidth * hdr.skinheight));
+			else
+			{
+				daliasskingroup_t *pinskingroup = (daliasskingroup_t *) (pskintype + 1);
+				daliasskininterval_t *pinskinintervals = (daliasskininterval_t *) (pinskingroup + 1);
+
+				pskintype = (daliasskintype_t *) ((byte *) (pinskinintervals + pinskingroup->numskins) + pinskingroup->numskins * (hdr.skinwidth * hdr.skinheight));
+			}
+		}
+
+		load.stverts = (stvert_t *) pskintype;
+		load.triangles = (dtriangle_t *) &load.stverts[hdr.vertsperframe];
+		load.vertexes = (drawvertx_t **) scratchbuf;
+
+		daliasframetype_t *pframetype = (daliasframetype_t *) &load.triangles[hdr.numtris];
+		double framestart = Sys_ProfileTime ();
+
+		for (int j = 0; j < hdr.numframes; j++)
+		{
+			if ((aliasframetype_t) pframetype->type == ALIAS_SINGLE)
+			{
+				trivertx_t *verts = (trivertx_t *) ((daliasframe_t *) (pframetype + 1) + 1);
+
+				Mod_LoadFrameVerts (&hdr, verts, &load);
+				pframetype = (daliasframetype_t *) (verts + hdr.vertsperframe);
+			}
+			else
+			{
+				daliasgroup_t *pingroup = (daliasgroup_t *) (pframetype + 1);
+				void *ptemp = (void *) ((daliasinterval_t *) (pingroup + 1) + pingroup->numframes);
+
+				for (int k = 0; k < pingroup->numframes; k++)
+				{
+					Mod_LoadFrameVerts (&hdr, (trivertx_t *) ((daliasframe_t *) ptemp + 1), &load);
+					ptemp = (trivertx_t *) ((daliasframe_t *) ptemp + 1) + hdr.vertsperframe;
+				}
+
+				pframetype = (daliasframetype_t *) ptemp;
+			}
+		}
+
+		double compressstart = Sys_ProfileTime ();
+
+		load.mesh = (aliasmesh_t *) TempHunk->FastAlloc (hdr.numtris * 3 * sizeof (aliasmesh_t));
+		load.indexes = (unsigned short *) TempHunk->FastAlloc (3 * sizeof (unsigned short) * hdr.numtris);
+
+		D3DAlias_CompressMesh (&hdr, &load);
+
+		double compressend = Sys_ProfileTime ();
+		float acmrbefore = D3DAlias_MeshACMR (load.indexes, hdr.numtris, hdr.nummesh);
+		double optimizestart = Sys_ProfileTime ();
+
+		D3DAlias_OptimizeMesh (&hdr, &load);
+
+		double optimizeend = Sys_ProfileTime ();
+		float acmrafter = D3DAlias_MeshACMR (load.indexes, hdr.numtris, hdr.nummesh);
+
+		Con_Printf
+		(
+			"%-20s %6i tris %6i verts %4i poses : %8.3f %8.3f %8.3f ms : acmr %0.3f -> %0.3f\n",
+			mdllist[i],
+			hdr.numtris,
+			hdr.nummesh,
+			hdr.nummeshframes,
+			(float) ((compressstart - framestart) * 1000.0),
+			(float) ((compressend - compressstart) * 1000.0),
+			(float) ((optimizeend - optimizestart) * 1000.0),
+			acmrbefore,
+			acmrafter
+		);
+
+		totalframetime += compressstart - framestart;
+		totalcompresstime += compressend - compressstart;
+		totaloptimizetime += optimizeend - optimizestart;
+		totaltris += hdr.numtris;
+		nummodels++;
+
+		TempHunk->FreeToLowMark (filemark);
+	}
+
+	Con_Printf
+	(
+		"%i MDLs, %i tris : frames %0.3f ms, compress %0.3f ms, optimize %0.3f ms\n",
+		nummodels,
+		totaltris,
+		(float) (totalframetime * 1000.0),
+		(float) (totalcompresstime * 1000.0),
+		(float) (totaloptimizetime * 1000.0)
+	);
+
+	TempHunk->FreeToLowMark (hunkmark);
+}
+
+
+cmd_t Mod_AliasLoadBench_Cmd ("mdl_loadbench", Mod_AliasLoadBench_f);
@@ -734,6 +734,96 @@ void Mod_CalcSurfaceBounds (model_t *mod, msurface_t *surf)
 }
 
 
+/*
+=================
+Mod_LoadSurfaceBounds
+
+bounds and extents for every surface in the model, from the model cache if possible
+=================
+*/
+struct surfbounds_t
+{
+	float mins[3];
+	float maxs[3];
+	float midpoint[3];
+	short texturemins[2];
+	short extents[2];
+};
+
+
+void Mod_PackSurfaceBounds (model_t *mod)
+{
+	brushhdr_t *hdr = mod->brushhdr;
+
+	// padded by 4 so that a group of 4 starting at the last surface never reads past the end
+	for (int i = 0; i < 6; i++)
+		hdr->surfbounds[i] = (float *) MainHunk->Alloc ((hdr->numsurfaces + 4) * sizeof (float));
+
+	for (int i = 0; i < hdr->numsurfaces; i++)
+	{
+		msurface_t *surf = &hdr->surfaces[i];
+
+		for (int j = 0; j < 3; j++)
+		{
+			hdr->surfbounds[j][i] = surf->cullinfo.mins[j];
+			hdr->surfbounds[j + 3][i] = surf->cullinfo.maxs[j];
+		}
+	}
+}
+
+
+void Mod_LoadSurfaceBounds (model_t *mod)
+{
+	QMODELCACHE cache (mod->name, "bsp", mod_LoadInfo.crc, mod_LoadInfo.srclength);
+	msurface_t *surf = mod->brushhdr->surfaces;
+	int numsurfaces = mod->brushhdr->numsurfaces;
+	surfbounds_t *sb = NULL;
+
+	if (cache.Open () && (sb = (surfbounds_t *) cache.Read (numsurfaces * sizeof (surfbounds_t))) != NULL)
+	{
+		for (int i = 0; i < numsurfaces; i++, surf++, sb++)
+		{
+			Vector3Copy (surf->cullinfo.mins, sb->mins);
+			Vector3Copy (surf->cullinfo.maxs, sb->maxs);
+			Vector3Copy (surf->midpoint, sb->midpoint);
+
+			surf->texturemins[0] = sb->texturemins[0];
+			surf->texturemins[1] = sb->texturemins[1];
+			surf->extents[0] = sb->extents[0];
+			surf->extents[1] = sb->extents[1];
+		}
+
+		cache.Hit ();
+		Mod_PackSurfaceBounds (mod);
+		return;
+	}
+
+	int hunkmark = TempHunk->GetLowMark ();
+	sb = (surfbounds_t *) TempHunk->FastAlloc (numsurfaces * sizeof (surfbounds_t));
+
+	for (int i = 0; i < numsurfaces; i++, surf++)
+	{
+		Mod_CalcSurfaceBounds (mod, surf);
+
+		Vector3Copy (sb[i].mins, surf->cullinfo.mins);
+		Vector3Copy (sb[i].maxs, surf->cullinfo.maxs);
+		Vector3Copy (sb[i].midpoint, surf->midpoint);
+
+		sb[i].texturemins[0] = surf->texturemins[0];
+		sb[i].texturemins[1] = surf->texturemins[1];
+		sb[i].extents[0] = surf->extents[0];
+		sb[i].extents[1] = surf->extents[1];
+	}
+
+	cache.Create ();
+	cache.Write (sb, numsurfaces * sizeof (surfbounds_t));
+	cache.Close ();
+
+	TempHunk->FreeToLowMark (hunkmark);
+	Mod_PackSurfaceBounds (mod);
+}
+
+
 /*
 =================
 ModBrush_LoadSurfaces
@@ -823,8 +913,10 @@ void ModBrush_LoadSurfaces (model_t *mod, byte *mod_base, lump_t *l)
 		else surf->flags |= SURF_DRAWSOLID;
 
 		D3DSurf_AccumulateSurface (surf);
-		Mod_CalcSurfaceBounds (mod, surf);
 	}
+
+	// done as a separate pass so that all of the bounds can come from the cache in one go
+	Mod_LoadSurfaceBounds (mod);
 }
 
 
@@ -43,23 +43,29 @@ struct partvert_t
 };
 
 
-struct particle_t
+// particles are stored per-emitter in contiguous blocks taken from a slab pool, so that they can be simulated
+// without pointer chasing and sent to the renderer in a single copy.  die times are also held in a separate
+// array alongside the vertexes so that expiry can be tested 4 at a time.
+#define PARTICLE_BLOCK_MIN		64
+#define PARTICLE_BLOCK_CLASSES	8		// 64 to 8192 particles per emitter
+
+// free blocks are linked through their first few bytes
+struct partblock_t
 {
-	// having this struct inherit from partvert_t and then copying it over in the renderer was a huge code-smell
-	// in PVS studio so I did it this way instead
-	partvert_t v;
-
-	// drivers never touch the following fields
-	int killflag;
-	particle_t *next;
+	partblock_t *next;
 };
 
 
 // this is needed outside of r_part now...
 struct emitter_t
 {
-	particle_t *particles;
+	partvert_t *particles;
+	float *die;
 	int numparticles;
+	int maxparticles;
+	int numsynced;		// particles whose die time has been copied to the die array
+	int blockclass;
+	int killflag;
 	vec3_t spawnorg;
 	double spawntime;
 	emitter_t *next;
@@ -77,6 +83,7 @@ public:
 
 	void InitParticles (void);
 	void ClearParticles (void);
+	void RunEmitters (void);
 	void AddToAlphaList (void);
 
 	void PointFile (void);
@@ -92,24 +99,36 @@ public:
 	void TeleportSplash (vec3_t org);
 	void RocketTrail (vec3_t start, vec3_t end, int trailtype);
 	void EntityParticles (entity_t *ent);
+	void KillParticles (void);
+
+	// accumulated by the renderer for the benchmark report
+	double DrawTime;
 
 private:
 	emitter_t *NewEmitter (vec3_t spawnorg);
-	particle_t *NewParticle (emitter_t *pe);
+	partvert_t *NewParticle (emitter_t *pe);
+	bool GrowEmitter (emitter_t *pe);
+	void FreeEmitterBlock (emitter_t *pe);
+	void RunEmitter (emitter_t *pe);
 
 	void SetExplosionVelocity (float *vel);
 	void SetExplosionOrigin (float *orgout, float *orgin, int num);
 	void RainParticle (emitter_t *pe, vec3_t mins, vec3_t maxs, int color, vec3_t vel, float time, float z, int type);
 
-	void StandardParticle (particle_t *p, float *org, float *dir, int color);
+	void StandardParticle (partvert_t *p, float *org, float *dir, int color);
 	void Blood (vec3_t org, vec3_t dir, int color, int count);
 	void SetRamp (partvert_t *v, int rampnum, float baseramp, float ramptime);
 
-	particle_t *FreeParticles;
+	partblock_t *FreeBlocks[PARTICLE_BLOCK_CLASSES];
 	emitter_t *ActiveEmitters;
 	emitter_t *FreeEmitters;
 
-	particle_t DefaultParticle;
+	partvert_t DefaultParticle;
+
+	// benchmark state
+	double BenchEndTime;
+	double BenchSimTime;
+	int BenchFrames;
 
 	// if the counts in R_TeleportSplash are ever changed this will need to be changed too...!
 	float TeleSplashNormals[8][8][14][3];
@@ -76,6 +76,7 @@ char *pr_extensions[] =
 	"DP_TE_PARTICLESNOW",
 	"DP_SV_CLIENTCAMERA",
 	"FRIK_FILE",
+	"DQ_QC_CVARHANDLE",
 	NULL
 };
 
@@ -394,12 +395,9 @@ void PF_setmodel (void)
 	e = G_EDICT (OFS_PARM0);
 	m = G_STRING (OFS_PARM1);
 
-	// rewrote to use array indexing instead of a pointer
-	for (i = 0; sv.model_precache[i]; i++)
-	{
-		if (!sv.model_precache[i]) SVProgs->RunError ("no precache: %s\n", m);
-		if (!strcmp (sv.model_precache[i], m)) break;
-	}
+	// an unprecached model gets the first free slot which has no model in it
+	if ((i = sv_modelprecachehash.Find (m)) < 0)
+		i = sv_modelprecachehash.Count ();
 
 	e->v.model = SVProgs->SetString (m);
 	e->v.modelindex = i;
@@ -662,7 +660,6 @@ PF_ambientsound
 */
 void PF_ambientsound (void)
 {
-	char		**check;
 	char		*samp;
 	float		*pos;
 	float 		vol, attenuation;
@@ -674,11 +671,7 @@ void PF_ambientsound (void)
 	attenuation = G_FLOAT (OFS_PARM3);
 
 	// check to see if samp was properly precached
-	for (soundnum = 0, check = sv.sound_precache; *check; check++, soundnum++)
-		if (!strcmp (*check, samp))
-			break;
-
-	if (!*check)
+	if ((soundnum = sv_soundprecachehash.Find (samp)) < 0)
 	{
 		Con_Printf ("no precache: %s\n", samp);
 		return;
@@ -1050,6 +1043,77 @@ void PF_cvar_set (void)
 }
 
 
+/*
+=================
+DQ_QC_CVARHANDLE
+
+lets mods that poll cvars every frame look the name up once and keep a handle to it.  handles are
+1-based indexes into this list (so 0 is "not a cvar") and stay valid for the life of the program, as
+cvars are never unregistered.
+
+float cvar_handle (string name) = #82
+float cvar_hvalue (float handle) = #83
+void cvar_hset (float handle, string value) = #84
+=================
+*/
+std::vector<cvar_t *> pr_cvarhandles;
+
+cvar_t *PR_CvarForHandle (float handle)
+{
+	int h = (int) handle;
+
+	if (h < 1 || h > (int) pr_cvarhandles.size ())
+	{
+		SVProgs->RunError ("bad cvar handle %i", h);
+		return NULL;
+	}
+
+	return pr_cvarhandles[h - 1];
+}
+
+
+void PF_cvar_handle (void)
+{
+	cvar_t *var = cvar_t::FindVar (G_STRING (OFS_PARM0));
+
+	if (!var)
+	{
+		G_FLOAT (OFS_RETURN) = 0;
+		return;
+	}
+
+	if (!var->handle)
+	{
+		pr_cvarhandles.push_back (var);
+		var->handle = pr_cvarhandles.size ();
+	}
+
+	G_FLOAT (OFS_RETURN) = var->handle;
+}
+
+
+void PF_cvar_hvalue (void)
+{
+	cvar_t *var = PR_CvarForHandle (G_FLOAT (OFS_PARM0));
+
+	if (var)
+		G_FLOAT (OFS_RETURN) = var->value;
+	else G_FLOAT (OFS_RETURN) = 0;
+}
+
+
+void PF_cvar_hset (void)
+{
+	cvar_t *var = PR_CvarForHandle (G_FLOAT (OFS_PARM0));
+
+	if (var)
+	{
+		var->Set (G_STRING (OFS_PARM1));
+		QC_DebugOutput ("Setting cvar \"%s\" to \"%s\"", var->name, var->string);
+	}
+}
+
+
 /*
 =================
 PF_findradius
@@ -1299,19 +1363,14 @@ void PF_precache_sound (void)
 	G_INT (OFS_RETURN) = G_INT (OFS_PARM0);
 	PR_CheckEmptyString (s);
 
-	for (i = 0; i < MAX_SOUNDS; i++)
-	{
-		if (!sv.sound_precache[i])
-		{
-			sv.sound_precache[i] = s;
-			return;
-		}
+	if (sv_soundprecachehash.Find (s) >= 0)
+		return;
 
-		if (!strcmp (sv.sound_precache[i], s))
-			return;
-	}
+	if ((i = sv_soundprecachehash.Count ()) >= MAX_SOUNDS)
+		SVProgs->RunError ("PF_precache_sound: overflow");
 
-	SVProgs->RunError ("PF_precache_sound: overflow");
+	sv.sound_precache[i] = s;
+	sv_soundprecachehash.Insert (s, i);
 }
 
 void PF_precache_model (void)
@@ -1326,20 +1385,15 @@ void PF_precache_model (void)
 	G_INT (OFS_RETURN) = G_INT (OFS_PARM0);
 	PR_CheckEmptyString (s);
 
-	for (i = 0; i < MAX_MODELS; i++)
-	{
-		if (!sv.model_precache[i])
-		{
-			sv.model_precache[i] = s;
-			sv.models[i] = Mod_ForName (s, true);
-			return;
-		}
+	if (sv_modelprecachehash.Find (s) >= 0)
+		return;
 
-		if (!strcmp (sv.model_precache[i], s))
-			return;
-	}
+	if ((i = sv_modelprecachehash.Count ()) >= MAX_MODELS)
+		SVProgs->RunError ("PF_precache_model: overflow");
 
-	SVProgs->RunError ("PF_precache_model: overflow");
+	sv.model_precache[i] = s;
+	sv_modelprecachehash.Insert (s, i);
+	sv.models[i] = Mod_ForName (s, true);
 }
 
 
@@ -2506,6 +2560,9 @@ ebfs_builtin_t pr_ebfs_builtins[] =
 	{  77, "precache_file2", PF_precache_file},
 	{  78, "setspawnparms", PF_setspawnparms},
 	{  81, "stof", PF_stof},	// 2001-09-20 QuakeC string manipulation by FrikaC/Maddes
+	{  82, "cvar_handle", PF_cvar_handle},	// DQ_QC_CVARHANDLE; 82-84 are unused by the other extensions we support
+	{  83, "cvar_hvalue", PF_cvar_hvalue},
+	{  84, "cvar_hset", PF_cvar_hset},
 	// 2001-11-15 DarkPlaces general builtin functions by Lord Havoc  start
 	// not implemented yet
 	/*
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "pr_class.h"
 #include "d3d_model.h"
+#include <vector>
 
 CProgsDat *SVProgs = NULL;
 
@@ -393,7 +394,7 @@ Writes a string describing *data in a type specific manner to an output stream
 Easier to parse than PR_ValueString
 =============
 */
-void PR_WriteUglyValueString (std::ofstream &f, etype_t type, eval_t *val)
+void PR_WriteUglyValueString (std::ostream &f, etype_t type, eval_t *val)
 {
 	int itype = (int) type;
 
@@ -698,7 +699,7 @@ FIXME: need to tag constants, doesn't really work
 ED_WriteGlobals
 =============
 */
-void ED_WriteGlobals (std::ofstream &f)
+void ED_WriteGlobals (std::ostream &f)
 {
 	f << "{\n";
 
@@ -974,6 +975,380 @@ char *ED_ParseEdict (char *data, edict_t *ent)
 }
 
 
+/*
+==============================================================================
+
+					BINARY ARCHIVING
+
+the binary savegame carries the progs field defs followed by the raw field block of every edict.  anything in a
+block that won't mean the same thing on load (strings, entity pointers, function numbers and field offsets) is
+swapped for a string table index or an edict number when the snapshot is taken, so the block can go straight back
+in when the field layout matches and be mapped across by name when the progs has changed.
+==============================================================================
+*/
+
+struct edsaveheader_t
+{
+	int numfields;
+	int entityfields;
+	int numedicts;
+	int stringsize;
+};
+
+struct edsavefield_t
+{
+	int type;
+	int ofs;
+	int name;	// string table offset
+};
+
+struct edsaveedict_t
+{
+	int free;
+	int alphaval;
+	// entityfields ints follow
+};
+
+
+static QNAMEHASH ed_savestringhash;
+
+static int ED_SaveString (std::vector<byte> &strings, char *s)
+{
+	// 0 is reserved for the null string so indexes are offset + 1
+	int idx = ed_savestringhash.Find (s);
+
+	if (idx < 0)
+	{
+		idx = strings.size () + 1;
+		strings.insert (strings.end (), s, s + strlen (s) + 1);
+
+		// the name pointer is only held for the duration of the snapshot, during which the string won't move
+		ed_savestringhash.Insert (s, idx);
+	}
+
+	return idx;
+}
+
+
+static bool ED_IsReferenceType (int type)
+{
+	type &= ~DEF_SAVEGLOBAL;
+
+	return (type == ev_string || type == ev_entity || type == ev_function || type == ev_field);
+}
+
+
+/*
+=============
+ED_SnapshotEdicts
+
+copies out all edicts for a binary save; this runs on the main thread and everything it produces is self-contained
+so that it can be compressed and written elsewhere while the game carries on
+=============
+*/
+void ED_SnapshotEdicts (std::vector<byte> &data)
+{
+	std::vector<edsavefield_t> fields (SVProgs->QC->numfielddefs);
+	std::vector<byte> strings;
+	int blocksize = sizeof (edsaveedict_t) + SVProgs->QC->entityfields * 4;
+	std::vector<byte> edicts (SVProgs->NumEdicts * blocksize);
+
+	// field table; also gathers the fields that need to be swapped out
+	std::vector<edsavefield_t *> refs;
+
+	for (int i = 0; i < SVProgs->QC->numfielddefs; i++)
+	{
+		ddef_t *d = &SVProgs->FieldDefs[i];
+
+		fields[i].type = d->type;
+		fields[i].ofs = d->ofs;
+		fields[i].name = ED_SaveString (strings, SVProgs->GetString (d->s_name));
+
+		if (ED_IsReferenceType (d->type)) refs.push_back (&fields[i]);
+	}
+
+	for (int i = 0; i < SVProgs->NumEdicts; i++)
+	{
+		edict_t *ed = GetEdictForNumber (i);
+		edsaveedict_t *rec = (edsaveedict_t *) &edicts[i * blocksize];
+		int *v = (int *) (rec + 1);
+
+		rec->free = ed->free;
+		rec->alphaval = ed->alphaval;
+
+		// free edicts are written out as empty, same as the text format
+		if (ed->free)
+		{
+			memset (v, 0, SVProgs->QC->entityfields * 4);
+			continue;
+		}
+
+		memcpy (v, &ed->v, SVProgs->QC->entityfields * 4);
+
+		for (int j = 0; j < refs.size (); j++)
+		{
+			int *val = &v[refs[j]->ofs];
+
+			if (!*val) continue;
+
+			switch (refs[j]->type & ~DEF_SAVEGLOBAL)
+			{
+			case ev_string:
+				*val = ED_SaveString (strings, SVProgs->GetString (*val));
+				break;
+
+			case ev_entity:
+				*val = GetNumberForEdict (ProgToEdict (*val));
+				break;
+
+			case ev_function:
+				if (*val > 0 && *val < SVProgs->QC->numfunctions)
+					*val = ED_SaveString (strings, SVProgs->GetString (SVProgs->Functions[*val].s_name));
+				else *val = 0;
+
+				break;
+
+			case ev_field:
+				{
+					ddef_t *def = ED_FieldAtOfs (*val);
+
+					if (def)
+						*val = ED_SaveString (strings, SVProgs->GetString (def->s_name));
+					else *val = 0;
+				}
+
+				break;
+			}
+		}
+	}
+
+	ed_savestringhash.Clear ();
+
+	// keep the edicts 4-byte aligned
+	while (strings.size () & 3) strings.push_back (0);
+
+	edsaveheader_t header = {(int) fields.size (), SVProgs->QC->entityfields, SVProgs->NumEdicts, (int) strings.size ()};
+
+	data.clear ();
+	data.insert (data.end (), (byte *) &header, (byte *) (&header + 1));
+	data.insert (data.end (), (byte *) &fields[0], (byte *) (&fields[0] + fields.size ()));
+	data.insert (data.end (), strings.begin (), strings.end ());
+	data.insert (data.end (), edicts.begin (), edicts.end ());
+}
+
+
+struct edloadfield_t
+{
+	int srcofs;
+	int dstofs;
+	int type;
+};
+
+
+struct edloadstate_t
+{
+	char *strings;
+	int stringsize;
+	int numedicts;
+
+	// per string table entry so that each name is only looked up once
+	std::vector<int> stringcache;
+	std::vector<int> funccache;
+	std::vector<int> fieldcache;
+};
+
+
+static bool ED_RestoreValue (edloadstate_t *ls, int *val, int type)
+{
+	int idx = *val;
+
+	// null string, world, no function or no field
+	if (!idx) return true;
+
+	if ((type & ~DEF_SAVEGLOBAL) == ev_entity)
+	{
+		if (idx < 0 || idx >= ls->numedicts) return false;
+
+		*val = EdictToProg (GetEdictForNumber (idx));
+		return true;
+	}
+
+	if (idx < 1 || idx > ls->stringsize) return false;
+
+	char *s = ls->strings + idx - 1;
+
+	switch (type & ~DEF_SAVEGLOBAL)
+	{
+	case ev_string:
+		if (ls->stringcache[idx] < 0)
+		{
+			char *newstring;
+			ls->stringcache[idx] = SVProgs->AllocString (strlen (s) + 1, &newstring);
+			strcpy (newstring, s);
+		}
+
+		*val = ls->stringcache[idx];
+		break;
+
+	case ev_function:
+		if (ls->funccache[idx] < 0)
+		{
+			dfunction_t *func = ED_FindFunction (s);
+
+			if (!func) Con_Printf ("Can't find function %s\n", s);
+
+			ls->funccache[idx] = func ? (func - SVProgs->Functions) : 0;
+		}
+
+		*val = ls->funccache[idx];
+		break;
+
+	case ev_field:
+		if (ls->fieldcache[idx] < 0)
+		{
+			ddef_t *def = ED_FindField (s);
+
+			if (!def) Con_Printf ("Can't find field %s\n", s);
+
+			ls->fieldcache[idx] = def ? def->ofs : 0;
+		}
+
+		*val = ls->fieldcache[idx];
+		break;
+	}
+
+	return true;
+}
+
+
+/*
+=============
+ED_LoadBinaryEdicts
+
+the reverse of ED_SnapshotEdicts; returns false if the data is damaged
+=============
+*/
+bool ED_LoadBinaryEdicts (byte *data, int size)
+{
+	if (size < sizeof (edsaveheader_t)) return false;
+
+	edsaveheader_t *header = (edsaveheader_t *) data;
+
+	if (header->numfields < 0 || header->entityfields < 0 || header->numedicts < 1 || header->stringsize < 0) return false;
+	if (header->numedicts > MAX_EDICTS) return false;
+
+	int blocksize = sizeof (edsaveedict_t) + header->entityfields * 4;
+	__int64 needed = sizeof (edsaveheader_t) + (__int64) header->numfields * sizeof (edsavefield_t) + header->stringsize + (__int64) header->numedicts * blocksize;
+
+	if (needed != size) return false;
+
+	edsavefield_t *fields = (edsavefield_t *) (header + 1);
+	edloadstate_t ls;
+
+	ls.strings = (char *) (fields + header->numfields);
+	ls.stringsize = header->stringsize;
+	ls.numedicts = header->numedicts;
+
+	// everything is looked up by string so make sure none of them can run off the end
+	if (ls.stringsize && ls.strings[ls.stringsize - 1]) return false;
+
+	ls.stringcache.assign (ls.stringsize + 1, -1);
+	ls.funccache.assign (ls.stringsize + 1, -1);
+	ls.fieldcache.assign (ls.stringsize + 1, -1);
+
+	byte *edicts = (byte *) ls.strings + ls.stringsize;
+
+	// if the field layout is unchanged the blocks can be copied straight in
+	bool samelayout = (header->numfields == SVProgs->QC->numfielddefs && header->entityfields == SVProgs->QC->entityfields);
+	std::vector<edloadfield_t> copyfields;
+	std::vector<edloadfield_t> reffields;
+
+	for (int i = 0; i < header->numfields; i++)
+	{
+		edsavefield_t *sf = &fields[i];
+
+		if (sf->name < 1 || sf->name > ls.stringsize) return false;
+
+		char *name = ls.strings + sf->name - 1;
+		int type = sf->type & ~DEF_SAVEGLOBAL;
+
+		if (type < 0 || type >= 8) return false;
+		if (sf->ofs < 0 || sf->ofs + type_size[type] > header->entityfields) return false;
+
+		if (samelayout)
+		{
+			ddef_t *d = &SVProgs->FieldDefs[i];
+
+			if (d->type != sf->type || d->ofs != sf->ofs || strcmp (SVProgs->GetString (d->s_name), name))
+				samelayout = false;
+		}
+
+		// skip _x, _y, _z vars as they're copied with the vector; only floats can be vector components
+		// so reference fields with names like foo_1 still get mapped and have their indexes restored
+		int len = strlen (name);
+
+		if (type == ev_float && len > 1 && name[len - 2] == '_') continue;
+
+		ddef_t *d = ED_FindField (name);
+
+		if (!d || (d->type & ~DEF_SAVEGLOBAL) != type) continue;
+
+		edloadfield_t lf = {sf->ofs, d->ofs, type};
+
+		copyfields.push_back (lf);
+
+		if (ED_IsReferenceType (type)) reffields.push_back (lf);
+	}
+
+	if (!samelayout) Con_DPrintf ("ED_LoadBinaryEdicts : progs fields have changed, mapping by name\n");
+
+	for (int i = 0; i < header->numedicts; i++)
+	{
+		edsaveedict_t *rec = (edsaveedict_t *) (edicts + i * blocksize);
+		int *v = (int *) (rec + 1);
+		edict_t *ent = GetEdictForNumber (i);
+		int *dst = (int *) &ent->v;
+
+		memset (&ent->v, 0, SVProgs->QC->entityfields * 4);
+		ent->free = !!rec->free;
+		ent->alphaval = rec->alphaval;
+
+		if (ent->free) continue;
+
+		if (samelayout)
+		{
+			memcpy (dst, v, header->entityfields * 4);
+
+			for (int j = 0; j < reffields.size (); j++)
+				if (!ED_RestoreValue (&ls, &dst[reffields[j].dstofs], reffields[j].type)) return false;
+		}
+		else
+		{
+			for (int j = 0; j < copyfields.size (); j++)
+			{
+				edloadfield_t *lf = &copyfields[j];
+
+				memcpy (&dst[lf->dstofs], &v[lf->srcofs], type_size[lf->type] * 4);
+
+				if (ED_IsReferenceType (lf->type) && !ED_RestoreValue (&ls, &dst[lf->dstofs], lf->type)) return false;
+			}
+		}
+	}
+
+	SVProgs->NumEdicts = header->numedicts;
+
+	// link them all into the bsp tree now that every entity reference can be resolved
+	for (int i = 0; i < SVProgs->NumEdicts; i++)
+	{
+		edict_t *ent = GetEdictForNumber (i);
+
+		if (!ent->free) SV_LinkEdict (ent, false);
+	}
+
+	return true;
+}
+
+
 struct entitystat_t
 {
 	char *name;
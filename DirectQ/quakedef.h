@@ -167,6 +167,10 @@ typedef char quakepath[260];
 // savegame version for all savegames
 #define	SAVEGAME_VERSION	5
 
+// binary savegames have the same text header but the edicts are packed; this is well clear of the text
+// version so that other engines will reject them cleanly
+#define	SAVEGAME_BINARY_VERSION	105
+
 #define	QUAKE_GAME			// as opposed to utilities
 
 #define	VERSION				1.09
@@ -109,6 +109,7 @@ struct entity_t
 	vec3_t					angles;
 	struct model_t			*model;			// NULL = no model
 	struct efrag_t			*efrag;
+	int						staticnum;		// index into the flattened efrags
 	int						frame;
 	float					syncbase;		// for client-side animations
 	int						effects;		// light, particals, etc
@@ -169,6 +170,9 @@ struct entity_t
 	class QTEXTURE *teximage;
 	class QTEXTURE *lumaimage;
 	class QTEXTURE *cmapimage;
+
+	// persistent instance slot for alias models (only valid while the slot is still owned by this entity)
+	int			instanceslot;
 };
 
 
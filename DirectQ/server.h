@@ -217,6 +217,11 @@ extern	cvar_t	timelimit;
 extern	server_static_t	svs;				// persistant server info
 extern	server_t		sv;					// local server
 
+// hashed name lookups into sv.model_precache and sv.sound_precache; the precache lists are
+// filled in order so Count is also the next free slot
+extern	QNAMEHASH	sv_modelprecachehash;
+extern	QNAMEHASH	sv_soundprecachehash;
+
 extern	client_t	*host_client;
 
 extern	edict_t		*sv_player;
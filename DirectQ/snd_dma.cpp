@@ -63,6 +63,7 @@ int   		paintedtime; 	// sample PAIRS
 
 
 std::vector<sfx_t *> known_sfx;
+QNAMEHASH known_sfx_hash;
 
 sfx_t		*ambient_sfx[NUM_AMBIENTS];
 
@@ -236,34 +237,23 @@ sfx_t *S_FindName (char *name)
 	}
 
 	// see if already loaded
-	int slot = -1;
+	int slot = known_sfx_hash.Find (name);
 
-	for (int i = 0; i < known_sfx.size (); i++)
+	if (slot >= 0)
 	{
-		if (!known_sfx[i])
-		{
-			// this is a reusable slot
-			slot = i;
-			continue;
-		}
-
-		if (!strcmp (known_sfx[i]->name, name))
-		{
-			known_sfx[i]->sndcache = NULL;
-			return known_sfx[i];
-		}
+		known_sfx[slot]->sndcache = NULL;
+		return known_sfx[slot];
 	}
 
 	// alloc a new SFX
 	sfx_t *sfx = (sfx_t *) MainHunk->Alloc (sizeof (sfx_t));
 
-	if (slot >= 0)
-		known_sfx[slot] = sfx;
-	else known_sfx.push_back (sfx);
-
 	strcpy (sfx->name, name);
 	sfx->sndcache = NULL;
 
+	known_sfx.push_back (sfx);
+	known_sfx_hash.Insert (sfx->name, known_sfx.size () - 1);
+
 	return sfx;
 }
 
@@ -273,6 +263,7 @@ void S_ClearSounds (void)
 	// on hunk so it doesn't need a free
 	// be sure to call this and MainHunk->FreeToLowMark (0) together!!!!
 	known_sfx.clear ();
+	known_sfx_hash.Clear ();
 }
 
 
@@ -430,6 +421,9 @@ void S_StartSound (int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float
 	if (!sfx) return;
 	if (nosound.value) return;
 
+	// don't start anything while skipping through a demo
+	if (cls.demoseeking) return;
+
 	int vol = fvol * 255;
 
 	// pick a channel to play on
@@ -464,6 +458,7 @@ void S_StartSound (int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float
 	}
 
 	target_chan->sfx = sfx;
+	target_chan->sc = sc;
 	target_chan->pos = 0.0;
 	target_chan->end = paintedtime + sc->length;
 
@@ -581,6 +576,7 @@ void S_StaticSound (sfx_t *sfx, vec3_t origin, float vol, float attenuation)
 	}
 
 	ss->sfx = sfx;
+	ss->sc = sc;
 	Vector3Copy (ss->origin, origin);
 	ss->master_vol = vol;
 	ss->dist_mult = (attenuation / 64) / sound_nominal_clip_dist.value;
@@ -609,7 +605,10 @@ void S_UpdateAmbientSounds (double frametime)
 	if (!l || !ambient_level.value)
 	{
 		for (int ambient_channel = 0; ambient_channel < NUM_AMBIENTS; ambient_channel++)
+		{
 			channels[ambient_channel].sfx = NULL;
+			channels[ambient_channel].sc = NULL;
+		}
 
 		return;
 	}
@@ -619,7 +618,9 @@ void S_UpdateAmbientSounds (double frametime)
 		channel_t *chan = &channels[ambient_channel];
 		float vol = 0;
 
+		// the cache is picked up once per frame here rather than per paint in the mixer
 		chan->sfx = ambient_sfx[ambient_channel];
+		chan->sc = chan->sfx ? S_LoadSound (chan->sfx) : NULL;
 
 		// was < 8 but we'll always keep some ambience
 		if ((vol = ambient_level.value * l->ambient_sound_level[ambient_channel]) < 0)
@@ -919,14 +920,14 @@ void S_SoundList (void)
 		if (!(sfx = known_sfx[i])) continue;
 		if (!(sc = sfx->sndcache)) continue;
 
-		size = sc->length * 2 * (sc->stereo + 1);
+		size = sc->length * sizeof (float) * (sc->stereo + 1);
 		total += size;
 
 		if (sc->loopstart >= 0)
 			Con_Printf ("L");
 		else Con_Printf (" ");
 
-		Con_Printf ("(%2db) %6i : %s\n", 16, size, sfx->name);
+		Con_Printf ("(%2db) %6i : %s\n", 32, size, sfx->name);
 	}
 
 	Con_Printf ("Total resident: %i\n", total);
@@ -973,10 +974,20 @@ void S_ClearPrecache (void)
 
 void S_BeginPrecaching (void)
 {
+	memset (&snd_LoadStats, 0, sizeof (snd_LoadStats));
 }
 
 
 void S_EndPrecaching (void)
 {
+	Con_DPrintf
+	(
+		"Loaded %i sounds (%i from cache) in %0.3f ms\n",
+		snd_LoadStats.numloaded,
+		snd_LoadStats.numcached,
+		(float) (snd_LoadStats.loadtime * 1000.0)
+	);
+
+	known_sfx_hash.Report ("sound registry");
 }
 
@@ -21,16 +21,75 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 
+#include <xmmintrin.h>
+
+cvar_t snd_cache ("snd_cache", "1", CVAR_ARCHIVE);
+
+snd_loadstats_t snd_LoadStats;
+
 
 /*
 ================
 ResampleSfx
+
+windowed-sinc polyphase resampler.  the filter is rebuilt only when the rate pair changes, which in practice
+means once per map as almost everything is 11025 in and shm->speed out.
 ================
 */
+#define SND_SINC_TAPS		16		// must be a multiple of 4 for the SSE kernel
+#define SND_SINC_PHASES		256
+
+static __declspec (align (16)) float snd_SincTable[SND_SINC_PHASES + 1][SND_SINC_TAPS];
+static int snd_SincInRate = 0;
+static int snd_SincOutRate = 0;
+
+
+int SND_ResampledLength (int samples, int inrate, int outrate)
+{
+	return (int) (((__int64) samples * (__int64) outrate) / (__int64) inrate);
+}
+
+
+void SND_BuildSincTable (int inrate, int outrate)
+{
+	if (inrate == snd_SincInRate && outrate == snd_SincOutRate) return;
+
+	// when downsampling the cutoff moves down to the output nyquist frequency
+	double cutoff = (outrate < inrate) ? (double) outrate / (double) inrate : 1.0;
+	double halfwidth = SND_SINC_TAPS / 2;
+
+	for (int p = 0; p <= SND_SINC_PHASES; p++)
+	{
+		double frac = (double) p / (double) SND_SINC_PHASES;
+		double sum = 0;
+
+		for (int t = 0; t < SND_SINC_TAPS; t++)
+		{
+			// distance from the output position to the input sample under this tap
+			double x = (double) (t - (SND_SINC_TAPS / 2 - 1)) - frac;
+			double sinc = (fabs (x) < 0.000001) ? cutoff : sin (D3DX_PI * x * cutoff) / (D3DX_PI * x);
+			double window = 0;
+
+			// blackman window
+			if (fabs (x) < halfwidth)
+				window = 0.42 + 0.5 * cos (D3DX_PI * x / halfwidth) + 0.08 * cos (2.0 * D3DX_PI * x / halfwidth);
+
+			snd_SincTable[p][t] = sinc * window;
+			sum += snd_SincTable[p][t];
+		}
+
+		// normalize so that each phase has unity gain
+		for (int t = 0; t < SND_SINC_TAPS; t++)
+			snd_SincTable[p][t] /= sum;
+	}
+
+	snd_SincInRate = inrate;
+	snd_SincOutRate = outrate;
+}
+
+
 void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, void *data)
 {
-	int		outcount;
-	int		srcsample;
 	sfxcache_t	*sc;
 
 	// not in memory
@@ -40,12 +99,18 @@ void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, void *data)
 		return;
 	}
 
+	int inlength = sc->length;
+
+	// yayyy - no more 8-bit sounds
+	sc->speed = shm->speed;
+	sc->stereo = 0;
+
 	if (inrate == shm->speed && inwidth == 2)
 	{
 		short *data16 = (short *) data;
 
 		for (int i = 0; i < sc->length; i++)
-			sc->data[i] = data16[i];
+			sc->data[i] = (float) data16[i];
 
 		return;
 	}
@@ -55,36 +120,171 @@ void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, void *data)
 		byte *data8 = (byte *) data;
 
 		for (int i = 0; i < sc->length; i++)
-			sc->data[i] = ((int) data8[i] - 128) << 8;
+			sc->data[i] = (float) (((int) data8[i] - 128) << 8);
 
 		return;
 	}
 
-	// pitch-shift the sound to the new frequency
-	float stepscale = (float) inrate / shm->speed;	// this is usually 0.5, 1, or 2
+	// convert the source to float with enough zero padding either side that the filter never reads outside it
+	int hunkmark = TempHunk->GetLowMark ();
+	float *padded = (float *) TempHunk->Alloc ((inlength + SND_SINC_TAPS) * sizeof (float));
+	float *src = &padded[SND_SINC_TAPS / 2 - 1];
 
-	outcount = sc->length / stepscale;
-	sc->length = outcount;
+	if (inwidth == 2)
+	{
+		for (int i = 0; i < inlength; i++)
+			src[i] = (float) ((short *) data)[i];
+	}
+	else
+	{
+		for (int i = 0; i < inlength; i++)
+			src[i] = (float) (((int) ((unsigned char *) data)[i] - 128) << 8);
+	}
 
-	if (sc->loopstart != -1)
-		sc->loopstart = sc->loopstart / stepscale;
+	SND_BuildSincTable (inrate, shm->speed);
 
-	// yayyy - no more 8-bit sounds
-	sc->speed = shm->speed;
-	sc->stereo = 0;
+	sc->length = SND_ResampledLength (inlength, inrate, shm->speed);
 
-	int samplefrac = 0;
-	int fracstep = stepscale * 256;
+	if (sc->loopstart != -1)
+		sc->loopstart = SND_ResampledLength (sc->loopstart, inrate, shm->speed);
+
+	// 32.32 fixed point source position
+	unsigned __int64 pos = 0;
+	unsigned __int64 step = ((unsigned __int64) inrate << 32) / (unsigned __int64) shm->speed;
 
-	for (int i = 0; i < outcount; i++)
+	for (int i = 0; i < sc->length; i++, pos += step)
 	{
-		srcsample = samplefrac >> 8;
-		samplefrac += fracstep;
+		// nearest phase to the fractional position; this can round up to SND_SINC_PHASES which is why the table has an extra row
+		float *in = &padded[(int) (pos >> 32)];
+		float *coeffs = snd_SincTable[(int) (((pos & 0xffffffff) + (1 << 23)) >> 24)];
+
+		__m128 acc = _mm_mul_ps (_mm_loadu_ps (&in[0]), _mm_load_ps (&coeffs[0]));
+
+		for (int t = 4; t < SND_SINC_TAPS; t += 4)
+			acc = _mm_add_ps (acc, _mm_mul_ps (_mm_loadu_ps (&in[t]), _mm_load_ps (&coeffs[t])));
+
+		// horizontal add
+		acc = _mm_add_ps (acc, _mm_movehl_ps (acc, acc));
+		acc = _mm_add_ss (acc, _mm_shuffle_ps (acc, acc, _MM_SHUFFLE (1, 1, 1, 1)));
+
+		_mm_store_ss (&sc->data[i], acc);
+	}
+
+	TempHunk->FreeToLowMark (hunkmark);
+}
+
+
+/*
+===============================================================================
+
+CONVERTED SOUND CACHE
+
+sounds are stored after conversion and resampling keyed by the CRC of the source file and the output rate,
+so that repeat loads can skip WAV parsing and resampling.
+
+===============================================================================
+*/
+
+#define SND_CACHE_IDENT		(('C' << 24) + ('D' << 16) + ('N' << 8) + 'S')
+#define SND_CACHE_VERSION	1
+
+struct sndcacheheader_t
+{
+	int ident;
+	int version;
+	unsigned int crc;
+	int srclength;
+	int speed;
+	int length;
+	int loopstart;
+};
+
+
+void S_GetCachePath (char *path, sfx_t *s)
+{
+	char cachename[MAX_QPATH];
+
+	// flatten the name so that we don't need to create a directory tree
+	Q_strncpy (cachename, s->name, MAX_QPATH - 1);
+
+	for (int i = 0; cachename[i]; i++)
+		if (cachename[i] == '/' || cachename[i] == '\\')
+			cachename[i] = '_';
+
+	Q_snprintf (path, MAX_PATH, "%s/cache/sound/%s.%i", com_gamedir, cachename, shm->speed);
+}
+
+
+sfxcache_t *S_LoadCachedSound (sfx_t *s, unsigned int crc, int srclength)
+{
+	if (!snd_cache.integer) return NULL;
+
+	char path[MAX_PATH];
+	sndcacheheader_t header;
+
+	S_GetCachePath (path, s);
+
+	std::ifstream f (path, std::ios::in | std::ios::binary);
+
+	if (!f.is_open ()) return NULL;
+
+	f.read ((char *) &header, sizeof (header));
+
+	// a stale or mismatched cache is just ignored and will be overwritten when the sound is converted
+	if (f.fail ()) return NULL;
+	if (header.ident != SND_CACHE_IDENT) return NULL;
+	if (header.version != SND_CACHE_VERSION) return NULL;
+	if (header.crc != crc) return NULL;
+	if (header.srclength != srclength) return NULL;
+	if (header.speed != shm->speed) return NULL;
+	if (header.length < 1) return NULL;
+
+	int hunkmark = MainHunk->GetLowMark ();
+	sfxcache_t *sc = (sfxcache_t *) MainHunk->FastAlloc (header.length * sizeof (float) + sizeof (sfxcache_t));
+
+	f.read ((char *) sc->data, header.length * sizeof (float));
 
-		if (inwidth == 2)
-			sc->data[i] = ((short *) data)[srcsample];
-		else sc->data[i] = ((int) ((unsigned char *) data)[srcsample] - 128) << 8;
+	if (f.fail ())
+	{
+		MainHunk->FreeToLowMark (hunkmark);
+		return NULL;
 	}
+
+	sc->length = header.length;
+	sc->loopstart = header.loopstart;
+	sc->speed = header.speed;
+	sc->stereo = 0;
+	sc->memsize = 0;
+
+	return sc;
+}
+
+
+void S_WriteCachedSound (sfx_t *s, sfxcache_t *sc, unsigned int crc, int srclength)
+{
+	if (!snd_cache.integer) return;
+
+	char path[MAX_PATH];
+	sndcacheheader_t header;
+
+	Sys_mkdir ("cache/sound");
+	S_GetCachePath (path, s);
+
+	std::ofstream f (path, std::ios::out | std::ios::binary);
+
+	if (!f.is_open ()) return;
+
+	header.ident = SND_CACHE_IDENT;
+	header.version = SND_CACHE_VERSION;
+	header.crc = crc;
+	header.srclength = srclength;
+	header.speed = sc->speed;
+	header.length = sc->length;
+	header.loopstart = sc->loopstart;
+
+	f.write ((char *) &header, sizeof (header));
+	f.write ((char *) sc->data, sc->length * sizeof (float));
+	f.close ();
 }
 
 
@@ -104,6 +304,8 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 		return s->sndcache;
 	}
 
+	double loadstart = Sys_ProfileTime ();
+
 	// load it in
 	char namebuffer[256];
 
@@ -120,7 +322,25 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 		return NULL;
 	}
 
-	wavinfo_t info = GetWavinfo (s->name, data, CQuakeFile::FileSize);
+	int filesize = CQuakeFile::FileSize;
+	unsigned int crc = CRC_Block32 (data, filesize);
+
+	// see if we've got a converted copy
+	sfxcache_t *sc = S_LoadCachedSound (s, crc, filesize);
+
+	if (sc)
+	{
+		s->sndcache = sc;
+		TempHunk->FreeToLowMark (hunkmark);
+
+		snd_LoadStats.numloaded++;
+		snd_LoadStats.numcached++;
+		snd_LoadStats.loadtime += Sys_ProfileTime () - loadstart;
+
+		return sc;
+	}
+
+	wavinfo_t info = GetWavinfo (s->name, data, filesize);
 
 	if (info.channels != 1)
 	{
@@ -130,13 +350,12 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 		return NULL;
 	}
 
-	float stepscale = (float) info.rate / shm->speed;
-	int len = info.samples / stepscale;
+	int len = SND_ResampledLength (info.samples, info.rate, shm->speed);
 
-	len = len * 2 * info.channels;
+	len = len * sizeof (float) * info.channels;
 
 	// because sounds now go on MainHunk they must be cleared between maps too - see Host_ClearMemory
-	sfxcache_t *sc = (sfxcache_t *) MainHunk->Alloc (len + sizeof (sfxcache_t));
+	sc = (sfxcache_t *) MainHunk->Alloc (len + sizeof (sfxcache_t));
 
 	if (!sc)
 	{
@@ -152,9 +371,13 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	sc->stereo = info.channels;
 
 	ResampleSfx (s, info.rate, info.width, data + info.dataofs);
+	S_WriteCachedSound (s, sc, crc, filesize);
 
 	TempHunk->FreeToLowMark (hunkmark);
 
+	snd_LoadStats.numloaded++;
+	snd_LoadStats.loadtime += Sys_ProfileTime () - loadstart;
+
 	return sc;
 }
 
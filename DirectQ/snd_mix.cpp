@@ -22,16 +22,19 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "winquake.h"
 
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
 extern LPDIRECTSOUNDBUFFER8 ds_SecondaryBuffer8;
 extern DWORD ds_SoundBufferSize;
 
 // use a larger paintbuffer to prevent sound stuttering/etc
 #define	PAINTBUF_SIZE	8192
 
-portable_samplepair_t *paintbuffer = NULL;
+// number of samples over which a change in channel volume is spread, to prevent clicks when sounds start, stop or move
+#define SND_VOLRAMP_SAMPLES	128
 
-int 	*snd_p, snd_linear_count;
-short	*snd_out;
+portable_samplepair_t *paintbuffer = NULL;
 
 
 // made this inline as it will be called fairly regularly
@@ -45,6 +48,32 @@ __inline void Snd_InitPaintBuffer (void)
 }
 
 
+void S_WritePaintSamples (short *out, portable_samplepair_t *in, int numpairs, float vol)
+{
+	float *src = (float *) in;
+	int numsamples = numpairs << 1;
+	int i;
+
+	__m128 mvol = _mm_set1_ps (vol);
+
+	// the saturating pack does the clamp to 16-bit for us
+	for (i = 0; i + 8 <= numsamples; i += 8)
+	{
+		__m128i lo = _mm_cvtps_epi32 (_mm_mul_ps (_mm_loadu_ps (&src[i]), mvol));
+		__m128i hi = _mm_cvtps_epi32 (_mm_mul_ps (_mm_loadu_ps (&src[i + 4]), mvol));
+
+		_mm_storeu_si128 ((__m128i *) &out[i], _mm_packs_epi32 (lo, hi));
+	}
+
+	// rounded the same way as the conversion above
+	for (; i < numsamples; i++)
+	{
+		int val = _mm_cvtss_si32 (_mm_set_ss (src[i] * vol));
+		out[i] = (val > 32767) ? 32767 : ((val < -32768) ? -32768 : val);
+	}
+}
+
+
 void S_TransferPaintBuffer (int endtime)
 {
 	// init the paintbuffer if we need to
@@ -53,16 +82,14 @@ void S_TransferPaintBuffer (int endtime)
 	// only support 16-bit stereo sound
 	int		lpos;
 	int		lpaintedtime;
+	int		linearcount;
 	DWORD	*pbuf;
 	DWORD	dwSize, dwSize2;
 	DWORD	*pbuf2;
 
-	snd_p = (int *) paintbuffer;
+	portable_samplepair_t *snd_p = paintbuffer;
 	lpaintedtime = paintedtime;
 
-	int snd_vol = volume.value * 256;
-	int val[2];
-
 	// attempt to get a lock on the sound buffer
 	if (!S_GetBufferLock (0, ds_SoundBufferSize, (LPVOID *) &pbuf, &dwSize, (LPVOID *) &pbuf2, &dwSize2, 0)) return;
 
@@ -70,25 +97,15 @@ void S_TransferPaintBuffer (int endtime)
 	{
 		// handle recirculating buffer issues
 		lpos = lpaintedtime & ((shm->samples >> 1) - 1);
+		linearcount = (shm->samples >> 1) - lpos;
 
-		snd_out = (short *) pbuf + (lpos << 1);
-		snd_linear_count = (shm->samples >> 1) - lpos;
-
-		if (lpaintedtime + snd_linear_count > endtime) snd_linear_count = endtime - lpaintedtime;
-
-		snd_linear_count <<= 1;
+		if (lpaintedtime + linearcount > endtime) linearcount = endtime - lpaintedtime;
 
 		// write a linear blast of samples
-		for (int l = 0; l < snd_linear_count; l += 2, snd_p += 2, snd_out += 2)
-		{
-			val[0] = (snd_p[0] * snd_vol) >> 8;
-			val[1] = (snd_p[1] * snd_vol) >> 8;
+		S_WritePaintSamples ((short *) pbuf + (lpos << 1), snd_p, linearcount, volume.value);
 
-			snd_out[0] = (val[0] > 32767) ? 32767 : ((val[0] < -32768) ? -32768 : val[0]);
-			snd_out[1] = (val[1] > 32767) ? 32767 : ((val[1] < -32768) ? -32768 : val[1]);
-		}
-
-		lpaintedtime += (snd_linear_count >> 1);
+		snd_p += linearcount;
+		lpaintedtime += linearcount;
 	}
 
 	ds_SecondaryBuffer8->Unlock (pbuf, dwSize, NULL, 0);
@@ -103,36 +120,141 @@ CHANNEL MIXING
 ===============================================================================
 */
 
-void SND_PaintChannelFrom16 (channel_t *ch, sfxcache_t *sc, int count)
+void SND_PaintChannel (channel_t *ch, sfxcache_t *sc, portable_samplepair_t *pb, int count)
 {
-	// init the paintbuffer if we need to
-	Snd_InitPaintBuffer ();
+	float *sfx = &sc->data[ch->pos];
+	float *dst = (float *) pb;
+	int i = 0;
+
+	// ramp from the volume we last mixed at towards the current spatialized volume
+	float leftvol = ch->mixleftvol;
+	float rightvol = ch->mixrightvol;
+	float lefttarget = (float) ch->leftvol * (1.0f / 256.0f);
+	float righttarget = (float) ch->rightvol * (1.0f / 256.0f);
+
+	// a change of volume starts a new ramp from wherever the last one got to; the step is fixed for the ramp so that it
+	// finishes in exactly SND_VOLRAMP_SAMPLES however many paints that's spread over
+	if (ch->leftvol != ch->rampleftvol || ch->rightvol != ch->ramprightvol)
+	{
+		ch->mixleftstep = (lefttarget - leftvol) / (float) SND_VOLRAMP_SAMPLES;
+		ch->mixrightstep = (righttarget - rightvol) / (float) SND_VOLRAMP_SAMPLES;
+		ch->rampleftvol = ch->leftvol;
+		ch->ramprightvol = ch->rightvol;
+		ch->rampsamples = SND_VOLRAMP_SAMPLES;
+	}
+
+	if (ch->rampsamples > 0)
+	{
+		int rampcount = min2 (count, ch->rampsamples);
+
+		for (; i < rampcount; i++)
+		{
+			leftvol += ch->mixleftstep;
+			rightvol += ch->mixrightstep;
 
-	int leftvol = ch->leftvol;
-	int rightvol = ch->rightvol;
+			dst[i * 2 + 0] += sfx[i] * leftvol;
+			dst[i * 2 + 1] += sfx[i] * rightvol;
+		}
+
+		ch->rampsamples -= rampcount;
+
+		// when the ramp finishes snap to the target so that float error doesn't leave it short
+		if (!ch->rampsamples)
+		{
+			leftvol = lefttarget;
+			rightvol = righttarget;
+		}
+
+		ch->mixleftvol = leftvol;
+		ch->mixrightvol = rightvol;
+	}
 
-	signed short *sfx = (signed short *) sc->data + ch->pos;
+	// constant volume for the rest; 4 mono source samples go to 4 stereo pairs per pass
+	__m128 mleft = _mm_set1_ps (leftvol);
+	__m128 mright = _mm_set1_ps (rightvol);
 
-	for (int i = 0; i < count; i++)
+	for (; i + 4 <= count; i += 4)
 	{
-		paintbuffer[i].left += (sfx[i] * leftvol) >> 8;
-		paintbuffer[i].right += (sfx[i] * rightvol) >> 8;
+		__m128 samples = _mm_loadu_ps (&sfx[i]);
+		__m128 l = _mm_mul_ps (samples, mleft);
+		__m128 r = _mm_mul_ps (samples, mright);
+
+		float *out = &dst[i * 2];
+
+		_mm_storeu_ps (&out[0], _mm_add_ps (_mm_loadu_ps (&out[0]), _mm_unpacklo_ps (l, r)));
+		_mm_storeu_ps (&out[4], _mm_add_ps (_mm_loadu_ps (&out[4]), _mm_unpackhi_ps (l, r)));
+	}
+
+	for (; i < count; i++)
+	{
+		dst[i * 2 + 0] += sfx[i] * leftvol;
+		dst[i * 2 + 1] += sfx[i] * rightvol;
 	}
 
 	ch->pos += count;
 }
 
 
+void S_MixChannels (channel_t *chans, int numchans, int starttime, int end)
+{
+	channel_t *ch = chans;
+	int ltime, count;
+
+	for (int i = 0; i < numchans; i++, ch++)
+	{
+		if (!ch->sfx) continue;
+
+		// the cache is looked up once when the sound is started so there's no need to touch the sfx here
+		sfxcache_t *sc = ch->sc;
+
+		if (!sc) continue;
+
+		// silent and not ramping down from a previous volume
+		if (!ch->leftvol && !ch->rightvol && !(ch->mixleftvol > 0) && !(ch->mixrightvol > 0)) continue;
+
+		ltime = starttime;
+
+		while (ltime < end)
+		{
+			// paint up to end
+			if (ch->end < end)
+				count = ch->end - ltime;
+			else count = end - ltime;
+
+			if (count > 0)
+			{
+				// paint at the correct offset so that a loop restart doesn't go back over the start of the buffer
+				SND_PaintChannel (ch, sc, &paintbuffer[ltime - starttime], count);
+				ltime += count;
+			}
+
+			// if at end of loop, restart
+			if (ltime >= ch->end)
+			{
+				if (sc->loopstart >= 0)
+				{
+					ch->pos = sc->loopstart;
+					ch->end = ltime + sc->length - ch->pos;
+				}
+				else
+				{
+					// channel just stopped
+					ch->sfx = NULL;
+					ch->sc = NULL;
+					break;
+				}
+			}
+		}
+	}
+}
+
+
 void S_PaintChannels (int endtime)
 {
 	// init the paintbuffer if we need to
 	Snd_InitPaintBuffer ();
 
-	int 	i;
 	int 	end;
-	channel_t *ch;
-	sfxcache_t	*sc;
-	int		ltime, count;
 
 	while (paintedtime < endtime)
 	{
@@ -145,50 +267,114 @@ void S_PaintChannels (int endtime)
 		memset (paintbuffer, 0, (end - paintedtime) * sizeof (portable_samplepair_t));
 
 		// paint in the channels.
-		ch = channels;
+		S_MixChannels (channels, total_channels, paintedtime, end);
 
-		for (i = 0; i < total_channels; i++, ch++)
-		{
-			if (!ch->sfx) continue;
-			if (!ch->leftvol && !ch->rightvol) continue;
-			if (!(sc = S_LoadSound (ch->sfx))) continue;
+		// transfer out according to DMA format
+		S_TransferPaintBuffer (end);
+		paintedtime = end;
+	}
+}
 
-			ltime = paintedtime;
 
-			while (ltime < end)
-			{
-				// paint up to end
-				if (ch->end < end)
-					count = ch->end - ltime;
-				else count = end - ltime;
+/*
+===============================================================================
 
-				if (count > 0)
-				{
-					SND_PaintChannelFrom16 (ch, sc, count);
-					ltime += count;
-				}
+MIXER BENCHMARK
 
-				// if at end of loop, restart
-				if (ltime >= ch->end)
-				{
-					if (sc->loopstart >= 0)
-					{
-						ch->pos = sc->loopstart;
-						ch->end = ltime + sc->length - ch->pos;
-					}
-					else
-					{
-						// channel just stopped
-						ch->sfx = NULL;
-						break;
-					}
-				}
-			}
-		}
+===============================================================================
+*/
 
-		// transfer out according to DMA format
-		S_TransferPaintBuffer (end);
-		paintedtime = end;
+void S_MixBench_f (void)
+{
+	// runs the mixer against synthetic channels and discards the output, so it doesn't need a sound device
+	Snd_InitPaintBuffer ();
+
+	int numchans = 128;
+	int seconds = 10;
+
+	if (Cmd_Argc () > 1) numchans = atoi (Cmd_Argv (1));
+	if (Cmd_Argc () > 2) seconds = atoi (Cmd_Argv (2));
+
+	if (numchans < 1) numchans = 1;
+	if (numchans > MAX_CHANNELS) numchans = MAX_CHANNELS;
+	if (seconds < 1) seconds = 1;
+
+	int speed = shm ? shm->speed : 44100;
+	int hunkmark = TempHunk->GetLowMark ();
+
+	// a looped second of noise
+	sfxcache_t *sc = (sfxcache_t *) TempHunk->Alloc (sizeof (sfxcache_t) + speed * sizeof (float));
+	sfx_t benchsfx;
+
+	sc->length = speed;
+	sc->loopstart = 0;
+	sc->speed = speed;
+	sc->stereo = 0;
+
+	for (int i = 0; i < speed; i++)
+		sc->data[i] = (float) ((int) (Q_fastrand () & 0xffff) - 32768);
+
+	strcpy (benchsfx.name, "mixbench");
+	benchsfx.sndcache = sc;
+
+	// fill the channels with staggered positions and varying volumes so that ramps and loop restarts are exercised
+	channel_t *chans = (channel_t *) TempHunk->Alloc (numchans * sizeof (channel_t));
+
+	for (int i = 0; i < numchans; i++)
+	{
+		chans[i].sfx = &benchsfx;
+		chans[i].sc = sc;
+		chans[i].pos = (i * 997) % speed;
+		chans[i].end = sc->length - chans[i].pos;
+		chans[i].leftvol = (i * 37) & 255;
+		chans[i].rightvol = 255 - chans[i].leftvol;
+	}
+
+	short *nullout = (short *) TempHunk->Alloc (PAINTBUF_SIZE * 2 * sizeof (short));
+	int totalsamples = speed * seconds;
+	double mixtime = 0;
+	double writetime = 0;
+
+	for (int ltime = 0; ltime < totalsamples;)
+	{
+		int end = ltime + PAINTBUF_SIZE;
+
+		if (end > totalsamples) end = totalsamples;
+
+		double t1 = Sys_ProfileTime ();
+
+		memset (paintbuffer, 0, (end - ltime) * sizeof (portable_samplepair_t));
+		S_MixChannels (chans, numchans, ltime, end);
+
+		double t2 = Sys_ProfileTime ();
+
+		S_WritePaintSamples (nullout, paintbuffer, end - ltime, volume.value);
+
+		mixtime += t2 - t1;
+		writetime += Sys_ProfileTime () - t2;
+
+		// move the volumes about a little so that the next block ramps
+		for (int i = 0; i < numchans; i++)
+			chans[i].leftvol = (chans[i].leftvol + 17) & 255;
+
+		ltime = end;
 	}
+
+	Con_Printf
+	(
+		"mixed %i channels x %i seconds at %i Hz: %0.3f ms mix, %0.3f ms write (%0.1fx realtime)\n",
+		numchans, seconds, speed,
+		(float) (mixtime * 1000.0),
+		(float) (writetime * 1000.0),
+		(float) ((double) seconds / (mixtime + writetime))
+	);
+
+	TempHunk->FreeToLowMark (hunkmark);
+
+	// the paintbuffer is also used by the live mixer so don't leave our junk in it
+	memset (paintbuffer, 0, PAINTBUF_SIZE * sizeof (portable_samplepair_t));
 }
 
+
+cmd_t S_MixBench_Cmd ("snd_mixbench", S_MixBench_f);
+
@@ -28,14 +28,14 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 typedef enum {SIS_SUCCESS, SIS_FAILURE, SIS_NOTAVAIL} sndinitstat;
 
 
-// !!! if this is changed, it much be changed in asm_i386.h too !!!
+// the mixer works in float so that volume scaling and clamping can be deferred to the final write
 struct portable_samplepair_t
 {
-	int left;
-	int right;
+	float left;
+	float right;
 };
 
-// !!! if this is changed, it much be changed in asm_i386.h too !!!
+// sample data is converted to float in 16-bit range at load time so that the mixer doesn't need to
 struct sfxcache_t
 {
 	int 	length;
@@ -43,7 +43,7 @@ struct sfxcache_t
 	int 	speed;
 	int 	stereo;
 	int		memsize;
-	short	data[1];		// variable sized
+	float	data[1];		// variable sized
 };
 
 
@@ -66,10 +66,10 @@ struct dma_t
 	unsigned char	*buffer;
 };
 
-// !!! if this is changed, it much be changed in asm_i386.h too !!!
 struct channel_t
 {
 	sfx_t	*sfx;			// sfx number
+	sfxcache_t *sc;			// cached when the sound is started so that the mixer doesn't need to look it up
 	int		leftvol;		// 0-255 volume
 	int		rightvol;		// 0-255 volume
 	int		end;			// end time in global paintsamples
@@ -80,6 +80,13 @@ struct channel_t
 	vec3_t	origin;			// origin of sound effect
 	vec_t	dist_mult;		// distance multiplier (attenuation/clipK)
 	float	master_vol;		// 0-255 master volume
+	float	mixleftvol;		// volumes that were last mixed at, for ramping to leftvol/rightvol
+	float	mixrightvol;
+	float	mixleftstep;	// per-sample change of the ramp in progress
+	float	mixrightstep;
+	int		rampleftvol;	// the leftvol/rightvol that the ramp in progress is heading for
+	int		ramprightvol;
+	int		rampsamples;	// samples left until it gets there
 };
 
 struct wavinfo_t
@@ -163,6 +170,16 @@ extern bool	snd_initialized;
 
 extern int		snd_blocked;
 
+// load timing for the precache report
+struct snd_loadstats_t
+{
+	int numloaded;
+	int numcached;
+	double loadtime;
+};
+
+extern snd_loadstats_t snd_LoadStats;
+
 void S_LocalSound (char *s);
 sfxcache_t *S_LoadSound (sfx_t *s);
 void S_BlockSound (bool block);
@@ -32,6 +32,9 @@ int		sv_max_datagram = MAX_DATAGRAM; // Must be set so client will work without
 server_t		sv;
 server_static_t	svs;
 
+QNAMEHASH	sv_modelprecachehash;
+QNAMEHASH	sv_soundprecachehash;
+
 // inline model names for precache - extra space for an extra digit
 char localmodels[MAX_MODELS][8];
 
@@ -245,12 +248,8 @@ void SV_StartSound (edict_t *entity, int channel, char *sample, int s_volume, fl
 	if (sv.datagram.cursize > MAX_DATAGRAM2 - 16)
 		return;
 
-	// find precache number for sound
-	for (sound_num = 1; sound_num < MAX_SOUNDS && sv.sound_precache[sound_num]; sound_num++)
-		if (!strcmp (sample, sv.sound_precache[sound_num]))
-			break;
-
-	if (sound_num == MAX_SOUNDS || !sv.sound_precache[sound_num])
+	// find precache number for sound (0 is the dummy slot)
+	if ((sound_num = sv_soundprecachehash.Find (sample)) < 1)
 	{
 		Con_DPrintf ("SV_StartSound: %s not precached\n", sample);
 		return;
@@ -362,6 +361,7 @@ void SV_SendServerinfo (client_t *client)
 		{
 			// Con_Printf ("Forcing precache of %s\n", Damage2Hack);
 			sv.sound_precache[i] = Damage2Hack;
+			sv_soundprecachehash.Insert (Damage2Hack, i);
 			break;
 		}
 
@@ -1166,15 +1166,14 @@ int SV_ModelIndex (char *name)
 	if (!name || !name[0])
 		return 0;
 
-	for (i = 0; i < MAX_MODELS && sv.model_precache[i]; i++)
-		if (!strcmp (sv.model_precache[i], name))
-			return i;
+	if ((i = sv_modelprecachehash.Find (name)) >= 0)
+		return i;
 
 	// fixme - precache it if not already precached!!!
-	if (i == MAX_MODELS) Host_Error ("SV_ModelIndex: model %s not precached (i == MAX_MODELS)", name);
-	if (!sv.model_precache[i]) Host_Error ("SV_ModelIndex: model %s not precached (!sv.model_precache[i])", name);
+	if (sv_modelprecachehash.Count () == MAX_MODELS) Host_Error ("SV_ModelIndex: model %s not precached (i == MAX_MODELS)", name);
+	Host_Error ("SV_ModelIndex: model %s not precached (!sv.model_precache[i])", name);
 
-	return i;
+	return 0;
 }
 
 
@@ -1476,10 +1475,17 @@ void SV_SpawnServer (char *server)
 
 	static char	dummy[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 
+	sv_soundprecachehash.Clear ();
+	sv_modelprecachehash.Clear ();
+
 	sv.sound_precache[0] = dummy;
 	sv.model_precache[0] = dummy;
 	sv.model_precache[1] = sv.modelname;
 
+	sv_soundprecachehash.Insert (sv.sound_precache[0], 0);
+	sv_modelprecachehash.Insert (sv.model_precache[0], 0);
+	sv_modelprecachehash.Insert (sv.model_precache[1], 1);
+
 	for (i = 1; i < sv.worldmodel->brushhdr->numsubmodels; i++)
 	{
 		// prevent crash
@@ -1489,6 +1495,7 @@ void SV_SpawnServer (char *server)
 		if (sv.Protocol == PROTOCOL_VERSION_NQ && i > 255) break;
 
 		sv.model_precache[1 + i] = localmodels[i];
+		sv_modelprecachehash.Insert (sv.model_precache[1 + i], 1 + i);
 		sv.models[i + 1] = Mod_ForName (localmodels[i], false);
 	}
 
@@ -1533,6 +1540,9 @@ void SV_SpawnServer (char *server)
 		if (host_client->active)
 			SV_SendServerinfo (host_client);
 
+	sv_modelprecachehash.Report ("model precache");
+	sv_soundprecachehash.Report ("sound precache");
+
 	Con_DPrintf ("Allocated %i edicts\n", SVProgs->NumEdicts);
 	Con_DPrintf ("Server spawned.\n");
 	Con_DPrintf ("SV_SpawnServer took %f seconds\n", Sys_DoubleTime () - beginloadtime);
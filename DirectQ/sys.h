@@ -36,6 +36,34 @@ void Sys_Quit (int ExitCode);
 
 double Sys_DoubleTime (void);
 
+// raw QPC time for profiling counters; doesn't go through the timer thread so it's cheap and can be called from any thread
+double Sys_ProfileTime (void);
+
+// spreads func (index, data) for every index in [0, count) over the worker threads and returns when all are done
+typedef void (*sysjobfunc_t) (int index, void *data);
+void Sys_ParallelFor (int count, sysjobfunc_t func, void *data);
+
+// a job in a graph; func is called with the job's own index.  a job may only depend on jobs that come before it in the
+// array (so the array order is always a valid serial order) and mainthread jobs are only ever run by the calling thread
+#define MAX_JOB_DEPS	4
+
+struct sysjob_t
+{
+	char *name;
+	sysjobfunc_t func;
+	bool mainthread;
+	int deps[MAX_JOB_DEPS];
+	int numdeps;
+
+	// filled in when the graph is run
+	volatile LONG waiting;
+	volatile LONG claimed;
+	double time;
+};
+
+// runs every job in the graph, each as soon as the jobs it depends on are done, and returns when all are done
+void Sys_RunJobGraph (sysjob_t *jobs, int numjobs, void *data, bool serial);
+
 void Sys_SendKeyEvents (void);
 // Perform Key_Event () callbacks until the input que is empty
 
@@ -252,6 +252,18 @@ double Sys_GetDoubleTime (void)
 }
 
 
+double Sys_ProfileTime (void)
+{
+	static __int64 qpcfreq = 0;
+	__int64 qpccurr;
+
+	if (!qpcfreq) QueryPerformanceFrequency ((LARGE_INTEGER *) &qpcfreq);
+	QueryPerformanceCounter ((LARGE_INTEGER *) &qpccurr);
+
+	return (double) qpccurr / (double) qpcfreq;
+}
+
+
 DWORD WINAPI Sys_TimerThread (LPVOID lpThreadParameter)
 {
 	// get an initial time
@@ -298,6 +310,313 @@ double Sys_DoubleTime (void)
 }
 
 
+/*
+================
+Sys_ParallelFor
+
+runs func for every index in [0, count) spread over a small pool of worker threads with the calling thread
+joining in; returns when all are done.  func must be thread-safe: no hunk allocations, no console output
+and no errors.
+================
+*/
+#define MAX_SYS_WORKERS		8
+
+struct sysworkers_t
+{
+	HANDLE hThreads[MAX_SYS_WORKERS];
+	HANDLE hWorkSemaphore;
+	HANDLE hDoneEvent;
+	int NumWorkers;
+	bool Initialized;
+
+	// the job currently being run
+	sysjobfunc_t Func;
+	void *Data;
+	int Count;
+	volatile LONG NextIndex;
+	volatile LONG NumBusy;
+
+	// set while the workers are running a job so that anything run from within it doesn't try to reuse them
+	bool Active;
+};
+
+sysworkers_t sys_Workers;
+
+
+void Sys_RunParallelJob (void)
+{
+	for (;;)
+	{
+		int index = InterlockedIncrement (&sys_Workers.NextIndex) - 1;
+
+		if (index >= sys_Workers.Count) break;
+
+		sys_Workers.Func (index, sys_Workers.Data);
+	}
+}
+
+
+DWORD WINAPI Sys_WorkerThread (LPVOID lpThreadParameter)
+{
+	for (;;)
+	{
+		WaitForSingleObject (sys_Workers.hWorkSemaphore, INFINITE);
+
+		Sys_RunParallelJob ();
+
+		// the last one out signals that the job is complete
+		if (!InterlockedDecrement (&sys_Workers.NumBusy))
+			SetEvent (sys_Workers.hDoneEvent);
+	}
+
+	return 0;
+}
+
+
+void Sys_InitWorkers (void)
+{
+	sys_Workers.Initialized = true;
+	sys_Workers.NumWorkers = 0;
+
+	// one less than the number of cores as the calling thread also does work
+	int numworkers = (int) SysInfo.dwNumberOfProcessors - 1;
+
+	if (numworkers > MAX_SYS_WORKERS) numworkers = MAX_SYS_WORKERS;
+	if (numworkers < 1) return;
+
+	sys_Workers.hWorkSemaphore = CreateSemaphore (NULL, 0, MAX_SYS_WORKERS, NULL);
+	sys_Workers.hDoneEvent = CreateEvent (NULL, TRUE, FALSE, NULL);
+
+	if (!sys_Workers.hWorkSemaphore || !sys_Workers.hDoneEvent) return;
+
+	for (int i = 0; i < numworkers; i++)
+	{
+		if (!(sys_Workers.hThreads[i] = CreateThread (NULL, 0, Sys_WorkerThread, NULL, 0, NULL)))
+			break;
+
+		sys_Workers.NumWorkers++;
+	}
+}
+
+
+void Sys_ParallelFor (int count, sysjobfunc_t func, void *data)
+{
+	if (!sys_Workers.Initialized) Sys_InitWorkers ();
+
+	// called from inside a job graph; the workers are already busy so just run it inline
+	if (sys_Workers.Active)
+	{
+		for (int i = 0; i < count; i++)
+			func (i, data);
+
+		return;
+	}
+
+	sys_Workers.Func = func;
+	sys_Workers.Data = data;
+	sys_Workers.Count = count;
+	sys_Workers.NextIndex = 0;
+
+	// not worth waking anything up for
+	if (count < 2 || !sys_Workers.NumWorkers)
+	{
+		Sys_RunParallelJob ();
+		return;
+	}
+
+	// don't wake more workers than there is work for
+	int numworkers = (count - 1 < sys_Workers.NumWorkers) ? count - 1 : sys_Workers.NumWorkers;
+
+	sys_Workers.NumBusy = numworkers;
+	sys_Workers.Active = true;
+	ResetEvent (sys_Workers.hDoneEvent);
+	ReleaseSemaphore (sys_Workers.hWorkSemaphore, numworkers, NULL);
+
+	// this thread works too, then waits for the rest to finish
+	Sys_RunParallelJob ();
+	WaitForSingleObject (sys_Workers.hDoneEvent, INFINITE);
+	sys_Workers.Active = false;
+}
+
+
+/*
+================
+Sys_RunJobGraph
+
+every thread that's running the graph pulls whatever job is ready next off the shared list, so a worker that finishes
+early just picks up the next thing instead of sitting idle.  graphs are small (a handful of jobs per frame) so a scan
+of the list is all that's needed to find one.  a thread that finds nothing ready sleeps until a finished job releases
+another; each job that becomes ready posts once to the semaphore for the threads that can run it, so a post can at
+worst wake a thread that finds somebody else already took the job.
+================
+*/
+struct sysjobgraph_t
+{
+	sysjob_t *Jobs;
+	int NumJobs;
+	void *Data;
+	volatile LONG NumDone;
+
+	// posted when a job becomes ready; the calling thread waits on both as it can run either kind of job
+	HANDLE hReadySemaphore;
+	HANDLE hMainReadySemaphore;
+	int NumWorkers;
+};
+
+sysjobgraph_t sys_JobGraph;
+
+
+void Sys_RunJob (sysjob_t *job, int index, void *data)
+{
+	double start = Sys_ProfileTime ();
+
+	job->func (index, data);
+	job->time = Sys_ProfileTime () - start;
+}
+
+
+sysjob_t *Sys_ClaimJob (bool mainthread, int *index)
+{
+	for (int i = 0; i < sys_JobGraph.NumJobs; i++)
+	{
+		sysjob_t *job = &sys_JobGraph.Jobs[i];
+
+		if (job->claimed) continue;
+		if (job->waiting) continue;
+		if (job->mainthread != mainthread) continue;
+
+		// somebody else may have got in first
+		if (InterlockedCompareExchange (&job->claimed, 1, 0)) continue;
+
+		index[0] = i;
+		return job;
+	}
+
+	return NULL;
+}
+
+
+void Sys_RunJobGraphLoop (bool mainthread)
+{
+	while (sys_JobGraph.NumDone < sys_JobGraph.NumJobs)
+	{
+		int index = 0;
+		sysjob_t *job = NULL;
+
+		// the calling thread gives priority to jobs that nobody else can run
+		if (mainthread) job = Sys_ClaimJob (true, &index);
+		if (!job) job = Sys_ClaimJob (false, &index);
+
+		if (!job)
+		{
+			// nothing ready yet so sleep until something is
+			if (mainthread)
+			{
+				HANDLE hReady[2] = {sys_JobGraph.hMainReadySemaphore, sys_JobGraph.hReadySemaphore};
+				WaitForMultipleObjects (2, hReady, FALSE, INFINITE);
+			}
+			else WaitForSingleObject (sys_JobGraph.hReadySemaphore, INFINITE);
+
+			continue;
+		}
+
+		Sys_RunJob (job, index, sys_JobGraph.Data);
+
+		// release anything that was waiting on this job (dependents always come later in the array)
+		for (int i = index + 1; i < sys_JobGraph.NumJobs; i++)
+		{
+			sysjob_t *dep = &sys_JobGraph.Jobs[i];
+
+			for (int d = 0; d < dep->numdeps; d++)
+			{
+				if (dep->deps[d] != index) continue;
+				if (InterlockedDecrement (&dep->waiting)) continue;
+
+				// that was the last thing it was waiting on so wake a thread that can run it
+				ReleaseSemaphore (dep->mainthread ? sys_JobGraph.hMainReadySemaphore : sys_JobGraph.hReadySemaphore, 1, NULL);
+			}
+		}
+
+		// the last job out wakes everything that's still sleeping so that they can see the graph is done
+		if (InterlockedIncrement (&sys_JobGraph.NumDone) == sys_JobGraph.NumJobs)
+		{
+			ReleaseSemaphore (sys_JobGraph.hReadySemaphore, sys_JobGraph.NumWorkers, NULL);
+			ReleaseSemaphore (sys_JobGraph.hMainReadySemaphore, 1, NULL);
+		}
+	}
+}
+
+
+void Sys_JobGraphWorker (int index, void *data)
+{
+	Sys_RunJobGraphLoop (false);
+}
+
+
+void Sys_RunJobGraph (sysjob_t *jobs, int numjobs, void *data, bool serial)
+{
+	if (!sys_Workers.Initialized) Sys_InitWorkers ();
+
+	int numworkerjobs = 0;
+
+	for (int i = 0; i < numjobs; i++)
+	{
+		for (int d = 0; d < jobs[i].numdeps; d++)
+			if (jobs[i].deps[d] >= i)
+				Sys_Error ("Sys_RunJobGraph : job \"%s\" depends on a later job", jobs[i].name);
+
+		jobs[i].waiting = jobs[i].numdeps;
+		jobs[i].claimed = 0;
+		jobs[i].time = 0;
+
+		if (!jobs[i].mainthread) numworkerjobs++;
+	}
+
+	if (!sys_JobGraph.hReadySemaphore) sys_JobGraph.hReadySemaphore = CreateSemaphore (NULL, 0, 0x7fffffff, NULL);
+	if (!sys_JobGraph.hMainReadySemaphore) sys_JobGraph.hMainReadySemaphore = CreateSemaphore (NULL, 0, 0x7fffffff, NULL);
+
+	// the array order is always a valid order to run them in
+	if (serial || sys_Workers.Active || !sys_Workers.NumWorkers || !numworkerjobs || !sys_JobGraph.hReadySemaphore || !sys_JobGraph.hMainReadySemaphore)
+	{
+		for (int i = 0; i < numjobs; i++)
+			Sys_RunJob (&jobs[i], i, data);
+
+		return;
+	}
+
+	sys_JobGraph.Jobs = jobs;
+	sys_JobGraph.NumJobs = numjobs;
+	sys_JobGraph.Data = data;
+	sys_JobGraph.NumDone = 0;
+
+	// don't wake more workers than there are jobs they can run
+	int numworkers = (numworkerjobs < sys_Workers.NumWorkers) ? numworkerjobs : sys_Workers.NumWorkers;
+
+	// posts left over from the last graph (for jobs that were taken by a thread that was already awake) would only
+	// cause wakeups that find nothing, but clear them anyway
+	while (WaitForSingleObject (sys_JobGraph.hReadySemaphore, 0) == WAIT_OBJECT_0);
+	while (WaitForSingleObject (sys_JobGraph.hMainReadySemaphore, 0) == WAIT_OBJECT_0);
+
+	sys_JobGraph.NumWorkers = numworkers;
+
+	// each worker takes one index and stays in the graph until it's done
+	sys_Workers.Func = Sys_JobGraphWorker;
+	sys_Workers.Data = NULL;
+	sys_Workers.Count = numworkers;
+	sys_Workers.NextIndex = 0;
+
+	sys_Workers.NumBusy = numworkers;
+	sys_Workers.Active = true;
+	ResetEvent (sys_Workers.hDoneEvent);
+	ReleaseSemaphore (sys_Workers.hWorkSemaphore, numworkers, NULL);
+
+	// this thread runs the main thread jobs and anything else it can get, then waits for the rest to finish
+	Sys_RunJobGraphLoop (true);
+	WaitForSingleObject (sys_Workers.hDoneEvent, INFINITE);
+	sys_Workers.Active = false;
+}
+
+
 void Sys_SendKeyEvents (void)
 {
 	MSG msg;